@@ -0,0 +1,21 @@
+/** @file CRC.c
+ * @see CRC.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "CRC.h"
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+unsigned short CRCUpdate(unsigned short CRC, unsigned char Byte)
+{
+	unsigned char Value;
+	
+	// Process the whole byte at once instead of looping on each bit (there is no room for a lookup table)
+	Value = (CRC >> 8) ^ Byte;
+	Value ^= Value >> 4;
+	CRC = (CRC << 8) ^ ((unsigned short) Value << 12) ^ ((unsigned short) Value << 5) ^ Value;
+	
+	return CRC;
+}
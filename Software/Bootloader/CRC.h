@@ -0,0 +1,24 @@
+/** @file CRC.h
+ * Compute the CRC-16 (CCITT polynomial 0x1021, initial value 0xFFFF) used to check the flash content and the received data.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_CRC_H
+#define H_CRC_H
+
+//--------------------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------------------
+/** The value a CRC computation must start from. */
+#define CRC_INITIAL_VALUE 0xFFFF
+
+//--------------------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------------------
+/** Add a byte to a CRC computation.
+ * @param CRC The CRC computed so far (use CRC_INITIAL_VALUE for the first byte).
+ * @param Byte The byte to add.
+ * @return The updated CRC.
+ */
+unsigned short CRCUpdate(unsigned short CRC, unsigned char Byte);
+
+#endif
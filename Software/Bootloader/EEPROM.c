@@ -0,0 +1,48 @@
+/** @file EEPROM.c
+ * @see EEPROM.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "EEPROM.h"
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+unsigned char EEPROMReadByte(unsigned short Address)
+{
+	// Load the address
+	eeadrh = Address >> 8;
+	eeadr = (unsigned char) Address;
+	
+	// Read the byte
+	eecon1 = 0; // Access data EEPROM memory
+	eecon1.RD = 1;
+	return eedata;
+}
+
+void EEPROMWriteByte(unsigned short Address, unsigned char Byte)
+{
+	unsigned char Is_Interrupt_Enabled;
+	
+	// Load the address and the data
+	eeadrh = Address >> 8;
+	eeadr = (unsigned char) Address;
+	eedata = Byte;
+	
+	// Configure a write cycle
+	eecon1 = 0x04; // Access data EEPROM memory, allow writing to the data EEPROM
+	
+	// Execute the special write sequence, it must not be interrupted
+	Is_Interrupt_Enabled = intcon.GIE;
+	intcon.GIE = 0;
+	eecon2 = 0x55;
+	eecon2 = 0xAA;
+	eecon1.WR = 1; // Start the write cycle
+	if (Is_Interrupt_Enabled) intcon.GIE = 1;
+	
+	// Wait for the write cycle to terminate
+	while (eecon1.WR);
+	
+	// Disable writing to memory
+	eecon1.WREN = 0;
+}
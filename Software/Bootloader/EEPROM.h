@@ -0,0 +1,32 @@
+/** @file EEPROM.h
+ * Read from and write to the data EEPROM. The bootloader and the firmware share the EEPROM content, so keep this file identical in both projects.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_EEPROM_H
+#define H_EEPROM_H
+
+//--------------------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------------------
+/** The address of the flag telling the bootloader to stay in programming mode. */
+#define EEPROM_ADDRESS_BOOTLOADER_FLAG 0
+/** The bootloader flag value set by the firmware to request a firmware update. Any other value lets the bootloader start the firmware. */
+#define EEPROM_BOOTLOADER_FLAG_UPDATE_REQUESTED 0x5A
+
+//--------------------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------------------
+/** Read a byte from the data EEPROM.
+ * @param Address The byte address.
+ * @return The byte value.
+ */
+unsigned char EEPROMReadByte(unsigned short Address);
+
+/** Write a byte to the data EEPROM and wait for the write cycle to terminate (it lasts about 4ms).
+ * @param Address The byte address.
+ * @param Byte The value to write.
+ * @note The interrupts are disabled during the write unlock sequence.
+ */
+void EEPROMWriteByte(unsigned short Address, unsigned char Byte);
+
+#endif
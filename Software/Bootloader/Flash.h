@@ -1,23 +1,49 @@
-/** @file Flash.h
- * Read from and write to the flash memory.
- * @author Adrien RICCIARDI
- */
-#ifndef H_FLASH_H
-#define H_FLASH_H
-
-//--------------------------------------------------------------------------------------------------
-// Constants
-//--------------------------------------------------------------------------------------------------
-/** A program memory block size in bytes. */
-#define FLASH_BLOCK_SIZE 64
-
-//--------------------------------------------------------------------------------------------------
-// Functions
-//--------------------------------------------------------------------------------------------------
-/** Erase the specified block and write the provided data.
- * @param Block_Address The block beginning address.
- * @param Pointer_Data_Buffer The data to write. The buffer must be FLASH_BLOCK_SIZE bytes.
- */
-void FlashWriteBlock(unsigned long Block_Address, unsigned char *Pointer_Data_Buffer);
-
-#endif
+/** @file Flash.h
+ * Read from and write to the flash memory.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_FLASH_H
+#define H_FLASH_H
+
+//--------------------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------------------
+/** A program memory block size in bytes. */
+#define FLASH_BLOCK_SIZE 64
+
+//--------------------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------------------
+/** Read a whole block.
+ * @param Block_Address The block beginning address.
+ * @param Pointer_Data_Buffer On output, contain the block content. The buffer must be FLASH_BLOCK_SIZE bytes.
+ */
+void FlashReadBlock(unsigned long Block_Address, unsigned char *Pointer_Data_Buffer);
+
+/** Compare the content of a block with the provided data.
+ * @param Block_Address The block beginning address.
+ * @param Pointer_Data_Buffer The data to compare to. The buffer must be FLASH_BLOCK_SIZE bytes.
+ * @return 0 if the block content is different,
+ * @return 1 if the block already contains the provided data.
+ */
+unsigned char FlashIsBlockEqual(unsigned long Block_Address, unsigned char *Pointer_Data_Buffer);
+
+/** Tell if a block is already erased.
+ * @param Block_Address The block beginning address.
+ * @return 0 if at least one byte of the block is programmed,
+ * @return 1 if all the block bytes are set to 0xFF.
+ */
+unsigned char FlashIsBlockErased(unsigned long Block_Address);
+
+/** Erase the specified block, leaving all its bytes set to 0xFF.
+ * @param Block_Address The block beginning address.
+ */
+void FlashEraseBlock(unsigned long Block_Address);
+
+/** Erase the specified block and write the provided data.
+ * @param Block_Address The block beginning address.
+ * @param Pointer_Data_Buffer The data to write. The buffer must be FLASH_BLOCK_SIZE bytes.
+ */
+void FlashWriteBlock(unsigned long Block_Address, unsigned char *Pointer_Data_Buffer);
+
+#endif
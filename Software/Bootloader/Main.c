@@ -1,126 +1,626 @@
-/** @file Main.c
- * Allow to flash a new firmware without using a programmer.
- * @author Adrien RICCIARDI
- */
-#include <system.h>
-#include "Flash.h"
-#include "Led.h"
-#include "UART.h"
-
-//--------------------------------------------------------------------------------------------------
-// Microcontroller configuration
-//--------------------------------------------------------------------------------------------------
-#pragma DATA _CONFIG1H, _IESO_OFF_1H & _FCMEN_OFF_1H & _PRICLKEN_ON_1H & _PLLCFG_ON_1H & _FOSC_INTIO67_1H // Disable oscillator switchover mode, disable fail-safe clock monitor, always enable primary clock, always enable PLL, select the internal oscillator block
-#pragma DATA _CONFIG2L, _BORV_285_2L & _BOREN_SBORDIS_2L & _PWRTEN_ON_2L // Use the highest Brown-out reset voltage level, enable the Brown-out reset in hardware only, enable the Power-up timer
-#pragma DATA _CONFIG2H, _WDTEN_OFF_2H // Disable the watchdog timer in hardware
-#pragma DATA _CONFIG3H, _MCLRE_INTMCLR_3H & _HFOFST_OFF_3H & _PBADEN_OFF_3H & _CCP2MX_PORTC1_3H // Disable /MCLR, wait for the system clock to stabilize before starting the core, PORTB pins are configured as digital I/O, CCP2 is multiplexed with RC1
-#pragma DATA _CONFIG4L, _DEBUG_OFF_4L & _XINST_OFF_4L & _LVP_OFF_4L & _STVREN_ON_4L // Disable the background debugger, disable the extended instruction set, disable the Single-supply ICSP, reset the MCU if a stack overflow/underflow occurs
-#pragma DATA _CONFIG5L, _CP3_OFF_5L & _CP2_OFF_5L & _CP1_OFF_5L & _CP0_OFF_5L // Disable all code protections
-#pragma DATA _CONFIG5H, _CPD_OFF_5H & _CPB_OFF_5H // Disable the data EEPROM and the Boot block code protections
-#pragma DATA _CONFIG6L, _WRT3_OFF_6L & _WRT2_OFF_6L & _WRT1_OFF_6L & _WRT0_OFF_6L // Disable all write protections
-#pragma DATA _CONFIG6H, _WRTD_OFF_6H & _WRTB_OFF_6H & _WRTC_OFF_6H // Disable data EEPROM, Boot block and configuration registers write protection
-#pragma DATA _CONFIG7L, _EBTR3_OFF_7L & _EBTR2_OFF_7L & _EBTR1_OFF_7L & _EBTR0_OFF_7L // Disable all table read protections
-#pragma DATA _CONFIG7H, _EBTRB_OFF_7H // Disable Boot block table read protection
-
-// Configure clock frequency
-#pragma CLOCK_FREQ 64000000
-
-//--------------------------------------------------------------------------------------------------
-// Constants and macros
-//--------------------------------------------------------------------------------------------------
-/** The firmware base address. */
-#define MAIN_FIRMWARE_BASE_ADDRESS 0x300
-
-/** The protocol magic number. */
-#define MAIN_PROTOCOL_MAGIC_NUMBER 0xA5
-/** The bootloader acknowledges that it has received and flashed a block. */
-#define MAIN_PROTOCOL_ACKNOWLEDGE 0x42
-/** How many milliseconds to wait for the PC to answer. */
-#define MAIN_PROTOCOL_ANSWER_WAITING_TIME 200 // Warning : this value is stored on an unsigned char
-
-//--------------------------------------------------------------------------------------------------
-// Private functions
-//--------------------------------------------------------------------------------------------------
-/** High-priority interrupt redirection to the firmware code. */
-static void MainHighPriorityInterruptRedirection(void) @ 0x08
-{
-	asm goto MAIN_FIRMWARE_BASE_ADDRESS + 0x08;
-}
-
-/** Low-priority interrupt redirection to the firmware code. */
-static void MainLowPriorityInterruptRedirection(void) @ 0x18
-{
-	asm goto MAIN_FIRMWARE_BASE_ADDRESS + 0x18;
-}
-
-//--------------------------------------------------------------------------------------------------
-// Entry point
-//--------------------------------------------------------------------------------------------------
-void main(void)
-{
-	unsigned char Byte, i, Block_Buffer[FLASH_BLOCK_SIZE], Bytes_To_Receive_Count;
-	unsigned short Firmware_Size;
-	unsigned long Block_Address = MAIN_FIRMWARE_BASE_ADDRESS;
-	
-	// Set core clock to 64MHz
-	osctune = 0x40; // Enable the 4x PLL
-	osccon2 = 0; // Disable the secondary clock, disable the primary clock external oscillator circuit
-	osccon = 0x78; // Set internal oscillator block frequency to 16MHz, use the clock defined by FOSC bits, use primary clock as core clock
-	while (!osccon2.PLLRDY); // Wait for the PLL to lock
-	
-	// Initialize the peripherals
-	LedInitialize();
-	UARTInitialize();
-	
-	LedOnRed();
-	
-	// Send an handshake code to the PC
-	UARTWriteByte(MAIN_PROTOCOL_MAGIC_NUMBER);
-	
-	// Wait some time for the PC to answer
-	for (i = 0; i < MAIN_PROTOCOL_ANSWER_WAITING_TIME; i++)
-	{
-		// Stop waiting if the correct answer has been received
-		if (UARTIsByteReceived())
-		{
-			if (UARTReadByte() == MAIN_PROTOCOL_MAGIC_NUMBER) break;
-		}
-		delay_ms(1);
-	}
-	
-	// The waiting loop has been interrupted before its end, so the PC answered
-	if (i < MAIN_PROTOCOL_ANSWER_WAITING_TIME)
-	{		
-		// Receive the firmware size
-		Firmware_Size = (UARTReadByte() << 8) | UARTReadByte();
-		
-		// Receive the firmware data and flash it
-		while (Firmware_Size > 0)
-		{
-			// Compute the amount of bytes to receive
-			if (Firmware_Size >= FLASH_BLOCK_SIZE) Bytes_To_Receive_Count = FLASH_BLOCK_SIZE;
-			else Bytes_To_Receive_Count = (unsigned char) Firmware_Size;
-		
-			// Receive up to a full block of data
-			for (i = 0; i < Bytes_To_Receive_Count; i++) Block_Buffer[i] = UARTReadByte();
-			
-			// Flash the block
-			FlashWriteBlock(Block_Address, Block_Buffer);
-			Block_Address += FLASH_BLOCK_SIZE;
-			
-			// Send an acknowledge to the PC
-			UARTWriteByte(MAIN_PROTOCOL_ACKNOWLEDGE);
-			
-			Firmware_Size -= Bytes_To_Receive_Count;
-		}
-			
-		// Reboot the microcontroller
-		delay_ms(1); // Let enough time to transmit the last acknowledge
-		asm reset;
-	}
-	// Boot the firmware
-	else asm goto MAIN_FIRMWARE_BASE_ADDRESS;
-	
-	// Safety infinite loop
-	while (1);
+/** @file Main.c
+ * Allow to flash a new firmware without using a programmer.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "CRC.h"
+#include "EEPROM.h"
+#include "Flash.h"
+#include "Led.h"
+#include "UART.h"
+
+//--------------------------------------------------------------------------------------------------
+// Microcontroller configuration
+//--------------------------------------------------------------------------------------------------
+#pragma DATA _CONFIG1H, _IESO_OFF_1H & _FCMEN_OFF_1H & _PRICLKEN_ON_1H & _PLLCFG_ON_1H & _FOSC_INTIO67_1H // Disable oscillator switchover mode, disable fail-safe clock monitor, always enable primary clock, always enable PLL, select the internal oscillator block
+#pragma DATA _CONFIG2L, _BORV_285_2L & _BOREN_SBORDIS_2L & _PWRTEN_ON_2L // Use the highest Brown-out reset voltage level, enable the Brown-out reset in hardware only, enable the Power-up timer
+#pragma DATA _CONFIG2H, _WDTEN_OFF_2H // Disable the watchdog timer in hardware
+#pragma DATA _CONFIG3H, _MCLRE_INTMCLR_3H & _HFOFST_OFF_3H & _PBADEN_OFF_3H & _CCP2MX_PORTC1_3H // Disable /MCLR, wait for the system clock to stabilize before starting the core, PORTB pins are configured as digital I/O, CCP2 is multiplexed with RC1
+#pragma DATA _CONFIG4L, _DEBUG_OFF_4L & _XINST_OFF_4L & _LVP_OFF_4L & _STVREN_ON_4L // Disable the background debugger, disable the extended instruction set, disable the Single-supply ICSP, reset the MCU if a stack overflow/underflow occurs
+#pragma DATA _CONFIG5L, _CP3_OFF_5L & _CP2_OFF_5L & _CP1_OFF_5L & _CP0_OFF_5L // Disable all code protections
+#pragma DATA _CONFIG5H, _CPD_OFF_5H & _CPB_OFF_5H // Disable the data EEPROM and the Boot block code protections
+#pragma DATA _CONFIG6L, _WRT3_OFF_6L & _WRT2_OFF_6L & _WRT1_OFF_6L & _WRT0_OFF_6L // Disable all write protections
+#pragma DATA _CONFIG6H, _WRTD_OFF_6H & _WRTB_OFF_6H & _WRTC_OFF_6H // Disable data EEPROM, Boot block and configuration registers write protection
+#pragma DATA _CONFIG7L, _EBTR3_OFF_7L & _EBTR2_OFF_7L & _EBTR1_OFF_7L & _EBTR0_OFF_7L // Disable all table read protections
+#pragma DATA _CONFIG7H, _EBTRB_OFF_7H // Disable Boot block table read protection
+
+// Configure clock frequency
+#pragma CLOCK_FREQ 64000000
+
+//--------------------------------------------------------------------------------------------------
+// Constants and macros
+//--------------------------------------------------------------------------------------------------
+/** The firmware base address, right after the microcontroller 2KB boot block the bootloader lives in (the bootloader outgrew the 768 bytes available below the first 0x300 base address). */
+#define MAIN_FIRMWARE_BASE_ADDRESS 0x800
+/** How many flash blocks are available to the firmware. */
+#define MAIN_FIRMWARE_BLOCKS_COUNT ((0x10000 - MAIN_FIRMWARE_BASE_ADDRESS) / FLASH_BLOCK_SIZE)
+
+/** The protocol magic number. */
+#define MAIN_PROTOCOL_MAGIC_NUMBER 0xA5
+/** The bootloader protocol version, sent after the handshake code with the firmware base address so the PC can refuse to program a firmware built for another bootloader (the first bootloader did not send anything). */
+#define MAIN_PROTOCOL_VERSION 2
+/** The bootloader acknowledges that it has received and flashed a block. */
+#define MAIN_PROTOCOL_ACKNOWLEDGE_BLOCK_WRITTEN 0x42
+/** The bootloader acknowledges that it has received a block which was already present in the flash memory, so it has not been rewritten. */
+#define MAIN_PROTOCOL_ACKNOWLEDGE_BLOCK_SKIPPED 0x43
+
+/** The first byte of the frame sent by the PC to check that the new baud rate works. */
+#define MAIN_PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE 0x55
+/** The second byte of the frame sent by the PC to check that the new baud rate works. */
+#define MAIN_PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE 0xAA
+/** How much time to wait for each probe byte, in units of 100us. */
+#define MAIN_PROTOCOL_BAUD_RATE_PROBE_WAITING_TIME 2000
+
+/** How many blocks the PC can send before waiting for an acknowledge. */
+#define MAIN_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT 8
+
+/** The bootloader received a corrupted block, or did not receive the whole block in time, so the block has not been written. */
+#define MAIN_PROTOCOL_ACKNOWLEDGE_BLOCK_CORRUPTED 0x44
+
+/** The blocks are transmitted compressed (see MainReceiveCompressedBlock() for the format). */
+#define MAIN_PROTOCOL_BLOCKS_FLAG_COMPRESSED 0x01
+/** Each block is followed by the CRC of its 16-bit index and of its data (decompressed if needed), transmitted most significant byte first. */
+#define MAIN_PROTOCOL_BLOCKS_FLAG_CRC 0x02
+
+/** How many timer 5 overflows (32.768ms each) to wait for a byte before considering that the PC stopped transmitting. */
+#define MAIN_PROTOCOL_RECEPTION_TIMEOUT 4
+/** How many timer 5 overflows (32.768ms each) to wait for the PC to answer the handshake code before starting the firmware. */
+#define MAIN_PROTOCOL_HANDSHAKE_TIMEOUT 16
+
+/** How many bytes are needed to store one presence bit for each firmware block. */
+#define MAIN_BLOCK_MAP_SIZE ((MAIN_FIRMWARE_BLOCKS_COUNT + 7) / 8)
+
+/** Convert a block index relative to the firmware base address to the block absolute address.
+ * @param Block_Index The block index.
+ */
+#define MAIN_CONVERT_BLOCK_INDEX_TO_ADDRESS(Block_Index) (MAIN_FIRMWARE_BASE_ADDRESS + ((unsigned long) (Block_Index) << 6)) // The block size is 64 bytes
+
+//--------------------------------------------------------------------------------------------------
+// Private types
+//--------------------------------------------------------------------------------------------------
+/** All commands the PC can send once the programming mode is entered. */
+typedef enum
+{
+	MAIN_PROTOCOL_COMMAND_UPLOAD_FIRMWARE, //!< Program the whole firmware starting from the specified block, only the non-blank blocks are transmitted.
+	MAIN_PROTOCOL_COMMAND_GET_BLOCKS_CRC, //!< Send the CRC of a range of firmware blocks.
+	MAIN_PROTOCOL_COMMAND_WRITE_BLOCKS, //!< Program only the provided blocks, each one is transmitted with its index.
+	MAIN_PROTOCOL_COMMAND_REBOOT, //!< Leave the programming mode.
+	MAIN_PROTOCOL_COMMAND_SET_BAUD_RATE //!< Switch to a faster baud rate, falling back to the default one if the PC probe is not received.
+} TMainProtocolCommand;
+
+//--------------------------------------------------------------------------------------------------
+// Private variables
+//--------------------------------------------------------------------------------------------------
+/** Hold all blocks of a window until they are flashed. */
+static unsigned char Main_Window_Buffer[MAIN_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT * FLASH_BLOCK_SIZE];
+/** The index of each block stored in the window buffer (used only when the blocks are not sequential). */
+static unsigned short Main_Window_Blocks_Indexes[MAIN_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT];
+/** The CRC transmitted with each block stored in the window buffer. */
+static unsigned short Main_Window_Blocks_CRC[MAIN_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT];
+
+/** Set when the PC stopped transmitting in the middle of a command or sent a malformed compressed block, all following receptions immediately fail until the next command. */
+static unsigned char Main_Is_Reception_Timed_Out;
+
+/** How the blocks of the command being executed are transmitted (a combination of MAIN_PROTOCOL_BLOCKS_FLAG_xxx values). */
+static unsigned char Main_Blocks_Flags;
+
+/** Tell which firmware blocks are sent by the PC (bit set) and which ones are blank and must only be erased (bit cleared). */
+static unsigned char Main_Block_Map[MAIN_BLOCK_MAP_SIZE];
+
+//--------------------------------------------------------------------------------------------------
+// Private functions
+//--------------------------------------------------------------------------------------------------
+/** High-priority interrupt redirection to the firmware code. */
+static void MainHighPriorityInterruptRedirection(void) @ 0x08
+{
+	asm goto MAIN_FIRMWARE_BASE_ADDRESS + 0x08;
+}
+
+/** Low-priority interrupt redirection to the firmware code. */
+static void MainLowPriorityInterruptRedirection(void) @ 0x18
+{
+	asm goto MAIN_FIRMWARE_BASE_ADDRESS + 0x18;
+}
+
+/** Tell if a block is transmitted by the PC or if it is blank.
+ * @param Block_Index The block index relative to the firmware base address.
+ * @return 0 if the block is blank,
+ * @return a non-zero value if the block content is transmitted.
+ */
+static unsigned char MainIsBlockPresent(unsigned short Block_Index)
+{
+	return Main_Block_Map[Block_Index >> 3] & (1 << (Block_Index & 0x07));
+}
+
+/** Wait for a byte during a limited amount of time.
+ * @return The received byte, or 0xFF if the PC stopped transmitting (in this case Main_Is_Reception_Timed_Out is set).
+ * @note The timer 5 can be used here because the firmware boot time is meaningless once the programming mode is entered (the microcontroller is reset before starting the firmware).
+ */
+static unsigned char MainReceiveByte(void)
+{
+	unsigned char Overflows_Count = 0;
+	
+	// Do not wait anymore if the PC is known to have stopped transmitting
+	if (Main_Is_Reception_Timed_Out) return 0xFF;
+	
+	pir5.TMR5IF = 0;
+	while (!UARTIsByteReceived())
+	{
+		if (pir5.TMR5IF)
+		{
+			pir5.TMR5IF = 0;
+			Overflows_Count++;
+			if (Overflows_Count >= MAIN_PROTOCOL_RECEPTION_TIMEOUT)
+			{
+				Main_Is_Reception_Timed_Out = 1;
+				return 0xFF;
+			}
+		}
+	}
+	return UARTReadByte();
+}
+
+/** Discard all received bytes until the PC stops transmitting, so the next command is correctly synchronized. */
+static void MainDiscardReceivedBytes(void)
+{
+	Main_Is_Reception_Timed_Out = 0;
+	while (!Main_Is_Reception_Timed_Out) MainReceiveByte();
+}
+
+/** Receive a 16-bit value transmitted most significant byte first.
+ * @return The received value.
+ */
+static unsigned short MainReceiveWord(void)
+{
+	unsigned short Word;
+	
+	Word = MainReceiveByte() << 8;
+	Word |= MainReceiveByte();
+	return Word;
+}
+
+/** Receive a compressed block and decompress it on the fly. The block is made of the following tokens :
+ * - 0x00 to 0x3F : (Token + 1) literal bytes follow,
+ * - 0x40 to 0x7F : the next byte must be repeated ((Token & 0x3F) + 1) times,
+ * - 0x80 to 0xFF : copy ((Token & 0x7F) + 1) bytes located at the distance given by the next byte backward in the block.
+ * @param Pointer_Block On output, contain the decompressed block data.
+ * @note The PC never sends compressed blocks faster than 230400 bit/s (PROTOCOL_COMPRESSED_TRANSFER_MAXIMUM_BAUD_RATE in the command line interface), so a byte is received every 43.4us (694 instruction cycles). The 2-byte UART FIFO and the byte being shifted in give 3 byte times (2083 cycles) to expand the longest token, a 64-byte copy lasts about 1300 cycles. Check this budget again before allowing a faster baud rate.
+ * @note A token that would read before the block start or write past its end aborts the reception like a timeout does, so the whole window is reported as corrupted.
+ */
+static void MainReceiveCompressedBlock(unsigned char *Pointer_Block)
+{
+	unsigned char Token, Count, Byte, Distance, i = 0;
+	
+	while (i < FLASH_BLOCK_SIZE)
+	{
+		Token = MainReceiveByte();
+		
+		// Back-reference
+		if (Token & 0x80)
+		{
+			Count = (Token & 0x7F) + 1;
+			Distance = MainReceiveByte();
+			if ((Distance == 0) || (Distance > i) || (Count > FLASH_BLOCK_SIZE - i))
+			{
+				Main_Is_Reception_Timed_Out = 1;
+				return;
+			}
+			
+			while (Count > 0)
+			{
+				Pointer_Block[i] = Pointer_Block[i - Distance];
+				i++;
+				Count--;
+			}
+		}
+		// Repeated byte
+		else if (Token & 0x40)
+		{
+			Count = (Token & 0x3F) + 1;
+			Byte = MainReceiveByte();
+			if (Count > FLASH_BLOCK_SIZE - i)
+			{
+				Main_Is_Reception_Timed_Out = 1;
+				return;
+			}
+			
+			while (Count > 0)
+			{
+				Pointer_Block[i] = Byte;
+				i++;
+				Count--;
+			}
+		}
+		// Literal bytes
+		else
+		{
+			Count = Token + 1;
+			if (Count > FLASH_BLOCK_SIZE - i)
+			{
+				Main_Is_Reception_Timed_Out = 1;
+				return;
+			}
+			
+			while (Count > 0)
+			{
+				Pointer_Block[i] = MainReceiveByte();
+				i++;
+				Count--;
+			}
+		}
+	}
+}
+
+/** Receive the content of a whole block, decompressing it if needed, and its CRC if any.
+ * @param Pointer_Block On output, contain the block data.
+ * @param Pointer_CRC On output, contain the transmitted CRC (left untouched if no CRC is transmitted).
+ */
+static void MainReceiveBlock(unsigned char *Pointer_Block, unsigned short *Pointer_CRC)
+{
+	unsigned char i;
+	
+	if (Main_Blocks_Flags & MAIN_PROTOCOL_BLOCKS_FLAG_COMPRESSED) MainReceiveCompressedBlock(Pointer_Block);
+	else
+	{
+		for (i = 0; i < FLASH_BLOCK_SIZE; i++) Pointer_Block[i] = MainReceiveByte();
+	}
+	
+	if (Main_Blocks_Flags & MAIN_PROTOCOL_BLOCKS_FLAG_CRC) *Pointer_CRC = MainReceiveWord();
+}
+
+/** Check a received block against its transmitted CRC. The check is done once the whole window is received, because computing the CRC is too slow to be done while receiving at high baud rates.
+ * @param Block_Index The block index relative to the firmware base address.
+ * @param Pointer_Block The block data.
+ * @param CRC The transmitted CRC.
+ * @return 0 if the block is corrupted,
+ * @return 1 if the block is valid or if no CRC is transmitted.
+ */
+static unsigned char MainIsBlockValid(unsigned short Block_Index, unsigned char *Pointer_Block, unsigned short CRC)
+{
+	unsigned short Computed_CRC;
+	unsigned char i;
+	
+	if (!(Main_Blocks_Flags & MAIN_PROTOCOL_BLOCKS_FLAG_CRC)) return 1;
+	
+	Computed_CRC = CRCUpdate(CRC_INITIAL_VALUE, Block_Index >> 8);
+	Computed_CRC = CRCUpdate(Computed_CRC, (unsigned char) Block_Index);
+	for (i = 0; i < FLASH_BLOCK_SIZE; i++) Computed_CRC = CRCUpdate(Computed_CRC, Pointer_Block[i]);
+	
+	if (Computed_CRC == CRC) return 1;
+	return 0;
+}
+
+/** Write a received block only if the flash does not contain the same data yet, then acknowledge it.
+ * @param Block_Address The block absolute address.
+ * @param Pointer_Block The block data.
+ * @note The PC does not send anything until the whole window is acknowledged, so the acknowledge can be sent while flashing the next blocks.
+ */
+static void MainProgramBlock(unsigned long Block_Address, unsigned char *Pointer_Block)
+{
+	if (FlashIsBlockEqual(Block_Address, Pointer_Block)) UARTWriteByte(MAIN_PROTOCOL_ACKNOWLEDGE_BLOCK_SKIPPED);
+	else
+	{
+		FlashWriteBlock(Block_Address, Pointer_Block);
+		UARTWriteByte(MAIN_PROTOCOL_ACKNOWLEDGE_BLOCK_WRITTEN);
+	}
+}
+
+/** Handle the MAIN_PROTOCOL_COMMAND_UPLOAD_FIRMWARE command. The command is aborted after a window containing a corrupted block, so the PC can retransmit the corrupted blocks and then resume the upload after this window. */
+static void MainUploadFirmware(void)
+{
+	unsigned char Window_Blocks_Count, Received_Blocks_Count, Is_Window_Corrupted, *Pointer_Block;
+	unsigned short Firmware_Size, Blocks_Count, Block_Index, Window_First_Block_Index, Map_Index;
+	unsigned long Block_Address;
+	
+	// Receive the firmware size
+	Firmware_Size = MainReceiveWord();
+	Blocks_Count = (Firmware_Size + FLASH_BLOCK_SIZE - 1) / FLASH_BLOCK_SIZE;
+	
+	// Receive the block to start from (it is not 0 when resuming an interrupted upload)
+	Block_Index = MainReceiveWord();
+	
+	// The command header has no CRC, so a corrupted size must not overflow the block map nor make the bootloader erase blocks outside of the firmware area
+	if ((Blocks_Count > MAIN_FIRMWARE_BLOCKS_COUNT) || (Block_Index > Blocks_Count))
+	{
+		MainDiscardReceivedBytes();
+		return;
+	}
+	Block_Address = MAIN_CONVERT_BLOCK_INDEX_TO_ADDRESS(Block_Index);
+	
+	// Receive how many blocks the PC will send before waiting for an acknowledge
+	Window_Blocks_Count = MainReceiveByte();
+	if ((Window_Blocks_Count == 0) || (Window_Blocks_Count > MAIN_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT)) Window_Blocks_Count = MAIN_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT;
+	
+	// Receive how the blocks are transmitted
+	Main_Blocks_Flags = MainReceiveByte();
+	
+	// Receive the map telling which blocks are not blank
+	for (Map_Index = 0; Map_Index < (Blocks_Count + 7) / 8; Map_Index++) Main_Block_Map[Map_Index] = MainReceiveByte();
+	
+	// Do not write anything if the command was not fully received
+	if (Main_Is_Reception_Timed_Out) return;
+	
+	// Receive the firmware data and flash it
+	while (Block_Index < Blocks_Count)
+	{
+		// Receive a whole window back-to-back (the core is stalled during a flash erase or write cycle and the UART FIFO is only 2 bytes deep, so nothing can be received while flashing)
+		Window_First_Block_Index = Block_Index;
+		Pointer_Block = Main_Window_Buffer;
+		Received_Blocks_Count = 0;
+		while ((Received_Blocks_Count < Window_Blocks_Count) && (Block_Index < Blocks_Count))
+		{
+			// Only non-blank blocks are transmitted
+			if (MainIsBlockPresent(Block_Index))
+			{
+				MainReceiveBlock(Pointer_Block, &Main_Window_Blocks_CRC[Received_Blocks_Count]);
+				Pointer_Block += FLASH_BLOCK_SIZE;
+				Received_Blocks_Count++;
+			}
+			Block_Index++;
+		}
+		
+		// Flash all valid received blocks and erase the blank ones located between them, leaving untouched the blocks that already have the right content
+		Pointer_Block = Main_Window_Buffer;
+		Received_Blocks_Count = 0;
+		Is_Window_Corrupted = 0;
+		for (; Window_First_Block_Index < Block_Index; Window_First_Block_Index++)
+		{
+			if (MainIsBlockPresent(Window_First_Block_Index))
+			{
+				if (Main_Is_Reception_Timed_Out || !MainIsBlockValid(Window_First_Block_Index, Pointer_Block, Main_Window_Blocks_CRC[Received_Blocks_Count]))
+				{
+					UARTWriteByte(MAIN_PROTOCOL_ACKNOWLEDGE_BLOCK_CORRUPTED);
+					Is_Window_Corrupted = 1;
+				}
+				else MainProgramBlock(Block_Address, Pointer_Block);
+				Pointer_Block += FLASH_BLOCK_SIZE;
+				Received_Blocks_Count++;
+			}
+			else if (!FlashIsBlockErased(Block_Address)) FlashEraseBlock(Block_Address);
+			Block_Address += FLASH_BLOCK_SIZE;
+		}
+		
+		// Let the PC retransmit the corrupted blocks
+		if (Is_Window_Corrupted)
+		{
+			MainDiscardReceivedBytes();
+			return;
+		}
+	}
+}
+
+/** Handle the MAIN_PROTOCOL_COMMAND_GET_BLOCKS_CRC command. */
+static void MainSendBlocksCRC(void)
+{
+	unsigned char i;
+	unsigned short Block_Index, Blocks_Count, CRC;
+	
+	// Receive the range of blocks to check
+	Block_Index = MainReceiveWord();
+	Blocks_Count = MainReceiveWord();
+	if (Main_Is_Reception_Timed_Out) return;
+	
+	while (Blocks_Count > 0)
+	{
+		// Compute the CRC of the block content (blocks located outside of the firmware area are reported as blank)
+		CRC = CRC_INITIAL_VALUE;
+		if (Block_Index < MAIN_FIRMWARE_BLOCKS_COUNT)
+		{
+			FlashReadBlock(MAIN_CONVERT_BLOCK_INDEX_TO_ADDRESS(Block_Index), Main_Window_Buffer);
+			for (i = 0; i < FLASH_BLOCK_SIZE; i++) CRC = CRCUpdate(CRC, Main_Window_Buffer[i]);
+		}
+		else
+		{
+			for (i = 0; i < FLASH_BLOCK_SIZE; i++) CRC = CRCUpdate(CRC, 0xFF);
+		}
+		
+		// Send it
+		UARTWriteByte(CRC >> 8);
+		UARTWriteByte((unsigned char) CRC);
+		
+		Block_Index++;
+		Blocks_Count--;
+	}
+}
+
+/** Handle the MAIN_PROTOCOL_COMMAND_WRITE_BLOCKS command. The command is aborted after a window containing a corrupted block, so the PC can retransmit the corrupted blocks followed by the not yet transmitted ones. */
+static void MainWriteBlocks(void)
+{
+	unsigned char i, Window_Blocks_Count, Is_Window_Corrupted, *Pointer_Block;
+	unsigned short Blocks_Count, Block_Index;
+	
+	// Receive how many blocks will be transmitted
+	Blocks_Count = MainReceiveWord();
+	
+	// Receive how the blocks are transmitted
+	Main_Blocks_Flags = MainReceiveByte();
+	
+	// Do not write anything if the command was not fully received
+	if (Main_Is_Reception_Timed_Out) return;
+	
+	while (Blocks_Count > 0)
+	{
+		// Receive a whole window, each block is preceded by its index
+		if (Blocks_Count >= MAIN_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT) Window_Blocks_Count = MAIN_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT;
+		else Window_Blocks_Count = (unsigned char) Blocks_Count;
+		Pointer_Block = Main_Window_Buffer;
+		for (i = 0; i < Window_Blocks_Count; i++)
+		{
+			Main_Window_Blocks_Indexes[i] = MainReceiveWord();
+			MainReceiveBlock(Pointer_Block, &Main_Window_Blocks_CRC[i]);
+			Pointer_Block += FLASH_BLOCK_SIZE;
+		}
+		
+		// Flash the valid received blocks
+		Pointer_Block = Main_Window_Buffer;
+		Is_Window_Corrupted = 0;
+		for (i = 0; i < Window_Blocks_Count; i++)
+		{
+			Block_Index = Main_Window_Blocks_Indexes[i];
+			if (Main_Is_Reception_Timed_Out || !MainIsBlockValid(Block_Index, Pointer_Block, Main_Window_Blocks_CRC[i]))
+			{
+				UARTWriteByte(MAIN_PROTOCOL_ACKNOWLEDGE_BLOCK_CORRUPTED);
+				Is_Window_Corrupted = 1;
+			}
+			// Never write outside of the firmware area
+			else if (Block_Index < MAIN_FIRMWARE_BLOCKS_COUNT) MainProgramBlock(MAIN_CONVERT_BLOCK_INDEX_TO_ADDRESS(Block_Index), Pointer_Block);
+			else UARTWriteByte(MAIN_PROTOCOL_ACKNOWLEDGE_BLOCK_SKIPPED);
+			Pointer_Block += FLASH_BLOCK_SIZE;
+		}
+		
+		// Let the PC retransmit the corrupted blocks
+		if (Is_Window_Corrupted)
+		{
+			MainDiscardReceivedBytes();
+			return;
+		}
+		
+		Blocks_Count -= Window_Blocks_Count;
+	}
+}
+
+/** Wait for a byte during a limited amount of time.
+ * @param Pointer_Byte On output, contain the received byte.
+ * @return 0 if a byte was received,
+ * @return 1 if no byte was received in time.
+ */
+static unsigned char MainReceiveByteWithTimeout(unsigned char *Pointer_Byte)
+{
+	unsigned short i;
+	
+	for (i = 0; i < MAIN_PROTOCOL_BAUD_RATE_PROBE_WAITING_TIME; i++)
+	{
+		if (UARTIsByteReceived())
+		{
+			*Pointer_Byte = UARTReadByte();
+			return 0;
+		}
+		delay_10us(10);
+	}
+	return 1;
+}
+
+/** Handle the MAIN_PROTOCOL_COMMAND_SET_BAUD_RATE command. */
+static void MainSetBaudRate(void)
+{
+	unsigned char Baud_Rate, Byte;
+	
+	// Tell the PC whether the requested baud rate is supported, using the current baud rate
+	Baud_Rate = UARTReadByte();
+	if (Baud_Rate >= UART_BAUD_RATES_COUNT)
+	{
+		UARTWriteByte(0);
+		return;
+	}
+	UARTWriteByte(MAIN_PROTOCOL_MAGIC_NUMBER);
+	
+	// Switch to the new baud rate as soon as the answer is sent
+	UARTSetBaudRate(Baud_Rate);
+	
+	// Echo the PC probe if it is correctly received at the new baud rate
+	if (MainReceiveByteWithTimeout(&Byte) == 0)
+	{
+		if (Byte == MAIN_PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE)
+		{
+			if (MainReceiveByteWithTimeout(&Byte) == 0)
+			{
+				if (Byte == MAIN_PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE)
+				{
+					UARTWriteByte(MAIN_PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE);
+					UARTWriteByte(MAIN_PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE);
+					return;
+				}
+			}
+		}
+	}
+	
+	// The link does not work at this baud rate, go back to the default one
+	UARTSetBaudRate(UART_BAUD_RATE_115200);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Entry point
+//--------------------------------------------------------------------------------------------------
+void main(void)
+{
+	unsigned char Overflows_Count = 0;
+	
+	// Set core clock to 64MHz
+	osctune = 0x40; // Enable the 4x PLL
+	osccon2 = 0; // Disable the secondary clock, disable the primary clock external oscillator circuit
+	osccon = 0x78; // Set internal oscillator block frequency to 16MHz, use the clock defined by FOSC bits, use primary clock as core clock
+	while (!osccon2.PLLRDY); // Wait for the PLL to lock
+	
+	// Start measuring the boot time, the firmware will stop the timer when it is ready
+	t5con = 0x33; // Use Fosc/4 as clock source, use a 8x prescaler, disable the dedicated secondary oscillator circuit, access to the timer registers in one 16-bit operation, enable the timer
+	
+	// Initialize the peripherals
+	LedInitialize();
+	UARTInitialize();
+	
+	// Start the firmware immediately, unless the firmware rebooted the microcontroller to be updated or the PC holds the UART line in break state to update a robot whose firmware does not work
+	if (EEPROMReadByte(EEPROM_ADDRESS_BOOTLOADER_FLAG) == EEPROM_BOOTLOADER_FLAG_UPDATE_REQUESTED) EEPROMWriteByte(EEPROM_ADDRESS_BOOTLOADER_FLAG, 0xFF); // Clear the request, so the firmware is started on next boot if the PC never answers
+	else if (!UARTIsBreakReceived()) asm goto MAIN_FIRMWARE_BASE_ADDRESS;
+	
+	LedOnRed();
+	
+	// Send an handshake code to the PC, followed by the bootloader identification
+	UARTWriteByte(MAIN_PROTOCOL_MAGIC_NUMBER);
+	UARTWriteByte(MAIN_PROTOCOL_VERSION);
+	UARTWriteByte(MAIN_FIRMWARE_BASE_ADDRESS >> 8);
+	UARTWriteByte((unsigned char) MAIN_FIRMWARE_BASE_ADDRESS);
+	
+	// Wait for the PC to answer (the bytes received while the line was in break state are discarded), start the firmware if no PC answers (it can also refuse this bootloader)
+	pir5.TMR5IF = 0;
+	while (1)
+	{
+		if (UARTIsByteReceived())
+		{
+			if (UARTReadByte() == MAIN_PROTOCOL_MAGIC_NUMBER) break;
+		}
+		else if (pir5.TMR5IF)
+		{
+			pir5.TMR5IF = 0;
+			Overflows_Count++;
+			if (Overflows_Count >= MAIN_PROTOCOL_HANDSHAKE_TIMEOUT)
+			{
+				LedOff();
+				asm goto MAIN_FIRMWARE_BASE_ADDRESS;
+			}
+		}
+	}
+	
+	// Execute the PC commands until it asks to reboot
+	while (1)
+	{
+		Main_Is_Reception_Timed_Out = 0;
+		switch (UARTReadByte())
+		{
+			case MAIN_PROTOCOL_COMMAND_UPLOAD_FIRMWARE:
+				MainUploadFirmware();
+				break;
+				
+			case MAIN_PROTOCOL_COMMAND_GET_BLOCKS_CRC:
+				MainSendBlocksCRC();
+				break;
+				
+			case MAIN_PROTOCOL_COMMAND_WRITE_BLOCKS:
+				MainWriteBlocks();
+				break;
+				
+			case MAIN_PROTOCOL_COMMAND_SET_BAUD_RATE:
+				MainSetBaudRate();
+				break;
+				
+			case MAIN_PROTOCOL_COMMAND_REBOOT:
+				// Reboot the microcontroller
+				delay_ms(1); // Let enough time to transmit any byte still in the UART FIFO
+				asm reset;
+				break;
+			
+			// Unknown command, do nothing
+			default:
+				break;
+		}
+	}
 }
\ No newline at end of file
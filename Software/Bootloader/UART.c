@@ -1,53 +1,128 @@
-/** @file UART.c
- * @see UART.h for description.
- * @author Adrien RICCIARDI
- */
-#include <system.h>
-#include "UART.h"
-
-//--------------------------------------------------------------------------------------------------
-// Private constants
-//--------------------------------------------------------------------------------------------------
-/** The frequency divider value to achieve a 115200 bit/s baud rate. */
-#define UART_BAUD_RATE_DIVIDER 138
-
-//--------------------------------------------------------------------------------------------------
-// Public functions
-//--------------------------------------------------------------------------------------------------
-void UARTInitialize(void)
-{
-	// Configure the baud rate generator
-	spbrg2 = (unsigned char) UART_BAUD_RATE_DIVIDER;
-	spbrgh2 = UART_BAUD_RATE_DIVIDER >> 8;
-	baudcon2 = 0x08; // Use 16-bit baud rate generator, disable Auto Baud Detect mode
-	
-	// Set the UART pins as inputs
-	trisb.7 = 1; // RX
-	trisb.6 = 1; // TX
-	
-	// Configure the module
-	rcsta2 = 0x90; // Enable the serial port, select 8-bit reception, enable reception
-	txsta2 = 0x24; // Use 8-bit transmission, enable transmission, use asynchronous mode, select high baud rate	
-}
-
-unsigned char UARTReadByte(void)
-{
-	// Wait for a byte to be received
-	while (!pir3.RC2IF);
-	return rcreg2;
-}
-
-unsigned char UARTIsByteReceived(void)
-{
-	if (pir3.RC2IF) return 1;
-	return 0;
-}
-
-void UARTWriteByte(unsigned char Byte)
-{
-	// Wait for the transmit buffer and FIFO to become free
-	while ((!txsta2.TRMT) || (!pir3.TX2IF));
-	
-	// Send the byte
-	txreg2 = Byte;
+/** @file UART.c
+ * @see UART.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "UART.h"
+
+//--------------------------------------------------------------------------------------------------
+// Private constants
+//--------------------------------------------------------------------------------------------------
+/** The frequency divider value to achieve a 115200 bit/s baud rate. */
+#define UART_BAUD_RATE_DIVIDER_115200 138
+/** The frequency divider value to achieve a 230400 bit/s baud rate (0.64% error). */
+#define UART_BAUD_RATE_DIVIDER_230400 68
+/** The frequency divider value to achieve a 460800 bit/s baud rate (0.79% error). */
+#define UART_BAUD_RATE_DIVIDER_460800 34
+/** The frequency divider value to achieve a 500000 bit/s baud rate. */
+#define UART_BAUD_RATE_DIVIDER_500000 31
+/** The frequency divider value to achieve a 1000000 bit/s baud rate. */
+#define UART_BAUD_RATE_DIVIDER_1000000 15
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+void UARTInitialize(void)
+{
+	// Configure the baud rate generator
+	spbrg2 = (unsigned char) UART_BAUD_RATE_DIVIDER_115200;
+	spbrgh2 = UART_BAUD_RATE_DIVIDER_115200 >> 8;
+	baudcon2 = 0x08; // Use 16-bit baud rate generator, disable Auto Baud Detect mode
+	
+	// Set the UART pins as inputs
+	trisb.7 = 1; // RX
+	trisb.6 = 1; // TX
+	
+	// Configure the module
+	rcsta2 = 0x90; // Enable the serial port, select 8-bit reception, enable reception
+	txsta2 = 0x24; // Use 8-bit transmission, enable transmission, use asynchronous mode, select high baud rate	
+}
+
+unsigned char UARTSetBaudRate(unsigned char Baud_Rate)
+{
+	unsigned short Divider;
+	unsigned char Byte;
+	
+	switch (Baud_Rate)
+	{
+		case UART_BAUD_RATE_115200:
+			Divider = UART_BAUD_RATE_DIVIDER_115200;
+			break;
+			
+		case UART_BAUD_RATE_230400:
+			Divider = UART_BAUD_RATE_DIVIDER_230400;
+			break;
+			
+		case UART_BAUD_RATE_460800:
+			Divider = UART_BAUD_RATE_DIVIDER_460800;
+			break;
+			
+		case UART_BAUD_RATE_500000:
+			Divider = UART_BAUD_RATE_DIVIDER_500000;
+			break;
+			
+		case UART_BAUD_RATE_1000000:
+			Divider = UART_BAUD_RATE_DIVIDER_1000000;
+			break;
+			
+		// Unsupported baud rate
+		default:
+			return 1;
+	}
+	
+	// Wait for the last byte to be fully transmitted
+	while (!txsta2.TRMT);
+	
+	// Change the baud rate
+	spbrg2 = (unsigned char) Divider;
+	spbrgh2 = Divider >> 8;
+	
+	// Discard anything received during the switch
+	rcsta2.CREN = 0; // Clear a possible overrun error
+	rcsta2.CREN = 1;
+	while (pir3.RC2IF) Byte = rcreg2;
+	
+	return 0;
+}
+
+unsigned char UARTReadByte(void)
+{
+	// Wait for a byte to be received
+	while (!UARTIsByteReceived());
+	return rcreg2;
+}
+
+unsigned char UARTIsBreakReceived(void)
+{
+	unsigned char i;
+	
+	// A valid byte can't hold the line low for more than 10 bits (87us at 115200 bit/s), so sample the RX pin during 1ms
+	for (i = 0; i < 100; i++)
+	{
+		if (portb.7) return 0;
+		delay_10us(1);
+	}
+	return 1;
+}
+
+unsigned char UARTIsByteReceived(void)
+{
+	// Bytes received while the core was stalled by a flash operation may have overflowed the FIFO, which blocks the reception until the error is cleared
+	if (rcsta2.OERR)
+	{
+		rcsta2.CREN = 0; // Disable the reception to clear the error bit
+		rcsta2.CREN = 1; // Re-enable it
+	}
+	
+	if (pir3.RC2IF) return 1;
+	return 0;
+}
+
+void UARTWriteByte(unsigned char Byte)
+{
+	// Wait for the transmit buffer and FIFO to become free
+	while ((!txsta2.TRMT) || (!pir3.TX2IF));
+	
+	// Send the byte
+	txreg2 = Byte;
 }
\ No newline at end of file
@@ -1,30 +1,57 @@
-/** @file UART.h
- * Simple polling UART driver.
- * @author Adrien RICCIARDI
- */
-#ifndef H_UART_H
-#define H_UART_H
-
-//--------------------------------------------------------------------------------------------------
-// Functions
-//--------------------------------------------------------------------------------------------------
-/** Initialize the UART at 115200 bauds, 8 data bits, no parity, 1 stop bit. */
-void UARTInitialize(void);
-
-/** Block until a byte is received from the UART.
- * @return The read byte.
- */
-unsigned char UARTReadByte(void);
-
-/** Tell if a byte has been received or not.
- * @return 1 if a byte is available to read,
- * @return 0 if no byte was received.
- */
-unsigned char UARTIsByteReceived(void);
-
-/** Write a byte to the UART.
- * @param Byte The byte to send.
- */
-void UARTWriteByte(unsigned char Byte);
-
+/** @file UART.h
+ * Simple polling UART driver.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_UART_H
+#define H_UART_H
+
+//--------------------------------------------------------------------------------------------------
+// Types
+//--------------------------------------------------------------------------------------------------
+/** All supported baud rates (their values are used by the PC protocol, so do not reorder them). */
+typedef enum
+{
+	UART_BAUD_RATE_115200,
+	UART_BAUD_RATE_230400,
+	UART_BAUD_RATE_460800,
+	UART_BAUD_RATE_500000,
+	UART_BAUD_RATE_1000000,
+	UART_BAUD_RATES_COUNT
+} TUARTBaudRate;
+
+//--------------------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------------------
+/** Initialize the UART at 115200 bauds, 8 data bits, no parity, 1 stop bit. */
+void UARTInitialize(void);
+
+/** Change the UART baud rate once the byte being transmitted has been fully sent. The bytes received meanwhile are discarded.
+ * @param Baud_Rate The new baud rate (one of the TUARTBaudRate values).
+ * @return 0 if the baud rate was changed,
+ * @return 1 if the baud rate is not supported.
+ */
+unsigned char UARTSetBaudRate(unsigned char Baud_Rate);
+
+/** Block until a byte is received from the UART.
+ * @return The read byte.
+ */
+unsigned char UARTReadByte(void);
+
+/** Tell if the remote side holds the reception line low (this is called a break).
+ * @return 1 if a break is received,
+ * @return 0 if the line is idle or a byte is being received.
+ */
+unsigned char UARTIsBreakReceived(void);
+
+/** Tell if a byte has been received or not.
+ * @return 1 if a byte is available to read,
+ * @return 0 if no byte was received.
+ */
+unsigned char UARTIsByteReceived(void);
+
+/** Write a byte to the UART.
+ * @param Byte The byte to send.
+ */
+void UARTWriteByte(unsigned char Byte);
+
 #endif
\ No newline at end of file
@@ -1,61 +1,89 @@
-/** @file Artificial_Intelligence.c
- * @see Artificial_Intelligence.h for description.
- * @author Adrien RICCIARDI
- */
-#include <system.h>
-#include "Artificial_Intelligence.h"
-#include "Distance_Sensor.h"
-#include "Motor.h"
-#include "Random.h"
-
-//--------------------------------------------------------------------------------------------------
-// Public functions
-//--------------------------------------------------------------------------------------------------
-unsigned char ArtificialIntelligenceRandomBinaryChoice(void)
-{
-	if (RandomGetNumber() < 128) return 0; // Do not use modulo operator to be faster
-	return 1;
-}
-
-void ArtificialIntelligenceRandomAngleTurn(unsigned char Is_Turning_Left)
-{
-	if (Is_Turning_Left)
-	{
-		// Turn left
-		MotorSetState(MOTOR_LEFT, MOTOR_STATE_BACKWARD);
-		MotorSetState(MOTOR_RIGHT, MOTOR_STATE_FORWARD);
-	}
-	else
-	{
-		// Turn right
-		MotorSetState(MOTOR_LEFT, MOTOR_STATE_FORWARD);
-		MotorSetState(MOTOR_RIGHT, MOTOR_STATE_BACKWARD);
-	}
-	
-	// Choose the turning time, which determine the turning angle, from 500ms (45) to 2s (180)
-	switch (RandomGetNumber() % 4)
-	{
-		// 45
-		case 0:
-			delay_ms(250);
-			delay_ms(250);
-			break;
-		
-		// 90
-		case 1:
-			delay_s(1);
-			break;
-		
-		// 135
-		case 2:
-			delay_s(1);
-			delay_ms(250);
-			delay_ms(250);
-			break;
-		
-		// 180	
-		default:
-			delay_s(2);
-			break;
-	}
-}
+/** @file Artificial_Intelligence.c
+ * @see Artificial_Intelligence.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "Artificial_Intelligence.h"
+#include "Distance_Sensor.h"
+#include "Motor.h"
+#include "Random.h"
+#include "Shared_Timer.h"
+
+//--------------------------------------------------------------------------------------------------
+// Private variables
+//--------------------------------------------------------------------------------------------------
+/** What the running behavior is doing. */
+static unsigned char Artificial_Intelligence_State = ARTIFICIAL_INTELLIGENCE_STATE_STARTING;
+/** When the running behavior delay ends, in milliseconds of uptime. */
+static unsigned long Artificial_Intelligence_Delay_End_Time = 0;
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+void ArtificialIntelligenceSetState(TArtificialIntelligenceState State)
+{
+	Artificial_Intelligence_State = State;
+}
+
+TArtificialIntelligenceState ArtificialIntelligenceGetState(void)
+{
+	return Artificial_Intelligence_State;
+}
+
+void ArtificialIntelligenceStartDelay(unsigned short Milliseconds)
+{
+	Artificial_Intelligence_Delay_End_Time = SharedTimerGetUptime() + Milliseconds;
+}
+
+unsigned char ArtificialIntelligenceIsDelayElapsed(void)
+{
+	// The signed difference stays right when the uptime wraps around
+	if ((signed long) (SharedTimerGetUptime() - Artificial_Intelligence_Delay_End_Time) >= 0) return 1;
+	return 0;
+}
+
+unsigned char ArtificialIntelligenceRandomBinaryChoice(void)
+{
+	if (RandomGetNumber() < 128) return 0; // Do not use modulo operator to be faster
+	return 1;
+}
+
+void ArtificialIntelligenceStartRandomAngleTurn(unsigned char Is_Turning_Left)
+{
+	if (Is_Turning_Left)
+	{
+		// Turn left
+		MotorSetState(MOTOR_LEFT, MOTOR_STATE_BACKWARD);
+		MotorSetState(MOTOR_RIGHT, MOTOR_STATE_FORWARD);
+	}
+	else
+	{
+		// Turn right
+		MotorSetState(MOTOR_LEFT, MOTOR_STATE_FORWARD);
+		MotorSetState(MOTOR_RIGHT, MOTOR_STATE_BACKWARD);
+	}
+	
+	// Choose the turning time, which determine the turning angle, from 500ms (45°) to 2s (180°)
+	switch (RandomGetNumber() % 4)
+	{
+		// 45°
+		case 0:
+			ArtificialIntelligenceStartDelay(500);
+			break;
+		
+		// 90°
+		case 1:
+			ArtificialIntelligenceStartDelay(1000);
+			break;
+		
+		// 135°
+		case 2:
+			ArtificialIntelligenceStartDelay(1500);
+			break;
+		
+		// 180°	
+		default:
+			ArtificialIntelligenceStartDelay(2000);
+			break;
+	}
+}
\ No newline at end of file
@@ -1,36 +1,80 @@
-/** @file Artificial_Intelligence.h
- * Provide utility functions used by all artificial intelligence behaviors and gather all behaviors.
- * @author Adrien RICCIARDI
- */
-#ifndef H_ARTIFICIAL_INTELLIGENCE_H
-#define H_ARTIFICIAL_INTELLIGENCE_H
-
-//--------------------------------------------------------------------------------------------------
-// Functions
-//--------------------------------------------------------------------------------------------------
-// Utility functions
-/** Randomly returns 0 or 1.
- * @return 0 or 1.
- */
-unsigned char ArtificialIntelligenceRandomBinaryChoice(void);
-
-/** Turn to the specified direction with a random angle (from 45 degrees to 180 degrees).
- * @param Is_Turning_Left Set to 1 to turn left or to 0 to turn right.
- */
-void ArtificialIntelligenceRandomAngleTurn(unsigned char Is_Turning_Left);
-
-// Artificial intelligence algorithms
-/** The robot avoids obstacles by turning to a random direction and goes nearer to the obstacles until it comes too close and must go backward.
- * The robot seems to gain trust until it comes too close. Then, it becomes again fearful and does not hang over the obstacles. 
- * The led is lighted in red when the robot is scared and lighted in green when it is self-confident.
- * The robot can randomly change direction even if no obstacle is signaled to seem more "alive".
- */
-void ArtificialIntelligenceAvoidObjects(void);
-
-/** Robot follows an object that is close enough to be spotted. It waits when the object is still and moves when the object moves.
- * Robot will escape if the object comes too close.
- * This behaviour will cease when the robot is bored (nothing at sight or the object is still for a too long time) or when it is scared (object is too close).
- */
-void ArtificialIntelligenceFollowObjects(void);
-
+/** @file Artificial_Intelligence.h
+ * Provide utility functions used by all artificial intelligence behaviors and gather all behaviors.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_ARTIFICIAL_INTELLIGENCE_H
+#define H_ARTIFICIAL_INTELLIGENCE_H
+
+//--------------------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------------------
+/** How often the scheduler calls the running behavior, in milliseconds. It is shorter than the distance sampling period (at least DISTANCE_SENSOR_SETTLE_TIME milliseconds plus the echo duration), so each distance sample is evaluated at most 20ms after it was measured. */
+#define ARTIFICIAL_INTELLIGENCE_TASK_PERIOD 20
+
+//--------------------------------------------------------------------------------------------------
+// Types
+//--------------------------------------------------------------------------------------------------
+/** What the running behavior is doing (the values are reported to the PC, so do not reorder them). */
+typedef enum
+{
+	ARTIFICIAL_INTELLIGENCE_STATE_STARTING, //!< The robot is not ready yet.
+	ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STATE_GO_STRAIGHT,
+	ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STATE_TURN,
+	ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STATE_ESCAPE,
+	ARTIFICIAL_INTELLIGENCE_FOLLOW_OBJECTS_STATE_WAIT_FOR_OBJECT,
+	ARTIFICIAL_INTELLIGENCE_FOLLOW_OBJECTS_STATE_FOLLOW_OBJECT,
+	ARTIFICIAL_INTELLIGENCE_FOLLOW_OBJECTS_STATE_SEARCH_OBJECT_ON_LEFT,
+	ARTIFICIAL_INTELLIGENCE_FOLLOW_OBJECTS_STATE_SEARCH_OBJECT_ON_RIGHT,
+	ARTIFICIAL_INTELLIGENCE_FOLLOW_OBJECTS_STATE_ESCAPE
+} TArtificialIntelligenceState;
+
+//--------------------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------------------
+// Utility functions
+/** Tell what the running behavior is doing, so it can be reported to the PC.
+ * @param State The behavior state.
+ */
+void ArtificialIntelligenceSetState(TArtificialIntelligenceState State);
+
+/** Get what the running behavior is doing.
+ * @return The behavior state.
+ */
+TArtificialIntelligenceState ArtificialIntelligenceGetState(void);
+
+/** Start the running behavior delay. The behaviors must never wait, they check ArtificialIntelligenceIsDelayElapsed() on each call instead.
+ * @param Milliseconds How many milliseconds the delay lasts.
+ */
+void ArtificialIntelligenceStartDelay(unsigned short Milliseconds);
+
+/** Tell whether the delay started by ArtificialIntelligenceStartDelay() is over.
+ * @return 0 if the delay is not over,
+ * @return 1 if the delay is over.
+ */
+unsigned char ArtificialIntelligenceIsDelayElapsed(void);
+
+/** Randomly returns 0 or 1.
+ * @return 0 or 1.
+ */
+unsigned char ArtificialIntelligenceRandomBinaryChoice(void);
+
+/** Start turning to the specified direction with a random angle (from 45 degrees to 180 degrees). The turn is over when ArtificialIntelligenceIsDelayElapsed() returns 1, the motors are not stopped.
+ * @param Is_Turning_Left Set to 1 to turn left or to 0 to turn right.
+ */
+void ArtificialIntelligenceStartRandomAngleTurn(unsigned char Is_Turning_Left);
+
+// Artificial intelligence algorithms (each one is a scheduler task that must be called every ARTIFICIAL_INTELLIGENCE_TASK_PERIOD milliseconds, a call evaluates the last distance sample and returns immediately)
+/** The robot avoids obstacles by turning to a random direction and goes nearer to the obstacles until it comes too close and must go backward.
+ * The robot seems to gain trust until it comes too close. Then, it becomes again fearful and does not hang over the obstacles. 
+ * The led is lighted in red when the robot is scared and lighted in green when it is self-confident.
+ * The robot can randomly change direction even if no obstacle is signaled to seem more "alive".
+ */
+void ArtificialIntelligenceAvoidObjects(void);
+
+/** Robot follows an object that is close enough to be spotted. It waits when the object is still and moves when the object moves.
+ * Robot will escape if the object comes too close.
+ * This behaviour will cease when the robot is bored (nothing at sight or the object is still for a too long time) or when it is scared (object is too close).
+ */
+void ArtificialIntelligenceFollowObjects(void);
+
 #endif
\ No newline at end of file
@@ -1,132 +1,203 @@
-/** @file Artificial_Intelligence_Avoid_Objects.c
- * @see Artificial_Intelligence.h for description.
- * @author Adrien RICCIARDI
- */
-#include "Artificial_Intelligence.h"
-#include "Distance_Sensor.h"
-#include "Led.h"
-#include "Motor.h"
-#include "Random.h"
-#include "Shared_Timer.h"
-
-//--------------------------------------------------------------------------------------------------
-// Private constants
-//--------------------------------------------------------------------------------------------------
-/** The obstacle detection distance used when the robot is scared (cm). */
-#define ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_DEFAULT_OBSTACLE_DETECTION_DISTANCE 40
-/** How many time (in ms * 100) before the robot comes nearer to an object (i.e. gain trust). */
-#define ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_TRUST_TIMER_VALUE 50
-
-/** How many time to wait while the robot is going straight for it to turn. */
-#define ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STRAIGHT_TIMER_VALUE 200
- 
-//--------------------------------------------------------------------------------------------------
-// Public functions
-//--------------------------------------------------------------------------------------------------
-void ArtificialIntelligenceAvoidObjects(void)
-{
-	unsigned char Turn_Direction;
-	unsigned short Distance, Obstacle_Detection_Distance = DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_DEFAULT_OBSTACLE_DETECTION_DISTANCE);
-	
-	MotorSetState(MOTOR_LEFT, MOTOR_STATE_FORWARD);
-	MotorSetState(MOTOR_RIGHT, MOTOR_STATE_FORWARD);
-	
-	// Start the "trust" timer
-	SharedTimerStartTimer(1, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_TRUST_TIMER_VALUE);
-	// Start the "going straight" timer
-	SharedTimerStartTimer(2, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STRAIGHT_TIMER_VALUE);
-	
-	while (1)
-	{
-		// Make the robot react in 20ms (it is useless to react too fast because motors and distance sensor are far more slower than the microcontroller running frequency)
-		delay_ms(20);
-	
-		Distance = DistanceSensorGetLastSampledDistance();
-		
-		// Go backward if the obstacle is too close
-		if (Distance < DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(15))
-		{
-			LedOnRed();
-			
-			// Stop motors
-			MotorSetState(MOTOR_LEFT, MOTOR_STATE_STOPPED);
-			MotorSetState(MOTOR_RIGHT, MOTOR_STATE_STOPPED);
-			delay_ms(250); // Wait some time for the motors inductive current to dissipate (or it will generate a short circuit)
-			delay_ms(250);
-			
-			// Go straight backward for some time
-			MotorSetState(MOTOR_LEFT, MOTOR_STATE_BACKWARD);
-			MotorSetState(MOTOR_RIGHT, MOTOR_STATE_BACKWARD);
-			delay_s(3);
-			
-			// Quickly turn in a random direction in backward mode
-			if (ArtificialIntelligenceRandomBinaryChoice())
-			{
-				// Turn left
-				MotorSetState(MOTOR_LEFT, MOTOR_STATE_FORWARD);
-				MotorSetState(MOTOR_RIGHT, MOTOR_STATE_BACKWARD);
-			}
-			else
-			{
-				// Turn right
-				MotorSetState(MOTOR_LEFT, MOTOR_STATE_BACKWARD);
-				MotorSetState(MOTOR_RIGHT, MOTOR_STATE_FORWARD);
-			}
-			delay_s(1);
-			
-			// Reset the object detection distance to farthest distance (the robot went too far and was scared, so it becomes fearful again)
-			Obstacle_Detection_Distance = DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_DEFAULT_OBSTACLE_DETECTION_DISTANCE);
-			SharedTimerStartTimer(1, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_TRUST_TIMER_VALUE); // Reset the timer too (do that after the delay to avoid loosing 1 second due to the delay)
-			
-			// Reset the "going straight" timer
-			SharedTimerStartTimer(2, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STRAIGHT_TIMER_VALUE);
-		}
-		// Turn from 45 (turning time is 500ms) to 180 (turning time is 2s) if an obstacle was detected
-		else if (Distance < Obstacle_Detection_Distance)
-		{
-			LedOnRed();
-		
-			// Choose a new random direction if the previous one lasted long enough. By keeping the same direction for some time, the robot avoids turning left then right then left and so on when it is blocked until the random choice keeps a direction long enough
-			if (SharedTimerIsTimerStopped(0))
-			{
-				Turn_Direction = ArtificialIntelligenceRandomBinaryChoice();
-				SharedTimerStartTimer(0, 60); // 6s should be enough for most blocking situations, even if the robot does not turn 90 every time
-			}
-			
-			ArtificialIntelligenceRandomAngleTurn(Turn_Direction);
-			
-			// Reset the "going straigh" timer
-			SharedTimerStartTimer(2, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STRAIGHT_TIMER_VALUE);
-		}
-		// Go straight if nothing at sight
-		else
-		{
-			LedOnGreen();
-			
-			// Turn in a random direction if the robot is going straight since several seconds
-			if (SharedTimerIsTimerStopped(2))
-			{
-				// Turn left or right
-				ArtificialIntelligenceRandomAngleTurn(ArtificialIntelligenceRandomBinaryChoice());
-			
-				// Restart the timer for the next straight line
-				SharedTimerStartTimer(2, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STRAIGHT_TIMER_VALUE);
-			}
-			else
-			{
-				MotorSetState(MOTOR_LEFT, MOTOR_STATE_FORWARD);
-				MotorSetState(MOTOR_RIGHT, MOTOR_STATE_FORWARD);
-			}
-		}
-		
-		// Decrement the object detection distance if the robot did not went too far to an object for some time (it's like the robot is gaining trust)
-		if (SharedTimerIsTimerStopped(1))
-		{
-			// Make the robot come closer to the obstacles
-			if (DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(Obstacle_Detection_Distance) > DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(20)) Obstacle_Detection_Distance -= DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(2);
-			
-			// Restart the timer
-			SharedTimerStartTimer(1, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_TRUST_TIMER_VALUE);
-		}	
-	}
+/** @file Artificial_Intelligence_Avoid_Objects.c
+ * @see Artificial_Intelligence.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include "Artificial_Intelligence.h"
+#include "Distance_Sensor.h"
+#include "Led.h"
+#include "Motor.h"
+#include "Random.h"
+#include "Shared_Timer.h"
+
+//--------------------------------------------------------------------------------------------------
+// Private constants
+//--------------------------------------------------------------------------------------------------
+/** The obstacle detection distance used when the robot is scared (cm). */
+#define ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_DEFAULT_OBSTACLE_DETECTION_DISTANCE 40
+/** How many time (in ms) before the robot comes nearer to an object (i.e. gain trust). */
+#define ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_TRUST_TIMER_VALUE 5000
+
+/** How many time to wait while the robot is going straight for it to turn (in ms). */
+#define ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STRAIGHT_TIMER_VALUE 20000
+/** How long the robot keeps turning in the same direction when it meets obstacles (in ms). 6s should be enough for most blocking situations, even if the robot does not turn 90° every time. */
+#define ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_TURN_DIRECTION_TIMER_VALUE 6000
+
+//--------------------------------------------------------------------------------------------------
+// Private types
+//--------------------------------------------------------------------------------------------------
+/** Where the behavior stopped on its last call. */
+typedef enum
+{
+	ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_START,
+	ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_GO_STRAIGHT,
+	ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_TURN, //!< The robot turns until the delay is elapsed.
+	ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_ESCAPE_STOP_MOTORS, //!< The motors are stopped until the delay is elapsed.
+	ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_ESCAPE_GO_BACKWARD, //!< The robot goes backward until the delay is elapsed or the obstacle is far enough.
+	ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_ESCAPE_TURN //!< The robot turns backward until the delay is elapsed.
+} TArtificialIntelligenceAvoidObjectsStep;
+
+//--------------------------------------------------------------------------------------------------
+// Private variables
+//--------------------------------------------------------------------------------------------------
+/** What the behavior is doing. */
+static unsigned char Artificial_Intelligence_Avoid_Objects_Step = ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_START;
+/** The distance under which an object is considered as an obstacle (in sensor units), it decreases while the robot gains trust. */
+static unsigned short Artificial_Intelligence_Avoid_Objects_Obstacle_Detection_Distance;
+/** The direction to turn to when an obstacle is detected (1 to turn left, 0 to turn right). */
+static unsigned char Artificial_Intelligence_Avoid_Objects_Turn_Direction = 0;
+
+/** Keep the same turn direction while this timer runs. */
+static TSharedTimerHandle Artificial_Intelligence_Avoid_Objects_Turn_Direction_Timer;
+/** Periodically make the robot gain trust. */
+static TSharedTimerHandle Artificial_Intelligence_Avoid_Objects_Trust_Timer;
+/** Make the robot turn when it goes straight for too long. */
+static TSharedTimerHandle Artificial_Intelligence_Avoid_Objects_Straight_Timer;
+
+//--------------------------------------------------------------------------------------------------
+// Private functions
+//--------------------------------------------------------------------------------------------------
+/** Decrement the object detection distance each time the robot did not went too far to an object for some time (it's like the robot is gaining trust). This is the trust timer callback. */
+static void ArtificialIntelligenceAvoidObjectsGainTrust(void)
+{
+	// Make the robot come closer to the obstacles
+	if (DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(Artificial_Intelligence_Avoid_Objects_Obstacle_Detection_Distance) > DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(20)) Artificial_Intelligence_Avoid_Objects_Obstacle_Detection_Distance -= DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(2);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+void ArtificialIntelligenceAvoidObjects(void)
+{
+	TDistanceSensorSample Sample;
+	unsigned short Distance;
+	
+	// Take a decision only once per sample, and keep doing the same thing until the distance can be trusted again (the delays are checked at the same pace, which is precise enough for them)
+	if (!DistanceSensorIsNewSampleAvailable()) return;
+	DistanceSensorGetSample(&Sample);
+	if (!Sample.Is_Valid) return;
+	Distance = Sample.Filtered_Distance; // A single spurious echo must not make the robot escape
+	
+	switch (Artificial_Intelligence_Avoid_Objects_Step)
+	{
+		case ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_START:
+			MotorSetState(MOTOR_LEFT, MOTOR_STATE_FORWARD);
+			MotorSetState(MOTOR_RIGHT, MOTOR_STATE_FORWARD);
+			Artificial_Intelligence_Avoid_Objects_Obstacle_Detection_Distance = DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_DEFAULT_OBSTACLE_DETECTION_DISTANCE);
+			
+			// Start the "trust" timer
+			Artificial_Intelligence_Avoid_Objects_Trust_Timer = SharedTimerCreate(ArtificialIntelligenceAvoidObjectsGainTrust);
+			SharedTimerStart(Artificial_Intelligence_Avoid_Objects_Trust_Timer, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_TRUST_TIMER_VALUE, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_TRUST_TIMER_VALUE);
+			// Start the "going straight" timer
+			Artificial_Intelligence_Avoid_Objects_Straight_Timer = SharedTimerCreate(0);
+			SharedTimerStart(Artificial_Intelligence_Avoid_Objects_Straight_Timer, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STRAIGHT_TIMER_VALUE, 0);
+			// The turn direction timer is stopped, so the first turn direction is randomly chosen
+			Artificial_Intelligence_Avoid_Objects_Turn_Direction_Timer = SharedTimerCreate(0);
+			
+			Artificial_Intelligence_Avoid_Objects_Step = ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_GO_STRAIGHT;
+			return;
+		
+		// Wait some time for the motors inductive current to dissipate (or it will generate a short circuit), then go straight backward for some time
+		case ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_ESCAPE_STOP_MOTORS:
+			if (!ArtificialIntelligenceIsDelayElapsed()) return;
+			
+			MotorSetState(MOTOR_LEFT, MOTOR_STATE_BACKWARD);
+			MotorSetState(MOTOR_RIGHT, MOTOR_STATE_BACKWARD);
+			ArtificialIntelligenceStartDelay(3000);
+			Artificial_Intelligence_Avoid_Objects_Step = ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_ESCAPE_GO_BACKWARD;
+			return;
+		
+		// Stop going backward as soon as the obstacle is out of the fearful detection distance, then quickly turn in a random direction in backward mode
+		case ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_ESCAPE_GO_BACKWARD:
+			if (!ArtificialIntelligenceIsDelayElapsed() && (Distance < DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_DEFAULT_OBSTACLE_DETECTION_DISTANCE))) return;
+			
+			if (ArtificialIntelligenceRandomBinaryChoice())
+			{
+				// Turn left
+				MotorSetState(MOTOR_LEFT, MOTOR_STATE_FORWARD);
+				MotorSetState(MOTOR_RIGHT, MOTOR_STATE_BACKWARD);
+			}
+			else
+			{
+				// Turn right
+				MotorSetState(MOTOR_LEFT, MOTOR_STATE_BACKWARD);
+				MotorSetState(MOTOR_RIGHT, MOTOR_STATE_FORWARD);
+			}
+			ArtificialIntelligenceStartDelay(1000);
+			Artificial_Intelligence_Avoid_Objects_Step = ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_ESCAPE_TURN;
+			return;
+		
+		case ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_ESCAPE_TURN:
+			if (!ArtificialIntelligenceIsDelayElapsed()) return;
+			
+			// Reset the object detection distance to farthest distance (the robot went too far and was scared, so it becomes fearful again)
+			Artificial_Intelligence_Avoid_Objects_Obstacle_Detection_Distance = DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_DEFAULT_OBSTACLE_DETECTION_DISTANCE);
+			SharedTimerStart(Artificial_Intelligence_Avoid_Objects_Trust_Timer, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_TRUST_TIMER_VALUE, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_TRUST_TIMER_VALUE); // Reset the timer too (do that after the escape to avoid loosing 1 second due to the escape)
+			
+			// Reset the "going straight" timer
+			SharedTimerStart(Artificial_Intelligence_Avoid_Objects_Straight_Timer, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STRAIGHT_TIMER_VALUE, 0);
+			
+			// Evaluate the distance sample right now
+			Artificial_Intelligence_Avoid_Objects_Step = ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_GO_STRAIGHT;
+			break;
+	}
+	
+	// Go backward if the obstacle is too close, even in the middle of a turn
+	if (Distance < DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(15))
+	{
+		LedOnRed();
+		ArtificialIntelligenceSetState(ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STATE_ESCAPE);
+		
+		// Stop motors
+		MotorSetState(MOTOR_LEFT, MOTOR_STATE_STOPPED);
+		MotorSetState(MOTOR_RIGHT, MOTOR_STATE_STOPPED);
+		ArtificialIntelligenceStartDelay(500);
+		Artificial_Intelligence_Avoid_Objects_Step = ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_ESCAPE_STOP_MOTORS;
+		return;
+	}
+	
+	// Let the current turn terminate
+	if ((Artificial_Intelligence_Avoid_Objects_Step == ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_TURN) && !ArtificialIntelligenceIsDelayElapsed()) return;
+	
+	// Turn from 45° (turning time is 500ms) to 180° (turning time is 2s) if an obstacle was detected
+	if (Distance < Artificial_Intelligence_Avoid_Objects_Obstacle_Detection_Distance)
+	{
+		LedOnRed();
+		ArtificialIntelligenceSetState(ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STATE_TURN);
+		
+		// Choose a new random direction if the previous one lasted long enough. By keeping the same direction for some time, the robot avoids turning left then right then left and so on when it is blocked until the random choice keeps a direction long enough
+		if (SharedTimerIsTimerStopped(Artificial_Intelligence_Avoid_Objects_Turn_Direction_Timer))
+		{
+			Artificial_Intelligence_Avoid_Objects_Turn_Direction = ArtificialIntelligenceRandomBinaryChoice();
+			SharedTimerStart(Artificial_Intelligence_Avoid_Objects_Turn_Direction_Timer, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_TURN_DIRECTION_TIMER_VALUE, 0);
+		}
+		
+		ArtificialIntelligenceStartRandomAngleTurn(Artificial_Intelligence_Avoid_Objects_Turn_Direction);
+		Artificial_Intelligence_Avoid_Objects_Step = ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_TURN;
+		
+		// Reset the "going straigh" timer
+		SharedTimerStart(Artificial_Intelligence_Avoid_Objects_Straight_Timer, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STRAIGHT_TIMER_VALUE, 0);
+	}
+	// Go straight if nothing at sight
+	else
+	{
+		LedOnGreen();
+		ArtificialIntelligenceSetState(ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STATE_GO_STRAIGHT);
+		
+		// Turn in a random direction if the robot is going straight since several seconds
+		if (SharedTimerIsTimerStopped(Artificial_Intelligence_Avoid_Objects_Straight_Timer))
+		{
+			// Turn left or right
+			ArtificialIntelligenceStartRandomAngleTurn(ArtificialIntelligenceRandomBinaryChoice());
+			Artificial_Intelligence_Avoid_Objects_Step = ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_TURN;
+			
+			// Restart the timer for the next straight line
+			SharedTimerStart(Artificial_Intelligence_Avoid_Objects_Straight_Timer, ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STRAIGHT_TIMER_VALUE, 0);
+		}
+		else
+		{
+			MotorSetState(MOTOR_LEFT, MOTOR_STATE_FORWARD);
+			MotorSetState(MOTOR_RIGHT, MOTOR_STATE_FORWARD);
+			Artificial_Intelligence_Avoid_Objects_Step = ARTIFICIAL_INTELLIGENCE_AVOID_OBJECTS_STEP_GO_STRAIGHT;
+		}
+	}
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+/** @file Boot_Time.c
+ * @see Boot_Time.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "Boot_Time.h"
+
+//--------------------------------------------------------------------------------------------------
+// Private variables
+//--------------------------------------------------------------------------------------------------
+/** How many times the timer overflowed (each overflow lasts 32.768ms). */
+static unsigned short Boot_Time_Overflows_Count = 0;
+/** The boot time in microseconds, it is set only when the measure is terminated. */
+static unsigned long Boot_Time_Microseconds = 0;
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+void BootTimeInitialize(void)
+{
+	// Start the timer now if the bootloader did not, only the firmware boot time will be measured
+	if (!t5con.TMR5ON) t5con = 0x33; // Use Fosc/4 as clock source, use a 8x prescaler, disable the dedicated secondary oscillator circuit, access to the timer registers in one 16-bit operation, enable the timer
+	
+	// Take into account an overflow that happened in the bootloader
+	if (pir5.TMR5IF)
+	{
+		Boot_Time_Overflows_Count = 1;
+		pir5.TMR5IF = 0;
+	}
+	
+	// Enable timer 5 interrupt
+	ipr5.TMR5IP = 0; // Set interrupt as low priority
+	pie5.TMR5IE = 1;
+}
+
+void BootTimeStop(void)
+{
+	unsigned long Ticks_Count;
+	
+	// Stop the timer and its interrupt
+	t5con.TMR5ON = 0;
+	pie5.TMR5IE = 0;
+	
+	// Take into account an overflow that was not handled yet
+	if (pir5.TMR5IF)
+	{
+		Boot_Time_Overflows_Count++;
+		pir5.TMR5IF = 0;
+	}
+	
+	// The timer increments every 0.5us
+	Ticks_Count = tmr5l; // TMR5L must be read before TMR5H to grant a valid result
+	Ticks_Count |= (unsigned short) tmr5h << 8;
+	Ticks_Count |= (unsigned long) Boot_Time_Overflows_Count << 16;
+	
+	// The UART module reads the variable from the main context too, so no interrupt can see it half written
+	Boot_Time_Microseconds = Ticks_Count >> 1;
+}
+
+unsigned long BootTimeGetTime(void)
+{
+	return Boot_Time_Microseconds;
+}
+
+void BootTimeInterruptHandler(void)
+{
+	Boot_Time_Overflows_Count++;
+	
+	// Clear the interrupt flag
+	pir5.TMR5IF = 0;
+}
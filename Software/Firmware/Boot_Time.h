@@ -0,0 +1,28 @@
+/** @file Boot_Time.h
+ * Measure the time elapsed between the microcontroller reset and the artificial intelligence start. The bootloader starts the timer 5 as soon as the core runs at 64MHz, this module counts the timer overflows until the firmware is ready.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_BOOT_TIME_H
+#define H_BOOT_TIME_H
+
+//--------------------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------------------
+/** Start counting the timer 5 overflows (the timer is started if the bootloader did not do it).
+ * @warning This function must be called first thing in the firmware to avoid missing an overflow.
+ */
+void BootTimeInitialize(void);
+
+/** Stop the measure, call this function when the robot is ready. */
+void BootTimeStop(void);
+
+/** Get the measured boot time. This function must be called from the main context, like BootTimeStop() (the UART requests are decoded by UARTProcessRequests()).
+ * @return The boot time in microseconds,
+ * @return 0 if the measure is not terminated yet.
+ */
+unsigned long BootTimeGetTime(void);
+
+/** Handle the timer 5 interrupt. */
+void BootTimeInterruptHandler(void);
+
+#endif
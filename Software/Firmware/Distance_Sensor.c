@@ -1,126 +1,376 @@
-/** @file Distance_Sensor.c
- * @see Distance_Sensor.h for description.
- * @author Adrien RICCIARDI
- */
-#include <system.h>
-#include "Distance_Sensor.h"
-
-//--------------------------------------------------------------------------------------------------
-// Private constants and macros
-//--------------------------------------------------------------------------------------------------
-/** The "trigger" pin. */
-#define DISTANCE_SENSOR_TRIGGER_PIN 0 // RB0
-/** The "echo" pin. */
-#define DISTANCE_SENSOR_ECHO_PIN 1 // RB1
-
-/** Start the counter. */
-#define DISTANCE_SENSOR_COUNTER_TIMER_START() t0con.TMR0ON = 1
-/** Stop the counter. */
-#define DISTANCE_SENSOR_COUNTER_TIMER_STOP() t0con.TMR0ON = 0
-/** Reset the counter. */
-#define DISTANCE_SENSOR_COUNTER_TIMER_RESET() \
-{ \
-	tmr0h = 0; \
-	tmr0l = 0; \
-}
-
-/** Enable the INT1 interrupt. */
-#define DISTANCE_SENSOR_EXTERNAL_INTERRUPT_ENABLE() intcon3.INT1IE = 1
-/** Disable the INT1 interrupt. */
-#define DISTANCE_SENSOR_EXTERNAL_INTERRUPT_DISABLE() intcon3.INT1IE = 0
-
-//--------------------------------------------------------------------------------------------------
-// Private variables
-//--------------------------------------------------------------------------------------------------
-/** The distance to the nearest object in centimeters. */
-static unsigned short Distance_Sensor_Last_Measured_Distance = 0; // Do not allow the motors to move until a real measure has been done
-
-//--------------------------------------------------------------------------------------------------
-// Public functions
-//--------------------------------------------------------------------------------------------------
-void DistanceSensorInitialize(void)
-{
-	// Configure the pins as digital
-	anselb.DISTANCE_SENSOR_TRIGGER_PIN = 0;
-	anselb.DISTANCE_SENSOR_ECHO_PIN = 0;
-	
-	// Configure the pins direction
-	latb.DISTANCE_SENSOR_TRIGGER_PIN = 0; // Avoid triggering a spurious measure
-	trisb.DISTANCE_SENSOR_TRIGGER_PIN = 0; // Set as output
-	trisb.DISTANCE_SENSOR_ECHO_PIN = 1; // Set as input
-	
-	// Configure the timer 0 to increment every microsecond
-	t0con = 0x03; // Enable the timer in 16-bit mode, use Fosc/4 as clock source, use a 1:16 prescaler, do not start the timer
-	DISTANCE_SENSOR_COUNTER_TIMER_RESET();
-	
-	// Configure the external interrupt 1
-	intcon2.INTEDG1 = 1; // Trigger an interrupt when a rising edge is detected
-	intcon3.INT1IP = 1; // Set the interrupt as high priority
-	DISTANCE_SENSOR_EXTERNAL_INTERRUPT_ENABLE();
-	
-	// Configure the timer 2 (this timer releases the trigger pin without using a busy loop in the interrupt handler)
-	pr2 = 20; // The timer period is 1us, the recommended trigger pin hold time is 10us, so use 20us for increased safety
-	ipr1.TMR2IP = 0; // Set the interrupt as low priority
-	pie1.TMR2IE = 1; // Enable the interrupt
-}
-
-void DistanceSensorStartMeasure(void)
-{
-	// Trigger a distance measure
-	latb.DISTANCE_SENSOR_TRIGGER_PIN = 1;
-	// Configure timer 2 to trigger an interrupt 20us later
-	tmr2 = 0;
-	t2con = 0x06; // Do not use a postscaler, enable the timer, set a 16x prescaler to get a timer frequency of 1MHz (so it is easy to count microseconds)
-}
-
-unsigned short DistanceSensorGetLastSampledDistance(void)
-{
-	unsigned short Distance;
-	
-	// Atomically access to the shared variable
-	DISTANCE_SENSOR_EXTERNAL_INTERRUPT_DISABLE();
-	Distance = Distance_Sensor_Last_Measured_Distance;
-	DISTANCE_SENSOR_EXTERNAL_INTERRUPT_ENABLE();
-	
-	return Distance;
-}
-
-void DistanceSensorInterruptHandler(void)
-{
-	static unsigned char Is_Waiting_For_Rising_Edge = 1; // The echo signal starts with a rising edge
-	
-	// A rising edge has been detected
-	if (Is_Waiting_For_Rising_Edge)
-	{
-		DISTANCE_SENSOR_COUNTER_TIMER_START(); // Start counting
-		intcon2.INTEDG1 = 0; // Configure the external interrupt to trigger an interrupt when a falling edge is detected
-		Is_Waiting_For_Rising_Edge = 0;
-	}
-	// A falling edge has been detected
-	else
-	{
-		DISTANCE_SENSOR_COUNTER_TIMER_STOP(); // Stop counting
-		intcon2.INTEDG1 = 1; // Configure the external interrupt to trigger an interrupt when a rising edge is detected
-		Is_Waiting_For_Rising_Edge = 1;
-		
-		// Retrieve the measured time
-		Distance_Sensor_Last_Measured_Distance = tmr0l; // TMR0L must be read before TMR0H to grant a valid result
-		Distance_Sensor_Last_Measured_Distance |= tmr0h << 8;
-		DISTANCE_SENSOR_COUNTER_TIMER_RESET();
-	}
-	
-	// Clear the interrupt flag
-	intcon3.INT1IF = 0;
-}
-
-void DistanceSensorTriggerPinInterruptHandler(void)
-{
-	// Stop the timer
-	t2con.TMR2ON = 0;
-	
-	// Release the trigger pin
-	latb.DISTANCE_SENSOR_TRIGGER_PIN = 0;
-	
-	// Clear the interrupt flag
-	pir1.TMR2IF = 0;
-}
+/** @file Distance_Sensor.c
+ * @see Distance_Sensor.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "Distance_Sensor.h"
+#include "Shared_Timer.h"
+
+//--------------------------------------------------------------------------------------------------
+// Private constants and macros
+//--------------------------------------------------------------------------------------------------
+#if DISTANCE_SENSOR_IS_INPUT_CAPTURE_ENABLED
+	/** The "trigger" pin. */
+	#define DISTANCE_SENSOR_TRIGGER_PIN 1 // RB1
+	/** The "echo" pin. */
+	#define DISTANCE_SENSOR_ECHO_PIN 0 // RB0 (CCP4)
+	
+	/** The CCP4 configuration capturing the timer on each echo rising edge. */
+	#define DISTANCE_SENSOR_CAPTURE_MODE_RISING_EDGE 0x05
+	/** The CCP4 configuration capturing the timer on each echo falling edge. */
+	#define DISTANCE_SENSOR_CAPTURE_MODE_FALLING_EDGE 0x04
+	
+	/** Enable the CCP4 interrupt. */
+	#define DISTANCE_SENSOR_ECHO_INTERRUPT_ENABLE() pie4.CCP4IE = 1
+	/** Disable the CCP4 interrupt. */
+	#define DISTANCE_SENSOR_ECHO_INTERRUPT_DISABLE() pie4.CCP4IE = 0
+#else
+	/** The "trigger" pin. */
+	#define DISTANCE_SENSOR_TRIGGER_PIN 0 // RB0
+	/** The "echo" pin. */
+	#define DISTANCE_SENSOR_ECHO_PIN 1 // RB1
+	
+	/** Start the counter. */
+	#define DISTANCE_SENSOR_COUNTER_TIMER_START() t0con.TMR0ON = 1
+	/** Stop the counter. */
+	#define DISTANCE_SENSOR_COUNTER_TIMER_STOP() t0con.TMR0ON = 0
+	/** Reset the counter. */
+	#define DISTANCE_SENSOR_COUNTER_TIMER_RESET() \
+	{ \
+		tmr0h = 0; \
+		tmr0l = 0; \
+	}
+	
+	/** The longest echo pulse an object can produce in microseconds (the sensor range is 4m, which makes a 23.2ms pulse), the 38ms pulse sent when no object is in range is longer. */
+	#define DISTANCE_SENSOR_MAXIMUM_ECHO_DURATION 30000
+	
+	/** Enable the INT1 interrupt. */
+	#define DISTANCE_SENSOR_ECHO_INTERRUPT_ENABLE() intcon3.INT1IE = 1
+	/** Disable the INT1 interrupt. */
+	#define DISTANCE_SENSOR_ECHO_INTERRUPT_DISABLE() intcon3.INT1IE = 0
+#endif
+
+/** How many samples the ring buffer holds (the median filter is written for 3 samples). */
+#define DISTANCE_SENSOR_SAMPLES_COUNT 3
+
+//--------------------------------------------------------------------------------------------------
+// Private variables
+//--------------------------------------------------------------------------------------------------
+/** The distance to the nearest object in sensor units. */
+static unsigned short Distance_Sensor_Last_Measured_Distance = 0; // Do not allow the motors to move until a real measure has been done
+
+#if !DISTANCE_SENSOR_IS_INPUT_CAPTURE_ENABLED
+	/** Which echo edge the INT1 interrupt is configured for. */
+	static unsigned char Distance_Sensor_Is_Waiting_For_Rising_Edge = 1; // The echo signal starts with a rising edge
+#endif
+
+/** How many milliseconds remain before the timer handler has something to do. */
+static unsigned char Distance_Sensor_Timer_Counter = 1; // Start the first measure on the first timer tick, so the robot is ready sooner
+/** Set by the echo interrupt handler when the echo ended, cleared by the timer handler (a single byte is atomically written, so the high priority interrupt can safely set it). */
+static volatile unsigned char Distance_Sensor_Is_Echo_Received = 0;
+#if DISTANCE_SENSOR_IS_ADAPTIVE_SAMPLING_ENABLED
+	/** Set to 1 when a measure has been triggered and the echo end is expected. */
+	static unsigned char Distance_Sensor_Is_Measure_Running = 0;
+#endif
+
+/** The ring buffer of the last samples, it is written by the timer handler. */
+static TDistanceSensorSample Distance_Sensor_Samples[DISTANCE_SENSOR_SAMPLES_COUNT];
+/** The ring buffer most recent sample. */
+static unsigned char Distance_Sensor_Newest_Sample_Index = DISTANCE_SENSOR_SAMPLES_COUNT - 1; // The first sample will be stored at index 0
+/** How many samples the ring buffer holds, up to DISTANCE_SENSOR_SAMPLES_COUNT. */
+static unsigned char Distance_Sensor_Stored_Samples_Count = 0;
+/** The next sample sequence number. */
+static unsigned char Distance_Sensor_Next_Sequence_Number = 0;
+/** Set to 1 when a sample is added, cleared when DistanceSensorIsNewSampleAvailable() reports it. */
+static unsigned char Distance_Sensor_Is_New_Sample_Available = 0;
+
+//--------------------------------------------------------------------------------------------------
+// Private functions
+//--------------------------------------------------------------------------------------------------
+/** Compute the median of 3 values.
+ * @param First The first value.
+ * @param Second The second value.
+ * @param Third The third value.
+ * @return The value lying between the 2 others.
+ */
+static unsigned short DistanceSensorComputeMedian(unsigned short First, unsigned short Second, unsigned short Third)
+{
+	unsigned short Temporary;
+	
+	// Make sure First <= Second
+	if (First > Second)
+	{
+		Temporary = First;
+		First = Second;
+		Second = Temporary;
+	}
+	
+	if (Third >= Second) return Second;
+	if (Third >= First) return Third;
+	return First;
+}
+
+/** Store the last measured distance in the ring buffer and filter it. This function must be called from the low priority interrupt context. */
+static void DistanceSensorAddSample(void)
+{
+	TDistanceSensorSample *Pointer_Sample;
+	
+	// Overwrite the oldest sample
+	Distance_Sensor_Newest_Sample_Index++;
+	if (Distance_Sensor_Newest_Sample_Index >= DISTANCE_SENSOR_SAMPLES_COUNT) Distance_Sensor_Newest_Sample_Index = 0;
+	Pointer_Sample = &Distance_Sensor_Samples[Distance_Sensor_Newest_Sample_Index];
+	
+	Pointer_Sample->Raw_Distance = DistanceSensorGetLastSampledDistance();
+	Pointer_Sample->Timestamp = SharedTimerGetUptime(); // The shared timer interrupt is the caller, so the uptime can't change while it is read
+	Pointer_Sample->Sequence_Number = Distance_Sensor_Next_Sequence_Number;
+	Distance_Sensor_Next_Sequence_Number++;
+	
+	// The median can't be computed until the ring buffer is full
+	if (Distance_Sensor_Stored_Samples_Count < DISTANCE_SENSOR_SAMPLES_COUNT) Distance_Sensor_Stored_Samples_Count++;
+	if (Distance_Sensor_Stored_Samples_Count < DISTANCE_SENSOR_SAMPLES_COUNT)
+	{
+		Pointer_Sample->Filtered_Distance = Pointer_Sample->Raw_Distance;
+		Pointer_Sample->Is_Valid = 0;
+	}
+	else
+	{
+		Pointer_Sample->Filtered_Distance = DistanceSensorComputeMedian(Distance_Sensor_Samples[0].Raw_Distance, Distance_Sensor_Samples[1].Raw_Distance, Distance_Sensor_Samples[2].Raw_Distance);
+		Pointer_Sample->Is_Valid = 1;
+	}
+	
+	Distance_Sensor_Is_New_Sample_Available = 1;
+}
+
+#if DISTANCE_SENSOR_IS_ADAPTIVE_SAMPLING_ENABLED
+	/** Forget a partially received echo, so the next measure starts with the echo interrupt waiting for a rising edge. */
+	static void DistanceSensorResetEcho(void)
+	{
+		DISTANCE_SENSOR_ECHO_INTERRUPT_DISABLE();
+		
+		#if DISTANCE_SENSOR_IS_INPUT_CAPTURE_ENABLED
+			ccp4con = DISTANCE_SENSOR_CAPTURE_MODE_RISING_EDGE;
+			pir4.CCP4IF = 0;
+		#else
+			DISTANCE_SENSOR_COUNTER_TIMER_STOP();
+			DISTANCE_SENSOR_COUNTER_TIMER_RESET();
+			intcon2.INTEDG1 = 1;
+			Distance_Sensor_Is_Waiting_For_Rising_Edge = 1;
+			intcon3.INT1IF = 0;
+		#endif
+		
+		DISTANCE_SENSOR_ECHO_INTERRUPT_ENABLE();
+	}
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+void DistanceSensorInitialize(void)
+{
+	// Configure the pins as digital
+	anselb.DISTANCE_SENSOR_TRIGGER_PIN = 0;
+	anselb.DISTANCE_SENSOR_ECHO_PIN = 0;
+	
+	// Configure the pins direction
+	latb.DISTANCE_SENSOR_TRIGGER_PIN = 0; // Avoid triggering a spurious measure
+	trisb.DISTANCE_SENSOR_TRIGGER_PIN = 0; // Set as output
+	trisb.DISTANCE_SENSOR_ECHO_PIN = 1; // Set as input
+	
+	#if DISTANCE_SENSOR_IS_INPUT_CAPTURE_ENABLED
+		// Configure the timer 3 to run freely and increment every 0.5us
+		t3con = 0x33; // Use Fosc/4 as clock source, use a 8x prescaler, disable the dedicated secondary oscillator circuit, access to the timer registers in one 16-bit operation, enable the timer
+		
+		// Configure the CCP4 module to capture the timer 3 value on the next echo rising edge
+		ccptmrs1 = 0x01; // Use the timer 3 for the CCP4 module (the CCP5 module is not used)
+		ccp4con = DISTANCE_SENSOR_CAPTURE_MODE_RISING_EDGE;
+		pir4.CCP4IF = 0;
+		ipr4.CCP4IP = 0; // The hardware captures the edges time, so the interrupt latency does not alter the measure and the interrupt can be low priority
+		DISTANCE_SENSOR_ECHO_INTERRUPT_ENABLE();
+	#else
+		// Configure the timer 0 to increment every microsecond
+		t0con = 0x03; // Enable the timer in 16-bit mode, use Fosc/4 as clock source, use a 1:16 prescaler, do not start the timer
+		DISTANCE_SENSOR_COUNTER_TIMER_RESET();
+		
+		// Configure the external interrupt 1
+		intcon2.INTEDG1 = 1; // Trigger an interrupt when a rising edge is detected
+		intcon3.INT1IP = 1; // Set the interrupt as high priority
+		DISTANCE_SENSOR_ECHO_INTERRUPT_ENABLE();
+	#endif
+	
+	// Configure the timer 2 (this timer releases the trigger pin without using a busy loop in the interrupt handler)
+	pr2 = 20; // The timer period is 1us, the recommended trigger pin hold time is 10us, so use 20us for increased safety
+	ipr1.TMR2IP = 0; // Set the interrupt as low priority
+	pie1.TMR2IE = 1; // Enable the interrupt
+}
+
+void DistanceSensorStartMeasure(void)
+{
+	// Trigger a distance measure
+	latb.DISTANCE_SENSOR_TRIGGER_PIN = 1;
+	// Configure timer 2 to trigger an interrupt 20us later
+	tmr2 = 0;
+	t2con = 0x06; // Do not use a postscaler, enable the timer, set a 16x prescaler to get a timer frequency of 1MHz (so it is easy to count microseconds)
+}
+
+unsigned short DistanceSensorGetLastSampledDistance(void)
+{
+	unsigned short Distance;
+	
+	// Atomically access to the shared variable
+	DISTANCE_SENSOR_ECHO_INTERRUPT_DISABLE();
+	Distance = Distance_Sensor_Last_Measured_Distance;
+	DISTANCE_SENSOR_ECHO_INTERRUPT_ENABLE();
+	
+	return Distance;
+}
+
+void DistanceSensorGetSample(TDistanceSensorSample *Pointer_Sample)
+{
+	TDistanceSensorSample *Pointer_Newest_Sample;
+	
+	// Atomically access to the shared variables
+	SHARED_TIMER_DISABLE_INTERRUPT();
+	Pointer_Newest_Sample = &Distance_Sensor_Samples[Distance_Sensor_Newest_Sample_Index];
+	Pointer_Sample->Raw_Distance = Pointer_Newest_Sample->Raw_Distance;
+	Pointer_Sample->Filtered_Distance = Pointer_Newest_Sample->Filtered_Distance;
+	Pointer_Sample->Timestamp = Pointer_Newest_Sample->Timestamp;
+	Pointer_Sample->Sequence_Number = Pointer_Newest_Sample->Sequence_Number;
+	Pointer_Sample->Is_Valid = Pointer_Newest_Sample->Is_Valid;
+	SHARED_TIMER_ENABLE_INTERRUPT();
+}
+
+unsigned char DistanceSensorIsNewSampleAvailable(void)
+{
+	unsigned char Is_New_Sample_Available;
+	
+	// Atomically access to the shared variable
+	SHARED_TIMER_DISABLE_INTERRUPT();
+	Is_New_Sample_Available = Distance_Sensor_Is_New_Sample_Available;
+	Distance_Sensor_Is_New_Sample_Available = 0;
+	SHARED_TIMER_ENABLE_INTERRUPT();
+	
+	return Is_New_Sample_Available;
+}
+
+void DistanceSensorTimerHandler(void)
+{
+	// Store the sample as soon as the echo ended
+	if (Distance_Sensor_Is_Echo_Received)
+	{
+		Distance_Sensor_Is_Echo_Received = 0;
+		DistanceSensorAddSample();
+		
+		// Let the sensor settle once the echo ended
+		#if DISTANCE_SENSOR_IS_ADAPTIVE_SAMPLING_ENABLED
+			Distance_Sensor_Is_Measure_Running = 0;
+			Distance_Sensor_Timer_Counter = DISTANCE_SENSOR_SETTLE_TIME;
+			return;
+		#endif
+	}
+	
+	#if DISTANCE_SENSOR_IS_ADAPTIVE_SAMPLING_ENABLED
+		Distance_Sensor_Timer_Counter--;
+		if (Distance_Sensor_Timer_Counter > 0) return;
+		
+		// The echo did not end in time, give the sensor the settle time before triggering it again
+		if (Distance_Sensor_Is_Measure_Running)
+		{
+			DistanceSensorResetEcho();
+			Distance_Sensor_Samples[Distance_Sensor_Newest_Sample_Index].Is_Valid = 0; // The last sample may be outdated
+			Distance_Sensor_Is_Measure_Running = 0;
+			Distance_Sensor_Timer_Counter = DISTANCE_SENSOR_SETTLE_TIME;
+			return;
+		}
+		
+		DistanceSensorStartMeasure();
+		Distance_Sensor_Is_Measure_Running = 1;
+		Distance_Sensor_Timer_Counter = DISTANCE_SENSOR_ECHO_TIMEOUT;
+	#else
+		Distance_Sensor_Timer_Counter--;
+		if (Distance_Sensor_Timer_Counter > 0) return;
+		
+		DistanceSensorStartMeasure();
+		Distance_Sensor_Timer_Counter = DISTANCE_SENSOR_FIXED_SAMPLING_PERIOD;
+	#endif
+}
+
+#if DISTANCE_SENSOR_IS_INPUT_CAPTURE_ENABLED
+	void DistanceSensorInterruptHandler(void)
+	{
+		static unsigned short Rising_Edge_Time;
+		static unsigned long Rising_Edge_Uptime;
+		unsigned short Captured_Time, Ticks_Count;
+		unsigned long Milliseconds_Count;
+		
+		// Retrieve the time the edge occurred at
+		Captured_Time = ccpr4l;
+		Captured_Time |= (unsigned short) ccpr4h << 8;
+		
+		// A rising edge has been captured
+		if (ccp4con == DISTANCE_SENSOR_CAPTURE_MODE_RISING_EDGE)
+		{
+			Rising_Edge_Time = Captured_Time;
+			Rising_Edge_Uptime = SharedTimerGetUptime(); // The shared timer interrupt has the same priority, so it can't modify the uptime while it is read
+			ccp4con = DISTANCE_SENSOR_CAPTURE_MODE_FALLING_EDGE; // The shortest echo pulse lasts 150us, which leaves plenty of time to change the capture edge
+		}
+		// A falling edge has been captured
+		else
+		{
+			ccp4con = DISTANCE_SENSOR_CAPTURE_MODE_RISING_EDGE;
+			
+			// The unsigned subtraction gives the right result even if the timer wrapped around once
+			Ticks_Count = Captured_Time - Rising_Edge_Time;
+			
+			// The timer wraps around every 32.768ms, but the sensor sends a 38ms pulse when no object is in range. Such a pulse makes the ticks count much shorter than the uptime difference (dividing the ticks count by 2048 instead of 2000 loses less than one millisecond)
+			Milliseconds_Count = SharedTimerGetUptime() - Rising_Edge_Uptime;
+			if (Milliseconds_Count > (Ticks_Count >> 11) + 2) Distance_Sensor_Last_Measured_Distance = DISTANCE_SENSOR_OUT_OF_RANGE_DISTANCE;
+			else Distance_Sensor_Last_Measured_Distance = (Ticks_Count >> 1) + (Ticks_Count & 1); // Convert to microseconds and round to the nearest value
+			
+			Distance_Sensor_Is_Echo_Received = 1;
+		}
+		
+		// Clear the interrupt flag (changing the capture mode can set it)
+		pir4.CCP4IF = 0;
+	}
+#else
+	void DistanceSensorInterruptHandler(void)
+	{
+		// A rising edge has been detected
+		if (Distance_Sensor_Is_Waiting_For_Rising_Edge)
+		{
+			DISTANCE_SENSOR_COUNTER_TIMER_START(); // Start counting
+			intcon2.INTEDG1 = 0; // Configure the external interrupt to trigger an interrupt when a falling edge is detected
+			Distance_Sensor_Is_Waiting_For_Rising_Edge = 0;
+		}
+		// A falling edge has been detected
+		else
+		{
+			DISTANCE_SENSOR_COUNTER_TIMER_STOP(); // Stop counting
+			intcon2.INTEDG1 = 1; // Configure the external interrupt to trigger an interrupt when a rising edge is detected
+			Distance_Sensor_Is_Waiting_For_Rising_Edge = 1;
+			
+			// Retrieve the measured time
+			Distance_Sensor_Last_Measured_Distance = tmr0l; // TMR0L must be read before TMR0H to grant a valid result
+			Distance_Sensor_Last_Measured_Distance |= tmr0h << 8;
+			DISTANCE_SENSOR_COUNTER_TIMER_RESET();
+			if (Distance_Sensor_Last_Measured_Distance > DISTANCE_SENSOR_MAXIMUM_ECHO_DURATION) Distance_Sensor_Last_Measured_Distance = DISTANCE_SENSOR_OUT_OF_RANGE_DISTANCE;
+			
+			Distance_Sensor_Is_Echo_Received = 1;
+		}
+		
+		// Clear the interrupt flag
+		intcon3.INT1IF = 0;
+	}
+#endif
+
+void DistanceSensorTriggerPinInterruptHandler(void)
+{
+	// Stop the timer
+	t2con.TMR2ON = 0;
+	
+	// Release the trigger pin
+	latb.DISTANCE_SENSOR_TRIGGER_PIN = 0;
+	
+	// Clear the interrupt flag
+	pir1.TMR2IF = 0;
+}
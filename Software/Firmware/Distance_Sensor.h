@@ -1,42 +1,86 @@
-/** @file Distance_Sensor.h
- * Measure the distance between the robot and the nearest object in front of it.
- * @author Adrien RICCIARDI
- */
-#ifndef H_DISTANCE_SENSOR_H
-#define H_DISTANCE_SENSOR_H
-
-//--------------------------------------------------------------------------------------------------
-// Constants
-//--------------------------------------------------------------------------------------------------
-/** Convert a value from centimeters to the sensor unit.
- * @param Value The value to convert.
- */
-#define DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(Value) (Value * 58)
-
-/** Convert a value from sensor unit to centimeters.
- * @param Value The value to convert.
- */
-#define DISTANCE_SENSOR_CONVERT_SENSOR_UNIT_TO_CENTIMETERS(Value) (Value / 58)
-
-//--------------------------------------------------------------------------------------------------
-// Functions
-//--------------------------------------------------------------------------------------------------
-/** Initialize the timer required to measure the time elapsed between the ultrasonic burst emission and reception. */
-void DistanceSensorInitialize(void);
-
-/** Start the distance measuring procedure.
- * @warning Make sure to let almost 80ms between each measure to avoid hanging the sensor.
- */
-void DistanceSensorStartMeasure(void);
-
-/** Return the last sampled distance value.
- * @return The distance to the nearest object in sensor units (must divide by 58 to convert to cm). */
-unsigned short DistanceSensorGetLastSampledDistance(void);
-
-/** Called on RB1 pin state change. */
-void DistanceSensorInterruptHandler(void);
-
-/** Called when the trigger pin hold timer times out. */
-void DistanceSensorTriggerPinInterruptHandler(void);
-
+/** @file Distance_Sensor.h
+ * Measure the distance between the robot and the nearest object in front of it.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_DISTANCE_SENSOR_H
+#define H_DISTANCE_SENSOR_H
+
+//--------------------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------------------
+/** Set to 1 to time the echo pulse with the CCP4 module capturing the timer 3 value on both echo edges, set to 0 to start and stop the timer 0 from the INT1 interrupt.
+ * The capture is immune to the interrupt latency and uses a low priority interrupt, but the echo pin must be wired to RB0 (the CCP4 input) and the trigger pin to RB1.
+ */
+#define DISTANCE_SENSOR_IS_INPUT_CAPTURE_ENABLED 0
+
+/** Set to 1 to trigger a new measure DISTANCE_SENSOR_SETTLE_TIME milliseconds after each echo end, set to 0 to trigger a measure every DISTANCE_SENSOR_FIXED_SAMPLING_PERIOD milliseconds. A close object echo ends sooner, so the closer the object, the higher the sampling rate. */
+#define DISTANCE_SENSOR_IS_ADAPTIVE_SAMPLING_ENABLED 1
+/** How many milliseconds to wait after the echo end before triggering a new measure (the sensor needs 60ms to 80ms between two measures or it hangs). */
+#define DISTANCE_SENSOR_SETTLE_TIME 60
+/** How many milliseconds to wait for the echo end after triggering a measure. The sensor sends a 38ms echo when no object is in range, so a longer delay means that the echo was lost. The sensor is given the settle time before being triggered again. */
+#define DISTANCE_SENSOR_ECHO_TIMEOUT 50
+/** How many milliseconds between two measures when the adaptive sampling is disabled. */
+#define DISTANCE_SENSOR_FIXED_SAMPLING_PERIOD 100
+
+/** The distance reported by both measuring methods when there is no object in range. */
+#define DISTANCE_SENSOR_OUT_OF_RANGE_DISTANCE 0xFFFF
+
+/** Convert a value from centimeters to the sensor unit.
+ * @param Value The value to convert.
+ */
+#define DISTANCE_SENSOR_CONVERT_CENTIMETERS_TO_SENSOR_UNIT(Value) (Value * 58)
+
+/** Convert a value from sensor unit to centimeters.
+ * @param Value The value to convert.
+ */
+#define DISTANCE_SENSOR_CONVERT_SENSOR_UNIT_TO_CENTIMETERS(Value) (Value / 58)
+
+//--------------------------------------------------------------------------------------------------
+// Types
+//--------------------------------------------------------------------------------------------------
+/** A distance measure. */
+typedef struct
+{
+	unsigned short Raw_Distance; //!< The measured distance in sensor units.
+	unsigned short Filtered_Distance; //!< The median of the last 3 raw distances, so a single spurious echo is ignored.
+	unsigned long Timestamp; //!< The uptime when the echo ended, in milliseconds (the echo end is noticed on the next shared timer tick).
+	unsigned char Sequence_Number; //!< Incremented on each measure, so a gap tells how many samples were missed.
+	unsigned char Is_Valid; //!< 0 until 3 measures were done, or if the measure following this sample did not get any echo, 1 otherwise.
+} TDistanceSensorSample;
+
+//--------------------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------------------
+/** Initialize the timer required to measure the time elapsed between the ultrasonic burst emission and reception. */
+void DistanceSensorInitialize(void);
+
+/** Start the distance measuring procedure.
+ * @warning Make sure to let almost 80ms between each measure to avoid hanging the sensor.
+ */
+void DistanceSensorStartMeasure(void);
+
+/** Trigger the measures at the right time and recover from a lost echo. This function must be called every millisecond from the low priority interrupt context. */
+void DistanceSensorTimerHandler(void);
+
+/** Return the last sampled distance value.
+ * @return The distance to the nearest object in sensor units (must divide by 58 to convert to cm). */
+unsigned short DistanceSensorGetLastSampledDistance(void);
+
+/** Get the last sample. Any number of readers can call this function, DistanceSensorIsNewSampleAvailable() tells the artificial intelligence when the sample changed.
+ * @param Pointer_Sample On output, contain the last sample (it is zeroed until the first measure terminates).
+ */
+void DistanceSensorGetSample(TDistanceSensorSample *Pointer_Sample);
+
+/** Tell whether a sample was added since the previous call. This function is meant to be called by a single reader, the running artificial intelligence behavior.
+ * @return 0 if the last sample was already reported,
+ * @return 1 if a new sample is available.
+ */
+unsigned char DistanceSensorIsNewSampleAvailable(void);
+
+/** Called on echo pin state change (INT1 interrupt) or on echo edge capture (CCP4 interrupt). */
+void DistanceSensorInterruptHandler(void);
+
+/** Called when the trigger pin hold timer times out. */
+void DistanceSensorTriggerPinInterruptHandler(void);
+
 #endif
\ No newline at end of file
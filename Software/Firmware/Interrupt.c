@@ -1,34 +1,76 @@
-/** Interrupt.c
- * Gather all interrupt handlers.
- * @author Adrien RICCIARDI
- */
-#include <system.h>
-#include "ADC.h"
-#include "Distance_Sensor.h"
-#include "Motor.h"
-#include "Shared_Timer.h"
-#include "UART.h"
-
-//--------------------------------------------------------------------------------------------------
-// Public functions
-//--------------------------------------------------------------------------------------------------
-void interrupt(void)
-{
-	// External interrupt 1
-	if (intcon3.INT1IE && intcon3.INT1IF) DistanceSensorInterruptHandler();
-}
-
-void interrupt_low(void)
-{
-	// UART RX and TX interrupts
-	if ((pie3.RC2IE && pir3.RC2IF) || (pie3.TX2IE && pir3.TX2IF)) UARTInterruptHandler();
-	
-	// Timer 1, ECCP1 and ECCP2 interrupts
-	MotorInterruptHandler(); // The relevant interrupt flags are checked in the function
-	
-	// Timer 2 interrupt
-	if (pir1.TMR2IF) DistanceSensorTriggerPinInterruptHandler();
-	
-	// Timer 3 interrupt
-	if (pie2.TMR3IE && pir2.TMR3IF) SharedTimerInterruptHandler();
+/** Interrupt.c
+ * Gather all interrupt handlers.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "ADC.h"
+#include "Boot_Time.h"
+#include "Distance_Sensor.h"
+#include "Interrupt_Profiler.h"
+#include "Motor.h"
+#include "Shared_Timer.h"
+#include "UART.h"
+
+//--------------------------------------------------------------------------------------------------
+// Private macros
+//--------------------------------------------------------------------------------------------------
+#if INTERRUPT_PROFILER_IS_ENABLED
+	/** Call a low priority interrupt handler and account how long it lasted.
+	 * @param Handler The handler function.
+	 * @param Source The profiled source (one of the TInterruptProfilerSource values).
+	 */
+	#define INTERRUPT_CALL_PROFILED_HANDLER(Handler, Source) \
+	{ \
+		INTERRUPT_PROFILER_READ_TIMER(Handler_Start_Time); \
+		Handler(); \
+		INTERRUPT_PROFILER_READ_TIMER(Handler_End_Time); \
+		InterruptProfilerAddSample(Source, Handler_End_Time - Handler_Start_Time); \
+	}
+#else
+	#define INTERRUPT_CALL_PROFILED_HANDLER(Handler, Source) Handler()
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+void interrupt(void)
+{
+	#if !DISTANCE_SENSOR_IS_INPUT_CAPTURE_ENABLED
+		// External interrupt 1
+		if (intcon3.INT1IE && intcon3.INT1IF) DistanceSensorInterruptHandler();
+	#endif
+}
+
+void interrupt_low(void)
+{
+	#if INTERRUPT_PROFILER_IS_ENABLED
+		unsigned short Interrupt_Start_Time, Handler_Start_Time, Handler_End_Time;
+		
+		INTERRUPT_PROFILER_READ_TIMER(Interrupt_Start_Time);
+	#endif
+	
+	// UART RX and TX interrupts
+	if ((pie3.RC2IE && pir3.RC2IF) || (pie3.TX2IE && pir3.TX2IF)) INTERRUPT_CALL_PROFILED_HANDLER(UARTInterruptHandler, INTERRUPT_PROFILER_SOURCE_UART);
+	
+	// Timer 1, ECCP1 and ECCP2 interrupts (the handler checks which ones are pending)
+	if (pir1.TMR1IF || (pie1.CCP1IE && pir1.CCP1IF) || (pie2.CCP2IE && pir2.CCP2IF)) INTERRUPT_CALL_PROFILED_HANDLER(MotorInterruptHandler, INTERRUPT_PROFILER_SOURCE_MOTOR);
+	
+	// Timer 2 interrupt
+	if (pir1.TMR2IF) INTERRUPT_CALL_PROFILED_HANDLER(DistanceSensorTriggerPinInterruptHandler, INTERRUPT_PROFILER_SOURCE_DISTANCE_SENSOR_TRIGGER);
+	
+	#if DISTANCE_SENSOR_IS_INPUT_CAPTURE_ENABLED
+		// CCP4 interrupt (it is not profiled separately, its duration is accounted in the whole low priority interrupt one)
+		if (pie4.CCP4IE && pir4.CCP4IF) DistanceSensorInterruptHandler();
+	#endif
+	
+	// Timer 6 interrupt
+	if (pie5.TMR6IE && pir5.TMR6IF) INTERRUPT_CALL_PROFILED_HANDLER(SharedTimerInterruptHandler, INTERRUPT_PROFILER_SOURCE_SHARED_TIMER);
+	
+	// Timer 5 interrupt (it is enabled only while the timer measures the boot time, so it is not profiled)
+	if (pie5.TMR5IE && pir5.TMR5IF) BootTimeInterruptHandler();
+	
+	#if INTERRUPT_PROFILER_IS_ENABLED
+		INTERRUPT_PROFILER_READ_TIMER(Handler_End_Time);
+		InterruptProfilerAddSample(INTERRUPT_PROFILER_SOURCE_LOW_PRIORITY_INTERRUPT, Handler_End_Time - Interrupt_Start_Time);
+	#endif
 }
\ No newline at end of file
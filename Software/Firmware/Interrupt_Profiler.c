@@ -0,0 +1,48 @@
+/** @file Interrupt_Profiler.c
+ * @see Interrupt_Profiler.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "Interrupt_Profiler.h"
+
+//--------------------------------------------------------------------------------------------------
+// Private variables
+//--------------------------------------------------------------------------------------------------
+/** Set to 1 when the timer 5 runs at the instruction cycle frequency. */
+static unsigned char Interrupt_Profiler_Is_Started = 0;
+
+/** How many times each handler was executed. */
+static unsigned long Interrupt_Profiler_Calls_Counts[INTERRUPT_PROFILER_SOURCES_COUNT] = {0};
+/** How many instruction cycles each handler consumed. */
+static unsigned long Interrupt_Profiler_Total_Cycles[INTERRUPT_PROFILER_SOURCES_COUNT] = {0};
+/** The longest execution of each handler, in instruction cycles. */
+static unsigned short Interrupt_Profiler_Worst_Cycles[INTERRUPT_PROFILER_SOURCES_COUNT] = {0};
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+void InterruptProfilerStart(void)
+{
+	// The boot time module does not use the timer anymore
+	t5con = 0x03; // Use Fosc/4 as clock source, use a 1x prescaler, disable the dedicated secondary oscillator circuit, access to the timer registers in one 16-bit operation, enable the timer
+	Interrupt_Profiler_Is_Started = 1;
+}
+
+void InterruptProfilerAddSample(unsigned char Source, unsigned short Cycles)
+{
+	if (!Interrupt_Profiler_Is_Started) return;
+	
+	Interrupt_Profiler_Calls_Counts[Source]++;
+	Interrupt_Profiler_Total_Cycles[Source] += Cycles;
+	if (Cycles > Interrupt_Profiler_Worst_Cycles[Source]) Interrupt_Profiler_Worst_Cycles[Source] = Cycles;
+}
+
+void InterruptProfilerGetStatistics(unsigned char Source, unsigned long *Pointer_Calls_Count, unsigned long *Pointer_Total_Cycles, unsigned short *Pointer_Worst_Cycles)
+{
+	// Atomically access to the variables modified by the interrupt handler
+	intcon.GIEL = 0;
+	*Pointer_Calls_Count = Interrupt_Profiler_Calls_Counts[Source];
+	*Pointer_Total_Cycles = Interrupt_Profiler_Total_Cycles[Source];
+	*Pointer_Worst_Cycles = Interrupt_Profiler_Worst_Cycles[Source];
+	intcon.GIEL = 1;
+}
@@ -0,0 +1,60 @@
+/** @file Interrupt_Profiler.h
+ * Measure how many instruction cycles each low priority interrupt handler consumes. The timer 5 is free-running at Fosc/4 once the boot time measure is terminated, so one timer tick is one instruction cycle (62.5ns) and a handler can last up to 4.096ms before the measure wraps around.
+ * The high priority interrupt can preempt a measured handler, its duration is then included in the handler one.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_INTERRUPT_PROFILER_H
+#define H_INTERRUPT_PROFILER_H
+
+//--------------------------------------------------------------------------------------------------
+// Constants and macros
+//--------------------------------------------------------------------------------------------------
+/** Set to 1 to measure the low priority interrupt handlers, set to 0 to remove the instrumentation from the interrupt handler. */
+#define INTERRUPT_PROFILER_IS_ENABLED 1
+
+/** Read the free-running timer.
+ * @param Time The unsigned short variable receiving the timer value.
+ */
+#define INTERRUPT_PROFILER_READ_TIMER(Time) \
+{ \
+	Time = tmr5l; /* TMR5L must be read before TMR5H to grant a valid result */ \
+	Time |= (unsigned short) tmr5h << 8; \
+}
+
+//--------------------------------------------------------------------------------------------------
+// Types
+//--------------------------------------------------------------------------------------------------
+/** All measured interrupt sources (their values are used by the PC protocol, so do not reorder them). */
+typedef enum
+{
+	INTERRUPT_PROFILER_SOURCE_LOW_PRIORITY_INTERRUPT, //!< The whole low priority interrupt handler, including the handlers selection.
+	INTERRUPT_PROFILER_SOURCE_UART,
+	INTERRUPT_PROFILER_SOURCE_MOTOR,
+	INTERRUPT_PROFILER_SOURCE_DISTANCE_SENSOR_TRIGGER,
+	INTERRUPT_PROFILER_SOURCE_SHARED_TIMER,
+	INTERRUPT_PROFILER_SOURCES_COUNT
+} TInterruptProfilerSource;
+
+//--------------------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------------------
+/** Take the timer 5 and start measuring. The durations recorded before are ignored because the timer was counting the boot time.
+ * @warning This function must be called after BootTimeStop().
+ */
+void InterruptProfilerStart(void);
+
+/** Account an interrupt handler execution. This function must be called from the low priority interrupt context.
+ * @param Source The measured handler (one of the TInterruptProfilerSource values, it must be valid).
+ * @param Cycles How many instruction cycles the handler lasted.
+ */
+void InterruptProfilerAddSample(unsigned char Source, unsigned short Cycles);
+
+/** Get the statistics of an interrupt source since the profiler started.
+ * @param Source The interrupt source (one of the TInterruptProfilerSource values, it must be valid).
+ * @param Pointer_Calls_Count On output, contain how many times the handler was executed.
+ * @param Pointer_Total_Cycles On output, contain how many instruction cycles all executions lasted (it wraps around after 268s of interrupt handling).
+ * @param Pointer_Worst_Cycles On output, contain the longest execution duration in instruction cycles.
+ */
+void InterruptProfilerGetStatistics(unsigned char Source, unsigned long *Pointer_Calls_Count, unsigned long *Pointer_Total_Cycles, unsigned short *Pointer_Worst_Cycles);
+
+#endif
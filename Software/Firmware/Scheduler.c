@@ -0,0 +1,57 @@
+/** @file Scheduler.c
+ * @see Scheduler.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "Scheduler.h"
+#include "Shared_Timer.h"
+
+//--------------------------------------------------------------------------------------------------
+// Private variables
+//--------------------------------------------------------------------------------------------------
+/** The registered tasks functions. */
+static TSchedulerTaskFunction Scheduler_Tasks_Functions[SCHEDULER_MAXIMUM_TASKS_COUNT];
+/** Each task period in milliseconds. */
+static unsigned short Scheduler_Tasks_Periods[SCHEDULER_MAXIMUM_TASKS_COUNT];
+/** When each task must be called next, in milliseconds of uptime. */
+static unsigned long Scheduler_Tasks_Next_Call_Times[SCHEDULER_MAXIMUM_TASKS_COUNT];
+/** How many tasks are registered. */
+static unsigned char Scheduler_Tasks_Count = 0;
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+void SchedulerAddTask(TSchedulerTaskFunction Pointer_Function, unsigned short Period)
+{
+	// Nothing to do if there is no more room
+	if (Scheduler_Tasks_Count >= SCHEDULER_MAXIMUM_TASKS_COUNT) return;
+	
+	Scheduler_Tasks_Functions[Scheduler_Tasks_Count] = Pointer_Function;
+	Scheduler_Tasks_Periods[Scheduler_Tasks_Count] = Period;
+	Scheduler_Tasks_Next_Call_Times[Scheduler_Tasks_Count] = SharedTimerGetUptime();
+	Scheduler_Tasks_Count++;
+}
+
+void SchedulerRun(void)
+{
+	unsigned char i;
+	unsigned long Uptime;
+	TSchedulerTaskFunction Pointer_Function;
+	
+	while (1)
+	{
+		for (i = 0; i < Scheduler_Tasks_Count; i++)
+		{
+			// The signed difference stays right when the uptime wraps around
+			Uptime = SharedTimerGetUptime();
+			if ((signed long) (Uptime - Scheduler_Tasks_Next_Call_Times[i]) < 0) continue;
+			
+			// Keep the calls on the period grid, unless the task is so late that it would be called several times in a row
+			Scheduler_Tasks_Next_Call_Times[i] += Scheduler_Tasks_Periods[i];
+			if ((signed long) (Uptime - Scheduler_Tasks_Next_Call_Times[i]) >= 0) Scheduler_Tasks_Next_Call_Times[i] = Uptime + Scheduler_Tasks_Periods[i];
+			
+			Pointer_Function = Scheduler_Tasks_Functions[i];
+			Pointer_Function();
+		}
+	}
+}
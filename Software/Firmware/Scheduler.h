@@ -0,0 +1,32 @@
+/** @file Scheduler.h
+ * Cooperative run-to-completion scheduler calling the main context tasks. A task must never wait : it remembers where it stopped, returns, and continues on its next call, so a task can't delay the other ones by more than its own execution time.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_SCHEDULER_H
+#define H_SCHEDULER_H
+
+//--------------------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------------------
+/** How many tasks can be registered. */
+#define SCHEDULER_MAXIMUM_TASKS_COUNT 4
+
+//--------------------------------------------------------------------------------------------------
+// Types
+//--------------------------------------------------------------------------------------------------
+/** A task function, it must return as soon as it has nothing to do. */
+typedef void (*TSchedulerTaskFunction)(void);
+
+//--------------------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------------------
+/** Register a task. The task is first called by SchedulerRun() as soon as possible. The function does nothing if all tasks are registered yet.
+ * @param Pointer_Function The task function.
+ * @param Period How often to call the task, in milliseconds (0 calls the task on each scheduler loop).
+ */
+void SchedulerAddTask(TSchedulerTaskFunction Pointer_Function, unsigned short Period);
+
+/** Call the registered tasks forever, in their registration order. A task that is late by more than a period is called once, the missed calls are skipped. */
+void SchedulerRun(void);
+
+#endif
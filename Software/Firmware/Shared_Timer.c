@@ -1,86 +1,252 @@
-/** @file Shared_Timer.c
- * @see Shared_Timer.h for description.
- * @author Adrien RICCIARDI
- */
-#include <system.h>
-#include "ADC.h"
-#include "Distance_Sensor.h"
-#include "Shared_Timer.h"
-
-//--------------------------------------------------------------------------------------------------
-// Private variables
-//--------------------------------------------------------------------------------------------------
-/** The software timers counters. */
-static unsigned int Shared_Timer_Timers_Counters[SHARED_TIMER_TIMERS_COUNT] = {0};
-
-//--------------------------------------------------------------------------------------------------
-// Public functions
-//--------------------------------------------------------------------------------------------------
-void SharedTimerInitialize(void)
-{
-	// Configure the timer 3 to trigger an interrupt at a 30Hz frequency (the lowest frequency that can be achieved with the available input clocks)
-	tmr3h = 0xFF; // Trigger an interrupt immediately after they are enabled
-	tmr3l = 0xFF;
-	t3con = 0x33; // Use Fosc/4 as clock source, use a 8x prescaler, disable the dedicated secondary oscillator circuit, access to the timer registers in one 16-bit operation, enable the timer
-	
-	// Enable timer 3 interrupt
-	ipr2.TMR3IP = 0; // Set interrupt as low priority
-	pie2.TMR3IE = 1;
-}
-
-void SharedTimerStartTimer(unsigned char Index, unsigned int Time)
-{
-	// Nothing to do if the provided index is invalid
-	if (Index >= SHARED_TIMER_TIMERS_COUNT) return;
-
-	// Atomically set the shared variable
-	SHARED_TIMER_DISABLE_INTERRUPT();
-	Shared_Timer_Timers_Counters[Index] = Time;
-	SHARED_TIMER_ENABLE_INTERRUPT();
-}
-
-unsigned char SharedTimerIsTimerStopped(unsigned char Index)
-{
-	unsigned char Is_Time_Out_Occurred;
-	
-	// Return false if the provided index is invalid
-	if (Index >= SHARED_TIMER_TIMERS_COUNT) return 0;
-	
-	// Atomically access to the shared variable
-	SHARED_TIMER_DISABLE_INTERRUPT();
-	if (Shared_Timer_Timers_Counters[Index] == 0) Is_Time_Out_Occurred = 1;
-	else Is_Time_Out_Occurred = 0;
-	SHARED_TIMER_ENABLE_INTERRUPT();
-	
-	return Is_Time_Out_Occurred;
-}
-
-void SharedTimerInterruptHandler(void)
-{
-	static unsigned char Frequency_Divider_1Hz = 0, Frequency_Divider_10_Hz = 0;
-	unsigned char i;
-	
-	// Schedule a battery voltage measure every second
-	Frequency_Divider_1Hz++;
-	if (Frequency_Divider_1Hz >= 30)
-	{
-		ADCScheduleBatteryVoltageSampling();
-		Frequency_Divider_1Hz = 0;
-	}
-	
-	// Decrement the timers every 100ms and trigger distance sensor measuring procedure
-	Frequency_Divider_10_Hz++;
-	if (Frequency_Divider_10_Hz >= 3)
-	{
-		for (i = 0; i < SHARED_TIMER_TIMERS_COUNT; i++)
-		{
-			if (Shared_Timer_Timers_Counters[i] > 0) Shared_Timer_Timers_Counters[i]--;
-		}
-		Frequency_Divider_10_Hz = 0;
-		
-		DistanceSensorStartMeasure();
-	}
-	
-	// Clear the interrupt flag
-	pir2.TMR3IF = 0;
+/** @file Shared_Timer.c
+ * @see Shared_Timer.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "ADC.h"
+#include "Distance_Sensor.h"
+#include "Shared_Timer.h"
+#include "UART.h"
+
+//--------------------------------------------------------------------------------------------------
+// Private constants
+//--------------------------------------------------------------------------------------------------
+/** How many slots the timer wheel has (it must be a power of 2). A timer is stored in the slot matching the low bits of its expiration time, so a slot is checked every SHARED_TIMER_WHEEL_SLOTS_COUNT milliseconds. */
+#define SHARED_TIMER_WHEEL_SLOTS_COUNT 32
+/** Keep the slot index bits of a time. */
+#define SHARED_TIMER_WHEEL_SLOT_MASK (SHARED_TIMER_WHEEL_SLOTS_COUNT - 1)
+
+//--------------------------------------------------------------------------------------------------
+// Private types
+//--------------------------------------------------------------------------------------------------
+/** A software timer state. */
+typedef enum
+{
+	SHARED_TIMER_STATE_FREE, //!< The timer can be allocated.
+	SHARED_TIMER_STATE_STOPPED, //!< The timer is allocated but it is not in the wheel.
+	SHARED_TIMER_STATE_RUNNING //!< The timer is in the wheel.
+} TSharedTimerState;
+
+//--------------------------------------------------------------------------------------------------
+// Private variables
+//--------------------------------------------------------------------------------------------------
+/** How many milliseconds elapsed since the timer started (only the interrupt handler writes it). */
+static volatile unsigned long Shared_Timer_Uptime = 0;
+/** The last uptime value processed by the timer wheel. */
+static unsigned long Shared_Timer_Processed_Uptime = 0;
+
+/** Each slot first timer, or SHARED_TIMER_INVALID_HANDLE if the slot is empty. */
+static unsigned char Shared_Timer_Wheel_Slots[SHARED_TIMER_WHEEL_SLOTS_COUNT];
+/** Each timer state (one of the TSharedTimerState values). */
+static unsigned char Shared_Timer_Timers_States[SHARED_TIMER_TIMERS_COUNT] = {0};
+/** The next timer of the same slot, or SHARED_TIMER_INVALID_HANDLE at the end of the slot list. */
+static unsigned char Shared_Timer_Timers_Next_Handles[SHARED_TIMER_TIMERS_COUNT];
+/** When each timer expires, in milliseconds of uptime. */
+static unsigned long Shared_Timer_Timers_Expiration_Times[SHARED_TIMER_TIMERS_COUNT];
+/** Each timer period in milliseconds (0 for a one-shot timer). */
+static unsigned short Shared_Timer_Timers_Periods[SHARED_TIMER_TIMERS_COUNT];
+/** Each timer callback (it can be null). */
+static TSharedTimerCallback Shared_Timer_Timers_Callbacks[SHARED_TIMER_TIMERS_COUNT];
+
+//--------------------------------------------------------------------------------------------------
+// Private functions
+//--------------------------------------------------------------------------------------------------
+/** Add a timer to the slot matching its expiration time.
+ * @param Handle The timer, it must not be in the wheel yet.
+ */
+static void SharedTimerInsertInWheel(unsigned char Handle)
+{
+	unsigned char Slot;
+	
+	Slot = (unsigned char) Shared_Timer_Timers_Expiration_Times[Handle] & SHARED_TIMER_WHEEL_SLOT_MASK;
+	Shared_Timer_Timers_Next_Handles[Handle] = Shared_Timer_Wheel_Slots[Slot];
+	Shared_Timer_Wheel_Slots[Slot] = Handle;
+	Shared_Timer_Timers_States[Handle] = SHARED_TIMER_STATE_RUNNING;
+}
+
+/** Remove a timer from its slot.
+ * @param Handle The timer, it must be in the wheel.
+ */
+static void SharedTimerRemoveFromWheel(unsigned char Handle)
+{
+	unsigned char Slot, Current_Handle;
+	
+	Slot = (unsigned char) Shared_Timer_Timers_Expiration_Times[Handle] & SHARED_TIMER_WHEEL_SLOT_MASK;
+	Shared_Timer_Timers_States[Handle] = SHARED_TIMER_STATE_STOPPED;
+	
+	// Is the timer the slot first one ?
+	if (Shared_Timer_Wheel_Slots[Slot] == Handle)
+	{
+		Shared_Timer_Wheel_Slots[Slot] = Shared_Timer_Timers_Next_Handles[Handle];
+		return;
+	}
+	
+	// Find the previous timer of the slot
+	Current_Handle = Shared_Timer_Wheel_Slots[Slot];
+	while (Current_Handle != SHARED_TIMER_INVALID_HANDLE)
+	{
+		if (Shared_Timer_Timers_Next_Handles[Current_Handle] == Handle)
+		{
+			Shared_Timer_Timers_Next_Handles[Current_Handle] = Shared_Timer_Timers_Next_Handles[Handle];
+			return;
+		}
+		Current_Handle = Shared_Timer_Timers_Next_Handles[Current_Handle];
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+void SharedTimerInitialize(void)
+{
+	unsigned char i;
+	
+	// Empty the timer wheel
+	for (i = 0; i < SHARED_TIMER_WHEEL_SLOTS_COUNT; i++) Shared_Timer_Wheel_Slots[i] = SHARED_TIMER_INVALID_HANDLE;
+	
+	// Configure the timer 6 to trigger an interrupt every millisecond. The period register reloads the timer in hardware, so the uptime does not drift with the interrupt latency
+	tmr6 = 0;
+	pr6 = 249; // The timer counts from 0 to 249, so it overflows at 4KHz
+	t6con = 0x1E; // Use a 4x postscaler to get a 1KHz interrupt, enable the timer, use a 16x prescaler to get a 1MHz timer frequency from Fosc/4
+	
+	// Enable timer 6 interrupt
+	ipr5.TMR6IP = 0; // Set interrupt as low priority
+	pie5.TMR6IE = 1;
+}
+
+TSharedTimerHandle SharedTimerCreate(TSharedTimerCallback Pointer_Callback)
+{
+	unsigned char i;
+	
+	// Find the first free timer
+	for (i = 0; i < SHARED_TIMER_TIMERS_COUNT; i++)
+	{
+		if (Shared_Timer_Timers_States[i] == SHARED_TIMER_STATE_FREE)
+		{
+			Shared_Timer_Timers_Callbacks[i] = Pointer_Callback;
+			Shared_Timer_Timers_States[i] = SHARED_TIMER_STATE_STOPPED;
+			return i;
+		}
+	}
+	return SHARED_TIMER_INVALID_HANDLE;
+}
+
+void SharedTimerDelete(TSharedTimerHandle Handle)
+{
+	// Nothing to do if the provided handle is invalid
+	if (Handle >= SHARED_TIMER_TIMERS_COUNT) return;
+	
+	SharedTimerStop(Handle);
+	Shared_Timer_Timers_States[Handle] = SHARED_TIMER_STATE_FREE;
+}
+
+void SharedTimerStart(TSharedTimerHandle Handle, unsigned short Delay, unsigned short Period)
+{
+	// Nothing to do if the provided handle is invalid
+	if ((Handle >= SHARED_TIMER_TIMERS_COUNT) || (Shared_Timer_Timers_States[Handle] == SHARED_TIMER_STATE_FREE)) return;
+	
+	// Restart the timer if it is running
+	if (Shared_Timer_Timers_States[Handle] == SHARED_TIMER_STATE_RUNNING) SharedTimerRemoveFromWheel(Handle);
+	
+	// The expiration time must be later than the last processed time, or the timer would wait for the whole uptime to wrap around
+	if (Delay == 0) Delay = 1;
+	Shared_Timer_Timers_Expiration_Times[Handle] = SharedTimerGetUptime() + Delay;
+	Shared_Timer_Timers_Periods[Handle] = Period;
+	SharedTimerInsertInWheel(Handle);
+}
+
+void SharedTimerStop(TSharedTimerHandle Handle)
+{
+	// Nothing to do if the provided handle is invalid or if the timer is not running
+	if ((Handle >= SHARED_TIMER_TIMERS_COUNT) || (Shared_Timer_Timers_States[Handle] != SHARED_TIMER_STATE_RUNNING)) return;
+	
+	SharedTimerRemoveFromWheel(Handle);
+}
+
+unsigned char SharedTimerIsTimerStopped(TSharedTimerHandle Handle)
+{
+	// Return false if the provided handle is invalid
+	if ((Handle >= SHARED_TIMER_TIMERS_COUNT) || (Shared_Timer_Timers_States[Handle] == SHARED_TIMER_STATE_FREE)) return 0;
+	
+	if (Shared_Timer_Timers_States[Handle] == SHARED_TIMER_STATE_STOPPED) return 1;
+	return 0;
+}
+
+unsigned long SharedTimerGetUptime(void)
+{
+	unsigned long Uptime;
+	
+	// The 4 bytes can't be read in one instruction, so read them again until the interrupt handler did not increment the uptime in the middle of a read (a tick lasts 1ms, so at most one of both reads can be corrupted)
+	do
+	{
+		Uptime = Shared_Timer_Uptime;
+	} while (Uptime != Shared_Timer_Uptime);
+	
+	return Uptime;
+}
+
+void SharedTimerProcessTimers(void)
+{
+	unsigned long Uptime;
+	unsigned char Slot, Handle;
+	TSharedTimerCallback Pointer_Callback;
+	
+	// Catch up with all elapsed milliseconds, in case a task lasted longer than a tick
+	Uptime = SharedTimerGetUptime();
+	while (Shared_Timer_Processed_Uptime != Uptime)
+	{
+		Shared_Timer_Processed_Uptime++;
+		Slot = (unsigned char) Shared_Timer_Processed_Uptime & SHARED_TIMER_WHEEL_SLOT_MASK;
+		
+		// Expire the slot timers one at a time, because a callback can start or stop any timer and so modify the slot list
+		while (1)
+		{
+			// Find a timer expiring now (the other timers of the slot will expire on a next wheel turn)
+			Handle = Shared_Timer_Wheel_Slots[Slot];
+			while ((Handle != SHARED_TIMER_INVALID_HANDLE) && (Shared_Timer_Timers_Expiration_Times[Handle] != Shared_Timer_Processed_Uptime)) Handle = Shared_Timer_Timers_Next_Handles[Handle];
+			if (Handle == SHARED_TIMER_INVALID_HANDLE) break;
+			
+			// Reload a periodic timer before calling the callback, so the callback can stop it
+			SharedTimerRemoveFromWheel(Handle);
+			if (Shared_Timer_Timers_Periods[Handle] != 0)
+			{
+				Shared_Timer_Timers_Expiration_Times[Handle] += Shared_Timer_Timers_Periods[Handle];
+				SharedTimerInsertInWheel(Handle);
+			}
+			
+			Pointer_Callback = Shared_Timer_Timers_Callbacks[Handle];
+			if (Pointer_Callback != 0) Pointer_Callback();
+		}
+	}
+}
+
+void SharedTimerInterruptHandler(void)
+{
+	static unsigned short Frequency_Divider_1Hz = 0;
+	static unsigned char Frequency_Divider_10_Hz = 0;
+	
+	Shared_Timer_Uptime++;
+	
+	DistanceSensorTimerHandler();
+	
+	// Schedule a battery voltage measure every second
+	Frequency_Divider_1Hz++;
+	if (Frequency_Divider_1Hz >= 1000)
+	{
+		ADCScheduleBatteryVoltageSampling();
+		Frequency_Divider_1Hz = 0;
+	}
+	
+	// Run the UART timers every 100ms
+	Frequency_Divider_10_Hz++;
+	if (Frequency_Divider_10_Hz >= 100)
+	{
+		Frequency_Divider_10_Hz = 0;
+		
+		UARTBaudRateProbeTimerHandler();
+		UARTTelemetryTimerHandler();
+	}
+	
+	// Clear the interrupt flag
+	pir5.TMR6IF = 0;
 }
\ No newline at end of file
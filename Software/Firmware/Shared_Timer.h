@@ -1,41 +1,82 @@
-/** @file Shared_Timer.h
- * Use a timer interrupt to schedule multiple tasks in order to avoid generating too much interrupts due to multiple timers.
- * @author Adrien RICCIARDI
- */
-#ifndef H_SHARED_TIMER_H
-#define H_SHARED_TIMER_H
-
-//--------------------------------------------------------------------------------------------------
-// Constants
-//--------------------------------------------------------------------------------------------------
-/** Enable the timer 3 interrupt. */
-#define SHARED_TIMER_ENABLE_INTERRUPT() pie2.TMR3IE = 1
-/** Disable the timer 3 interrupt. */
-#define SHARED_TIMER_DISABLE_INTERRUPT() pie2.TMR3IE = 0
-
-/** How many software timers are available. */
-#define SHARED_TIMER_TIMERS_COUNT 5
-
-//--------------------------------------------------------------------------------------------------
-// Functions
-//--------------------------------------------------------------------------------------------------
-/** Initialize the timer 3 to generate an interrupt at a 30Hz frequency. */
-void SharedTimerInitialize(void);
-
-/** Start a non-blocking software timer. The timer will count from Time to 0. The SharedTimerIsTimerStopped() function will return 1 if the timer reached 0 or 0 if not.
- * @param Index Which timer to start. There are up to SHARED_TIMER_TIMERS_COUNT timers. The function does nothing if an invalid index is provided.
- * @param Time How many time before the timer times out, in units of 100ms.
- */
-void SharedTimerStartTimer(unsigned char Index, unsigned int Time);
-
-/** Tell if the specified timer stopped or not.
- * @param Index The timer to test. There are up to SHARED_TIMER_TIMERS_COUNT timers.
- * @return 0 if the timer is still running or an invalid index is provided,
- * @return 1 if the timer timed out.
- */
-unsigned char SharedTimerIsTimerStopped(unsigned char Index);
-
-/** Handle the timer 3 interrupt. */
-void SharedTimerInterruptHandler(void);
-
+/** @file Shared_Timer.h
+ * Use a single 1ms timer interrupt to provide the uptime and many software timers, in order to avoid generating too much interrupts due to multiple hardware timers.
+ * The interrupt handler only increments the uptime, the software timers are stored in a timer wheel that is advanced from the main context by SharedTimerProcessTimers(), so the timers callbacks can safely call any function.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_SHARED_TIMER_H
+#define H_SHARED_TIMER_H
+
+//--------------------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------------------
+/** Enable the timer 6 interrupt. */
+#define SHARED_TIMER_ENABLE_INTERRUPT() pie5.TMR6IE = 1
+/** Disable the timer 6 interrupt. */
+#define SHARED_TIMER_DISABLE_INTERRUPT() pie5.TMR6IE = 0
+
+/** How many software timers can be allocated. */
+#define SHARED_TIMER_TIMERS_COUNT 8
+
+/** The value returned by SharedTimerCreate() when no more timer is available. All functions ignore this handle. */
+#define SHARED_TIMER_INVALID_HANDLE 0xFF
+
+//--------------------------------------------------------------------------------------------------
+// Types
+//--------------------------------------------------------------------------------------------------
+/** A software timer identifier. */
+typedef unsigned char TSharedTimerHandle;
+
+/** A function called from the main context when a timer expires. */
+typedef void (*TSharedTimerCallback)(void);
+
+//--------------------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------------------
+/** Initialize the timer 6 to generate an interrupt at a 1KHz frequency. */
+void SharedTimerInitialize(void);
+
+/** Allocate a stopped software timer.
+ * @param Pointer_Callback The function to call each time the timer expires, use 0 for a timer that is only polled with SharedTimerIsTimerStopped().
+ * @return The timer handle,
+ * @return SHARED_TIMER_INVALID_HANDLE if all timers are allocated yet.
+ */
+TSharedTimerHandle SharedTimerCreate(TSharedTimerCallback Pointer_Callback);
+
+/** Stop a software timer and give it back to the pool.
+ * @param Handle The timer to free.
+ */
+void SharedTimerDelete(TSharedTimerHandle Handle);
+
+/** Start or restart a non-blocking software timer. The SharedTimerIsTimerStopped() function will return 1 when a one-shot timer expired.
+ * @param Handle Which timer to start.
+ * @param Delay How many milliseconds before the timer first expires (a null delay is considered as 1ms).
+ * @param Period How many milliseconds between the next expirations, or 0 to make a one-shot timer. A periodic timer late by several periods expires several times in a row to stay on its period grid.
+ */
+void SharedTimerStart(TSharedTimerHandle Handle, unsigned short Delay, unsigned short Period);
+
+/** Stop a software timer without calling its callback.
+ * @param Handle The timer to stop.
+ */
+void SharedTimerStop(TSharedTimerHandle Handle);
+
+/** Tell if the specified timer stopped or not.
+ * @param Handle The timer to test.
+ * @return 0 if the timer is still running or an invalid handle is provided,
+ * @return 1 if the timer expired or was stopped.
+ */
+unsigned char SharedTimerIsTimerStopped(TSharedTimerHandle Handle);
+
+/** Get the time elapsed since the firmware started. This function does not disable any interrupt, so it can be called from any context.
+ * @return The uptime in milliseconds.
+ */
+unsigned long SharedTimerGetUptime(void);
+
+/** Expire the timers that reached their deadline and call their callbacks. This function must be called from the main context as often as possible (it is a scheduler task).
+ * @warning A callback must not call this function.
+ */
+void SharedTimerProcessTimers(void);
+
+/** Handle the timer 6 interrupt. */
+void SharedTimerInterruptHandler(void);
+
 #endif
\ No newline at end of file
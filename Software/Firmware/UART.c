@@ -1,142 +1,714 @@
-/** @file UART.c
- * @see UART.h for description.
- * @author Adrien RICCIARDI
- */
-#include <system.h>
-#include "ADC.h"
-#include "Distance_Sensor.h"
-#include "UART.h"
-
-//--------------------------------------------------------------------------------------------------
-// Private constants and macros
-//--------------------------------------------------------------------------------------------------
-/** The frequency divider value to achieve a 115200 bit/s baud rate. */
-#define UART_BAUD_RATE_DIVIDER 138
-
-/** Enable the UART transmission interrupt. */
-#define UART_ENABLE_TRANSMISSION_INTERRUPT() pie3.TX2IE = 1
-/** Disable the UART transmission interrupt. */
-#define UART_DISABLE_TRANSMISSION_INTERRUPT() pie3.TX2IE = 0
-
-/** The protocol magic number. */
-#define UART_PROTOCOL_MAGIC_NUMBER 0xA5
-/** How many bytes are expected as answer. */
-#define UART_PROTOCOL_COMMAND_ANSWER_MAXIMUM_SIZE 2
-
-//--------------------------------------------------------------------------------------------------
-// Private types
-//--------------------------------------------------------------------------------------------------
-/** All existing commands. */
-typedef enum
-{
-	UART_COMMAND_GET_BATTERY_VOLTAGE,
-	UART_COMMAND_GET_DISTANCE_SENSOR_VALUE
-} TUARTCommand;
-
-//--------------------------------------------------------------------------------------------------
-// Private variables
-//--------------------------------------------------------------------------------------------------
-/** The data to transmit. */
-static unsigned char UART_Transmission_Buffer[UART_PROTOCOL_COMMAND_ANSWER_MAXIMUM_SIZE];
-/** How many bytes to send. */
-static unsigned char UART_Remaining_Bytes_To_Send = 0;
-
-//--------------------------------------------------------------------------------------------------
-// Private functions
-//--------------------------------------------------------------------------------------------------
-/** Start transmitting data.
- * @param Bytes_To_Send_Count How many bytes to send.
- * @warning There is no check on the amount of bytes to send to save some cycles.
- */
-inline void UARTStartTransmission(unsigned char Bytes_To_Send_Count)
-{
-	UART_Remaining_Bytes_To_Send = Bytes_To_Send_Count;
-	UART_ENABLE_TRANSMISSION_INTERRUPT(); // This will immediately vector to the TX interrupt
-}
-
-//--------------------------------------------------------------------------------------------------
-// Public functions
-//--------------------------------------------------------------------------------------------------
-void UARTInitialize(void)
-{
-	// Configure the baud rate generator
-	spbrg2 = (unsigned char) UART_BAUD_RATE_DIVIDER;
-	spbrgh2 = UART_BAUD_RATE_DIVIDER >> 8;
-	baudcon2 = 0x08; // Use 16-bit baud rate generator, disable Auto Baud Detect mode
-	
-	// Set the UART pins as inputs
-	trisb.7 = 1; // RX
-	trisb.6 = 1; // TX
-	
-	// Configure the module
-	rcsta2 = 0x90; // Enable the serial port, select 8-bit reception, enable reception
-	txsta2 = 0x24; // Use 8-bit transmission, enable transmission, use asynchronous mode, select high baud rate
-	
-	// Enable the UART interrupts
-	ipr3 &= ~0x30; // Set both interrupts as low priority
-	pie3.RC2IE = 1; // Enable only the reception interrupt (the transmission interrupt is enabled only when transmitting, moreover it would immediately trigger an interrupt if enabled as told in datasheet 16.1.1.7)
-}
-
-void UARTInterruptHandler(void)
-{
-	static unsigned char Is_Magic_Number_Received = 0;
-	unsigned char Byte;
-	unsigned short Word;
-	
-	// A byte has been received
-	if (pie3.RC2IE && pir3.RC2IF)
-	{
-		Byte = rcreg2;
-		
-		// Handle an overflow error
-		if (rcsta.OERR)
-		{
-			rcsta.CREN = 0; // Disable the reception to clear the error bit
-			rcsta.CREN = 1; // Re-enable it
-			return;
-		}
-		
-		// Wait for the magic number
-		if (!Is_Magic_Number_Received && (Byte == UART_PROTOCOL_MAGIC_NUMBER)) Is_Magic_Number_Received = 1;
-		// Execute the command only if the magic number has been received first
-		else if (Is_Magic_Number_Received)
-		{
-			switch (Byte)
-			{
-				case UART_COMMAND_GET_BATTERY_VOLTAGE:
-					Word = ADCGetLastSampledBatteryVoltage();
-					UART_Transmission_Buffer[0] = Word >> 8;
-					UART_Transmission_Buffer[1] = (unsigned char) Word;
-					UARTStartTransmission(2);
-					break;
-					
-				case UART_COMMAND_GET_DISTANCE_SENSOR_VALUE:
-					Word = DistanceSensorGetLastSampledDistance();
-					UART_Transmission_Buffer[0] = Word >> 8;
-					UART_Transmission_Buffer[1] = (unsigned char) Word;
-					UARTStartTransmission(2);
-					break;
-					
-				// Unknown command, do nothing
-				default:
-					break;
-			}
-			
-			Is_Magic_Number_Received = 0;
-		}
-	}
-	
-	// A byte has been sent
-	if (pie3.TX2IE && pir3.TX2IF)
-	{
-		// Send the next byte
-		if (UART_Remaining_Bytes_To_Send > 0)
-		{
-			txreg2 = UART_Transmission_Buffer[UART_PROTOCOL_COMMAND_ANSWER_MAXIMUM_SIZE - UART_Remaining_Bytes_To_Send];
-			UART_Remaining_Bytes_To_Send--;
-			
-			// Disable the transmission interrupt if there is no more byte to send
-			if (UART_Remaining_Bytes_To_Send == 0) UART_DISABLE_TRANSMISSION_INTERRUPT();
-		}
-	}
+/** @file UART.c
+ * @see UART.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <system.h>
+#include "ADC.h"
+#include "Artificial_Intelligence.h"
+#include "Boot_Time.h"
+#include "CRC.h"
+#include "Distance_Sensor.h"
+#include "EEPROM.h"
+#include "Interrupt_Profiler.h"
+#include "Motor.h"
+#include "Shared_Timer.h"
+#include "UART.h"
+
+//--------------------------------------------------------------------------------------------------
+// Private constants and macros
+//--------------------------------------------------------------------------------------------------
+/** The frequency divider value to achieve a 115200 bit/s baud rate. */
+#define UART_BAUD_RATE_DIVIDER_115200 138
+/** The frequency divider value to achieve a 230400 bit/s baud rate (0.64% error). */
+#define UART_BAUD_RATE_DIVIDER_230400 68
+/** The frequency divider value to achieve a 460800 bit/s baud rate (0.79% error). */
+#define UART_BAUD_RATE_DIVIDER_460800 34
+/** The frequency divider value to achieve a 500000 bit/s baud rate. */
+#define UART_BAUD_RATE_DIVIDER_500000 31
+/** The frequency divider value to achieve a 1000000 bit/s baud rate. */
+#define UART_BAUD_RATE_DIVIDER_1000000 15
+
+/** Prevent the UART and shared timer interrupts from accessing the variables shared with the main context. */
+#define UART_DISABLE_LOW_PRIORITY_INTERRUPTS() intcon.GIEL = 0
+/** Allow the low priority interrupts again. */
+#define UART_ENABLE_LOW_PRIORITY_INTERRUPTS() intcon.GIEL = 1
+
+/** Enable the UART transmission interrupt. */
+#define UART_ENABLE_TRANSMISSION_INTERRUPT() pie3.TX2IE = 1
+/** Disable the UART transmission interrupt. */
+#define UART_DISABLE_TRANSMISSION_INTERRUPT() pie3.TX2IE = 0
+
+/** The first byte of every frame. */
+#define UART_PROTOCOL_FRAME_SYNCHRONIZATION_BYTE 0x5A
+/** How many bytes a frame contains besides its payload : synchronization byte, payload size, sequence number, command and 16-bit CRC. */
+#define UART_PROTOCOL_FRAME_OVERHEAD_SIZE 6
+/** The biggest payload a request can carry. */
+#define UART_PROTOCOL_REQUEST_MAXIMUM_PAYLOAD_SIZE 4
+/** The biggest answer payload (the status byte followed by the answer data). */
+#define UART_PROTOCOL_ANSWER_MAXIMUM_PAYLOAD_SIZE 11
+/** The protocol version reported to the PC, increment it each time the protocol changes. */
+#define UART_PROTOCOL_VERSION 3
+/** How many requests the PC can send back-to-back without waiting for their answers (the reception buffer can hold as many of the biggest requests, and the transmission buffer as many of the biggest answers plus a telemetry frame). */
+#define UART_PROTOCOL_MAXIMUM_PENDING_REQUESTS_COUNT 6
+/** The commands the PC can send (one bit per TUARTCommand value). */
+#if INTERRUPT_PROFILER_IS_ENABLED
+	#define UART_PROTOCOL_SUPPORTED_COMMANDS_MASK 0x037F
+#else
+	#define UART_PROTOCOL_SUPPORTED_COMMANDS_MASK 0x017F
+#endif
+
+/** The first byte of the frame sent by the PC to check that the new baud rate works. */
+#define UART_PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE 0x55
+/** The second byte of the frame sent by the PC to check that the new baud rate works. */
+#define UART_PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE 0xAA
+/** How much time the PC has to send the probe, in units of 100ms (one more period is needed because the first period can be shorter). */
+#define UART_PROTOCOL_BAUD_RATE_PROBE_WAITING_TIME 3
+
+/** The reception buffer size in bytes (it must be a power of two). */
+#define UART_RECEPTION_BUFFER_SIZE 64
+/** The transmission buffer size in bytes (it must be a power of two). */
+#define UART_TRANSMISSION_BUFFER_SIZE 128
+
+/** An encoded distance sensor sample size : 16-bit filtered distance, 16-bit raw distance, 32-bit timestamp, sequence number and validity flag. */
+#define UART_DISTANCE_SENSOR_SAMPLE_SIZE 10
+
+/** A telemetry frame payload size : 32-bit timestamp, 16-bit battery voltage, motor states, artificial intelligence state and distance sensor sample. */
+#define UART_TELEMETRY_PAYLOAD_SIZE (8 + UART_DISTANCE_SENSOR_SAMPLE_SIZE)
+
+//--------------------------------------------------------------------------------------------------
+// Private types
+//--------------------------------------------------------------------------------------------------
+/** All existing commands (their values are used by the PC protocol, so do not reorder them). */
+typedef enum
+{
+	UART_COMMAND_GET_BATTERY_VOLTAGE,
+	UART_COMMAND_GET_DISTANCE_SENSOR_VALUE,
+	UART_COMMAND_SET_BAUD_RATE,
+	UART_COMMAND_ENTER_BOOTLOADER,
+	UART_COMMAND_GET_BOOT_TIME,
+	UART_COMMAND_SET_TELEMETRY_PERIOD,
+	UART_COMMAND_GET_CAPABILITIES,
+	UART_COMMAND_TELEMETRY, //!< Sent by the robot only, without request.
+	UART_COMMAND_GET_LINK_STATISTICS,
+	UART_COMMAND_GET_INTERRUPT_PROFILE
+} TUARTCommand;
+
+/** The first payload byte of every answer. */
+typedef enum
+{
+	UART_ANSWER_STATUS_SUCCESS,
+	UART_ANSWER_STATUS_UNKNOWN_COMMAND,
+	UART_ANSWER_STATUS_BAD_PAYLOAD_SIZE,
+	UART_ANSWER_STATUS_BAD_PARAMETER
+} TUARTAnswerStatus;
+
+/** What the next received byte is expected to be. */
+typedef enum
+{
+	UART_PROTOCOL_STATE_WAIT_SYNCHRONIZATION_BYTE,
+	UART_PROTOCOL_STATE_WAIT_PAYLOAD_SIZE,
+	UART_PROTOCOL_STATE_WAIT_SEQUENCE_NUMBER,
+	UART_PROTOCOL_STATE_WAIT_COMMAND,
+	UART_PROTOCOL_STATE_WAIT_PAYLOAD,
+	UART_PROTOCOL_STATE_WAIT_CRC_HIGH_BYTE,
+	UART_PROTOCOL_STATE_WAIT_CRC_LOW_BYTE,
+	UART_PROTOCOL_STATE_WAIT_BAUD_RATE_PROBE_FIRST_BYTE,
+	UART_PROTOCOL_STATE_WAIT_BAUD_RATE_PROBE_SECOND_BYTE,
+	UART_PROTOCOL_STATE_NONE //!< Tell that no interrupt handler requested a state change.
+} TUARTProtocolState;
+
+//--------------------------------------------------------------------------------------------------
+// Private variables
+//--------------------------------------------------------------------------------------------------
+/** The received bytes waiting to be decoded, it is a circular buffer filled by the interrupt handler and emptied by the main context. */
+static unsigned char UART_Reception_Buffer[UART_RECEPTION_BUFFER_SIZE];
+/** Where to store the next received byte (only the interrupt handler modifies it). */
+static volatile unsigned char UART_Reception_Buffer_Write_Index = 0;
+/** The next byte to decode (only the main context modifies it). The buffer is empty when both indexes are equal. */
+static volatile unsigned char UART_Reception_Buffer_Read_Index = 0;
+
+/** The bytes waiting to be transmitted, it is a circular buffer filled by the main context and emptied by the interrupt handler. */
+static unsigned char UART_Transmission_Buffer[UART_TRANSMISSION_BUFFER_SIZE];
+/** Where to store the next byte to transmit (only the main context modifies it). */
+static volatile unsigned char UART_Transmission_Buffer_Write_Index = 0;
+/** The next byte to transmit (only the interrupt handler modifies it). The buffer is empty when both indexes are equal. */
+static volatile unsigned char UART_Transmission_Buffer_Read_Index = 0;
+
+/** How many times the hardware reception FIFO overflowed because the interrupt was serviced too late. */
+static unsigned short UART_Reception_Overruns_Count = 0;
+/** How many received bytes were dropped because the reception buffer was full. */
+static unsigned short UART_Reception_Dropped_Bytes_Count = 0;
+/** How many bytes were not transmitted because the transmission buffer was full. */
+static unsigned short UART_Transmission_Dropped_Bytes_Count = 0;
+
+/** The payload size of the request being received. */
+static unsigned char UART_Request_Payload_Size;
+/** The sequence number of the request being received, it is copied to the answer. */
+static unsigned char UART_Request_Sequence_Number;
+/** The command of the request being received. */
+static unsigned char UART_Request_Command;
+/** The payload of the request being received. */
+static unsigned char UART_Request_Payload[UART_PROTOCOL_REQUEST_MAXIMUM_PAYLOAD_SIZE];
+/** How many payload bytes have been received. */
+static unsigned char UART_Request_Received_Payload_Bytes_Count;
+/** The CRC computed on the request bytes received so far. */
+static unsigned short UART_Request_CRC;
+
+/** The answer payload being built. */
+static unsigned char UART_Answer_Payload[UART_PROTOCOL_ANSWER_MAXIMUM_PAYLOAD_SIZE];
+
+/** The telemetry frame payload being built. */
+static unsigned char UART_Telemetry_Payload[UART_TELEMETRY_PAYLOAD_SIZE];
+/** How often to send a telemetry frame, in units of 100ms (0 means that the telemetry is disabled). */
+static unsigned char UART_Telemetry_Period = 0;
+/** How many time remains before sending the next telemetry frame, in units of 100ms. */
+static unsigned char UART_Telemetry_Remaining_Time = 0;
+/** Incremented for each telemetry frame, even the skipped ones, so the PC can detect the lost frames. */
+static volatile unsigned char UART_Telemetry_Sequence_Number = 0;
+/** Set by the timer interrupt when a telemetry frame must be sent by the main context. */
+static volatile unsigned char UART_Is_Telemetry_Frame_Pending = 0;
+
+/** The protocol decoding state (only the main context modifies it). */
+static TUARTProtocolState UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_SYNCHRONIZATION_BYTE;
+/** The decoding state an interrupt handler asks the main context to switch to when the baud rate changed, UART_PROTOCOL_STATE_NONE if there is nothing to do. */
+static volatile unsigned char UART_Protocol_Requested_State = UART_PROTOCOL_STATE_NONE;
+/** The received bytes preceding this index must be discarded when the requested state is applied. */
+static unsigned char UART_Protocol_Requested_Reception_Buffer_Read_Index;
+/** The baud rate to switch to once all pending bytes have been sent, UART_BAUD_RATES_COUNT if the baud rate must not be changed. */
+static volatile unsigned char UART_Pending_Baud_Rate = UART_BAUD_RATES_COUNT;
+/** Tell if the current baud rate is not the default one. */
+static unsigned char UART_Is_Baud_Rate_Changed = 0;
+/** How many time remains before going back to the default baud rate if the PC probe is not received (in units of 100ms). */
+static volatile unsigned char UART_Baud_Rate_Probe_Remaining_Time = 0;
+
+//--------------------------------------------------------------------------------------------------
+// Private functions
+//--------------------------------------------------------------------------------------------------
+/** Append a byte to the transmission buffer. The interrupt handler can send it as soon as the write index is updated.
+ * @param Byte The byte to transmit.
+ * @warning There is no check on the buffer free room to save some cycles.
+ */
+inline void UARTAppendByte(unsigned char Byte)
+{
+	UART_Transmission_Buffer[UART_Transmission_Buffer_Write_Index] = Byte;
+	UART_Transmission_Buffer_Write_Index = (UART_Transmission_Buffer_Write_Index + 1) & (UART_TRANSMISSION_BUFFER_SIZE - 1);
+}
+
+/** Queue a frame for transmission. The frame is dropped if the transmission buffer is full, the PC will send the request again.
+ * @param Sequence_Number The frame sequence number.
+ * @param Command The frame command.
+ * @param Pointer_Payload The frame payload.
+ * @param Payload_Size How many payload bytes to send.
+ * @return 0 if the frame has been queued,
+ * @return 1 if the frame has been dropped.
+ * @note This function must be called from the main context only, which is the only transmission buffer writer.
+ */
+static unsigned char UARTSendFrame(unsigned char Sequence_Number, unsigned char Command, unsigned char *Pointer_Payload, unsigned char Payload_Size)
+{
+	unsigned char i, Byte, Free_Bytes_Count;
+	unsigned short CRC;
+	
+	// One byte is always left unused to tell a full buffer from an empty one
+	Free_Bytes_Count = (UART_Transmission_Buffer_Read_Index - UART_Transmission_Buffer_Write_Index - 1) & (UART_TRANSMISSION_BUFFER_SIZE - 1);
+	if (Free_Bytes_Count < Payload_Size + UART_PROTOCOL_FRAME_OVERHEAD_SIZE)
+	{
+		UART_Transmission_Dropped_Bytes_Count += Payload_Size + UART_PROTOCOL_FRAME_OVERHEAD_SIZE;
+		return 1;
+	}
+	
+	// The CRC covers all bytes following the synchronization one
+	UARTAppendByte(UART_PROTOCOL_FRAME_SYNCHRONIZATION_BYTE);
+	UARTAppendByte(Payload_Size);
+	CRC = CRCUpdate(CRC_INITIAL_VALUE, Payload_Size);
+	UARTAppendByte(Sequence_Number);
+	CRC = CRCUpdate(CRC, Sequence_Number);
+	UARTAppendByte(Command);
+	CRC = CRCUpdate(CRC, Command);
+	for (i = 0; i < Payload_Size; i++)
+	{
+		Byte = Pointer_Payload[i];
+		UARTAppendByte(Byte);
+		CRC = CRCUpdate(CRC, Byte);
+	}
+	UARTAppendByte(CRC >> 8);
+	UARTAppendByte((unsigned char) CRC);
+	
+	UART_ENABLE_TRANSMISSION_INTERRUPT(); // This will immediately vector to the TX interrupt
+	return 0;
+}
+
+/** Answer the request that has just been received. The answer data must be stored in UART_Answer_Payload, starting from the second byte.
+ * @param Status The request execution status (one of the TUARTAnswerStatus values).
+ * @param Data_Size How many answer data bytes to send.
+ * @return 0 if the answer has been queued,
+ * @return 1 if the answer has been dropped.
+ */
+static unsigned char UARTSendAnswer(unsigned char Status, unsigned char Data_Size)
+{
+	UART_Answer_Payload[0] = Status;
+	return UARTSendFrame(UART_Request_Sequence_Number, UART_Request_Command, UART_Answer_Payload, Data_Size + 1);
+}
+
+/** Make sure the received request has the payload size its command expects, answer with an error otherwise.
+ * @param Expected_Size The payload size the command expects.
+ * @return 0 if the payload size is right,
+ * @return 1 if the request must not be executed.
+ */
+static unsigned char UARTCheckRequestPayloadSize(unsigned char Expected_Size)
+{
+	if (UART_Request_Payload_Size == Expected_Size) return 0;
+	
+	UARTSendAnswer(UART_ANSWER_STATUS_BAD_PAYLOAD_SIZE, 0);
+	return 1;
+}
+
+/** Encode the last distance sensor sample in big endian, so the PC can tell how old the distance is and whether it can be trusted.
+ * @param Pointer_Buffer On output, contain the encoded sample. It must be UART_DISTANCE_SENSOR_SAMPLE_SIZE bytes large.
+ */
+static void UARTEncodeDistanceSensorSample(unsigned char *Pointer_Buffer)
+{
+	TDistanceSensorSample Sample;
+	
+	DistanceSensorGetSample(&Sample);
+	Pointer_Buffer[0] = Sample.Filtered_Distance >> 8;
+	Pointer_Buffer[1] = (unsigned char) Sample.Filtered_Distance;
+	Pointer_Buffer[2] = Sample.Raw_Distance >> 8;
+	Pointer_Buffer[3] = (unsigned char) Sample.Raw_Distance;
+	Pointer_Buffer[4] = Sample.Timestamp >> 24;
+	Pointer_Buffer[5] = Sample.Timestamp >> 16;
+	Pointer_Buffer[6] = Sample.Timestamp >> 8;
+	Pointer_Buffer[7] = (unsigned char) Sample.Timestamp;
+	Pointer_Buffer[8] = Sample.Sequence_Number;
+	Pointer_Buffer[9] = Sample.Is_Valid;
+}
+
+/** Execute the request that has just been received. */
+static void UARTExecuteRequest(void)
+{
+	unsigned short Word;
+	unsigned long Double_Word, Profiled_Cycles_Count;
+	
+	switch (UART_Request_Command)
+	{
+		case UART_COMMAND_GET_BATTERY_VOLTAGE:
+			if (UARTCheckRequestPayloadSize(0) != 0) break;
+			Word = ADCGetLastSampledBatteryVoltage();
+			UART_Answer_Payload[1] = Word >> 8;
+			UART_Answer_Payload[2] = (unsigned char) Word;
+			UARTSendAnswer(UART_ANSWER_STATUS_SUCCESS, 2);
+			break;
+			
+		case UART_COMMAND_GET_DISTANCE_SENSOR_VALUE:
+			if (UARTCheckRequestPayloadSize(0) != 0) break;
+			UARTEncodeDistanceSensorSample(&UART_Answer_Payload[1]);
+			UARTSendAnswer(UART_ANSWER_STATUS_SUCCESS, UART_DISTANCE_SENSOR_SAMPLE_SIZE);
+			break;
+			
+		// Tell the PC whether the requested baud rate is supported, the switch will happen when the answer is sent
+		case UART_COMMAND_SET_BAUD_RATE:
+			if (UARTCheckRequestPayloadSize(1) != 0) break;
+			if (UART_Request_Payload[0] >= UART_BAUD_RATES_COUNT)
+			{
+				UARTSendAnswer(UART_ANSWER_STATUS_BAD_PARAMETER, 0);
+				break;
+			}
+			if (UARTSendAnswer(UART_ANSWER_STATUS_SUCCESS, 0) != 0) break;
+			UART_Pending_Baud_Rate = UART_Request_Payload[0];
+			UART_ENABLE_TRANSMISSION_INTERRUPT(); // The answer may have already been sent, so make sure the interrupt handler sees the pending baud rate
+			break;
+			
+		// There is no answer, the PC waits for the bootloader instead
+		case UART_COMMAND_ENTER_BOOTLOADER:
+			if (UARTCheckRequestPayloadSize(0) != 0) break;
+			// Tell the bootloader to wait for the PC, then reboot (the reset stops the motors too)
+			EEPROMWriteByte(EEPROM_ADDRESS_BOOTLOADER_FLAG, EEPROM_BOOTLOADER_FLAG_UPDATE_REQUESTED);
+			asm reset;
+			break;
+			
+		case UART_COMMAND_GET_BOOT_TIME:
+			if (UARTCheckRequestPayloadSize(0) != 0) break;
+			Double_Word = BootTimeGetTime();
+			UART_Answer_Payload[1] = Double_Word >> 24;
+			UART_Answer_Payload[2] = Double_Word >> 16;
+			UART_Answer_Payload[3] = Double_Word >> 8;
+			UART_Answer_Payload[4] = (unsigned char) Double_Word;
+			UARTSendAnswer(UART_ANSWER_STATUS_SUCCESS, 4);
+			break;
+			
+		// Start sending telemetry frames at the requested period (in units of 100ms), or stop if the period is 0
+		case UART_COMMAND_SET_TELEMETRY_PERIOD:
+			if (UARTCheckRequestPayloadSize(1) != 0) break;
+			UART_Telemetry_Period = UART_Request_Payload[0];
+			UART_Telemetry_Remaining_Time = UART_Request_Payload[0];
+			UARTSendAnswer(UART_ANSWER_STATUS_SUCCESS, 0);
+			break;
+			
+		case UART_COMMAND_GET_CAPABILITIES:
+			if (UARTCheckRequestPayloadSize(0) != 0) break;
+			UART_Answer_Payload[1] = UART_PROTOCOL_VERSION;
+			UART_Answer_Payload[2] = UART_PROTOCOL_REQUEST_MAXIMUM_PAYLOAD_SIZE;
+			UART_Answer_Payload[3] = UART_PROTOCOL_MAXIMUM_PENDING_REQUESTS_COUNT;
+			UART_Answer_Payload[4] = UART_PROTOCOL_SUPPORTED_COMMANDS_MASK >> 8;
+			UART_Answer_Payload[5] = (unsigned char) UART_PROTOCOL_SUPPORTED_COMMANDS_MASK;
+			UARTSendAnswer(UART_ANSWER_STATUS_SUCCESS, 5);
+			break;
+			
+		// The reception counters are modified by the interrupt handler
+		case UART_COMMAND_GET_LINK_STATISTICS:
+			if (UARTCheckRequestPayloadSize(0) != 0) break;
+			UART_DISABLE_LOW_PRIORITY_INTERRUPTS();
+			UART_Answer_Payload[1] = UART_Reception_Overruns_Count >> 8;
+			UART_Answer_Payload[2] = (unsigned char) UART_Reception_Overruns_Count;
+			UART_Answer_Payload[3] = UART_Reception_Dropped_Bytes_Count >> 8;
+			UART_Answer_Payload[4] = (unsigned char) UART_Reception_Dropped_Bytes_Count;
+			UART_ENABLE_LOW_PRIORITY_INTERRUPTS();
+			UART_Answer_Payload[5] = UART_Transmission_Dropped_Bytes_Count >> 8;
+			UART_Answer_Payload[6] = (unsigned char) UART_Transmission_Dropped_Bytes_Count;
+			UARTSendAnswer(UART_ANSWER_STATUS_SUCCESS, 6);
+			break;
+			
+		#if INTERRUPT_PROFILER_IS_ENABLED
+			// Send the statistics of the requested interrupt source
+			case UART_COMMAND_GET_INTERRUPT_PROFILE:
+				if (UARTCheckRequestPayloadSize(1) != 0) break;
+				if (UART_Request_Payload[0] >= INTERRUPT_PROFILER_SOURCES_COUNT)
+				{
+					UARTSendAnswer(UART_ANSWER_STATUS_BAD_PARAMETER, 0);
+					break;
+				}
+				InterruptProfilerGetStatistics(UART_Request_Payload[0], &Double_Word, &Profiled_Cycles_Count, &Word);
+				UART_Answer_Payload[1] = Double_Word >> 24;
+				UART_Answer_Payload[2] = Double_Word >> 16;
+				UART_Answer_Payload[3] = Double_Word >> 8;
+				UART_Answer_Payload[4] = (unsigned char) Double_Word;
+				UART_Answer_Payload[5] = Profiled_Cycles_Count >> 24;
+				UART_Answer_Payload[6] = Profiled_Cycles_Count >> 16;
+				UART_Answer_Payload[7] = Profiled_Cycles_Count >> 8;
+				UART_Answer_Payload[8] = (unsigned char) Profiled_Cycles_Count;
+				UART_Answer_Payload[9] = Word >> 8;
+				UART_Answer_Payload[10] = (unsigned char) Word;
+				UARTSendAnswer(UART_ANSWER_STATUS_SUCCESS, 10);
+				break;
+		#endif
+			
+		default:
+			UARTSendAnswer(UART_ANSWER_STATUS_UNKNOWN_COMMAND, 0);
+			break;
+	}
+}
+
+/** Change the UART baud rate once the byte being transmitted has been fully sent. The bytes received meanwhile are discarded.
+ * @param Baud_Rate The new baud rate (one of the TUARTBaudRate values, it must be valid).
+ * @note Waiting for the transmission end lasts at most one byte duration, this happens only when the PC negotiates the baud rate.
+ */
+static void UARTSetBaudRate(unsigned char Baud_Rate)
+{
+	unsigned short Divider;
+	unsigned char Byte;
+	
+	switch (Baud_Rate)
+	{
+		case UART_BAUD_RATE_230400:
+			Divider = UART_BAUD_RATE_DIVIDER_230400;
+			break;
+			
+		case UART_BAUD_RATE_460800:
+			Divider = UART_BAUD_RATE_DIVIDER_460800;
+			break;
+			
+		case UART_BAUD_RATE_500000:
+			Divider = UART_BAUD_RATE_DIVIDER_500000;
+			break;
+			
+		case UART_BAUD_RATE_1000000:
+			Divider = UART_BAUD_RATE_DIVIDER_1000000;
+			break;
+			
+		default:
+			Divider = UART_BAUD_RATE_DIVIDER_115200;
+			break;
+	}
+	
+	// Wait for the last byte to be fully transmitted
+	while (!txsta2.TRMT);
+	
+	// Change the baud rate
+	spbrg2 = (unsigned char) Divider;
+	spbrgh2 = Divider >> 8;
+	if (Baud_Rate == UART_BAUD_RATE_115200) UART_Is_Baud_Rate_Changed = 0;
+	else UART_Is_Baud_Rate_Changed = 1;
+	
+	// Discard anything received during the switch
+	rcsta2.CREN = 0; // Clear a possible overrun error
+	rcsta2.CREN = 1;
+	while (pir3.RC2IF) Byte = rcreg2;
+}
+
+/** Ask the main context to switch to another decoding state, discarding the bytes received so far.
+ * @param State The new decoding state.
+ * @note This function must be called with the low priority interrupts disabled.
+ */
+static void UARTRequestProtocolState(unsigned char State)
+{
+	UART_Protocol_Requested_Reception_Buffer_Read_Index = UART_Reception_Buffer_Write_Index;
+	UART_Protocol_Requested_State = State;
+}
+
+/** Go back to the default baud rate and wait for a new command.
+ * @note This function must be called with the low priority interrupts disabled.
+ */
+static void UARTRestoreDefaultBaudRate(void)
+{
+	UARTSetBaudRate(UART_BAUD_RATE_115200);
+	UART_Baud_Rate_Probe_Remaining_Time = 0;
+	UARTRequestProtocolState(UART_PROTOCOL_STATE_WAIT_SYNCHRONIZATION_BYTE);
+}
+
+/** Feed a received byte to the protocol decoder, executing the request once it is fully received.
+ * @param Byte The received byte.
+ */
+static void UARTDecodeByte(unsigned char Byte)
+{
+	switch (UART_Protocol_State)
+	{
+		// Wait for the beginning of a frame
+		case UART_PROTOCOL_STATE_WAIT_SYNCHRONIZATION_BYTE:
+			if (Byte == UART_PROTOCOL_FRAME_SYNCHRONIZATION_BYTE) UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_PAYLOAD_SIZE;
+			break;
+			
+		// A too big payload can only come from a corrupted frame
+		case UART_PROTOCOL_STATE_WAIT_PAYLOAD_SIZE:
+			if (Byte > UART_PROTOCOL_REQUEST_MAXIMUM_PAYLOAD_SIZE)
+			{
+				UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_SYNCHRONIZATION_BYTE;
+				break;
+			}
+			UART_Request_Payload_Size = Byte;
+			UART_Request_CRC = CRCUpdate(CRC_INITIAL_VALUE, Byte);
+			UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_SEQUENCE_NUMBER;
+			break;
+			
+		case UART_PROTOCOL_STATE_WAIT_SEQUENCE_NUMBER:
+			UART_Request_Sequence_Number = Byte;
+			UART_Request_CRC = CRCUpdate(UART_Request_CRC, Byte);
+			UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_COMMAND;
+			break;
+			
+		case UART_PROTOCOL_STATE_WAIT_COMMAND:
+			UART_Request_Command = Byte;
+			UART_Request_CRC = CRCUpdate(UART_Request_CRC, Byte);
+			UART_Request_Received_Payload_Bytes_Count = 0;
+			if (UART_Request_Payload_Size > 0) UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_PAYLOAD;
+			else UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_CRC_HIGH_BYTE;
+			break;
+			
+		case UART_PROTOCOL_STATE_WAIT_PAYLOAD:
+			UART_Request_Payload[UART_Request_Received_Payload_Bytes_Count] = Byte;
+			UART_Request_Received_Payload_Bytes_Count++;
+			UART_Request_CRC = CRCUpdate(UART_Request_CRC, Byte);
+			if (UART_Request_Received_Payload_Bytes_Count >= UART_Request_Payload_Size) UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_CRC_HIGH_BYTE;
+			break;
+			
+		// Silently discard a corrupted frame, the PC will send it again when the answer does not come
+		case UART_PROTOCOL_STATE_WAIT_CRC_HIGH_BYTE:
+			if (Byte == (UART_Request_CRC >> 8)) UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_CRC_LOW_BYTE;
+			else UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_SYNCHRONIZATION_BYTE;
+			break;
+			
+		case UART_PROTOCOL_STATE_WAIT_CRC_LOW_BYTE:
+			UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_SYNCHRONIZATION_BYTE;
+			if (Byte == (unsigned char) UART_Request_CRC) UARTExecuteRequest();
+			break;
+			
+		// Echo the PC probe if it is correctly received at the new baud rate, otherwise go back to the default baud rate
+		case UART_PROTOCOL_STATE_WAIT_BAUD_RATE_PROBE_FIRST_BYTE:
+			if (Byte == UART_PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE) UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_BAUD_RATE_PROBE_SECOND_BYTE;
+			else
+			{
+				UART_DISABLE_LOW_PRIORITY_INTERRUPTS();
+				UARTRestoreDefaultBaudRate();
+				UART_ENABLE_LOW_PRIORITY_INTERRUPTS();
+			}
+			break;
+			
+		// The probe is not framed, it only checks that the link works (the transmission buffer is empty as the baud rate has just been changed)
+		case UART_PROTOCOL_STATE_WAIT_BAUD_RATE_PROBE_SECOND_BYTE:
+			if (Byte == UART_PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE)
+			{
+				UART_Baud_Rate_Probe_Remaining_Time = 0;
+				UARTAppendByte(UART_PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE);
+				UARTAppendByte(UART_PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE);
+				UART_ENABLE_TRANSMISSION_INTERRUPT();
+				UART_Protocol_State = UART_PROTOCOL_STATE_WAIT_SYNCHRONIZATION_BYTE;
+			}
+			else
+			{
+				UART_DISABLE_LOW_PRIORITY_INTERRUPTS();
+				UARTRestoreDefaultBaudRate();
+				UART_ENABLE_LOW_PRIORITY_INTERRUPTS();
+			}
+			break;
+	}
+}
+
+/** Build and queue a telemetry frame. */
+static void UARTSendTelemetryFrame(void)
+{
+	unsigned short Word;
+	unsigned long Double_Word;
+	
+	Double_Word = SharedTimerGetUptime();
+	UART_Telemetry_Payload[0] = Double_Word >> 24;
+	UART_Telemetry_Payload[1] = Double_Word >> 16;
+	UART_Telemetry_Payload[2] = Double_Word >> 8;
+	UART_Telemetry_Payload[3] = (unsigned char) Double_Word;
+	Word = ADCGetLastSampledBatteryVoltage();
+	UART_Telemetry_Payload[4] = Word >> 8;
+	UART_Telemetry_Payload[5] = (unsigned char) Word;
+	UART_Telemetry_Payload[6] = (MotorGetState(MOTOR_RIGHT) << 4) | MotorGetState(MOTOR_LEFT);
+	UART_Telemetry_Payload[7] = ArtificialIntelligenceGetState();
+	UARTEncodeDistanceSensorSample(&UART_Telemetry_Payload[8]);
+	
+	// The frame is skipped if the transmission buffer is full
+	UARTSendFrame(UART_Telemetry_Sequence_Number, UART_COMMAND_TELEMETRY, UART_Telemetry_Payload, UART_TELEMETRY_PAYLOAD_SIZE);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Public functions
+//--------------------------------------------------------------------------------------------------
+void UARTInitialize(void)
+{
+	// Configure the baud rate generator
+	spbrg2 = (unsigned char) UART_BAUD_RATE_DIVIDER_115200;
+	spbrgh2 = UART_BAUD_RATE_DIVIDER_115200 >> 8;
+	baudcon2 = 0x08; // Use 16-bit baud rate generator, disable Auto Baud Detect mode
+	
+	// Set the UART pins as inputs
+	trisb.7 = 1; // RX
+	trisb.6 = 1; // TX
+	
+	// Configure the module
+	rcsta2 = 0x90; // Enable the serial port, select 8-bit reception, enable reception
+	txsta2 = 0x24; // Use 8-bit transmission, enable transmission, use asynchronous mode, select high baud rate
+	
+	// Enable the UART interrupts
+	ipr3 &= ~0x30; // Set both interrupts as low priority
+	pie3.RC2IE = 1; // Enable only the reception interrupt (the transmission interrupt is enabled only when transmitting, moreover it would immediately trigger an interrupt if enabled as told in datasheet §16.1.1.7)
+}
+
+void UARTBaudRateProbeTimerHandler(void)
+{
+	if (UART_Baud_Rate_Probe_Remaining_Time == 0) return;
+	
+	UART_Baud_Rate_Probe_Remaining_Time--;
+	if (UART_Baud_Rate_Probe_Remaining_Time == 0) UARTRestoreDefaultBaudRate();
+}
+
+void UARTTelemetryTimerHandler(void)
+{
+	if (UART_Telemetry_Period == 0) return;
+	
+	UART_Telemetry_Remaining_Time--;
+	if (UART_Telemetry_Remaining_Time > 0) return;
+	UART_Telemetry_Remaining_Time = UART_Telemetry_Period;
+	
+	// The frame is built by the main context, a frame it had no time to send is skipped but still numbered
+	UART_Telemetry_Sequence_Number++;
+	UART_Is_Telemetry_Frame_Pending = 1;
+}
+
+void UARTProcessRequests(void)
+{
+	unsigned char Byte;
+	
+	while (1)
+	{
+		// Apply the decoding state requested by an interrupt handler, dropping the bytes received at the previous baud rate
+		if (UART_Protocol_Requested_State != UART_PROTOCOL_STATE_NONE)
+		{
+			UART_DISABLE_LOW_PRIORITY_INTERRUPTS();
+			UART_Protocol_State = UART_Protocol_Requested_State;
+			UART_Reception_Buffer_Read_Index = UART_Protocol_Requested_Reception_Buffer_Read_Index;
+			UART_Protocol_Requested_State = UART_PROTOCOL_STATE_NONE;
+			UART_ENABLE_LOW_PRIORITY_INTERRUPTS();
+		}
+		
+		if (UART_Reception_Buffer_Read_Index == UART_Reception_Buffer_Write_Index) break;
+		Byte = UART_Reception_Buffer[UART_Reception_Buffer_Read_Index];
+		UART_Reception_Buffer_Read_Index = (UART_Reception_Buffer_Read_Index + 1) & (UART_RECEPTION_BUFFER_SIZE - 1);
+		UARTDecodeByte(Byte);
+	}
+	
+	if (UART_Is_Telemetry_Frame_Pending)
+	{
+		UART_Is_Telemetry_Frame_Pending = 0;
+		
+		// Skip the frame if the PC is negotiating a baud rate because it waits for specific answers
+		if ((UART_Pending_Baud_Rate == UART_BAUD_RATES_COUNT) && (UART_Baud_Rate_Probe_Remaining_Time == 0)) UARTSendTelemetryFrame();
+	}
+}
+
+void UARTInterruptHandler(void)
+{
+	unsigned char Byte, Is_Framing_Error_Detected, Next_Write_Index;
+	
+	// Bytes have been received, only store them so the interrupt stays short
+	if (pie3.RC2IE && pir3.RC2IF)
+	{
+		// Empty the hardware FIFO, whose content is still valid in case of overrun
+		while (pir3.RC2IF)
+		{
+			Is_Framing_Error_Detected = rcsta2.FERR; // This bit must be read before the received byte
+			Byte = rcreg2;
+			
+			// A PC talking at the default baud rate while a faster one is in use produces framing errors, so fall back to the default baud rate
+			if (Is_Framing_Error_Detected && UART_Is_Baud_Rate_Changed)
+			{
+				UARTRestoreDefaultBaudRate(); // This also empties the FIFO and clears an overrun
+				break;
+			}
+			
+			Next_Write_Index = (UART_Reception_Buffer_Write_Index + 1) & (UART_RECEPTION_BUFFER_SIZE - 1);
+			if (Next_Write_Index == UART_Reception_Buffer_Read_Index) UART_Reception_Dropped_Bytes_Count++;
+			else
+			{
+				UART_Reception_Buffer[UART_Reception_Buffer_Write_Index] = Byte;
+				UART_Reception_Buffer_Write_Index = Next_Write_Index;
+			}
+		}
+		
+		// The reception is stopped until an overrun error is cleared
+		if (rcsta2.OERR)
+		{
+			rcsta2.CREN = 0; // Disable the reception to clear the error bit
+			rcsta2.CREN = 1; // Re-enable it
+			UART_Reception_Overruns_Count++;
+		}
+	}
+	
+	// A byte has been sent
+	if (pie3.TX2IE && pir3.TX2IF)
+	{
+		// Send the next byte
+		if (UART_Transmission_Buffer_Read_Index != UART_Transmission_Buffer_Write_Index)
+		{
+			txreg2 = UART_Transmission_Buffer[UART_Transmission_Buffer_Read_Index];
+			UART_Transmission_Buffer_Read_Index = (UART_Transmission_Buffer_Read_Index + 1) & (UART_TRANSMISSION_BUFFER_SIZE - 1);
+		}
+		
+		// Disable the transmission interrupt if there is no more byte to send (the main context enables it again after having queued new bytes)
+		if (UART_Transmission_Buffer_Read_Index == UART_Transmission_Buffer_Write_Index)
+		{
+			UART_DISABLE_TRANSMISSION_INTERRUPT();
+			
+			// Switch to the negotiated baud rate and wait for the PC probe
+			if (UART_Pending_Baud_Rate < UART_BAUD_RATES_COUNT)
+			{
+				UARTSetBaudRate(UART_Pending_Baud_Rate);
+				UART_Pending_Baud_Rate = UART_BAUD_RATES_COUNT;
+				UART_Baud_Rate_Probe_Remaining_Time = UART_PROTOCOL_BAUD_RATE_PROBE_WAITING_TIME;
+				UARTRequestProtocolState(UART_PROTOCOL_STATE_WAIT_BAUD_RATE_PROBE_FIRST_BYTE);
+			}
+		}
+	}
 }
\ No newline at end of file
@@ -1,17 +1,42 @@
-/** @file UART.h
- * Interrupt-driven UART driver.
- * @author Adrien RICCIARDI
- */
-#ifndef H_UART_H
-#define H_UART_H
-
-//--------------------------------------------------------------------------------------------------
-// Functions
-//--------------------------------------------------------------------------------------------------
-/** Initialize the UART at 115200 bauds, 8 data bits, no parity, 1 stop bit. */
-void UARTInitialize(void);
-
-/** The UART interrupt handler. */
-void UARTInterruptHandler(void);
-
+/** @file UART.h
+ * Interrupt-driven UART driver exchanging CRC-protected frames with the PC.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_UART_H
+#define H_UART_H
+
+//--------------------------------------------------------------------------------------------------
+// Types
+//--------------------------------------------------------------------------------------------------
+/** All supported baud rates (their values are used by the PC protocol, so do not reorder them). */
+typedef enum
+{
+	UART_BAUD_RATE_115200,
+	UART_BAUD_RATE_230400,
+	UART_BAUD_RATE_460800,
+	UART_BAUD_RATE_500000,
+	UART_BAUD_RATE_1000000,
+	UART_BAUD_RATES_COUNT
+} TUARTBaudRate;
+
+//--------------------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------------------
+/** Initialize the UART at 115200 bauds, 8 data bits, no parity, 1 stop bit. */
+void UARTInitialize(void);
+
+/** Go back to the default baud rate if the PC did not confirm a new baud rate in time. This function must be called every 100ms from an interrupt context which can't be interrupted by the UART one. */
+void UARTBaudRateProbeTimerHandler(void);
+
+/** Tell the main context to send a telemetry frame if the PC asked for periodic telemetry and the period is elapsed. This function must be called every 100ms from an interrupt context which can't be interrupted by the UART one. */
+void UARTTelemetryTimerHandler(void);
+
+/** Decode the bytes received since the last call, execute the complete requests and send the pending telemetry frame. This function must be called often from the main context (a request is answered only when this function runs).
+ * @note The interrupt handler only stores the received bytes in a ring buffer, which can hold several pending requests.
+ */
+void UARTProcessRequests(void);
+
+/** The UART interrupt handler, it only moves the bytes between the hardware and the reception and transmission ring buffers. */
+void UARTInterruptHandler(void);
+
 #endif
\ No newline at end of file
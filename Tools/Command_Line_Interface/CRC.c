@@ -0,0 +1,34 @@
+/** @file CRC.c
+ * @see CRC.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include "CRC.h"
+
+//-------------------------------------------------------------------------------------------------
+// Public functions
+//-------------------------------------------------------------------------------------------------
+unsigned short CRCUpdate(unsigned short CRC, unsigned char Byte)
+{
+	unsigned char Value;
+	
+	// Use the same algorithm than the robot to be sure to get the same results
+	Value = (CRC >> 8) ^ Byte;
+	Value ^= Value >> 4;
+	CRC = (CRC << 8) ^ ((unsigned short) Value << 12) ^ ((unsigned short) Value << 5) ^ Value;
+	
+	return CRC;
+}
+
+unsigned short CRCComputeBuffer(void *Pointer_Buffer, int Size)
+{
+	unsigned char *Pointer_Bytes = Pointer_Buffer;
+	unsigned short CRC = CRC_INITIAL_VALUE;
+	
+	while (Size > 0)
+	{
+		CRC = CRCUpdate(CRC, *Pointer_Bytes);
+		Pointer_Bytes++;
+		Size--;
+	}
+	return CRC;
+}
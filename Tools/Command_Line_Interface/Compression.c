@@ -0,0 +1,84 @@
+/** @file Compression.c
+ * @see Compression.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include "Compression.h"
+#include "Configuration.h"
+
+//-------------------------------------------------------------------------------------------------
+// Private constants
+//-------------------------------------------------------------------------------------------------
+/** The literal token base value. */
+#define COMPRESSION_TOKEN_LITERAL 0x00
+/** The repeated byte token base value. */
+#define COMPRESSION_TOKEN_RUN 0x40
+/** The back-reference token base value. */
+#define COMPRESSION_TOKEN_COPY 0x80
+
+/** A run or a copy must be at least this long to be worth its 2-byte token. */
+#define COMPRESSION_MINIMUM_MATCH_LENGTH 3
+
+//-------------------------------------------------------------------------------------------------
+// Public functions
+//-------------------------------------------------------------------------------------------------
+int CompressionCompressBlock(unsigned char *Pointer_Block, unsigned char *Pointer_Compressed_Block)
+{
+	int Position = 0, Compressed_Size = 0, Literal_Token_Position = -1, Run_Length, Copy_Length, Copy_Distance, Distance, Length;
+	
+	while (Position < COMPRESSION_BLOCK_SIZE)
+	{
+		// Count how many times the current byte is repeated
+		Run_Length = 1;
+		while ((Position + Run_Length < COMPRESSION_BLOCK_SIZE) && (Pointer_Block[Position + Run_Length] == Pointer_Block[Position])) Run_Length++;
+		
+		// Find the longest match in the already processed data (the match can overlap the current position)
+		Copy_Length = 0;
+		Copy_Distance = 0;
+		for (Distance = 1; Distance <= Position; Distance++)
+		{
+			Length = 0;
+			while ((Position + Length < COMPRESSION_BLOCK_SIZE) && (Pointer_Block[Position + Length - Distance] == Pointer_Block[Position + Length])) Length++;
+			if (Length > Copy_Length)
+			{
+				Copy_Length = Length;
+				Copy_Distance = Distance;
+			}
+		}
+		
+		// Prefer the run as it does not depend on previous data
+		if ((Run_Length >= COMPRESSION_MINIMUM_MATCH_LENGTH) && (Run_Length >= Copy_Length))
+		{
+			Pointer_Compressed_Block[Compressed_Size] = COMPRESSION_TOKEN_RUN | (Run_Length - 1);
+			Pointer_Compressed_Block[Compressed_Size + 1] = Pointer_Block[Position];
+			Compressed_Size += 2;
+			Position += Run_Length;
+			Literal_Token_Position = -1;
+		}
+		else if (Copy_Length >= COMPRESSION_MINIMUM_MATCH_LENGTH)
+		{
+			Pointer_Compressed_Block[Compressed_Size] = COMPRESSION_TOKEN_COPY | (Copy_Length - 1);
+			Pointer_Compressed_Block[Compressed_Size + 1] = (unsigned char) Copy_Distance;
+			Compressed_Size += 2;
+			Position += Copy_Length;
+			Literal_Token_Position = -1;
+		}
+		// Append the byte to the current literal token, starting a new token if needed
+		else
+		{
+			if (Literal_Token_Position < 0)
+			{
+				Literal_Token_Position = Compressed_Size;
+				Pointer_Compressed_Block[Compressed_Size] = COMPRESSION_TOKEN_LITERAL;
+				Compressed_Size++;
+			}
+			else Pointer_Compressed_Block[Literal_Token_Position]++;
+			
+			Pointer_Compressed_Block[Compressed_Size] = Pointer_Block[Position];
+			Compressed_Size++;
+			Position++;
+		}
+	}
+	Debug("[%s] Compressed block size : %d bytes.\n", __func__, Compressed_Size);
+	
+	return Compressed_Size;
+}
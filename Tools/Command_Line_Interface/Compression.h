@@ -0,0 +1,30 @@
+/** @file Compression.h
+ * Compress a flash block so it can be transmitted faster to the bootloader, which decompresses it on the fly.
+ * Each block is compressed independently of the others, using a sequence of the following tokens :
+ * - 0x00 to 0x3F : (Token + 1) literal bytes follow,
+ * - 0x40 to 0x7F : the next byte must be repeated ((Token & 0x3F) + 1) times,
+ * - 0x80 to 0xFF : copy ((Token & 0x7F) + 1) bytes located at the distance given by the next byte backward in the block.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_COMPRESSION_H
+#define H_COMPRESSION_H
+
+//-------------------------------------------------------------------------------------------------
+// Constants
+//-------------------------------------------------------------------------------------------------
+/** The size of the blocks to compress. */
+#define COMPRESSION_BLOCK_SIZE 64
+/** The worst-case size of a compressed block (only literal tokens). */
+#define COMPRESSION_MAXIMUM_COMPRESSED_BLOCK_SIZE (COMPRESSION_BLOCK_SIZE + 1)
+
+//-------------------------------------------------------------------------------------------------
+// Functions
+//-------------------------------------------------------------------------------------------------
+/** Compress a block.
+ * @param Pointer_Block The data to compress (COMPRESSION_BLOCK_SIZE bytes).
+ * @param Pointer_Compressed_Block On output, contain the compressed data. Make sure this buffer is at least COMPRESSION_MAXIMUM_COMPRESSED_BLOCK_SIZE bytes large.
+ * @return The compressed data size in bytes.
+ */
+int CompressionCompressBlock(unsigned char *Pointer_Block, unsigned char *Pointer_Compressed_Block);
+
+#endif
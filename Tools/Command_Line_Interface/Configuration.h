@@ -13,7 +13,18 @@
 /** The target processor memory size in bytes. */
 #define CONFIGURATION_TARGET_PROCESSOR_MEMORY_SIZE 65536
 /** The target processor firmware base address. */
-#define CONFIGURATION_FIRMWARE_BASE_ADDRESS 0x0300
+#define CONFIGURATION_FIRMWARE_BASE_ADDRESS 0x0800
+/** Where the hex file stores the configuration words. */
+#define CONFIGURATION_TARGET_PROCESSOR_CONFIGURATION_WORDS_ADDRESS 0x300000
+/** The configuration words area size in bytes. */
+#define CONFIGURATION_TARGET_PROCESSOR_CONFIGURATION_WORDS_SIZE 14
+/** Where the hex file stores the data EEPROM content. */
+#define CONFIGURATION_TARGET_PROCESSOR_EEPROM_ADDRESS 0xF00000
+/** The data EEPROM size in bytes. */
+#define CONFIGURATION_TARGET_PROCESSOR_EEPROM_SIZE 1024
+
+/** The fastest baud rate the USB-serial adapter can sustain. The robot supports 115200, 230400, 460800, 500000 and 1000000 bit/s. */
+#define CONFIGURATION_MAXIMUM_BAUD_RATE 1000000
 
 #if CONFIGURATION_ENABLE_DEBUG == 1
 	#define Debug(Format, ...) printf(Format, ##__VA_ARGS__)
@@ -0,0 +1,468 @@
+/** @file Daemon.c
+ * @see Daemon.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h> // Needed by lstat()
+#include <sys/un.h> // Needed by struct sockaddr_un
+#include <unistd.h>
+#include "Configuration.h"
+#include "CRC.h"
+#include "Daemon.h"
+#include "Protocol.h"
+
+//-------------------------------------------------------------------------------------------------
+// Private constants
+//-------------------------------------------------------------------------------------------------
+/** How many clients can be connected at the same time. */
+#define DAEMON_MAXIMUM_CLIENTS_COUNT 32
+/** How many client requests can be gathered in a single batch. */
+#define DAEMON_MAXIMUM_BATCH_QUERIES_COUNT 64
+/** How many bytes received from a client can wait to be decoded. */
+#define DAEMON_CLIENT_RECEPTION_BUFFER_SIZE 1024
+/** How many answer bytes can be sent to a client after a batch (all the batch requests may come from the same client). */
+#define DAEMON_CLIENT_TRANSMISSION_BUFFER_SIZE (DAEMON_MAXIMUM_BATCH_QUERIES_COUNT * (PROTOCOL_FRAME_OVERHEAD_SIZE + PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE))
+
+/** The commands the daemon does not forward, as a TProtocolCommand mask. */
+#define DAEMON_REFUSED_COMMANDS_MASK ((1 << PROTOCOL_COMMAND_SET_BAUD_RATE) | (1 << PROTOCOL_COMMAND_ENTER_BOOTLOADER) | (1 << PROTOCOL_COMMAND_SET_TELEMETRY_PERIOD))
+
+//-------------------------------------------------------------------------------------------------
+// Private types
+//-------------------------------------------------------------------------------------------------
+/** A connected client. */
+typedef struct
+{
+	int Socket; //!< The client connection, -1 if this slot is free.
+	unsigned char Reception_Buffer[DAEMON_CLIENT_RECEPTION_BUFFER_SIZE]; //!< The received bytes that were not decoded yet.
+	int Reception_Buffer_Bytes_Count; //!< How many bytes the reception buffer contains.
+	unsigned char Transmission_Buffer[DAEMON_CLIENT_TRANSMISSION_BUFFER_SIZE]; //!< The answers waiting to be sent.
+	int Transmission_Buffer_Bytes_Count; //!< How many bytes are waiting to be sent.
+} TDaemonClient;
+
+/** A request received from a client. */
+typedef struct
+{
+	TDaemonClient *Pointer_Client; //!< The client to answer to.
+	unsigned char Sequence_Number; //!< The client frame sequence number, the answer must carry it.
+	unsigned char Command; //!< The client frame command.
+	int Request_Index; //!< The robot request answering this query in the batch, or -1 if the daemon refuses the command.
+} TDaemonQuery;
+
+//-------------------------------------------------------------------------------------------------
+// Private variables
+//-------------------------------------------------------------------------------------------------
+/** Set to 1 when the user hits Ctrl+C. */
+static volatile sig_atomic_t Daemon_Is_Exit_Requested = 0;
+
+/** All client slots. */
+static TDaemonClient Daemon_Clients[DAEMON_MAXIMUM_CLIENTS_COUNT];
+
+/** The client requests of the current batch. */
+static TDaemonQuery Daemon_Queries[DAEMON_MAXIMUM_BATCH_QUERIES_COUNT];
+/** How many client requests the current batch contains. */
+static int Daemon_Queries_Count;
+/** The requests to send to the robot for the current batch, several queries can share the same request. */
+static TProtocolRequest Daemon_Requests[DAEMON_MAXIMUM_BATCH_QUERIES_COUNT];
+/** How many requests will be sent to the robot for the current batch. */
+static int Daemon_Requests_Count;
+
+/** How many requests were received from the clients. */
+static unsigned long Daemon_Received_Queries_Count = 0;
+/** How many requests were sent to the robot. */
+static unsigned long Daemon_Sent_Requests_Count = 0;
+
+//-------------------------------------------------------------------------------------------------
+// Private functions
+//-------------------------------------------------------------------------------------------------
+/** Tell the daemon loop to stop.
+ * @param Signal_Number Not used.
+ */
+static void DaemonSignalHandler(int __attribute__((unused)) Signal_Number)
+{
+	Daemon_Is_Exit_Requested = 1;
+}
+
+/** Create the socket the clients connect to.
+ * @param String_Socket_File The socket file.
+ * @return The listening socket,
+ * @return -1 if an error occurred (a message has been displayed).
+ */
+static int DaemonCreateSocket(char *String_Socket_File)
+{
+	struct sockaddr_un Address;
+	struct stat File_Status;
+	int Socket;
+	
+	if (strlen(String_Socket_File) >= sizeof(Address.sun_path))
+	{
+		printf("Error : the socket file path '%s' is too long.\n", String_Socket_File);
+		return -1;
+	}
+	memset(&Address, 0, sizeof(Address));
+	Address.sun_family = AF_UNIX;
+	strcpy(Address.sun_path, String_Socket_File);
+	
+	// A socket left by a daemon that did not exit properly can't be bound again, remove it unless a daemon is still listening on it (never remove anything that is not a socket)
+	if ((lstat(String_Socket_File, &File_Status) == 0) && S_ISSOCK(File_Status.st_mode))
+	{
+		Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if ((Socket >= 0) && (connect(Socket, (struct sockaddr *) &Address, sizeof(Address)) == 0))
+		{
+			printf("Error : another daemon is already listening on '%s'.\n", String_Socket_File);
+			close(Socket);
+			return -1;
+		}
+		if (Socket >= 0) close(Socket);
+		unlink(String_Socket_File);
+	}
+	
+	Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (Socket < 0)
+	{
+		printf("Error : failed to create the socket (%s).\n", strerror(errno));
+		return -1;
+	}
+	if ((bind(Socket, (struct sockaddr *) &Address, sizeof(Address)) != 0) || (listen(Socket, DAEMON_MAXIMUM_CLIENTS_COUNT) != 0))
+	{
+		printf("Error : failed to listen on '%s' (%s).\n", String_Socket_File, strerror(errno));
+		close(Socket);
+		return -1;
+	}
+	return Socket;
+}
+
+/** Accept a new client, it is disconnected right away if all client slots are used.
+ * @param Listening_Socket The daemon socket.
+ */
+static void DaemonAcceptClient(int Listening_Socket)
+{
+	int Socket, i;
+	
+	Socket = accept(Listening_Socket, NULL, NULL);
+	if (Socket < 0) return;
+	
+	for (i = 0; i < DAEMON_MAXIMUM_CLIENTS_COUNT; i++)
+	{
+		if (Daemon_Clients[i].Socket < 0) break;
+	}
+	if (i == DAEMON_MAXIMUM_CLIENTS_COUNT)
+	{
+		printf("Warning : too many clients, a new client was refused.\n");
+		close(Socket);
+		return;
+	}
+	
+	// A client that does not read its answers must not block the other ones
+	fcntl(Socket, F_SETFL, fcntl(Socket, F_GETFL) | O_NONBLOCK);
+	Daemon_Clients[i].Socket = Socket;
+	Daemon_Clients[i].Reception_Buffer_Bytes_Count = 0;
+	Daemon_Clients[i].Transmission_Buffer_Bytes_Count = 0;
+	Debug("[%s] Client %d connected.\n", __func__, i);
+}
+
+/** Disconnect a client, its pending requests are not answered.
+ * @param Pointer_Client The client.
+ */
+static void DaemonCloseClient(TDaemonClient *Pointer_Client)
+{
+	Debug("[%s] Client %d disconnected.\n", __func__, (int) (Pointer_Client - Daemon_Clients));
+	close(Pointer_Client->Socket);
+	Pointer_Client->Socket = -1;
+}
+
+/** Get all the bytes a client has sent.
+ * @param Pointer_Client The client.
+ */
+static void DaemonReceiveClientBytes(TDaemonClient *Pointer_Client)
+{
+	int Size;
+	
+	Size = read(Pointer_Client->Socket, &Pointer_Client->Reception_Buffer[Pointer_Client->Reception_Buffer_Bytes_Count], DAEMON_CLIENT_RECEPTION_BUFFER_SIZE - Pointer_Client->Reception_Buffer_Bytes_Count);
+	if (Size > 0) Pointer_Client->Reception_Buffer_Bytes_Count += Size;
+	else if ((Size == 0) || ((errno != EAGAIN) && (errno != EINTR))) DaemonCloseClient(Pointer_Client);
+}
+
+/** Extract the next valid frame from the bytes received from a client. The bytes that can't start a valid frame are discarded.
+ * @param Pointer_Client The client.
+ * @param Pointer_Frame On output, contain the frame. It must be PROTOCOL_FRAME_OVERHEAD_SIZE + PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE bytes large.
+ * @return 1 if a frame was extracted,
+ * @return 0 if no whole frame was received yet.
+ */
+static int DaemonExtractFrame(TDaemonClient *Pointer_Client, unsigned char *Pointer_Frame)
+{
+	unsigned char *Pointer_Buffer = Pointer_Client->Reception_Buffer;
+	unsigned short CRC;
+	int Frame_Size, Is_Frame_Extracted;
+	
+	while (Pointer_Client->Reception_Buffer_Bytes_Count > 0)
+	{
+		// A frame always starts with the synchronization byte, and a too big payload can only come from a corrupted frame
+		if ((Pointer_Buffer[0] != PROTOCOL_FRAME_SYNCHRONIZATION_BYTE) || ((Pointer_Client->Reception_Buffer_Bytes_Count >= 2) && (Pointer_Buffer[1] > PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE)))
+		{
+			Frame_Size = 1;
+			Is_Frame_Extracted = 0;
+		}
+		else
+		{
+			if (Pointer_Client->Reception_Buffer_Bytes_Count < 2) return 0;
+			Frame_Size = Pointer_Buffer[1] + PROTOCOL_FRAME_OVERHEAD_SIZE;
+			if (Pointer_Client->Reception_Buffer_Bytes_Count < Frame_Size) return 0;
+			
+			CRC = CRCComputeBuffer(&Pointer_Buffer[1], Frame_Size - 3);
+			if ((Pointer_Buffer[Frame_Size - 2] == (CRC >> 8)) && (Pointer_Buffer[Frame_Size - 1] == (unsigned char) CRC))
+			{
+				memcpy(Pointer_Frame, Pointer_Buffer, Frame_Size);
+				Is_Frame_Extracted = 1;
+			}
+			else
+			{
+				// Search the next frame from the following byte
+				Frame_Size = 1;
+				Is_Frame_Extracted = 0;
+			}
+		}
+		
+		Pointer_Client->Reception_Buffer_Bytes_Count -= Frame_Size;
+		memmove(Pointer_Buffer, &Pointer_Buffer[Frame_Size], Pointer_Client->Reception_Buffer_Bytes_Count);
+		if (Is_Frame_Extracted) return 1;
+	}
+	return 0;
+}
+
+/** Tell whether several identical requests can share the same robot exchange.
+ * @param Command The request command.
+ * @return 1 if the command only reads the robot state,
+ * @return 0 if the command must be executed for each request.
+ */
+static int DaemonIsCommandCoalescable(unsigned char Command)
+{
+	switch (Command)
+	{
+		case PROTOCOL_COMMAND_GET_BATTERY_VOLTAGE:
+		case PROTOCOL_COMMAND_GET_DISTANCE_SENSOR_VALUE:
+		case PROTOCOL_COMMAND_GET_BOOT_TIME:
+		case PROTOCOL_COMMAND_GET_CAPABILITIES:
+		case PROTOCOL_COMMAND_GET_LINK_STATISTICS:
+			return 1;
+		
+		default:
+			return 0;
+	}
+}
+
+/** Add a client request to the batch, sharing the robot request of an identical read-only request when possible.
+ * @param Pointer_Client The client.
+ * @param Pointer_Frame The client frame.
+ */
+static void DaemonAddQuery(TDaemonClient *Pointer_Client, unsigned char *Pointer_Frame)
+{
+	TDaemonQuery *Pointer_Query = &Daemon_Queries[Daemon_Queries_Count];
+	TProtocolRequest *Pointer_Request;
+	int i, Payload_Size;
+	
+	Pointer_Query->Pointer_Client = Pointer_Client;
+	Pointer_Query->Sequence_Number = Pointer_Frame[2];
+	Pointer_Query->Command = Pointer_Frame[3];
+	Payload_Size = Pointer_Frame[1];
+	Daemon_Queries_Count++;
+	Daemon_Received_Queries_Count++;
+	
+	if ((Pointer_Query->Command < 16) && (DAEMON_REFUSED_COMMANDS_MASK & (1 << Pointer_Query->Command)))
+	{
+		Debug("[%s] Refusing command %d.\n", __func__, Pointer_Query->Command);
+		Pointer_Query->Request_Index = -1;
+		return;
+	}
+	
+	if (DaemonIsCommandCoalescable(Pointer_Query->Command))
+	{
+		for (i = 0; i < Daemon_Requests_Count; i++)
+		{
+			Pointer_Request = &Daemon_Requests[i];
+			if ((Pointer_Request->Command == Pointer_Query->Command) && (Pointer_Request->Payload_Size == Payload_Size) && (memcmp(Pointer_Request->Payload, &Pointer_Frame[PROTOCOL_FRAME_HEADER_SIZE], Payload_Size) == 0))
+			{
+				Pointer_Query->Request_Index = i;
+				return;
+			}
+		}
+	}
+	
+	Pointer_Request = &Daemon_Requests[Daemon_Requests_Count];
+	Pointer_Request->Command = Pointer_Query->Command;
+	Pointer_Request->Payload_Size = Payload_Size;
+	memcpy(Pointer_Request->Payload, &Pointer_Frame[PROTOCOL_FRAME_HEADER_SIZE], Payload_Size);
+	Pointer_Query->Request_Index = Daemon_Requests_Count;
+	Daemon_Requests_Count++;
+}
+
+/** Gather the requests received from all clients into a new batch, taking one request from each client in turn so a busy client can't starve the other ones.
+ * @return 1 if the batch is full (some requests may be waiting for the next batch),
+ * @return 0 if all received requests are in the batch.
+ */
+static int DaemonBuildBatch(void)
+{
+	unsigned char Frame[PROTOCOL_FRAME_OVERHEAD_SIZE + PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE];
+	int i, Is_Frame_Extracted;
+	
+	Daemon_Queries_Count = 0;
+	Daemon_Requests_Count = 0;
+	
+	do
+	{
+		Is_Frame_Extracted = 0;
+		for (i = 0; i < DAEMON_MAXIMUM_CLIENTS_COUNT; i++)
+		{
+			if (Daemon_Clients[i].Socket < 0) continue;
+			if (Daemon_Queries_Count >= DAEMON_MAXIMUM_BATCH_QUERIES_COUNT) return 1;
+			
+			if (DaemonExtractFrame(&Daemon_Clients[i], Frame))
+			{
+				DaemonAddQuery(&Daemon_Clients[i], Frame);
+				Is_Frame_Extracted = 1;
+			}
+		}
+	} while (Is_Frame_Extracted);
+	return 0;
+}
+
+/** Send each client the answers to its requests. A client that does not read its answers is disconnected. */
+static void DaemonSendAnswers(void)
+{
+	unsigned char Payload[PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE];
+	int i, Payload_Size, Size;
+	TDaemonQuery *Pointer_Query;
+	TDaemonClient *Pointer_Client;
+	TProtocolRequest *Pointer_Request;
+	
+	// Gather the answers of each client, they are sent in one time
+	for (i = 0; i < Daemon_Queries_Count; i++)
+	{
+		Pointer_Query = &Daemon_Queries[i];
+		Pointer_Client = Pointer_Query->Pointer_Client;
+		if (Pointer_Client->Socket < 0) continue;
+		
+		if (Pointer_Query->Request_Index < 0)
+		{
+			Payload[0] = PROTOCOL_ANSWER_STATUS_UNKNOWN_COMMAND;
+			Payload_Size = 1;
+		}
+		else
+		{
+			// Let the client retry if the robot did not answer
+			Pointer_Request = &Daemon_Requests[Pointer_Query->Request_Index];
+			if (Pointer_Request->Status < 0) continue;
+			
+			// The first payload byte is the answer status
+			Payload[0] = Pointer_Request->Status;
+			memcpy(&Payload[1], Pointer_Request->Answer, Pointer_Request->Answer_Size);
+			Payload_Size = Pointer_Request->Answer_Size + 1;
+		}
+		
+		Pointer_Client->Transmission_Buffer_Bytes_Count += ProtocolBuildFrame(Pointer_Query->Sequence_Number, Pointer_Query->Command, Payload, Payload_Size, &Pointer_Client->Transmission_Buffer[Pointer_Client->Transmission_Buffer_Bytes_Count]);
+	}
+	
+	for (i = 0; i < DAEMON_MAXIMUM_CLIENTS_COUNT; i++)
+	{
+		Pointer_Client = &Daemon_Clients[i];
+		if ((Pointer_Client->Socket < 0) || (Pointer_Client->Transmission_Buffer_Bytes_Count == 0)) continue;
+		
+		// Do not get killed by SIGPIPE if the client has gone
+		Size = send(Pointer_Client->Socket, Pointer_Client->Transmission_Buffer, Pointer_Client->Transmission_Buffer_Bytes_Count, MSG_NOSIGNAL);
+		if (Size != Pointer_Client->Transmission_Buffer_Bytes_Count) DaemonCloseClient(Pointer_Client);
+		Pointer_Client->Transmission_Buffer_Bytes_Count = 0;
+	}
+}
+
+/** Hide the commands the daemon refuses from the capabilities answered to the clients, so they know they are not available. */
+static void DaemonFilterCapabilities(void)
+{
+	TProtocolRequest *Pointer_Request;
+	unsigned int Supported_Commands_Mask;
+	int i;
+	
+	for (i = 0; i < Daemon_Requests_Count; i++)
+	{
+		Pointer_Request = &Daemon_Requests[i];
+		if ((Pointer_Request->Command != PROTOCOL_COMMAND_GET_CAPABILITIES) || (Pointer_Request->Status != PROTOCOL_ANSWER_STATUS_SUCCESS) || (Pointer_Request->Answer_Size < 5)) continue;
+		
+		Supported_Commands_Mask = ((Pointer_Request->Answer[3] << 8) | Pointer_Request->Answer[4]) & ~DAEMON_REFUSED_COMMANDS_MASK;
+		Pointer_Request->Answer[3] = Supported_Commands_Mask >> 8;
+		Pointer_Request->Answer[4] = (unsigned char) Supported_Commands_Mask;
+	}
+}
+
+//-------------------------------------------------------------------------------------------------
+// Public functions
+//-------------------------------------------------------------------------------------------------
+int DaemonRun(char *String_Socket_File)
+{
+	struct pollfd Poll_File_Descriptors[DAEMON_MAXIMUM_CLIENTS_COUNT + 1];
+	TDaemonClient *Pointer_Polled_Clients[DAEMON_MAXIMUM_CLIENTS_COUNT];
+	struct sigaction Signal_Action;
+	int Listening_Socket, i, Polled_Clients_Count, Is_Batch_Full = 0;
+	
+	Listening_Socket = DaemonCreateSocket(String_Socket_File);
+	if (Listening_Socket < 0) return -1;
+	for (i = 0; i < DAEMON_MAXIMUM_CLIENTS_COUNT; i++) Daemon_Clients[i].Socket = -1;
+	
+	// Ctrl+C must remove the socket file before exiting (do not restart poll() so the loop sees the request)
+	memset(&Signal_Action, 0, sizeof(Signal_Action));
+	Signal_Action.sa_handler = DaemonSignalHandler;
+	sigaction(SIGINT, &Signal_Action, NULL);
+	sigaction(SIGTERM, &Signal_Action, NULL);
+	
+	printf("Sharing the robot on 'unix:%s', hit Ctrl+C to stop.\n", String_Socket_File);
+	fflush(stdout);
+	
+	while (!Daemon_Is_Exit_Requested)
+	{
+		// Wait for a new client or for requests, do not wait if the previous batch left requests behind
+		Poll_File_Descriptors[0].fd = Listening_Socket;
+		Poll_File_Descriptors[0].events = POLLIN;
+		Polled_Clients_Count = 0;
+		for (i = 0; i < DAEMON_MAXIMUM_CLIENTS_COUNT; i++)
+		{
+			if ((Daemon_Clients[i].Socket < 0) || (Daemon_Clients[i].Reception_Buffer_Bytes_Count >= DAEMON_CLIENT_RECEPTION_BUFFER_SIZE)) continue;
+			
+			Poll_File_Descriptors[Polled_Clients_Count + 1].fd = Daemon_Clients[i].Socket;
+			Poll_File_Descriptors[Polled_Clients_Count + 1].events = POLLIN;
+			Pointer_Polled_Clients[Polled_Clients_Count] = &Daemon_Clients[i];
+			Polled_Clients_Count++;
+		}
+		if (poll(Poll_File_Descriptors, Polled_Clients_Count + 1, Is_Batch_Full ? 0 : -1) < 0) continue; // Interrupted by a signal
+		
+		if (Poll_File_Descriptors[0].revents & POLLIN) DaemonAcceptClient(Listening_Socket);
+		for (i = 0; i < Polled_Clients_Count; i++)
+		{
+			if (Poll_File_Descriptors[i + 1].revents & (POLLIN | POLLERR | POLLHUP)) DaemonReceiveClientBytes(Pointer_Polled_Clients[i]);
+		}
+		
+		// Send all the requests received meanwhile to the robot at once, the clients are served when the whole batch is answered
+		Is_Batch_Full = DaemonBuildBatch();
+		if (Daemon_Queries_Count == 0) continue;
+		if (Daemon_Requests_Count > 0)
+		{
+			Debug("[%s] Executing %d requests for %d queries.\n", __func__, Daemon_Requests_Count, Daemon_Queries_Count);
+			ProtocolExecuteRequests(Daemon_Requests, Daemon_Requests_Count);
+			Daemon_Sent_Requests_Count += Daemon_Requests_Count;
+			DaemonFilterCapabilities();
+		}
+		DaemonSendAnswers();
+	}
+	
+	for (i = 0; i < DAEMON_MAXIMUM_CLIENTS_COUNT; i++)
+	{
+		if (Daemon_Clients[i].Socket >= 0) DaemonCloseClient(&Daemon_Clients[i]);
+	}
+	close(Listening_Socket);
+	unlink(String_Socket_File);
+	
+	printf("Daemon stopped : %lu client requests served with %lu robot requests.\n", Daemon_Received_Queries_Count, Daemon_Sent_Requests_Count);
+	return 0;
+}
@@ -0,0 +1,19 @@
+/** @file Daemon.h
+ * Keep the robot serial port opened and share the robot with several local programs through a UNIX socket. The clients exchange the same frames as with the firmware (they open "unix:Socket_File" instead of the serial port), and the requests received at the same time are sent to the robot as a single pipelined batch. Identical read-only requests of the same batch share a single robot exchange.
+ * The telemetry, baud rate and bootloader commands change the state of the link for every client, so the daemon refuses them.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_DAEMON_H
+#define H_DAEMON_H
+
+//-------------------------------------------------------------------------------------------------
+// Functions
+//-------------------------------------------------------------------------------------------------
+/** Serve the clients until the user hits Ctrl+C. The protocol must be initialized first.
+ * @param String_Socket_File The UNIX socket to create, a stale socket left by a previous daemon is replaced.
+ * @return 0 when the daemon was stopped by the user,
+ * @return -1 if the socket could not be created.
+ */
+int DaemonRun(char *String_Socket_File);
+
+#endif
@@ -3,6 +3,7 @@
  * @author Adrien RICCIARDI
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "Configuration.h"
 #include "Hex_Parser.h"
@@ -12,6 +13,10 @@
 //-------------------------------------------------------------------------------------------------
 /** The maximum amount of data a record can contain. */
 #define HEX_PARSER_RECORD_MAXIMUM_DATA_SIZE 255
+/** How many characters are located between the record mark and the data (data size, load offset and record type). */
+#define HEX_PARSER_RECORD_HEADER_CHARACTERS_COUNT 8
+/** How many characters the record checksum is made of. */
+#define HEX_PARSER_RECORD_CHECKSUM_CHARACTERS_COUNT 2
 
 //-------------------------------------------------------------------------------------------------
 // Private types
@@ -29,162 +34,210 @@ typedef enum
 } THexParserRecordType;
 
 //-------------------------------------------------------------------------------------------------
-// Private functions
+// Private variables
 //-------------------------------------------------------------------------------------------------
-/** Convert an hexadecimal character (a nibble) to its binary value.
- * @return The character binary value.
- */
-static inline unsigned char HexParserConvertHexadecimalCharacterToNibble(char Character)
+/** Convert an hexadecimal character to its binary value. Characters that are not hexadecimal digits are converted to 0xFF, so a single test on the high nibble of all converted characters tells whether a record is valid. */
+static const unsigned char Hex_Parser_Nibbles[256] =
 {
-	// Cast the character in upper case if needed
-	if ((Character >= 'a') && (Character <= 'f')) Character -= 32;
-	
-	// Convert the character
-	if (Character <= '9') Character -= '0'; // The character is a digit
-	else Character = Character - 'A' + 10; // The character is a letter
-
-	return Character;
-}
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
 
+//-------------------------------------------------------------------------------------------------
+// Private functions
+//-------------------------------------------------------------------------------------------------
 /** Convert an hexadecimal byte represented by two characters into the corresponding binary value.
- * @param First_Character The number's high nibble.
- * @param Second_Character The number's low nibble.
+ * @param Pointer_Characters The number high nibble followed by the low nibble.
+ * @param Pointer_Invalid_Characters On output, the high nibble of this value is set if a character is not an hexadecimal digit. This value is never cleared, so all the bytes of a record can be checked at once.
  * @return The corresponding binary value.
  */
-static unsigned char HexParserConvertHexadecimalNumberToByte(char First_Character, char Second_Character)
+static inline unsigned int HexParserConvertHexadecimalNumberToByte(const unsigned char *Pointer_Characters, unsigned int *Pointer_Invalid_Characters)
 {
-	unsigned char Value;
+	unsigned int High_Nibble, Low_Nibble;
 	
-	Value = (HexParserConvertHexadecimalCharacterToNibble(First_Character) << 4) & 0xF0;
-	Value |= HexParserConvertHexadecimalCharacterToNibble(Second_Character) & 0x0F;
-	return Value;
+	High_Nibble = Hex_Parser_Nibbles[Pointer_Characters[0]];
+	Low_Nibble = Hex_Parser_Nibbles[Pointer_Characters[1]];
+	*Pointer_Invalid_Characters |= High_Nibble | Low_Nibble;
+	
+	return ((High_Nibble << 4) | Low_Nibble) & 0xFF;
 }
 
-/** Parse a line from the Hex file.
- * @param String_Hexadecimal_Line A line read from the hex file.
- * @param Pointer_Data_Size On output, contain the data size.
- * @param Pointer_Load_Offset On output, contain the data load offset.
- * @param Pointer_Data On output, contain the record data converted to binary.
- * @return The record type.
+/** Fill the error report.
+ * @param Pointer_Error The error report.
+ * @param Error_Code What went wrong.
+ * @param Line_Number The faulty line.
+ * @return Always -1, so the result can be directly returned by the parsing functions.
  */
-static THexParserRecordType HexParserParseLine(char *String_Hexadecimal_Line, int *Pointer_Data_Size, int *Pointer_Load_Offset, unsigned char *Pointer_Data)
+static int HexParserReportError(THexParserError *Pointer_Error, THexParserErrorCode Error_Code, int Line_Number)
 {
-	THexParserRecordType Record_Type;
-	int i;
-	
-	Debug("[%s] Parsing line %s", __func__, String_Hexadecimal_Line); // No new line at the end of this string as the read line adds it
-	
-	// Bypass the record mark (':')
-	String_Hexadecimal_Line++;
-	
-	// Extract the record size
-	*Pointer_Data_Size = HexParserConvertHexadecimalNumberToByte(String_Hexadecimal_Line[0], String_Hexadecimal_Line[1]);
-	String_Hexadecimal_Line += 2;
-	Debug("[%s] Record data size = %d\n", __func__, *Pointer_Data_Size);
-	
-	// Extract the load offset
-	*Pointer_Load_Offset = HexParserConvertHexadecimalNumberToByte(String_Hexadecimal_Line[0], String_Hexadecimal_Line[1]) << 8;
-	*Pointer_Load_Offset |= HexParserConvertHexadecimalNumberToByte(String_Hexadecimal_Line[2], String_Hexadecimal_Line[3]);
-	String_Hexadecimal_Line += 4;
-	Debug("[%s] Record load offset = 0x%04X\n", __func__, *Pointer_Load_Offset);
-	
-	// Extract the record type
-	Record_Type = HexParserConvertHexadecimalNumberToByte(String_Hexadecimal_Line[0], String_Hexadecimal_Line[1]);
-	String_Hexadecimal_Line += 2;
-	Debug("[%s] Record type = %d\n", __func__, Record_Type);
-	
-	// Convert the data if there are provided
-	Debug("[%s] Data : ", __func__);
-	for (i = 0; i < *Pointer_Data_Size; i++)
-	{
-		*Pointer_Data = HexParserConvertHexadecimalNumberToByte(String_Hexadecimal_Line[0], String_Hexadecimal_Line[1]);
-		Debug("0x%02X ", *Pointer_Data);
-		Pointer_Data++;
-		String_Hexadecimal_Line += 2;
-	}
-	Debug("\n");
-	
-	return Record_Type;	
+	Pointer_Error->Code = Error_Code;
+	Pointer_Error->Line_Number = Line_Number;
+	return -1;
 }
 
 //-------------------------------------------------------------------------------------------------
 // Public functions
 //-------------------------------------------------------------------------------------------------
-int HexParserConvertHexToBinary(char *String_Hex_File, int Microcontroller_Memory_Size, int Firmware_Base_Address, unsigned char *Pointer_Microcontroller_Memory)
+int HexParserConvertBufferToImage(const unsigned char *Pointer_Buffer, size_t Buffer_Size, TMemoryImage *Pointer_Image, THexParserError *Pointer_Error)
 {
-	FILE *File_Hex;
-	THexParserRecordType Record_Type;
-	char String_Record_Line[HEX_PARSER_RECORD_MAXIMUM_DATA_SIZE * 2 + 10]; // Can contain a full record represented by hexadecimal characters
-	int Current_Line_Number = 0, Data_Size, Load_Offset, Current_Address, Highest_Address = 0, Return_Value = -1;
+	const unsigned char *Pointer_Character = Pointer_Buffer, *Pointer_Buffer_End = Pointer_Buffer + Buffer_Size;
 	unsigned char Data[HEX_PARSER_RECORD_MAXIMUM_DATA_SIZE];
-	unsigned short Current_Address_High_Word = 0; // Set by an Extended Linear Address Record
-	
-	// Try to open the Hex file
-	File_Hex = fopen(String_Hex_File, "rb");
-	if (File_Hex == NULL)
-	{
-		printf("Error : could not open the Hex file.\n");
-		return -1;
-	}
-	
-	// Initialize the memory representation with the erased flash value
-	memset(Pointer_Microcontroller_Memory, 0xFF, Microcontroller_Memory_Size);
+	unsigned int Data_Size, Load_Offset, Record_Type, Checksum, Invalid_Characters, Base_Address = 0, i;
+	int Line_Number = 1, Is_End_Of_File_Found = 0;
 	
 	// Process all records
-	while (fgets(String_Record_Line, sizeof(String_Record_Line), File_Hex) != NULL)
+	while ((Pointer_Character < Pointer_Buffer_End) && !Is_End_Of_File_Found)
 	{
-		Current_Line_Number++;
-		Debug("[%s] Processing line %d\n", __func__, Current_Line_Number);
+		// Skip the line terminators (blank lines are tolerated)
+		if (*Pointer_Character == '\n')
+		{
+			Line_Number++;
+			Pointer_Character++;
+			continue;
+		}
+		if (*Pointer_Character == '\r')
+		{
+			Pointer_Character++;
+			continue;
+		}
+		
+		// Bypass the record mark (':')
+		if (*Pointer_Character != ':') return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_BAD_RECORD_MARK, Line_Number);
+		Pointer_Character++;
+		
+		// Extract the record size, load offset and type
+		if (Pointer_Buffer_End - Pointer_Character < HEX_PARSER_RECORD_HEADER_CHARACTERS_COUNT + HEX_PARSER_RECORD_CHECKSUM_CHARACTERS_COUNT) return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_TRUNCATED_RECORD, Line_Number);
+		Invalid_Characters = 0;
+		Data_Size = HexParserConvertHexadecimalNumberToByte(Pointer_Character, &Invalid_Characters);
+		Load_Offset = HexParserConvertHexadecimalNumberToByte(&Pointer_Character[2], &Invalid_Characters) << 8;
+		Load_Offset |= HexParserConvertHexadecimalNumberToByte(&Pointer_Character[4], &Invalid_Characters);
+		Record_Type = HexParserConvertHexadecimalNumberToByte(&Pointer_Character[6], &Invalid_Characters);
+		Checksum = Data_Size + (Load_Offset >> 8) + Load_Offset + Record_Type;
+		Pointer_Character += HEX_PARSER_RECORD_HEADER_CHARACTERS_COUNT;
+		
+		// Convert the data and the checksum in the same pass
+		if ((size_t) (Pointer_Buffer_End - Pointer_Character) < Data_Size * 2 + HEX_PARSER_RECORD_CHECKSUM_CHARACTERS_COUNT) return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_TRUNCATED_RECORD, Line_Number);
+		for (i = 0; i < Data_Size; i++)
+		{
+			Data[i] = HexParserConvertHexadecimalNumberToByte(Pointer_Character, &Invalid_Characters);
+			Checksum += Data[i];
+			Pointer_Character += 2;
+		}
+		Checksum += HexParserConvertHexadecimalNumberToByte(Pointer_Character, &Invalid_Characters);
+		Pointer_Character += HEX_PARSER_RECORD_CHECKSUM_CHARACTERS_COUNT;
+		
+		// Check the whole record at once (the two's complement checksum makes the sum of all the record bytes null)
+		if (Invalid_Characters & 0xF0) return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_BAD_CHARACTER, Line_Number);
+		if ((Checksum & 0xFF) != 0) return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_BAD_CHECKSUM, Line_Number);
+		if ((Pointer_Character < Pointer_Buffer_End) && (*Pointer_Character != '\r') && (*Pointer_Character != '\n')) return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_BAD_RECORD_LENGTH, Line_Number);
+		Debug("[%s] Line %d : record type %u, %u data bytes, load offset 0x%04X.\n", __func__, Line_Number, Record_Type, Data_Size, Load_Offset);
 		
-		// Get the record type
-		Record_Type = HexParserParseLine(String_Record_Line, &Data_Size, &Load_Offset, Data);
 		switch (Record_Type)
 		{
 			case HEX_PARSER_RECORD_TYPE_DATA:
-				Debug("[%s] Record type : data\n", __func__);
-				
-				// Compute the instruction address
-				Current_Address = (Current_Address_High_Word << 16) | Load_Offset;
-				Debug("[%s] Instruction address : 0x%08X.\n", __func__, Current_Address);
-				
-				// Check address consistency (an address can't be lower than the base address)
-				if (Current_Address < Firmware_Base_Address)
-				{
-					printf("The instruction at line %d has an out of bounds address (0x%04X).\n", Current_Line_Number, Load_Offset);
-					goto Exit;
-				}
-				
-				// Put the instruction at the right memory place only if the instruction is in the firmware space (not the configuration registers location)
-				if (Current_Address < Microcontroller_Memory_Size) memcpy(&Pointer_Microcontroller_Memory[Current_Address], Data, Data_Size);
-				
-				// Find the highest address used in the program, so we can omit the remaining memory and shorten the output file (in order to shorten the flashing time)
-				Data_Size += Current_Address; // Compute the last address of this record into Data_Size (recycling the variable)
-				if ((Current_Address < Microcontroller_Memory_Size) && (Data_Size > Highest_Address)) Highest_Address = Data_Size;
+				// Sequential records are appended to the same segment
+				if (MemoryImageWrite(Pointer_Image, Base_Address + Load_Offset, Data, Data_Size) != 0) return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_NOT_ENOUGH_MEMORY, Line_Number);
 				break;
 				
 			case HEX_PARSER_RECORD_TYPE_END_OF_FILE:
-				Debug("[%s] Record type : end of file\n", __func__);
+				Is_End_Of_File_Found = 1;
 				break;
-
+				
+			// Allow to define bits 4 to 19 of the segment base address
+			case HEX_PARSER_RECORD_TYPE_EXTENDED_SEGMENT_ADDRESS:
+				if (Data_Size != 2) return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_BAD_RECORD_LENGTH, Line_Number);
+				Base_Address = ((Data[0] << 8) | Data[1]) << 4;
+				break;
+				
 			// Allow to define the upper bits of a 32-bit Linear Base Address
 			case HEX_PARSER_RECORD_TYPE_EXTENDED_LINEAR_ADDRESS:
-				Debug("[%s] Record type : extended linear address\n", __func__);
-
-				Current_Address_High_Word = (Data[0] << 8) | Data[1];
-				Debug("[%s] Current address changed to 0x%08X.\n", __func__, Current_Address_High_Word << 16);
+				if (Data_Size != 2) return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_BAD_RECORD_LENGTH, Line_Number);
+				Base_Address = ((Data[0] << 8) | Data[1]) << 16;
+				Debug("[%s] Current address changed to 0x%08X.\n", __func__, Base_Address);
 				break;
-
+				
+			// The program entry point is fixed by the microcontroller, so the start address is useless
+			case HEX_PARSER_RECORD_TYPE_START_SEGMENT_ADDRESS:
+			case HEX_PARSER_RECORD_TYPE_START_LINEAR_ADDRESS:
+				break;
+				
 			default:
-				printf("The line %d contains an unrecognized record (0x%02X). Aborting conversion.\n", Current_Line_Number, Record_Type);
-				goto Exit;
+				return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_UNSUPPORTED_RECORD_TYPE, Line_Number);
 		}
-		Debug("\n");
 	}
+	if (!Is_End_Of_File_Found) return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_MISSING_END_OF_FILE, 0);
 	
-	// Return the firmware size
-	Return_Value = Highest_Address - Firmware_Base_Address;
+	Pointer_Error->Code = HEX_PARSER_ERROR_NONE;
+	return 0;
+}
+
+int HexParserConvertHexToImage(char *String_Hex_File, TMemoryImage *Pointer_Image, THexParserError *Pointer_Error)
+{
+	FILE *File_Hex;
+	long File_Size;
+	unsigned char *Pointer_Buffer = NULL;
+	int Return_Value = -1;
+	
+	// Try to open the Hex file
+	File_Hex = fopen(String_Hex_File, "rb");
+	if (File_Hex == NULL) return HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_CANNOT_OPEN_FILE, 0);
+	
+	// Load the whole file in memory, so it can be parsed in a single pass without any per-line library call
+	HexParserReportError(Pointer_Error, HEX_PARSER_ERROR_CANNOT_OPEN_FILE, 0); // Until the parsing tells otherwise
+	if (fseek(File_Hex, 0, SEEK_END) != 0) goto Exit;
+	File_Size = ftell(File_Hex);
+	if ((File_Size < 0) || (fseek(File_Hex, 0, SEEK_SET) != 0)) goto Exit;
+	
+	Pointer_Buffer = malloc(File_Size + 1); // Make sure the allocation succeeds even with an empty file
+	if (Pointer_Buffer == NULL) goto Exit;
+	if (fread(Pointer_Buffer, 1, File_Size, File_Hex) != (size_t) File_Size) goto Exit;
+	
+	Return_Value = HexParserConvertBufferToImage(Pointer_Buffer, File_Size, Pointer_Image, Pointer_Error);
 	
 Exit:
+	free(Pointer_Buffer);
 	fclose(File_Hex);
 	return Return_Value;
 }
+
+const char *HexParserGetErrorMessage(THexParserErrorCode Error_Code)
+{
+	switch (Error_Code)
+	{
+		case HEX_PARSER_ERROR_NONE:
+			return "no error";
+		case HEX_PARSER_ERROR_CANNOT_OPEN_FILE:
+			return "could not read the hex file";
+		case HEX_PARSER_ERROR_BAD_RECORD_MARK:
+			return "the record does not start with ':'";
+		case HEX_PARSER_ERROR_BAD_CHARACTER:
+			return "the record contains a non-hexadecimal character";
+		case HEX_PARSER_ERROR_TRUNCATED_RECORD:
+			return "the record is truncated";
+		case HEX_PARSER_ERROR_BAD_RECORD_LENGTH:
+			return "the record length is wrong";
+		case HEX_PARSER_ERROR_BAD_CHECKSUM:
+			return "the record checksum is wrong";
+		case HEX_PARSER_ERROR_UNSUPPORTED_RECORD_TYPE:
+			return "the record type is not supported";
+		case HEX_PARSER_ERROR_NOT_ENOUGH_MEMORY:
+			return "not enough memory to store the data";
+		case HEX_PARSER_ERROR_MISSING_END_OF_FILE:
+			return "the end-of-file record is missing";
+	}
+	return "unknown error";
+}
@@ -1,22 +1,65 @@
 /** @file Hex_Parser.h
  * Extract useful values from an Intel Hex file record.
- * Only data and end-of-file records are supported.
+ * Data, end-of-file, extended segment address and extended linear address records are supported, start address records are ignored.
  * @author Adrien RICCIARDI
  */
 #ifndef H_HEX_PARSER_H
 #define H_HEX_PARSER_H
 
+#include <stddef.h>
+#include "Memory_Image.h"
+
+//-------------------------------------------------------------------------------------------------
+// Types
+//-------------------------------------------------------------------------------------------------
+/** All errors the parser can detect. */
+typedef enum
+{
+	HEX_PARSER_ERROR_NONE,
+	HEX_PARSER_ERROR_CANNOT_OPEN_FILE, //!< The hex file could not be opened or read.
+	HEX_PARSER_ERROR_BAD_RECORD_MARK, //!< A record does not start with ':'.
+	HEX_PARSER_ERROR_BAD_CHARACTER, //!< A record contains a character that is not an hexadecimal digit.
+	HEX_PARSER_ERROR_TRUNCATED_RECORD, //!< A record is shorter than its announced size.
+	HEX_PARSER_ERROR_BAD_RECORD_LENGTH, //!< A record is longer than its announced size, or an address record has not the right size.
+	HEX_PARSER_ERROR_BAD_CHECKSUM, //!< The record checksum does not match its content.
+	HEX_PARSER_ERROR_UNSUPPORTED_RECORD_TYPE, //!< The record type is unknown.
+	HEX_PARSER_ERROR_NOT_ENOUGH_MEMORY, //!< The memory image could not grow.
+	HEX_PARSER_ERROR_MISSING_END_OF_FILE //!< The end-of-file record was not found.
+} THexParserErrorCode;
+
+/** Tell where and why the parsing failed. */
+typedef struct
+{
+	THexParserErrorCode Code; //!< What went wrong.
+	int Line_Number; //!< The line the faulty record is located at (starting from 1), or 0 if the error is not related to a line.
+} THexParserError;
+
 //-------------------------------------------------------------------------------------------------
-// Function
+// Functions
 //-------------------------------------------------------------------------------------------------
-/** Parse the hex file to put all instructions in a microcontroller memory representation.
- * @param String_Hex_File The firmware hex file.
- * @param Microcontroller_Memory_Size The microcontroller program memory size in bytes. 
- * @param Pointer_Microcontroller_Memory On output, contain the firmware binary instructions as they would be in the microcontroller memory. Make sure that this buffer is at least Microcontroller_Memory_Size large.
- * @param Firmware_Base_Address The firmware base address.
- * @return The firmware size in bytes in case of success,
+/** Parse hex records stored in memory and store their data in a memory image. Every record checksum is verified. All addresses are kept, so the program memory, the configuration words and the data EEPROM records all end up in the image.
+ * @param Pointer_Buffer The hex file content. It does not need to be terminated by a null character.
+ * @param Buffer_Size The hex file content size in bytes.
+ * @param Pointer_Image An initialized image the records data are written to. Its previous content is kept, so several files can be merged.
+ * @param Pointer_Error On output, tell why the parsing failed. It is set to HEX_PARSER_ERROR_NONE on success.
+ * @return 0 in case of success,
+ * @return -1 if an error occurred (the image may contain the records parsed before the error).
+ */
+int HexParserConvertBufferToImage(const unsigned char *Pointer_Buffer, size_t Buffer_Size, TMemoryImage *Pointer_Image, THexParserError *Pointer_Error);
+
+/** Parse the hex file and store its data in a memory image. The whole file is loaded in memory and parsed with HexParserConvertBufferToImage().
+ * @param String_Hex_File The hex file.
+ * @param Pointer_Image An initialized image the records data are written to.
+ * @param Pointer_Error On output, tell why the parsing failed. It is set to HEX_PARSER_ERROR_NONE on success.
+ * @return 0 in case of success,
  * @return -1 if an error occurred.
  */
-int HexParserConvertHexToBinary(char *String_Hex_File, int Microcontroller_Memory_Size, int Firmware_Base_Address, unsigned char *Pointer_Microcontroller_Memory);
+int HexParserConvertHexToImage(char *String_Hex_File, TMemoryImage *Pointer_Image, THexParserError *Pointer_Error);
+
+/** Convert an error code to a human-readable message.
+ * @param Error_Code The error code.
+ * @return A static string describing the error.
+ */
+const char *HexParserGetErrorMessage(THexParserErrorCode Error_Code);
 
 #endif
@@ -0,0 +1,282 @@
+/** @file Hex_Parser_Benchmark.c
+ * Measure the hex parser throughput on multi-megabyte synthetic firmwares and check that the parsed content is right, as well as the memory image merging and coalescing. Real hex files can be given on the command line to be benchmarked too.
+ * @author Adrien RICCIARDI
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "Hex_Parser.h"
+
+//-------------------------------------------------------------------------------------------------
+// Private constants
+//-------------------------------------------------------------------------------------------------
+/** How many data bytes a synthetic record contains (like most compilers output). */
+#define BENCHMARK_RECORD_DATA_SIZE 16
+/** Where the synthetic firmwares start, like the robot firmware. */
+#define BENCHMARK_FIRMWARE_BASE_ADDRESS 0x800
+/** The biggest synthetic firmware size in bytes. */
+#define BENCHMARK_MAXIMUM_FIRMWARE_SIZE (16 * 1024 * 1024)
+/** How many times each file is parsed, the fastest run is kept. */
+#define BENCHMARK_RUNS_COUNT 5
+
+//-------------------------------------------------------------------------------------------------
+// Private variables
+//-------------------------------------------------------------------------------------------------
+/** The synthetic firmware sizes in bytes. */
+static int Benchmark_Firmware_Sizes[] = {1024 * 1024, 4 * 1024 * 1024, BENCHMARK_MAXIMUM_FIRMWARE_SIZE};
+
+//-------------------------------------------------------------------------------------------------
+// Private functions
+//-------------------------------------------------------------------------------------------------
+/** Append a record to the hex file being generated.
+ * @param Pointer_String Where to write the record.
+ * @param Record_Type The record type.
+ * @param Load_Offset The record load offset.
+ * @param Pointer_Data The record data.
+ * @param Data_Size How many data bytes to write.
+ * @return How many characters were written.
+ */
+static int BenchmarkWriteRecord(char *Pointer_String, int Record_Type, unsigned int Load_Offset, unsigned char *Pointer_Data, int Data_Size)
+{
+	int i, Length;
+	unsigned int Checksum;
+	
+	Length = sprintf(Pointer_String, ":%02X%04X%02X", Data_Size, Load_Offset & 0xFFFF, Record_Type);
+	Checksum = Data_Size + (Load_Offset >> 8) + Load_Offset + Record_Type;
+	for (i = 0; i < Data_Size; i++)
+	{
+		Length += sprintf(&Pointer_String[Length], "%02X", Pointer_Data[i]);
+		Checksum += Pointer_Data[i];
+	}
+	Length += sprintf(&Pointer_String[Length], "%02X\r\n", (-Checksum) & 0xFF);
+	
+	return Length;
+}
+
+/** Generate a hex file containing pseudo-random data.
+ * @param Pointer_Firmware On output, contain the generated firmware binary content.
+ * @param Firmware_Size How many data bytes to generate.
+ * @param Pointer_Hex_File_Size On output, contain the generated hex file size in bytes.
+ * @return The generated hex file content (it must be freed by the caller).
+ */
+static char *BenchmarkGenerateHexFile(unsigned char *Pointer_Firmware, int Firmware_Size, size_t *Pointer_Hex_File_Size)
+{
+	char *Pointer_Hex_File;
+	int i;
+	size_t Length = 0;
+	unsigned int Address, Random_Value = 12345;
+	unsigned char Address_High_Word[2];
+	
+	// A data record takes 2 characters per byte plus 13 characters of overhead
+	Pointer_Hex_File = malloc((Firmware_Size / BENCHMARK_RECORD_DATA_SIZE + 1) * (BENCHMARK_RECORD_DATA_SIZE * 2 + 13) + (Firmware_Size / 65536 + 2) * 32);
+	if (Pointer_Hex_File == NULL) return NULL;
+	
+	for (i = 0; i < Firmware_Size; i++)
+	{
+		Random_Value = Random_Value * 1103515245 + 12345;
+		Pointer_Firmware[i] = Random_Value >> 16;
+	}
+	
+	for (i = 0; i < Firmware_Size; i += BENCHMARK_RECORD_DATA_SIZE)
+	{
+		// Start a new 64KB segment when needed
+		Address = BENCHMARK_FIRMWARE_BASE_ADDRESS + i;
+		if ((i == 0) || ((Address & 0xFFFF) < BENCHMARK_RECORD_DATA_SIZE))
+		{
+			Address_High_Word[0] = Address >> 24;
+			Address_High_Word[1] = Address >> 16;
+			Length += BenchmarkWriteRecord(&Pointer_Hex_File[Length], 4, 0, Address_High_Word, 2);
+		}
+		Length += BenchmarkWriteRecord(&Pointer_Hex_File[Length], 0, Address, &Pointer_Firmware[i], BENCHMARK_RECORD_DATA_SIZE);
+	}
+	Length += BenchmarkWriteRecord(&Pointer_Hex_File[Length], 1, 0, NULL, 0);
+	
+	*Pointer_Hex_File_Size = Length;
+	return Pointer_Hex_File;
+}
+
+/** Parse a buffer several times and display the best throughput.
+ * @param String_Name The benchmark name.
+ * @param Pointer_Buffer The hex file content.
+ * @param Buffer_Size The hex file size.
+ * @param Pointer_Image On output, contain the parsed image. It must be initialized.
+ * @return 0 if the parsing succeeded, -1 if it failed.
+ */
+static int BenchmarkParseBuffer(char *String_Name, const unsigned char *Pointer_Buffer, size_t Buffer_Size, TMemoryImage *Pointer_Image)
+{
+	struct timeval Start_Time, End_Time;
+	double Elapsed_Time, Best_Time = 0;
+	int i, Return_Value;
+	unsigned int Populated_Bytes_Count = 0;
+	THexParserError Error;
+	
+	for (i = 0; i < BENCHMARK_RUNS_COUNT; i++)
+	{
+		MemoryImageFree(Pointer_Image);
+		gettimeofday(&Start_Time, NULL);
+		Return_Value = HexParserConvertBufferToImage(Pointer_Buffer, Buffer_Size, Pointer_Image, &Error);
+		gettimeofday(&End_Time, NULL);
+		
+		if (Return_Value != 0)
+		{
+			printf("%s : parsing failed (%s, line %d).\n", String_Name, HexParserGetErrorMessage(Error.Code), Error.Line_Number);
+			return -1;
+		}
+		
+		Elapsed_Time = (End_Time.tv_sec - Start_Time.tv_sec) + (End_Time.tv_usec - Start_Time.tv_usec) / 1000000.;
+		if ((i == 0) || (Elapsed_Time < Best_Time)) Best_Time = Elapsed_Time;
+	}
+	
+	for (i = 0; i < Pointer_Image->Segments_Count; i++) Populated_Bytes_Count += Pointer_Image->Pointer_Segments[i].Size;
+	printf("%s : %lu hex bytes, %u data bytes in %d segments, %0.2f ms, %0.1f MB/s.\n", String_Name, (unsigned long) Buffer_Size, Populated_Bytes_Count, Pointer_Image->Segments_Count, Best_Time * 1000., Best_Time > 0 ? Buffer_Size / Best_Time / 1000000. : 0.);
+	return 0;
+}
+
+/** Make sure that a corrupted record is detected.
+ * @param Pointer_Buffer A valid hex file, it is temporarily modified.
+ * @param Buffer_Size The hex file size.
+ * @return 0 if the checksum error was reported, 1 otherwise.
+ */
+static int BenchmarkCheckCorruptionDetection(unsigned char *Pointer_Buffer, size_t Buffer_Size)
+{
+	unsigned char Saved_Character;
+	size_t Offset;
+	THexParserError Error;
+	TMemoryImage Image;
+	
+	// Change a data character of the third record (the first one is an extended linear address record), keeping it an hexadecimal digit
+	Offset = strchr(strchr((char *) &Pointer_Buffer[1], ':') + 1, ':') - (char *) Pointer_Buffer + 10;
+	Saved_Character = Pointer_Buffer[Offset];
+	Pointer_Buffer[Offset] = Saved_Character == '0' ? '1' : '0';
+	MemoryImageInitialize(&Image);
+	HexParserConvertBufferToImage(Pointer_Buffer, Buffer_Size, &Image, &Error);
+	MemoryImageFree(&Image);
+	Pointer_Buffer[Offset] = Saved_Character;
+	
+	if ((Error.Code != HEX_PARSER_ERROR_BAD_CHECKSUM) || (Error.Line_Number != 3))
+	{
+		printf("Error : the corrupted record was not detected (error %d at line %d).\n", Error.Code, Error.Line_Number);
+		return 1;
+	}
+	return 0;
+}
+
+/** Make sure that merging two images gives precedence to the source content, and that coalescing fills only the small enough gaps.
+ * @return 0 if the resulting image is right, 1 otherwise.
+ */
+static int BenchmarkCheckImageMergingAndCoalescing(void)
+{
+	unsigned char Data[4], Expected_Content[0x24], Content[sizeof(Expected_Content)];
+	int Return_Value = 0;
+	TMemoryImage Destination_Image, Source_Image;
+	
+	MemoryImageInitialize(&Destination_Image);
+	MemoryImageInitialize(&Source_Image);
+	
+	// Build two overlapping images
+	memset(Data, 0x11, sizeof(Data));
+	MemoryImageWrite(&Destination_Image, 0x100, Data, 4);
+	memset(Data, 0x22, sizeof(Data));
+	MemoryImageWrite(&Destination_Image, 0x110, Data, 4);
+	memset(Data, 0x33, sizeof(Data));
+	MemoryImageWrite(&Source_Image, 0x102, Data, 4);
+	memset(Data, 0x44, sizeof(Data));
+	MemoryImageWrite(&Source_Image, 0x120, Data, 2);
+	
+	// The source overwrites the end of the first destination segment and extends it
+	if ((MemoryImageMerge(&Destination_Image, &Source_Image) != 0) || (Destination_Image.Segments_Count != 3))
+	{
+		printf("Error : the merged image contains %d segments instead of 3.\n", Destination_Image.Segments_Count);
+		Return_Value = 1;
+	}
+	
+	// Only the 10-byte gap is small enough to be filled
+	if ((MemoryImageCoalesce(&Destination_Image, 10, 0xFF) != 0) || (Destination_Image.Segments_Count != 2))
+	{
+		printf("Error : the coalesced image contains %d segments instead of 2.\n", Destination_Image.Segments_Count);
+		Return_Value = 1;
+	}
+	
+	memset(Expected_Content, 0, sizeof(Expected_Content));
+	memset(&Expected_Content[0x00], 0x11, 2);
+	memset(&Expected_Content[0x02], 0x33, 4);
+	memset(&Expected_Content[0x06], 0xFF, 10);
+	memset(&Expected_Content[0x10], 0x22, 4);
+	memset(&Expected_Content[0x20], 0x44, 2);
+	MemoryImageRead(&Destination_Image, 0x100, Content, sizeof(Content), 0);
+	if (memcmp(Content, Expected_Content, sizeof(Content)) != 0)
+	{
+		printf("Error : the merged and coalesced image content is wrong.\n");
+		Return_Value = 1;
+	}
+	
+	MemoryImageFree(&Destination_Image);
+	MemoryImageFree(&Source_Image);
+	return Return_Value;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Entry point
+//-------------------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+	static unsigned char Firmware[BENCHMARK_MAXIMUM_FIRMWARE_SIZE];
+	unsigned char *Pointer_Hex_File;
+	char String_Name[64];
+	size_t Hex_File_Size;
+	unsigned int i;
+	int Return_Value = EXIT_SUCCESS;
+	FILE *File_Hex;
+	TMemoryImage Image;
+	
+	MemoryImageInitialize(&Image);
+	
+	if (BenchmarkCheckImageMergingAndCoalescing() != 0) Return_Value = EXIT_FAILURE;
+	
+	// Parse the synthetic firmwares
+	for (i = 0; i < sizeof(Benchmark_Firmware_Sizes) / sizeof(Benchmark_Firmware_Sizes[0]); i++)
+	{
+		Pointer_Hex_File = (unsigned char *) BenchmarkGenerateHexFile(Firmware, Benchmark_Firmware_Sizes[i], &Hex_File_Size);
+		if (Pointer_Hex_File == NULL)
+		{
+			printf("Error : not enough memory to generate the synthetic firmware.\n");
+			return EXIT_FAILURE;
+		}
+		
+		sprintf(String_Name, "Synthetic %d MB firmware", Benchmark_Firmware_Sizes[i] / (1024 * 1024));
+		// The sequential records must have been gathered in a single segment
+		if ((BenchmarkParseBuffer(String_Name, Pointer_Hex_File, Hex_File_Size, &Image) != 0) || (Image.Segments_Count != 1) || (Image.Pointer_Segments[0].Address != BENCHMARK_FIRMWARE_BASE_ADDRESS) || (Image.Pointer_Segments[0].Size != (unsigned int) Benchmark_Firmware_Sizes[i]) || (memcmp(Image.Pointer_Segments[0].Pointer_Data, Firmware, Benchmark_Firmware_Sizes[i]) != 0))
+		{
+			printf("Error : the parsed firmware does not match the generated one.\n");
+			Return_Value = EXIT_FAILURE;
+		}
+		if (BenchmarkCheckCorruptionDetection(Pointer_Hex_File, Hex_File_Size) != 0) Return_Value = EXIT_FAILURE;
+		
+		free(Pointer_Hex_File);
+	}
+	
+	// Parse the provided files
+	for (i = 1; i < (unsigned int) argc; i++)
+	{
+		File_Hex = fopen(argv[i], "rb");
+		if (File_Hex == NULL)
+		{
+			printf("Error : could not open the file %s.\n", argv[i]);
+			Return_Value = EXIT_FAILURE;
+			continue;
+		}
+		fseek(File_Hex, 0, SEEK_END);
+		Hex_File_Size = ftell(File_Hex);
+		fseek(File_Hex, 0, SEEK_SET);
+		
+		Pointer_Hex_File = malloc(Hex_File_Size + 1);
+		if ((Pointer_Hex_File == NULL) || (fread(Pointer_Hex_File, 1, Hex_File_Size, File_Hex) != Hex_File_Size) || (BenchmarkParseBuffer(argv[i], Pointer_Hex_File, Hex_File_Size, &Image) != 0)) Return_Value = EXIT_FAILURE;
+		
+		free(Pointer_Hex_File);
+		fclose(File_Hex);
+	}
+	
+	MemoryImageFree(&Image);
+	return Return_Value;
+}
@@ -0,0 +1,132 @@
+/** @file Latency.c
+ * @see Latency.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h> // Needed by clock_gettime()
+#include "Latency.h"
+
+//-------------------------------------------------------------------------------------------------
+// Private constants
+//-------------------------------------------------------------------------------------------------
+/** The minimum amount of samples the samples array can hold. */
+#define LATENCY_MINIMUM_ALLOCATED_SAMPLES_COUNT 256
+/** How many histogram buckets exist, each bucket holds the durations from 2^n to 2^(n+1) - 1 microseconds. */
+#define LATENCY_HISTOGRAM_BUCKETS_COUNT 32
+/** How many characters the longest histogram bar is made of. */
+#define LATENCY_HISTOGRAM_MAXIMUM_BAR_LENGTH 50
+
+//-------------------------------------------------------------------------------------------------
+// Private functions
+//-------------------------------------------------------------------------------------------------
+/** A qsort() callback sorting the durations in increasing order.
+ * @param Pointer_First_Sample The first duration.
+ * @param Pointer_Second_Sample The second duration.
+ * @return A negative value if the first duration is the smallest, a positive value if it is the biggest, 0 if both are equal.
+ */
+static int LatencyCompareSamples(const void *Pointer_First_Sample, const void *Pointer_Second_Sample)
+{
+	unsigned int First_Sample = *(const unsigned int *) Pointer_First_Sample, Second_Sample = *(const unsigned int *) Pointer_Second_Sample;
+	
+	if (First_Sample < Second_Sample) return -1;
+	if (First_Sample > Second_Sample) return 1;
+	return 0;
+}
+
+/** Get a percentile of the sorted durations, using the nearest-rank method.
+ * @param Pointer_Recorder The recorder, its samples must be sorted.
+ * @param Percentile The percentile (from 1 to 100).
+ * @return The duration in microseconds.
+ */
+static unsigned int LatencyGetPercentile(TLatencyRecorder *Pointer_Recorder, int Percentile)
+{
+	int Index;
+	
+	Index = (Pointer_Recorder->Samples_Count * Percentile + 99) / 100 - 1;
+	if (Index < 0) Index = 0;
+	return Pointer_Recorder->Pointer_Samples[Index];
+}
+
+//-------------------------------------------------------------------------------------------------
+// Public functions
+//-------------------------------------------------------------------------------------------------
+long long LatencyGetCurrentTime(void)
+{
+	struct timespec Time;
+	
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return (long long) Time.tv_sec * 1000000 + Time.tv_nsec / 1000;
+}
+
+void LatencyInitialize(TLatencyRecorder *Pointer_Recorder)
+{
+	Pointer_Recorder->Pointer_Samples = NULL;
+	Pointer_Recorder->Samples_Count = 0;
+	Pointer_Recorder->Allocated_Samples_Count = 0;
+}
+
+void LatencyFree(TLatencyRecorder *Pointer_Recorder)
+{
+	free(Pointer_Recorder->Pointer_Samples);
+	LatencyInitialize(Pointer_Recorder);
+}
+
+int LatencyAddSample(TLatencyRecorder *Pointer_Recorder, unsigned int Duration)
+{
+	unsigned int *Pointer_Samples;
+	int Allocated_Samples_Count;
+	
+	// Grow exponentially to make recording cheap
+	if (Pointer_Recorder->Samples_Count >= Pointer_Recorder->Allocated_Samples_Count)
+	{
+		Allocated_Samples_Count = Pointer_Recorder->Allocated_Samples_Count * 2;
+		if (Allocated_Samples_Count < LATENCY_MINIMUM_ALLOCATED_SAMPLES_COUNT) Allocated_Samples_Count = LATENCY_MINIMUM_ALLOCATED_SAMPLES_COUNT;
+		
+		Pointer_Samples = realloc(Pointer_Recorder->Pointer_Samples, Allocated_Samples_Count * sizeof(unsigned int));
+		if (Pointer_Samples == NULL) return -1;
+		
+		Pointer_Recorder->Pointer_Samples = Pointer_Samples;
+		Pointer_Recorder->Allocated_Samples_Count = Allocated_Samples_Count;
+	}
+	
+	Pointer_Recorder->Pointer_Samples[Pointer_Recorder->Samples_Count] = Duration;
+	Pointer_Recorder->Samples_Count++;
+	return 0;
+}
+
+void LatencyDisplay(TLatencyRecorder *Pointer_Recorder, const char *String_Title)
+{
+	int Buckets[LATENCY_HISTOGRAM_BUCKETS_COUNT] = {0}, i, Bucket_Index, First_Bucket_Index, Last_Bucket_Index, Biggest_Bucket_Samples_Count = 0, Bar_Length;
+	unsigned int Duration;
+	
+	printf("%s (%d samples) :\n", String_Title, Pointer_Recorder->Samples_Count);
+	if (Pointer_Recorder->Samples_Count == 0) return;
+	
+	qsort(Pointer_Recorder->Pointer_Samples, Pointer_Recorder->Samples_Count, sizeof(unsigned int), LatencyCompareSamples);
+	printf("   min %u us, median %u us, p99 %u us, max %u us\n", Pointer_Recorder->Pointer_Samples[0], LatencyGetPercentile(Pointer_Recorder, 50), LatencyGetPercentile(Pointer_Recorder, 99), Pointer_Recorder->Pointer_Samples[Pointer_Recorder->Samples_Count - 1]);
+	
+	// Fill the logarithmic histogram, the durations shorter than 2 microseconds go to the first bucket
+	for (i = 0; i < Pointer_Recorder->Samples_Count; i++)
+	{
+		Bucket_Index = 0;
+		for (Duration = Pointer_Recorder->Pointer_Samples[i]; Duration > 1; Duration >>= 1) Bucket_Index++;
+		Buckets[Bucket_Index]++;
+		if (Buckets[Bucket_Index] > Biggest_Bucket_Samples_Count) Biggest_Bucket_Samples_Count = Buckets[Bucket_Index];
+	}
+	
+	// Display only the buckets between the shortest and the longest durations
+	for (First_Bucket_Index = 0; Buckets[First_Bucket_Index] == 0; First_Bucket_Index++);
+	for (Last_Bucket_Index = LATENCY_HISTOGRAM_BUCKETS_COUNT - 1; Buckets[Last_Bucket_Index] == 0; Last_Bucket_Index--);
+	for (i = First_Bucket_Index; i <= Last_Bucket_Index; i++)
+	{
+		printf("   %8u - %8u us : %6d ", i == 0 ? 0 : 1u << i, (2u << i) - 1, Buckets[i]);
+		Bar_Length = (Buckets[i] * LATENCY_HISTOGRAM_MAXIMUM_BAR_LENGTH + Biggest_Bucket_Samples_Count - 1) / Biggest_Bucket_Samples_Count;
+		while (Bar_Length > 0)
+		{
+			putchar('#');
+			Bar_Length--;
+		}
+		putchar('\n');
+	}
+}
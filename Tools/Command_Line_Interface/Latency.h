@@ -0,0 +1,51 @@
+/** @file Latency.h
+ * Record durations and display their distribution (minimum, median, 99th percentile, maximum and a logarithmic histogram), to qualify the serial adapters, cables and firmware builds.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_LATENCY_H
+#define H_LATENCY_H
+
+//-------------------------------------------------------------------------------------------------
+// Types
+//-------------------------------------------------------------------------------------------------
+/** A set of recorded durations. */
+typedef struct
+{
+	unsigned int *Pointer_Samples; //!< All recorded durations, in microseconds.
+	int Samples_Count; //!< How many durations were recorded.
+	int Allocated_Samples_Count; //!< How many durations can be stored without reallocating the samples array.
+} TLatencyRecorder;
+
+//-------------------------------------------------------------------------------------------------
+// Functions
+//-------------------------------------------------------------------------------------------------
+/** Get a monotonic time reference precise enough to measure a single request.
+ * @return The current time in microseconds.
+ */
+long long LatencyGetCurrentTime(void);
+
+/** Create an empty recorder.
+ * @param Pointer_Recorder The recorder to initialize.
+ */
+void LatencyInitialize(TLatencyRecorder *Pointer_Recorder);
+
+/** Release the memory used by a recorder. The recorder is empty and can be used again after this call.
+ * @param Pointer_Recorder The recorder to free.
+ */
+void LatencyFree(TLatencyRecorder *Pointer_Recorder);
+
+/** Record a duration.
+ * @param Pointer_Recorder The recorder.
+ * @param Duration The duration in microseconds.
+ * @return 0 on success,
+ * @return -1 if there is not enough memory (the duration is not recorded).
+ */
+int LatencyAddSample(TLatencyRecorder *Pointer_Recorder, unsigned int Duration);
+
+/** Display the distribution of the recorded durations. The samples are sorted by this function.
+ * @param Pointer_Recorder The recorder.
+ * @param String_Title What the durations are.
+ */
+void LatencyDisplay(TLatencyRecorder *Pointer_Recorder, const char *String_Title);
+
+#endif
@@ -2,34 +2,254 @@
  * Convert an Intel hex file into a binary representation of the MCU's memory and program it through a bootloader.
  * @author Adrien RICCIARDI
  */
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include "Configuration.h"
+#include "Daemon.h"
+#include "Latency.h"
 #include "Protocol.h"
 
+//-------------------------------------------------------------------------------------------------
+// Private constants
+//-------------------------------------------------------------------------------------------------
+/** The default telemetry period in milliseconds. */
+#define MAIN_TELEMETRY_DEFAULT_PERIOD 100
+/** How many milliseconds to wait for a telemetry frame byte before checking whether the user stopped the program. */
+#define MAIN_TELEMETRY_BYTE_TIMEOUT 200
+/** How many requests the benchmark sends by default. */
+#define MAIN_BENCHMARK_DEFAULT_REQUESTS_COUNT 1000
+/** How many microseconds separate the two interrupt profiles used to compute the interrupts CPU load. */
+#define MAIN_INTERRUPT_PROFILE_LOAD_MEASURE_DURATION 1000000
+
+//-------------------------------------------------------------------------------------------------
+// Private variables
+//-------------------------------------------------------------------------------------------------
+/** Set to 1 when the user hits Ctrl+C. */
+static volatile sig_atomic_t Main_Is_Exit_Requested = 0;
+
+//-------------------------------------------------------------------------------------------------
+// Private functions
+//-------------------------------------------------------------------------------------------------
+/** Tell the telemetry loop to stop.
+ * @param Signal_Number Not used.
+ */
+static void MainSignalHandler(int __attribute__((unused)) Signal_Number)
+{
+	Main_Is_Exit_Requested = 1;
+}
+
+/** Display the telemetry frames as CSV lines until the user hits Ctrl+C.
+ * @param Period How often the robot must send a frame, in milliseconds.
+ * @param File_Output Where to write the CSV lines.
+ * @return 0 on success,
+ * @return -1 if the robot did not answer.
+ */
+static int MainStreamTelemetry(int Period, FILE *File_Output)
+{
+	TProtocolTelemetryFrame Frame;
+	TProtocolTelemetryStatistics Statistics;
+	struct sigaction Signal_Action;
+	
+	// Ctrl+C must stop the telemetry before exiting, otherwise the robot would keep streaming
+	memset(&Signal_Action, 0, sizeof(Signal_Action));
+	Signal_Action.sa_handler = MainSignalHandler;
+	sigaction(SIGINT, &Signal_Action, NULL);
+	sigaction(SIGTERM, &Signal_Action, NULL);
+	
+	if (ProtocolStartTelemetry(Period / 100) != 0) return -1;
+	fprintf(File_Output, "Timestamp (ms),Sequence number,Distance (cm),Raw distance (cm),Distance timestamp (ms),Distance sequence number,Distance validity,Battery voltage (V),Left motor,Right motor,Artificial intelligence state\n");
+	
+	while (!Main_Is_Exit_Requested)
+	{
+		if (ProtocolReceiveTelemetryFrame(&Frame, MAIN_TELEMETRY_BYTE_TIMEOUT) != 0) continue;
+		
+		fprintf(File_Output, "%u,%d,%d,%d,%u,%d,%d,%0.3f,%s,%s,%s\n", Frame.Timestamp, Frame.Sequence_Number, Frame.Distance_Sensor_Sample.Filtered_Distance, Frame.Distance_Sensor_Sample.Raw_Distance, Frame.Distance_Sensor_Sample.Timestamp, Frame.Distance_Sensor_Sample.Sequence_Number, Frame.Distance_Sensor_Sample.Is_Valid, Frame.Battery_Voltage, ProtocolGetMotorStateName(Frame.Left_Motor_State), ProtocolGetMotorStateName(Frame.Right_Motor_State), ProtocolGetArtificialIntelligenceStateName(Frame.Artificial_Intelligence_State));
+		fflush(File_Output);
+	}
+	
+	if (ProtocolStopTelemetry() != 0) printf("Warning : the robot did not acknowledge the telemetry stop.\n");
+	
+	ProtocolGetTelemetryStatistics(&Statistics);
+	printf("Telemetry stopped : %d frames received, %d frames lost, %d corrupted frames.\n", Statistics.Received_Frames_Count, Statistics.Lost_Frames_Count, Statistics.Corrupted_Frames_Count);
+	return 0;
+}
+
+/** Measure the link round-trip latency with requests sent one by one, then the sustained throughput with pipelined requests. The distance and battery voltage requests are alternated.
+ * @param Requests_Count How many requests to send in each phase.
+ * @return 0 on success,
+ * @return -1 if there is not enough memory or if the robot did not answer at all.
+ */
+static int MainRunBenchmark(int Requests_Count)
+{
+	TLatencyRecorder Recorder;
+	TProtocolRequest *Pointer_Requests;
+	TProtocolCapabilities Capabilities;
+	int i, Lost_Requests_Count = 0;
+	long long Start_Time, Request_Start_Time, Sequential_Duration, Pipelined_Duration;
+	
+	Pointer_Requests = calloc(Requests_Count, sizeof(TProtocolRequest));
+	if (Pointer_Requests == NULL)
+	{
+		printf("Error : not enough memory.\n");
+		return -1;
+	}
+	for (i = 0; i < Requests_Count; i++)
+	{
+		if (i % 2 == 0) Pointer_Requests[i].Command = PROTOCOL_COMMAND_GET_DISTANCE_SENSOR_VALUE;
+		else Pointer_Requests[i].Command = PROTOCOL_COMMAND_GET_BATTERY_VOLTAGE;
+	}
+	
+	// Make sure the robot answers, and learn how many requests it can pipeline so the first measures do not include this exchange
+	if (ProtocolGetCapabilities(&Capabilities) != 0)
+	{
+		printf("Error : the robot did not answer.\n");
+		free(Pointer_Requests);
+		return -1;
+	}
+	
+	// Measure each request alone, the lost requests are counted apart so their timeout does not hide the link latency
+	printf("Sending %d requests one by one...\n", Requests_Count);
+	LatencyInitialize(&Recorder);
+	Start_Time = LatencyGetCurrentTime();
+	for (i = 0; i < Requests_Count; i++)
+	{
+		Request_Start_Time = LatencyGetCurrentTime();
+		if (ProtocolExecuteRequests(&Pointer_Requests[i], 1) != 0) Lost_Requests_Count++;
+		else LatencyAddSample(&Recorder, LatencyGetCurrentTime() - Request_Start_Time);
+	}
+	Sequential_Duration = LatencyGetCurrentTime() - Start_Time;
+	LatencyDisplay(&Recorder, "Round-trip latency");
+	LatencyFree(&Recorder);
+	if (Lost_Requests_Count > 0) printf("   %d requests were not answered.\n", Lost_Requests_Count);
+	
+	// Measure the sustained throughput
+	printf("Sending %d pipelined requests (%d in flight)...\n", Requests_Count, Capabilities.Maximum_Pending_Requests_Count);
+	Start_Time = LatencyGetCurrentTime();
+	ProtocolExecuteRequests(Pointer_Requests, Requests_Count);
+	Pipelined_Duration = LatencyGetCurrentTime() - Start_Time;
+	for (Lost_Requests_Count = 0, i = 0; i < Requests_Count; i++)
+	{
+		if (Pointer_Requests[i].Status < 0) Lost_Requests_Count++;
+	}
+	
+	printf("Sequential throughput : %0.0f requests/s\n", Requests_Count * 1000000. / Sequential_Duration);
+	printf("Pipelined throughput : %0.0f requests/s", Requests_Count * 1000000. / Pipelined_Duration);
+	if (Lost_Requests_Count > 0) printf(" (%d requests were not answered)", Lost_Requests_Count);
+	putchar('\n');
+	
+	free(Pointer_Requests);
+	return 0;
+}
+
+/** Display how long the firmware interrupt handlers last, and how much processing time they consumed during one second.
+ * @return 0 on success,
+ * @return -1 if the robot did not answer or does not support interrupt profiling.
+ */
+static int MainDisplayInterruptProfiles(void)
+{
+	TProtocolCapabilities Capabilities;
+	TProtocolInterruptProfile First_Profiles[PROTOCOL_INTERRUPT_SOURCES_COUNT], Second_Profiles[PROTOCOL_INTERRUPT_SOURCES_COUNT];
+	long long First_Time, Second_Time;
+	int i;
+	unsigned int Cycles;
+	
+	if (ProtocolGetCapabilities(&Capabilities) != 0)
+	{
+		printf("Error : the robot did not answer.\n");
+		return -1;
+	}
+	if (!(Capabilities.Supported_Commands_Mask & (1 << PROTOCOL_COMMAND_GET_INTERRUPT_PROFILE)))
+	{
+		printf("Error : the robot firmware was built without interrupt profiling.\n");
+		return -1;
+	}
+	
+	// The counters are cumulative, so the load is computed from two profiles
+	First_Time = LatencyGetCurrentTime();
+	if (ProtocolGetInterruptProfiles(First_Profiles) != 0)
+	{
+		printf("Error : the robot did not answer.\n");
+		return -1;
+	}
+	usleep(MAIN_INTERRUPT_PROFILE_LOAD_MEASURE_DURATION);
+	Second_Time = LatencyGetCurrentTime();
+	if (ProtocolGetInterruptProfiles(Second_Profiles) != 0)
+	{
+		printf("Error : the robot did not answer.\n");
+		return -1;
+	}
+	
+	printf("%-28s %10s %12s %12s %10s\n", "Interrupt handler", "Calls", "Average (us)", "Worst (us)", "Load (%)");
+	for (i = 0; i < PROTOCOL_INTERRUPT_SOURCES_COUNT; i++)
+	{
+		printf("%-28s %10u ", ProtocolGetInterruptSourceName(i), Second_Profiles[i].Calls_Count);
+		if (Second_Profiles[i].Calls_Count == 0) printf("%12s ", "-");
+		else printf("%12.2f ", (double) Second_Profiles[i].Total_Cycles / Second_Profiles[i].Calls_Count / PROTOCOL_INTERRUPT_CYCLES_PER_MICROSECOND);
+		printf("%12.2f ", (double) Second_Profiles[i].Worst_Cycles / PROTOCOL_INTERRUPT_CYCLES_PER_MICROSECOND);
+		
+		// The unsigned subtraction handles a counter wrap around
+		Cycles = Second_Profiles[i].Total_Cycles - First_Profiles[i].Total_Cycles;
+		printf("%10.2f\n", 100. * Cycles / PROTOCOL_INTERRUPT_CYCLES_PER_MICROSECOND / (Second_Time - First_Time));
+	}
+	printf("The cycles are counted since the robot became ready, the load is measured during the last %0.1f s.\n", (Second_Time - First_Time) / 1000000.);
+	return 0;
+}
+
 //-------------------------------------------------------------------------------------------------
 // Entry point
 //-------------------------------------------------------------------------------------------------
 int main(int argc, char *argv[])
 {
 	char *String_Serial_Port_File, *String_Command, *String_Hex_File;
+	int Telemetry_Period, Return_Value, Requests_Count;
+	float Value;
+	FILE *File_Telemetry;
+	TProtocolCapabilities Capabilities;
+	TProtocolLinkStatistics Link_Statistics;
+	TProtocolDistanceSensorSample Distance_Sensor_Sample;
+	TLatencyRecorder Recorder;
 		
 	// Check parameters
 	if (argc < 3)
 	{
 		printf("Usage : %s Serial_Port Command [Parameters]\n"
+			"   or  %s -f Hex_File Serial_Port_1 [Serial_Port_2 ...]\n"
 			"Available commands :\n"
 			"   -d : get the sonar distance from the nearest object\n"
 			"   -v : get the battery voltage\n"
+			"   -t : get the time the robot needed to become ready after its last reset\n"
+			"   -p : get the robot protocol version, capabilities and link errors\n"
+			"   -n : display how long the robot interrupt handlers last and their processor load\n"
 			"   -u Hex_File : update the robot firmware from an Intel Hex file\n"
+			"   -c Hex_File : same as -u, but transmit the firmware compressed\n"
+			"   -i Hex_File : same as -c, but transmit only the blocks that differ from the robot flash content\n"
+			"   -s [Period_Ms] [Output_File] : stream the robot state as CSV lines until Ctrl+C is hit (the period is a multiple of 100ms, 100ms by default ; the lines are displayed when no file is provided)\n"
+			"   -f : update the firmware of all robots connected to the provided serial ports at the same time\n"
+			"   -b [Requests_Count] : measure the round-trip latency and the throughput of the link with distance and battery voltage requests (1000 requests by default)\n"
+			"   -b -u|-c Hex_File : update the firmware like -u or -c and display the latency of each block acknowledge\n"
+			"   -l Socket_File : keep the serial port opened and share the robot with the local programs using \"unix:Socket_File\" as serial port, until Ctrl+C is hit (telemetry and firmware updates need the serial port itself)\n"
+			"Serial_Port can be a serial device or \"tcp:Host:Port\" to reach the robot through a serial-to-network bridge (the baud rate stays at 115200 bit/s).\n"
 			"How to update the robot firmware :\n"
-			"   1) Turn the robot off\n"
-			"   2) Start this program in update mode\n"
-			"   3) Turn the robot on\n", argv[0]);
+			"   - If the robot is running, start this program in update mode, the robot will automatically reboot in programming mode\n"
+			"   - If the robot firmware does not work, turn the robot off, start this program in update mode, then turn the robot on\n", argv[0], argv[0]);
 		return EXIT_FAILURE;
 	}
+	
+	// Update a whole fleet of robots, each one has its own serial port
+	if (strcmp(argv[1], "-f") == 0)
+	{
+		if (argc < 4)
+		{
+			printf("Error : you must provide an Hex file path and at least one serial port with the -f command.\n");
+			return EXIT_FAILURE;
+		}
+		if (ProtocolUpdateFleetFirmware(argv[2], &argv[3], argc - 3) != 0) return EXIT_FAILURE;
+		return EXIT_SUCCESS;
+	}
+	
 	String_Serial_Port_File = argv[1];
 	String_Command = argv[2];
 	
@@ -41,26 +261,151 @@ int main(int argc, char *argv[])
 	}
 	
 	// Select the right command
-	if (strcmp(String_Command, "-d") == 0) printf("Distance to the nearest object : %d cm\n", ProtocolGetSonarDistance());
-	else if (strcmp(String_Command, "-v") == 0) printf("Battery voltage : %0.3f V\n", ProtocolGetBatteryVoltage());
-	else if (strcmp(String_Command, "-u") == 0)
+	if (strcmp(String_Command, "-d") == 0)
+	{
+		if (ProtocolGetDistanceSensorSample(&Distance_Sensor_Sample) != 0)
+		{
+			printf("Error : the robot did not answer.\n");
+			return EXIT_FAILURE;
+		}
+		printf("Distance to the nearest object : %d cm (raw distance : %d cm, measure %d taken at %u ms%s)\n", Distance_Sensor_Sample.Filtered_Distance, Distance_Sensor_Sample.Raw_Distance, Distance_Sensor_Sample.Sequence_Number, Distance_Sensor_Sample.Timestamp, Distance_Sensor_Sample.Is_Valid ? "" : ", not trusted by the robot");
+	}
+	else if (strcmp(String_Command, "-v") == 0)
+	{
+		Value = ProtocolGetBatteryVoltage();
+		if (Value < 0)
+		{
+			printf("Error : the robot did not answer.\n");
+			return EXIT_FAILURE;
+		}
+		printf("Battery voltage : %0.3f V\n", Value);
+	}
+	else if (strcmp(String_Command, "-t") == 0)
+	{
+		Value = ProtocolGetBootTime();
+		if (Value < 0)
+		{
+			printf("Error : the robot did not answer.\n");
+			return EXIT_FAILURE;
+		}
+		printf("Boot time : %0.3f ms\n", Value);
+	}
+	else if (strcmp(String_Command, "-p") == 0)
+	{
+		if (ProtocolGetCapabilities(&Capabilities) != 0)
+		{
+			printf("Error : the robot did not answer.\n");
+			return EXIT_FAILURE;
+		}
+		printf("Protocol version : %d\n", Capabilities.Protocol_Version);
+		printf("Biggest request payload : %d bytes\n", Capabilities.Maximum_Request_Payload_Size);
+		printf("Pipelined requests : %d\n", Capabilities.Maximum_Pending_Requests_Count);
+		printf("Supported commands mask : 0x%04X\n", Capabilities.Supported_Commands_Mask);
+		
+		// Older firmwares do not count the UART errors
+		if ((Capabilities.Supported_Commands_Mask & (1 << PROTOCOL_COMMAND_GET_LINK_STATISTICS)) && (ProtocolGetLinkStatistics(&Link_Statistics) == 0)) printf("Link errors : %d reception overruns, %d received bytes dropped, %d transmitted bytes dropped\n", Link_Statistics.Reception_Overruns_Count, Link_Statistics.Reception_Dropped_Bytes_Count, Link_Statistics.Transmission_Dropped_Bytes_Count);
+	}
+	else if (strcmp(String_Command, "-n") == 0)
+	{
+		if (MainDisplayInterruptProfiles() != 0) return EXIT_FAILURE;
+	}
+	else if (strcmp(String_Command, "-s") == 0)
+	{
+		// Get the optional parameters
+		if (argc >= 4) Telemetry_Period = atoi(argv[3]);
+		else Telemetry_Period = MAIN_TELEMETRY_DEFAULT_PERIOD;
+		if ((Telemetry_Period < 100) || (Telemetry_Period > 25500) || (Telemetry_Period % 100 != 0))
+		{
+			printf("Error : the telemetry period must be a multiple of 100ms between 100ms and 25500ms.\n");
+			return EXIT_FAILURE;
+		}
+		
+		if (argc >= 5)
+		{
+			File_Telemetry = fopen(argv[4], "w");
+			if (File_Telemetry == NULL)
+			{
+				printf("Error : could not create the file '%s'.\n", argv[4]);
+				return EXIT_FAILURE;
+			}
+		}
+		else File_Telemetry = stdout;
+		
+		Return_Value = MainStreamTelemetry(Telemetry_Period, File_Telemetry);
+		if (File_Telemetry != stdout) fclose(File_Telemetry);
+		if (Return_Value != 0)
+		{
+			printf("Error : the robot did not answer.\n");
+			return EXIT_FAILURE;
+		}
+	}
+	else if ((strcmp(String_Command, "-u") == 0) || (strcmp(String_Command, "-c") == 0) || (strcmp(String_Command, "-i") == 0))
 	{
 		// Get the Hex file parameter
 		if (argc < 4)
 		{
-			printf("Error : you must provide an Hex file path with the -u command.\n");
+			printf("Error : you must provide an Hex file path with the %s command.\n", String_Command);
 			return EXIT_FAILURE;
 		}
 		String_Hex_File = argv[3];
 		
 		// Try to update the firmware
-		if (ProtocolUpdateFirmware(String_Hex_File) != 0) return EXIT_FAILURE;
+		if (strcmp(String_Command, "-u") == 0)
+		{
+			if (ProtocolUpdateFirmware(String_Hex_File, 0) != 0) return EXIT_FAILURE;
+		}
+		else if (strcmp(String_Command, "-c") == 0)
+		{
+			if (ProtocolUpdateFirmware(String_Hex_File, 1) != 0) return EXIT_FAILURE;
+		}
+		else if (ProtocolUpdateFirmwareChangedBlocks(String_Hex_File, 1) != 0) return EXIT_FAILURE;
+	}
+	else if (strcmp(String_Command, "-b") == 0)
+	{
+		// Time the firmware update acknowledges
+		if ((argc >= 4) && ((strcmp(argv[3], "-u") == 0) || (strcmp(argv[3], "-c") == 0)))
+		{
+			if (argc < 5)
+			{
+				printf("Error : you must provide an Hex file path with the %s command.\n", argv[3]);
+				return EXIT_FAILURE;
+			}
+			
+			LatencyInitialize(&Recorder);
+			ProtocolSetAcknowledgesLatencyRecorder(&Recorder);
+			Return_Value = ProtocolUpdateFirmware(argv[4], strcmp(argv[3], "-c") == 0);
+			ProtocolSetAcknowledgesLatencyRecorder(NULL);
+			LatencyDisplay(&Recorder, "Block acknowledge latency");
+			LatencyFree(&Recorder);
+			if (Return_Value != 0) return EXIT_FAILURE;
+		}
+		else
+		{
+			if (argc >= 4) Requests_Count = atoi(argv[3]);
+			else Requests_Count = MAIN_BENCHMARK_DEFAULT_REQUESTS_COUNT;
+			if (Requests_Count <= 0)
+			{
+				printf("Error : the requests count must be a positive number.\n");
+				return EXIT_FAILURE;
+			}
+			
+			if (MainRunBenchmark(Requests_Count) != 0) return EXIT_FAILURE;
+		}
+	}
+	else if (strcmp(String_Command, "-l") == 0)
+	{
+		if (argc < 4)
+		{
+			printf("Error : you must provide a socket file path with the -l command.\n");
+			return EXIT_FAILURE;
+		}
+		if (DaemonRun(argv[3]) != 0) return EXIT_FAILURE;
 	}
 	else
 	{
 		printf("Error : unknown command.\n");
 		return EXIT_FAILURE;
 	}
-
+	
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,266 @@
+/** @file Memory_Image.c
+ * @see Memory_Image.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "Memory_Image.h"
+
+//-------------------------------------------------------------------------------------------------
+// Private constants
+//-------------------------------------------------------------------------------------------------
+/** The minimum amount of bytes allocated for a segment, so appending small hex records does not reallocate the segment each time. */
+#define MEMORY_IMAGE_SEGMENT_MINIMUM_ALLOCATED_SIZE 256
+/** The minimum amount of segments the segments array can hold. */
+#define MEMORY_IMAGE_MINIMUM_ALLOCATED_SEGMENTS_COUNT 16
+
+//-------------------------------------------------------------------------------------------------
+// Private functions
+//-------------------------------------------------------------------------------------------------
+/** Find the first segment that ends at or after an address (a segment ending exactly at the address touches it).
+ * @param Pointer_Image The image.
+ * @param Address The address to look for.
+ * @return The segment index, or the segments count if all segments end before the address.
+ */
+static int MemoryImageFindSegment(const TMemoryImage *Pointer_Image, unsigned int Address)
+{
+	int Lowest_Index = 0, Highest_Index = Pointer_Image->Segments_Count, Middle_Index;
+	TMemoryImageSegment *Pointer_Segment;
+	
+	// The segments are sorted, so use a binary search
+	while (Lowest_Index < Highest_Index)
+	{
+		Middle_Index = (Lowest_Index + Highest_Index) / 2;
+		Pointer_Segment = &Pointer_Image->Pointer_Segments[Middle_Index];
+		if (Pointer_Segment->Address + Pointer_Segment->Size < Address) Lowest_Index = Middle_Index + 1;
+		else Highest_Index = Middle_Index;
+	}
+	return Lowest_Index;
+}
+
+/** Make sure a segment data buffer can hold a given amount of bytes.
+ * @param Pointer_Segment The segment.
+ * @param Size How many bytes the segment must be able to hold.
+ * @return 0 on success,
+ * @return -1 if there is not enough memory (the segment is left unchanged).
+ */
+static int MemoryImageReserveSegmentData(TMemoryImageSegment *Pointer_Segment, unsigned int Size)
+{
+	unsigned int Allocated_Size;
+	unsigned char *Pointer_Data;
+	
+	if (Size <= Pointer_Segment->Allocated_Size) return 0;
+	
+	// Grow exponentially to make appending data cheap
+	Allocated_Size = Pointer_Segment->Allocated_Size * 2;
+	if (Allocated_Size < Size) Allocated_Size = Size;
+	if (Allocated_Size < MEMORY_IMAGE_SEGMENT_MINIMUM_ALLOCATED_SIZE) Allocated_Size = MEMORY_IMAGE_SEGMENT_MINIMUM_ALLOCATED_SIZE;
+	
+	Pointer_Data = realloc(Pointer_Segment->Pointer_Data, Allocated_Size);
+	if (Pointer_Data == NULL) return -1;
+	
+	Pointer_Segment->Pointer_Data = Pointer_Data;
+	Pointer_Segment->Allocated_Size = Allocated_Size;
+	return 0;
+}
+
+/** Create a new segment.
+ * @param Pointer_Image The image.
+ * @param Index Where to insert the segment in the segments array.
+ * @param Address The segment address.
+ * @param Pointer_Data The segment content.
+ * @param Size The segment size in bytes.
+ * @return 0 on success,
+ * @return -1 if there is not enough memory (the image is left unchanged).
+ */
+static int MemoryImageInsertSegment(TMemoryImage *Pointer_Image, int Index, unsigned int Address, const void *Pointer_Data, unsigned int Size)
+{
+	TMemoryImageSegment Segment = {0}, *Pointer_Segments;
+	int Allocated_Segments_Count;
+	
+	// Make room for one more segment
+	if (Pointer_Image->Segments_Count == Pointer_Image->Allocated_Segments_Count)
+	{
+		Allocated_Segments_Count = Pointer_Image->Allocated_Segments_Count * 2;
+		if (Allocated_Segments_Count < MEMORY_IMAGE_MINIMUM_ALLOCATED_SEGMENTS_COUNT) Allocated_Segments_Count = MEMORY_IMAGE_MINIMUM_ALLOCATED_SEGMENTS_COUNT;
+		
+		Pointer_Segments = realloc(Pointer_Image->Pointer_Segments, Allocated_Segments_Count * sizeof(TMemoryImageSegment));
+		if (Pointer_Segments == NULL) return -1;
+		Pointer_Image->Pointer_Segments = Pointer_Segments;
+		Pointer_Image->Allocated_Segments_Count = Allocated_Segments_Count;
+	}
+	
+	// Fill the segment
+	if (MemoryImageReserveSegmentData(&Segment, Size) != 0) return -1;
+	Segment.Address = Address;
+	Segment.Size = Size;
+	memcpy(Segment.Pointer_Data, Pointer_Data, Size);
+	
+	// Insert it at the right place
+	memmove(&Pointer_Image->Pointer_Segments[Index + 1], &Pointer_Image->Pointer_Segments[Index], (Pointer_Image->Segments_Count - Index) * sizeof(TMemoryImageSegment));
+	Pointer_Image->Pointer_Segments[Index] = Segment;
+	Pointer_Image->Segments_Count++;
+	return 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Public functions
+//-------------------------------------------------------------------------------------------------
+void MemoryImageInitialize(TMemoryImage *Pointer_Image)
+{
+	memset(Pointer_Image, 0, sizeof(TMemoryImage));
+}
+
+void MemoryImageFree(TMemoryImage *Pointer_Image)
+{
+	int i;
+	
+	for (i = 0; i < Pointer_Image->Segments_Count; i++) free(Pointer_Image->Pointer_Segments[i].Pointer_Data);
+	free(Pointer_Image->Pointer_Segments);
+	MemoryImageInitialize(Pointer_Image);
+}
+
+int MemoryImageWrite(TMemoryImage *Pointer_Image, unsigned int Address, const void *Pointer_Data, unsigned int Size)
+{
+	int First_Segment_Index, Last_Segment_Index, i;
+	unsigned int End_Address, New_Address, New_End_Address;
+	TMemoryImageSegment *Pointer_Segment;
+	
+	if (Size == 0) return 0;
+	End_Address = Address + Size;
+	
+	// Find all the segments overlapping or touching the new data
+	First_Segment_Index = MemoryImageFindSegment(Pointer_Image, Address);
+	Last_Segment_Index = First_Segment_Index;
+	while ((Last_Segment_Index < Pointer_Image->Segments_Count) && (Pointer_Image->Pointer_Segments[Last_Segment_Index].Address <= End_Address)) Last_Segment_Index++;
+	
+	// The data are isolated, they are stored in their own segment
+	if (Last_Segment_Index == First_Segment_Index) return MemoryImageInsertSegment(Pointer_Image, First_Segment_Index, Address, Pointer_Data, Size);
+	
+	// Compute the merged segment bounds
+	Pointer_Segment = &Pointer_Image->Pointer_Segments[First_Segment_Index];
+	New_Address = Pointer_Segment->Address;
+	if (Address < New_Address) New_Address = Address;
+	New_End_Address = Pointer_Image->Pointer_Segments[Last_Segment_Index - 1].Address + Pointer_Image->Pointer_Segments[Last_Segment_Index - 1].Size;
+	if (End_Address > New_End_Address) New_End_Address = End_Address;
+	
+	// Grow the first segment to hold everything (the gaps between the merged segments are all covered by the new data)
+	if (MemoryImageReserveSegmentData(Pointer_Segment, New_End_Address - New_Address) != 0) return -1;
+	if (New_Address < Pointer_Segment->Address)
+	{
+		memmove(&Pointer_Segment->Pointer_Data[Pointer_Segment->Address - New_Address], Pointer_Segment->Pointer_Data, Pointer_Segment->Size);
+		Pointer_Segment->Address = New_Address;
+	}
+	for (i = First_Segment_Index + 1; i < Last_Segment_Index; i++)
+	{
+		memcpy(&Pointer_Segment->Pointer_Data[Pointer_Image->Pointer_Segments[i].Address - New_Address], Pointer_Image->Pointer_Segments[i].Pointer_Data, Pointer_Image->Pointer_Segments[i].Size);
+		free(Pointer_Image->Pointer_Segments[i].Pointer_Data);
+	}
+	memcpy(&Pointer_Segment->Pointer_Data[Address - New_Address], Pointer_Data, Size);
+	Pointer_Segment->Size = New_End_Address - New_Address;
+	
+	// Remove the segments that were merged
+	memmove(&Pointer_Image->Pointer_Segments[First_Segment_Index + 1], &Pointer_Image->Pointer_Segments[Last_Segment_Index], (Pointer_Image->Segments_Count - Last_Segment_Index) * sizeof(TMemoryImageSegment));
+	Pointer_Image->Segments_Count -= Last_Segment_Index - First_Segment_Index - 1;
+	return 0;
+}
+
+int MemoryImageMerge(TMemoryImage *Pointer_Destination_Image, const TMemoryImage *Pointer_Source_Image)
+{
+	int i;
+	TMemoryImageSegment *Pointer_Segment;
+	
+	for (i = 0; i < Pointer_Source_Image->Segments_Count; i++)
+	{
+		Pointer_Segment = &Pointer_Source_Image->Pointer_Segments[i];
+		if (MemoryImageWrite(Pointer_Destination_Image, Pointer_Segment->Address, Pointer_Segment->Pointer_Data, Pointer_Segment->Size) != 0) return -1;
+	}
+	return 0;
+}
+
+int MemoryImageCoalesce(TMemoryImage *Pointer_Image, unsigned int Maximum_Gap_Size, unsigned char Fill_Value)
+{
+	int i, Current_Segment_Index = 0, Return_Value = 0;
+	unsigned int Gap_Size;
+	TMemoryImageSegment *Pointer_Current_Segment, *Pointer_Next_Segment;
+	
+	if (Pointer_Image->Segments_Count == 0) return 0;
+	
+	for (i = 1; i < Pointer_Image->Segments_Count; i++)
+	{
+		Pointer_Current_Segment = &Pointer_Image->Pointer_Segments[Current_Segment_Index];
+		Pointer_Next_Segment = &Pointer_Image->Pointer_Segments[i];
+		Gap_Size = Pointer_Next_Segment->Address - (Pointer_Current_Segment->Address + Pointer_Current_Segment->Size);
+		
+		// Append the next segment and the gap to the current segment
+		if (Gap_Size <= Maximum_Gap_Size)
+		{
+			if (MemoryImageReserveSegmentData(Pointer_Current_Segment, Pointer_Current_Segment->Size + Gap_Size + Pointer_Next_Segment->Size) == 0)
+			{
+				memset(&Pointer_Current_Segment->Pointer_Data[Pointer_Current_Segment->Size], Fill_Value, Gap_Size);
+				memcpy(&Pointer_Current_Segment->Pointer_Data[Pointer_Current_Segment->Size + Gap_Size], Pointer_Next_Segment->Pointer_Data, Pointer_Next_Segment->Size);
+				Pointer_Current_Segment->Size += Gap_Size + Pointer_Next_Segment->Size;
+				free(Pointer_Next_Segment->Pointer_Data);
+				continue;
+			}
+			Return_Value = -1;
+		}
+		
+		// The next segment can't be appended, it becomes the current one
+		Current_Segment_Index++;
+		Pointer_Image->Pointer_Segments[Current_Segment_Index] = *Pointer_Next_Segment;
+	}
+	Pointer_Image->Segments_Count = Current_Segment_Index + 1;
+	
+	return Return_Value;
+}
+
+int MemoryImageIterate(const TMemoryImage *Pointer_Image, unsigned int Start_Address, unsigned int End_Address, TMemoryImageIterateCallback Callback, void *Pointer_Parameter)
+{
+	int i, Return_Value;
+	unsigned int Area_Start_Address, Area_End_Address;
+	TMemoryImageSegment *Pointer_Segment;
+	
+	for (i = MemoryImageFindSegment(Pointer_Image, Start_Address); i < Pointer_Image->Segments_Count; i++)
+	{
+		Pointer_Segment = &Pointer_Image->Pointer_Segments[i];
+		if (Pointer_Segment->Address >= End_Address) break;
+		
+		// Keep only the part of the segment located in the range
+		Area_Start_Address = Pointer_Segment->Address;
+		if (Area_Start_Address < Start_Address) Area_Start_Address = Start_Address;
+		Area_End_Address = Pointer_Segment->Address + Pointer_Segment->Size;
+		if (Area_End_Address > End_Address) Area_End_Address = End_Address;
+		if (Area_End_Address <= Area_Start_Address) continue; // The segment only touches the range start
+		
+		Return_Value = Callback(Area_Start_Address, &Pointer_Segment->Pointer_Data[Area_Start_Address - Pointer_Segment->Address], Area_End_Address - Area_Start_Address, Pointer_Parameter);
+		if (Return_Value != 0) return Return_Value;
+	}
+	return 0;
+}
+
+void MemoryImageRead(const TMemoryImage *Pointer_Image, unsigned int Address, void *Pointer_Buffer, unsigned int Size, unsigned char Fill_Value)
+{
+	int i;
+	unsigned int End_Address, Area_Start_Address, Area_End_Address;
+	TMemoryImageSegment *Pointer_Segment;
+	unsigned char *Pointer_Buffer_Bytes = Pointer_Buffer;
+	
+	memset(Pointer_Buffer, Fill_Value, Size);
+	End_Address = Address + Size;
+	
+	// Copy the populated areas
+	for (i = MemoryImageFindSegment(Pointer_Image, Address); i < Pointer_Image->Segments_Count; i++)
+	{
+		Pointer_Segment = &Pointer_Image->Pointer_Segments[i];
+		if (Pointer_Segment->Address >= End_Address) break;
+		
+		Area_Start_Address = Pointer_Segment->Address;
+		if (Area_Start_Address < Address) Area_Start_Address = Address;
+		Area_End_Address = Pointer_Segment->Address + Pointer_Segment->Size;
+		if (Area_End_Address > End_Address) Area_End_Address = End_Address;
+		if (Area_End_Address <= Area_Start_Address) continue;
+		
+		memcpy(&Pointer_Buffer_Bytes[Area_Start_Address - Address], &Pointer_Segment->Pointer_Data[Area_Start_Address - Pointer_Segment->Address], Area_End_Address - Area_Start_Address);
+	}
+}
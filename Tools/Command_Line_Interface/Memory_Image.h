@@ -0,0 +1,97 @@
+/** @file Memory_Image.h
+ * A sparse representation of the microcontroller memories (program flash, configuration words, data EEPROM...) as a sorted list of populated segments. Only the memory areas that contain data cost memory.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_MEMORY_IMAGE_H
+#define H_MEMORY_IMAGE_H
+
+//-------------------------------------------------------------------------------------------------
+// Types
+//-------------------------------------------------------------------------------------------------
+/** A contiguous area of populated memory. */
+typedef struct
+{
+	unsigned int Address; //!< The first byte address.
+	unsigned int Size; //!< How many bytes the segment contains.
+	unsigned int Allocated_Size; //!< How many bytes can be stored in the data buffer without reallocating it.
+	unsigned char *Pointer_Data; //!< The segment content.
+} TMemoryImageSegment;
+
+/** A whole memory image. The segments are sorted by address, they never overlap nor touch each other. */
+typedef struct
+{
+	TMemoryImageSegment *Pointer_Segments; //!< All populated segments.
+	int Segments_Count; //!< How many segments are populated.
+	int Allocated_Segments_Count; //!< How many segments can be stored without reallocating the segments array.
+} TMemoryImage;
+
+/** Called for each populated memory area by MemoryImageIterate().
+ * @param Address The area first byte address.
+ * @param Pointer_Data The area content.
+ * @param Size The area size in bytes.
+ * @param Pointer_Parameter The parameter given to MemoryImageIterate().
+ * @return 0 to continue iterating, any other value to stop.
+ */
+typedef int (*TMemoryImageIterateCallback)(unsigned int Address, const unsigned char *Pointer_Data, unsigned int Size, void *Pointer_Parameter);
+
+//-------------------------------------------------------------------------------------------------
+// Functions
+//-------------------------------------------------------------------------------------------------
+/** Create an empty image.
+ * @param Pointer_Image The image to initialize.
+ */
+void MemoryImageInitialize(TMemoryImage *Pointer_Image);
+
+/** Release all the memory used by an image. The image is empty and can be used again after this call.
+ * @param Pointer_Image The image to free.
+ */
+void MemoryImageFree(TMemoryImage *Pointer_Image);
+
+/** Store data in the image, overwriting the previous content of the same addresses. Touching or overlapping segments are merged, so appending sequential data is cheap.
+ * @param Pointer_Image The image.
+ * @param Address Where to store the data.
+ * @param Pointer_Data The data to store.
+ * @param Size How many bytes to store.
+ * @return 0 on success,
+ * @return -1 if there is not enough memory (the image is left unchanged).
+ */
+int MemoryImageWrite(TMemoryImage *Pointer_Image, unsigned int Address, const void *Pointer_Data, unsigned int Size);
+
+/** Store all the content of an image into another one. The source image content takes precedence.
+ * @param Pointer_Destination_Image The image to modify.
+ * @param Pointer_Source_Image The image to copy.
+ * @return 0 on success,
+ * @return -1 if there is not enough memory.
+ */
+int MemoryImageMerge(TMemoryImage *Pointer_Destination_Image, const TMemoryImage *Pointer_Source_Image);
+
+/** Join the segments separated by small gaps, filling the gaps with a default value. This allows to transfer fewer and bigger areas.
+ * @param Pointer_Image The image.
+ * @param Maximum_Gap_Size Segments separated by this amount of bytes or less are joined.
+ * @param Fill_Value The value the gaps are filled with (0xFF for an erased flash).
+ * @return 0 on success,
+ * @return -1 if there is not enough memory (the image stays valid but is partially coalesced).
+ */
+int MemoryImageCoalesce(TMemoryImage *Pointer_Image, unsigned int Maximum_Gap_Size, unsigned char Fill_Value);
+
+/** Call a function for each populated area of an address range, in increasing address order. The areas are clipped to the range.
+ * @param Pointer_Image The image.
+ * @param Start_Address The range first address.
+ * @param End_Address The address following the range last byte.
+ * @param Callback The function to call.
+ * @param Pointer_Parameter A parameter forwarded to the callback.
+ * @return 0 if all areas were visited,
+ * @return the callback return value if it stopped the iteration.
+ */
+int MemoryImageIterate(const TMemoryImage *Pointer_Image, unsigned int Start_Address, unsigned int End_Address, TMemoryImageIterateCallback Callback, void *Pointer_Parameter);
+
+/** Copy an image area to a flat buffer.
+ * @param Pointer_Image The image.
+ * @param Address The area first address.
+ * @param Pointer_Buffer On output, contain the area content.
+ * @param Size The area size in bytes.
+ * @param Fill_Value The value of the bytes that are not populated in the image.
+ */
+void MemoryImageRead(const TMemoryImage *Pointer_Image, unsigned int Address, void *Pointer_Buffer, unsigned int Size, unsigned char Fill_Value);
+
+#endif
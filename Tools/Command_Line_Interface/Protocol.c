@@ -1,160 +1,1904 @@
-/** @file Protocol.c
- * @see Protocol.h for description.
- * @author Adrien RICCIARDI
- */
-#include <Serial_Port.h>
-#include <stdlib.h> // Needed by atexit()
-#include <unistd.h> // Needed by usleep()
-#include "Configuration.h"
-#include "Hex_Parser.h"
-#include "Protocol.h"
-
-//-------------------------------------------------------------------------------------------------
-// Private constants
-//-------------------------------------------------------------------------------------------------
-/** The protocol magic number. */
-#define PROTOCOL_MAGIC_NUMBER 0xA5
-/** The bootloader acknowledges that it has received and flashed a block. */
-#define PROTOCOL_ACKNOWLEDGE 0x42
-
-/** How many bytes can be sent in one time. */
-#define PROTOCOL_SEND_BUFFER_SIZE 64
-
-//-------------------------------------------------------------------------------------------------
-// Private types
-//-------------------------------------------------------------------------------------------------
-/** All existing commands. */
-typedef enum
-{
-	PROTOCOL_COMMAND_GET_BATTERY_VOLTAGE,
-	PROTOCOL_COMMAND_GET_DISTANCE_SENSOR_VALUE
-} TProtocolCommand;
-
-//-------------------------------------------------------------------------------------------------
-// Private variables
-//-------------------------------------------------------------------------------------------------
-/** The opened serial port identifier. */
-static TSerialPortID Protocol_Serial_Port_ID;
-
-//-------------------------------------------------------------------------------------------------
-// Private functions
-//-------------------------------------------------------------------------------------------------
-/** Close the UART on program exit. */
-static void ProtocolExitCloseSerialPort(void)
-{
-	SerialPortClose(Protocol_Serial_Port_ID);
-}
-
-//-------------------------------------------------------------------------------------------------
-// Public functions
-//-------------------------------------------------------------------------------------------------
-int ProtocolInitialize(char *String_Serial_Port_File)
-{
-	// Try to open the serial port
-	if (SerialPortOpen(String_Serial_Port_File, 115200, &Protocol_Serial_Port_ID) == 0)
-	{
-		atexit(ProtocolExitCloseSerialPort);
-		return 0;
-	}
-
-	return 1;
-}
-
-float ProtocolGetBatteryVoltage(void)
-{
-	int Raw_Voltage;
-	
-	// Send the command
-	Debug("[%s] Sending magic number...\n", __func__);
-	SerialPortWriteByte(Protocol_Serial_Port_ID, PROTOCOL_MAGIC_NUMBER);
-	Debug("[%s] Sending command...\n", __func__);
-	SerialPortWriteByte(Protocol_Serial_Port_ID, PROTOCOL_COMMAND_GET_BATTERY_VOLTAGE);
-	
-	// Receive the raw voltage
-	Debug("[%s] Waiting for answer...\n", __func__);
-	Raw_Voltage = (SerialPortReadByte(Protocol_Serial_Port_ID) << 8) | SerialPortReadByte(Protocol_Serial_Port_ID);
-	Debug("[%s] Raw voltage : %d.\n", __func__, Raw_Voltage);
-	
-	// Convert the voltage to volts
-	return (15.f * Raw_Voltage) / 1023.f;
-}
-
-int ProtocolGetSonarDistance(void)
-{
-	int Raw_Distance;
-	
-	// Send the command
-	Debug("[%s] Sending magic number...\n", __func__);
-	SerialPortWriteByte(Protocol_Serial_Port_ID, PROTOCOL_MAGIC_NUMBER);
-	Debug("[%s] Sending command...\n", __func__);
-	SerialPortWriteByte(Protocol_Serial_Port_ID, PROTOCOL_COMMAND_GET_DISTANCE_SENSOR_VALUE);
-	
-	// Receive the raw distance
-	Debug("[%s] Waiting for answer...\n", __func__);
-	Raw_Distance = (SerialPortReadByte(Protocol_Serial_Port_ID) << 8) | SerialPortReadByte(Protocol_Serial_Port_ID);
-	Debug("[%s] Measured time : %d ms.\n", __func__, Raw_Distance);
-	
-	// Convert it to centimeters
-	return Raw_Distance / 58;
-}
-
-int ProtocolUpdateFirmware(char *String_Firmware_Hex_File)
-{
-	static unsigned char Microcontroller_Memory[CONFIGURATION_TARGET_PROCESSOR_MEMORY_SIZE];
-	unsigned char Byte, *Pointer_Memory;
-	int Firmware_Size, Bytes_To_Send_Count;
-	
-	// Convert the Hex file into something usable
-	Debug("[%s] Converting the Hex file to binary...\n", __func__);
-	Firmware_Size = HexParserConvertHexToBinary(String_Firmware_Hex_File, CONFIGURATION_TARGET_PROCESSOR_MEMORY_SIZE, CONFIGURATION_FIRMWARE_BASE_ADDRESS, Microcontroller_Memory);
-	if (Firmware_Size < 0)
-	{
-		printf("Error : failed to convert the hex file to binary.\n");
-		return 1;
-	}
-	Debug("[%s] Conversion succeeded.\n", __func__);
-	
-	// Start sending instructions from the firmware beginning
-	Pointer_Memory = &Microcontroller_Memory[CONFIGURATION_FIRMWARE_BASE_ADDRESS];
-	
-	// Wait for the microcontroller's bootloader "ready" code
-	printf("Waiting for the bootloader code...\n");
-	do
-	{
-		Byte = SerialPortReadByte(Protocol_Serial_Port_ID);
-		Debug("[%s] Received byte : 0x%02X.\n", __func__, Byte);
-	} while (Byte != PROTOCOL_MAGIC_NUMBER);
-	
-	// Send the same code to the bootloader to enter programming mode
-	SerialPortWriteByte(Protocol_Serial_Port_ID, PROTOCOL_MAGIC_NUMBER);
-	
-	// Send the firmware size
-	Debug("[%s] Sending the firmware size...\n", __func__);
-	SerialPortWriteByte(Protocol_Serial_Port_ID, Firmware_Size >> 8);
-	SerialPortWriteByte(Protocol_Serial_Port_ID, (unsigned char) Firmware_Size);
-	
-	// Send the instructions
-	while (Firmware_Size > 0)
-	{
-		Debug("[%s] Total remaining of bytes to send : %d.\n", __func__, Firmware_Size);
-		// Compute the amount of bytes to send
-		if (Firmware_Size >= PROTOCOL_SEND_BUFFER_SIZE) Bytes_To_Send_Count = PROTOCOL_SEND_BUFFER_SIZE;
-		else Bytes_To_Send_Count = Firmware_Size;
-		
-		// Send a block
-		SerialPortWriteBuffer(Protocol_Serial_Port_ID, Pointer_Memory, Bytes_To_Send_Count);
-		Pointer_Memory += Bytes_To_Send_Count;
-		Firmware_Size -= Bytes_To_Send_Count;
-		
-		// Wait for the bootloader to acknowledge
-		Byte = SerialPortReadByte(Protocol_Serial_Port_ID);
-		if (Byte != PROTOCOL_ACKNOWLEDGE)
-		{
-			printf("Error : the bootloader acknowledged value was 0x%02X instead of 0x%02X.\n", Byte, PROTOCOL_ACKNOWLEDGE);
-			return 2;
-		}
-	}
-	printf("Firmware successfully updated.\n");
-	
-	return 0;
-}
\ No newline at end of file
+/** @file Protocol.c
+ * @see Protocol.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <stdlib.h> // Needed by atexit()
+#include <string.h>
+#include <sys/time.h> // Needed by gettimeofday()
+#include <unistd.h> // Needed by usleep()
+#include "Compression.h"
+#include "Configuration.h"
+#include "CRC.h"
+#include "Hex_Parser.h"
+#include "Latency.h"
+#include "Memory_Image.h"
+#include "Protocol.h"
+#include "Transport.h"
+
+//-------------------------------------------------------------------------------------------------
+// Private constants
+//-------------------------------------------------------------------------------------------------
+/** The bootloader protocol magic number, also used by the firmware protocol before the frames were introduced. */
+#define PROTOCOL_MAGIC_NUMBER 0xA5
+/** The bootloader protocol version this program understands. */
+#define PROTOCOL_BOOTLOADER_VERSION 2
+/** The bootloader identification sent right after its magic number : the protocol version and the firmware base address (most significant byte first). */
+#define PROTOCOL_BOOTLOADER_IDENTIFICATION_SIZE 3
+/** How many milliseconds to wait for the bootloader identification after its magic number. The first bootloader did not send it, such a bootloader is left alone so it starts its firmware. */
+#define PROTOCOL_BOOTLOADER_IDENTIFICATION_TIMEOUT 100
+/** The bootloader acknowledges that it has received and flashed a block. */
+#define PROTOCOL_ACKNOWLEDGE_BLOCK_WRITTEN 0x42
+/** The bootloader acknowledges that it has received a block which was already present in the flash memory, so it has not been rewritten. */
+#define PROTOCOL_ACKNOWLEDGE_BLOCK_SKIPPED 0x43
+/** The bootloader tells that a block was corrupted (or not received in time), so it must be retransmitted. */
+#define PROTOCOL_ACKNOWLEDGE_BLOCK_CORRUPTED 0x44
+
+/** How many bytes can be sent in one time. */
+#define PROTOCOL_SEND_BUFFER_SIZE 64
+/** How many blocks are sent back-to-back before waiting for the bootloader acknowledge (the bootloader can't hold more than 8 blocks). */
+#define PROTOCOL_WINDOW_BLOCKS_COUNT 8
+/** The blocks are transmitted compressed. */
+#define PROTOCOL_BLOCKS_FLAG_COMPRESSED 0x01
+/** Each block is followed by a CRC computed on its index and its uncompressed content. */
+#define PROTOCOL_BLOCKS_FLAG_CRC 0x02
+
+/** How many milliseconds to wait for a block acknowledge (the bootloader may need to erase and write several blocks before sending it). */
+#define PROTOCOL_ACKNOWLEDGE_TIMEOUT 1000
+/** How many milliseconds to wait for the bootloader to abort a failed command (it needs about 130 ms without receiving anything). */
+#define PROTOCOL_TRANSFER_RECOVERY_TIME 300
+/** Abort the transfer when this amount of windows failed in a row without any block getting through, the link is probably broken. */
+#define PROTOCOL_TRANSFER_MAXIMUM_CONSECUTIVE_ERRORS_COUNT 16
+
+/** The baud rate used when the robot boots. */
+#define PROTOCOL_DEFAULT_BAUD_RATE 115200
+/** The bootloader decompresses the blocks while they are received and the UART FIFO is only 2 bytes deep, so it can't keep up with faster baud rates (see the MainReceiveCompressedBlock() timing budget before raising this value). */
+#define PROTOCOL_COMPRESSED_TRANSFER_MAXIMUM_BAUD_RATE 230400
+/** The first byte of the frame checking that the new baud rate works. */
+#define PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE 0x55
+/** The second byte of the frame checking that the new baud rate works. */
+#define PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE 0xAA
+/** How many milliseconds to wait for the robot to answer a baud rate change request. */
+#define PROTOCOL_BAUD_RATE_ANSWER_TIMEOUT 500
+/** How many milliseconds to wait for the robot to echo the probe. */
+#define PROTOCOL_BAUD_RATE_PROBE_TIMEOUT 100
+/** How many milliseconds the robot needs to go back to the default baud rate when the probe failed. */
+#define PROTOCOL_BAUD_RATE_FALLBACK_TIME 400
+
+/** How many milliseconds to wait for an answer before sending the request again. */
+#define PROTOCOL_ANSWER_TIMEOUT 200
+/** How many times a request is sent before giving up. */
+#define PROTOCOL_REQUEST_MAXIMUM_ATTEMPTS_COUNT 3
+/** The maximum amount of requests waiting for their answers, whatever the firmware tells. */
+#define PROTOCOL_MAXIMUM_PENDING_REQUESTS_COUNT 16
+
+/** An encoded distance sensor sample size : 16-bit filtered distance, 16-bit raw distance, 32-bit timestamp, sequence number and validity flag. */
+#define PROTOCOL_DISTANCE_SENSOR_SAMPLE_SIZE 10
+
+/** A telemetry frame payload size : 32-bit timestamp, 16-bit battery voltage, motor states, artificial intelligence state and distance sensor sample. */
+#define PROTOCOL_TELEMETRY_PAYLOAD_SIZE (8 + PROTOCOL_DISTANCE_SENSOR_SAMPLE_SIZE)
+
+/** How many milliseconds to wait for the robots to start their bootloader, so the robots that are turned off can be turned on by hand. */
+#define PROTOCOL_BOOTLOADER_TIMEOUT 30000
+
+/** How many robots can be updated at the same time in fleet mode, they are all waited for at once. */
+#define PROTOCOL_FLEET_MAXIMUM_ROBOTS_COUNT TRANSPORT_WAIT_MAXIMUM_TRANSPORTS_COUNT
+
+/** How many blocks can be located after the firmware base address. */
+#define PROTOCOL_FIRMWARE_MAXIMUM_BLOCKS_COUNT ((CONFIGURATION_TARGET_PROCESSOR_MEMORY_SIZE - CONFIGURATION_FIRMWARE_BASE_ADDRESS) / PROTOCOL_SEND_BUFFER_SIZE)
+
+//-------------------------------------------------------------------------------------------------
+// Private types
+//-------------------------------------------------------------------------------------------------
+/** A frame received from the firmware. */
+typedef struct
+{
+	unsigned char Sequence_Number; //!< The sequence number of the request being answered, or the telemetry frame number.
+	unsigned char Command; //!< The command of the request being answered, or PROTOCOL_COMMAND_TELEMETRY.
+	unsigned char Payload[PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE]; //!< The frame payload.
+	int Payload_Size; //!< How many bytes the payload contains.
+} TProtocolFrame;
+
+/** A request waiting for its answer. */
+typedef struct
+{
+	TProtocolRequest *Pointer_Request; //!< The request.
+	unsigned char Sequence_Number; //!< The sequence number of the last sent frame, the answer carries the same one.
+	int Attempts_Count; //!< How many times the request has been sent.
+	long long Deadline; //!< When the answer is considered lost (in milliseconds, see TransportGetCurrentTime()).
+} TProtocolPendingRequest;
+
+/** All commands understood by the bootloader once it is in programming mode. */
+typedef enum
+{
+	PROTOCOL_BOOTLOADER_COMMAND_UPLOAD_FIRMWARE,
+	PROTOCOL_BOOTLOADER_COMMAND_GET_BLOCKS_CRC,
+	PROTOCOL_BOOTLOADER_COMMAND_WRITE_BLOCKS,
+	PROTOCOL_BOOTLOADER_COMMAND_REBOOT,
+	PROTOCOL_BOOTLOADER_COMMAND_SET_BAUD_RATE
+} TProtocolBootloaderCommand;
+
+/** A firmware transfer state. */
+typedef struct
+{
+	unsigned char Blocks_Flags; //!< How the blocks are transmitted (a combination of PROTOCOL_BLOCKS_FLAG_xxx values).
+	int Written_Blocks_Count; //!< How many blocks were written by the bootloader.
+	int Skipped_Blocks_Count; //!< How many blocks did not need to be written.
+	int Retransmitted_Blocks_Count; //!< How many blocks were received corrupted by the bootloader.
+	int Transmitted_Bytes_Count; //!< How many bytes were transmitted to send the blocks data.
+	int Consecutive_Errors_Count; //!< How many windows failed in a row.
+} TProtocolTransfer;
+
+/** All the steps of a robot update in fleet mode. */
+typedef enum
+{
+	PROTOCOL_FLEET_ROBOT_STATE_WAIT_BOOTLOADER,
+	PROTOCOL_FLEET_ROBOT_STATE_WAIT_BOOTLOADER_IDENTIFICATION,
+	PROTOCOL_FLEET_ROBOT_STATE_WAIT_BAUD_RATE_ANSWER,
+	PROTOCOL_FLEET_ROBOT_STATE_WAIT_BAUD_RATE_PROBE_ECHO,
+	PROTOCOL_FLEET_ROBOT_STATE_WAIT_BAUD_RATE_FALLBACK,
+	PROTOCOL_FLEET_ROBOT_STATE_WAIT_ACKNOWLEDGES,
+	PROTOCOL_FLEET_ROBOT_STATE_WAIT_RECOVERY,
+	PROTOCOL_FLEET_ROBOT_STATE_SUCCEEDED,
+	PROTOCOL_FLEET_ROBOT_STATE_FAILED
+} TProtocolFleetRobotState;
+
+/** A robot being updated in fleet mode. */
+typedef struct
+{
+	char *String_Serial_Port_File; //!< The serial port device the robot is connected to.
+	TTransport Transport; //!< The robot connection, its file descriptor is -1 while it is closed.
+	TProtocolFleetRobotState State; //!< The current update step.
+	long long Deadline; //!< When the current step times out (in milliseconds, see TransportGetCurrentTime()).
+	long long Bootloader_Deadline; //!< When the robot is considered unreachable if no compatible bootloader answered.
+	unsigned char Bootloader_Identification[PROTOCOL_BOOTLOADER_IDENTIFICATION_SIZE]; //!< The bootloader identification received so far.
+	int Received_Identification_Bytes_Count; //!< How many bootloader identification bytes were received.
+	int Baud_Rate_Index; //!< The baud rate being tried, then used.
+	int Received_Probe_Bytes_Count; //!< How many baud rate probe bytes were echoed so far.
+	int Block_Index; //!< The next block to upload.
+	int Window_Block_Indexes[PROTOCOL_WINDOW_BLOCKS_COUNT]; //!< The blocks waiting for their acknowledge.
+	int Window_Blocks_Count; //!< How many blocks the window contains.
+	int Is_Window_Retransmitted; //!< Set when the window was sent by a WRITE_BLOCKS command instead of the UPLOAD_FIRMWARE one.
+	int Received_Acknowledges_Count; //!< How many acknowledges were received for the window.
+	int Corrupted_Block_Indexes[PROTOCOL_WINDOW_BLOCKS_COUNT]; //!< The window blocks the bootloader refused.
+	int Corrupted_Blocks_Count; //!< How many window blocks the bootloader refused.
+	int Displayed_Progress; //!< The last displayed progress percentage.
+	TProtocolTransfer Transfer; //!< The transfer statistics.
+	long long Start_Time; //!< When the upload started (0 if it did not start).
+	long long End_Time; //!< When the update succeeded or failed.
+	const char *String_Failure_Reason; //!< Why the update failed.
+} TProtocolFleetRobot;
+
+//-------------------------------------------------------------------------------------------------
+// Private variables
+//-------------------------------------------------------------------------------------------------
+/** The connection to the robot. */
+static TTransport Protocol_Transport;
+
+/** All baud rates the robot supports, the robot identifies them by their index in this array. */
+static unsigned int Protocol_Baud_Rates[] = {115200, 230400, 460800, 500000, 1000000};
+
+/** The firmware to program, only the memory areas described by the hex file are stored. */
+static TMemoryImage Protocol_Firmware_Image;
+
+/** The bytes received from the firmware that do not make a whole frame yet. */
+static unsigned char Protocol_Frame_Reception_Buffer[PROTOCOL_FRAME_OVERHEAD_SIZE + PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE];
+/** How many bytes the frame reception buffer contains. */
+static int Protocol_Frame_Reception_Buffer_Bytes_Count = 0;
+/** How many received frames were discarded because they were corrupted. */
+static int Protocol_Corrupted_Frames_Count = 0;
+/** The sequence number of the next request. */
+static unsigned char Protocol_Next_Sequence_Number = 0;
+/** How many requests can be waiting for their answers, a single one until the firmware capabilities are known. */
+static int Protocol_Maximum_Pending_Requests_Count = 1;
+/** Tell whether the firmware capabilities have been retrieved. */
+static int Protocol_Are_Capabilities_Known = 0;
+
+/** The sequence number of the last received telemetry frame, -1 if no frame has been received yet. */
+static int Protocol_Telemetry_Last_Sequence_Number = -1;
+/** The telemetry reception statistics. */
+static TProtocolTelemetryStatistics Protocol_Telemetry_Statistics;
+
+/** The interrupt sources names, in the same order as the firmware ones. */
+static const char *Protocol_String_Interrupt_Source_Names[PROTOCOL_INTERRUPT_SOURCES_COUNT] = {"whole low priority interrupt", "UART", "motors", "distance sensor trigger", "shared timer"};
+/** The motor states names, in the same order as the firmware ones. */
+static const char *Protocol_String_Motor_State_Names[] = {"stopped", "forward", "backward"};
+/** The artificial intelligence states names, in the same order as the firmware ones. */
+static const char *Protocol_String_Artificial_Intelligence_State_Names[] =
+{
+	"starting",
+	"avoid objects : go straight",
+	"avoid objects : turn",
+	"avoid objects : escape",
+	"follow objects : wait for object",
+	"follow objects : follow object",
+	"follow objects : search object on left",
+	"follow objects : search object on right",
+	"follow objects : escape"
+};
+
+/** Where to record the delay between a window transmission and each block acknowledge, NULL to record nothing. */
+static TLatencyRecorder *Protocol_Pointer_Acknowledges_Latency_Recorder = NULL;
+
+/** The firmware size in bytes, shared by all robots in fleet mode. */
+static int Protocol_Fleet_Firmware_Size;
+/** How many blocks the firmware is made of in fleet mode. */
+static int Protocol_Fleet_Blocks_Count;
+/** The map of the non-blank blocks, shared by all robots in fleet mode. */
+static unsigned char Protocol_Fleet_Block_Map[PROTOCOL_FIRMWARE_MAXIMUM_BLOCKS_COUNT / 8];
+
+//-------------------------------------------------------------------------------------------------
+// Private functions
+//-------------------------------------------------------------------------------------------------
+/** Send the last pending bytes and close the connection on program exit. */
+static void ProtocolExitCloseTransport(void)
+{
+	TransportClose(&Protocol_Transport);
+}
+
+/** Wait for a byte during a limited amount of time.
+ * @param Timeout How many milliseconds to wait.
+ * @param Pointer_Byte On output, contain the received byte.
+ * @return 0 if a byte was received,
+ * @return 1 if no byte was received in time.
+ */
+static int ProtocolReadByteWithTimeout(int Timeout, unsigned char *Pointer_Byte)
+{
+	if (TransportReadByte(&Protocol_Transport, Pointer_Byte, TransportGetCurrentTime() + Timeout) != 0) return 1;
+	return 0;
+}
+
+/** Discard the beginning of a corrupted frame, the reception restarts from the next synchronization byte found in the reception buffer. */
+static void ProtocolDiscardCorruptedFrame(void)
+{
+	int i;
+	
+	Protocol_Corrupted_Frames_Count++;
+	
+	for (i = 1; i < Protocol_Frame_Reception_Buffer_Bytes_Count; i++)
+	{
+		if (Protocol_Frame_Reception_Buffer[i] == PROTOCOL_FRAME_SYNCHRONIZATION_BYTE) break;
+	}
+	Protocol_Frame_Reception_Buffer_Bytes_Count -= i;
+	memmove(Protocol_Frame_Reception_Buffer, &Protocol_Frame_Reception_Buffer[i], Protocol_Frame_Reception_Buffer_Bytes_Count);
+}
+
+/** Wait for the next valid firmware frame. The corrupted frames are discarded, and the bytes they contained are searched for the next frame, so no valid frame is lost.
+ * @param Pointer_Frame On output, contain the received frame.
+ * @param Deadline When to stop waiting (in milliseconds, see TransportGetCurrentTime()).
+ * @return 0 if a frame was received,
+ * @return 1 if no frame was received in time (the bytes received so far are kept for the next call).
+ */
+static int ProtocolReceiveFrame(TProtocolFrame *Pointer_Frame, long long Deadline)
+{
+	unsigned char *Pointer_Buffer = Protocol_Frame_Reception_Buffer, Byte;
+	unsigned short CRC;
+	int Frame_Size;
+	
+	while (1)
+	{
+		// Gather a whole frame
+		while (1)
+		{
+			// A too big payload can only come from a corrupted frame
+			if (Protocol_Frame_Reception_Buffer_Bytes_Count >= 2)
+			{
+				if (Pointer_Buffer[1] > PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE)
+				{
+					Debug("[%s] Bad payload size, resynchronizing.\n", __func__);
+					ProtocolDiscardCorruptedFrame();
+					continue;
+				}
+				Frame_Size = Pointer_Buffer[1] + PROTOCOL_FRAME_OVERHEAD_SIZE;
+				if (Protocol_Frame_Reception_Buffer_Bytes_Count >= Frame_Size) break;
+			}
+			
+			if (TransportReadByte(&Protocol_Transport, &Byte, Deadline) != 0) return 1;
+			
+			// A frame always starts with the synchronization byte
+			if ((Protocol_Frame_Reception_Buffer_Bytes_Count == 0) && (Byte != PROTOCOL_FRAME_SYNCHRONIZATION_BYTE)) continue;
+			Pointer_Buffer[Protocol_Frame_Reception_Buffer_Bytes_Count] = Byte;
+			Protocol_Frame_Reception_Buffer_Bytes_Count++;
+		}
+		
+		CRC = CRCComputeBuffer(&Pointer_Buffer[1], Frame_Size - 3);
+		if ((Pointer_Buffer[Frame_Size - 2] == (CRC >> 8)) && (Pointer_Buffer[Frame_Size - 1] == (unsigned char) CRC)) break;
+		
+		Debug("[%s] Bad CRC, resynchronizing.\n", __func__);
+		ProtocolDiscardCorruptedFrame();
+	}
+	
+	// Decode the frame
+	Pointer_Frame->Payload_Size = Pointer_Buffer[1];
+	Pointer_Frame->Sequence_Number = Pointer_Buffer[2];
+	Pointer_Frame->Command = Pointer_Buffer[3];
+	memcpy(Pointer_Frame->Payload, &Pointer_Buffer[PROTOCOL_FRAME_HEADER_SIZE], Pointer_Frame->Payload_Size);
+	
+	// Keep the following bytes, they were received while resynchronizing
+	Protocol_Frame_Reception_Buffer_Bytes_Count -= Frame_Size;
+	memmove(Pointer_Buffer, &Pointer_Buffer[Frame_Size], Protocol_Frame_Reception_Buffer_Bytes_Count);
+	return 0;
+}
+
+/** Send a request, or send it again if its answer did not come.
+ * @param Pointer_Pending_Request The request to send.
+ */
+static void ProtocolSendRequest(TProtocolPendingRequest *Pointer_Pending_Request)
+{
+	unsigned char Frame[PROTOCOL_FRAME_OVERHEAD_SIZE + PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE];
+	int Size;
+	TProtocolRequest *Pointer_Request = Pointer_Pending_Request->Pointer_Request;
+	
+	// The robot may still be waiting for the end of a truncated frame, which would swallow the retransmitted one. Complete it with padding bytes, they make its CRC fail and are then ignored as they are not synchronization bytes
+	if (Pointer_Pending_Request->Attempts_Count > 0)
+	{
+		memset(Frame, 0, sizeof(Frame));
+		TransportWriteBuffer(&Protocol_Transport, Frame, sizeof(Frame));
+	}
+	
+	// Use a new sequence number each time, so a late answer to a previous attempt can't be mistaken for the answer to this one
+	Pointer_Pending_Request->Sequence_Number = Protocol_Next_Sequence_Number;
+	Protocol_Next_Sequence_Number++;
+	Debug("[%s] Sending command %d with sequence number %d (attempt %d).\n", __func__, Pointer_Request->Command, Pointer_Pending_Request->Sequence_Number, Pointer_Pending_Request->Attempts_Count + 1);
+	
+	Size = ProtocolBuildFrame(Pointer_Pending_Request->Sequence_Number, Pointer_Request->Command, Pointer_Request->Payload, Pointer_Request->Payload_Size, Frame);
+	TransportWriteBuffer(&Protocol_Transport, Frame, Size);
+	
+	Pointer_Pending_Request->Attempts_Count++;
+	Pointer_Pending_Request->Deadline = TransportGetCurrentTime() + PROTOCOL_ANSWER_TIMEOUT;
+}
+
+/** Decode a distance sensor sample encoded by the firmware.
+ * @param Pointer_Buffer The encoded sample (PROTOCOL_DISTANCE_SENSOR_SAMPLE_SIZE bytes).
+ * @param Pointer_Sample On output, contain the decoded sample.
+ */
+static void ProtocolDecodeDistanceSensorSample(unsigned char *Pointer_Buffer, TProtocolDistanceSensorSample *Pointer_Sample)
+{
+	// The sensor returns the echo duration in microseconds, sound needs 58us to travel 1 cm back and forth
+	Pointer_Sample->Filtered_Distance = ((Pointer_Buffer[0] << 8) | Pointer_Buffer[1]) / 58;
+	Pointer_Sample->Raw_Distance = ((Pointer_Buffer[2] << 8) | Pointer_Buffer[3]) / 58;
+	Pointer_Sample->Timestamp = ((unsigned int) Pointer_Buffer[4] << 24) | (Pointer_Buffer[5] << 16) | (Pointer_Buffer[6] << 8) | Pointer_Buffer[7];
+	Pointer_Sample->Sequence_Number = Pointer_Buffer[8];
+	Pointer_Sample->Is_Valid = Pointer_Buffer[9];
+	Debug("[%s] Filtered distance : %d cm, raw distance : %d cm, timestamp : %u ms, sequence number : %d, valid : %d.\n", __func__, Pointer_Sample->Filtered_Distance, Pointer_Sample->Raw_Distance, Pointer_Sample->Timestamp, Pointer_Sample->Sequence_Number, Pointer_Sample->Is_Valid);
+}
+
+/** Execute a single command that takes at most a one-byte parameter, and check its answer.
+ * @param Command The command to execute.
+ * @param Parameter The command parameter, or -1 if the command has no parameter.
+ * @param Pointer_Request On output, contain the request and its answer.
+ * @param Expected_Answer_Size How many answer data bytes the command returns.
+ * @return 0 if the command succeeded,
+ * @return -1 if the robot did not answer or refused the command.
+ */
+static int ProtocolExecuteCommand(TProtocolCommand Command, int Parameter, TProtocolRequest *Pointer_Request, int Expected_Answer_Size)
+{
+	Pointer_Request->Command = Command;
+	if (Parameter < 0) Pointer_Request->Payload_Size = 0;
+	else
+	{
+		Pointer_Request->Payload[0] = Parameter;
+		Pointer_Request->Payload_Size = 1;
+	}
+	
+	if (ProtocolExecuteRequests(Pointer_Request, 1) != 0)
+	{
+		Debug("[%s] The robot did not answer.\n", __func__);
+		return -1;
+	}
+	if ((Pointer_Request->Status != PROTOCOL_ANSWER_STATUS_SUCCESS) || (Pointer_Request->Answer_Size != Expected_Answer_Size))
+	{
+		Debug("[%s] The robot refused the command (status %d, %d answer bytes).\n", __func__, Pointer_Request->Status, Pointer_Request->Answer_Size);
+		return -1;
+	}
+	return 0;
+}
+
+/** Send the request making a running firmware reboot into the bootloader. The firmware does not answer.
+ * @param Pointer_Transport The connection to the robot.
+ */
+static void ProtocolSendEnterBootloaderRequest(TTransport *Pointer_Transport)
+{
+	unsigned char Frame[PROTOCOL_FRAME_OVERHEAD_SIZE + 2];
+	int Size;
+	
+	Size = ProtocolBuildFrame(Protocol_Next_Sequence_Number, PROTOCOL_COMMAND_ENTER_BOOTLOADER, NULL, 0, Frame);
+	Protocol_Next_Sequence_Number++;
+	
+	// A robot still running a firmware older than the frames only understands the magic number followed by the command
+	Frame[Size] = PROTOCOL_MAGIC_NUMBER;
+	Frame[Size + 1] = PROTOCOL_COMMAND_ENTER_BOOTLOADER;
+	TransportWriteBuffer(Pointer_Transport, Frame, Size + 2);
+}
+
+/** Close the serial port and open it again with another baud rate. The program is exited if the serial port can't be opened again.
+ * @param Baud_Rate The new baud rate.
+ */
+static void ProtocolReopenSerialPort(unsigned int Baud_Rate)
+{
+	if (TransportSetBaudRate(&Protocol_Transport, Baud_Rate) != 0)
+	{
+		printf("Error : failed to open the serial port '%s' at %u bit/s.\n", Protocol_Transport.String_Address, Baud_Rate);
+		exit(EXIT_FAILURE); // The serial port is lost, nothing more can be done
+	}
+}
+
+/** Switch both the robot and the PC to the fastest baud rate that works. The fastest allowed baud rate is tried first, then slower ones are tried until a probe frame is correctly echoed by the robot. The default baud rate is kept if no faster baud rate works.
+ * @param Is_Bootloader_Command Set to 1 if the robot is in the bootloader programming mode, set to 0 if the robot is running the firmware.
+ * @param Maximum_Baud_Rate The fastest baud rate that can be selected.
+ * @return The selected baud rate.
+ */
+static unsigned int ProtocolNegotiateBaudRate(int Is_Bootloader_Command, unsigned int Maximum_Baud_Rate)
+{
+	int Baud_Rate_Index;
+	unsigned char Byte, Probe[2] = {PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE, PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE};
+	TProtocolRequest Request;
+	
+	// A serial-to-network bridge owns the serial port settings, so the robot must not be told to switch
+	if (!TransportIsBaudRateChangeable(&Protocol_Transport))
+	{
+		Debug("[%s] The transport can't change the baud rate, keeping the default one.\n", __func__);
+		return PROTOCOL_DEFAULT_BAUD_RATE;
+	}
+	
+	for (Baud_Rate_Index = sizeof(Protocol_Baud_Rates) / sizeof(Protocol_Baud_Rates[0]) - 1; Baud_Rate_Index > 0; Baud_Rate_Index--)
+	{
+		if (Protocol_Baud_Rates[Baud_Rate_Index] > Maximum_Baud_Rate) continue;
+		Debug("[%s] Trying %u bit/s...\n", __func__, Protocol_Baud_Rates[Baud_Rate_Index]);
+		
+		// Propose the baud rate, the robot tells whether it supports it
+		if (!Is_Bootloader_Command)
+		{
+			if (ProtocolExecuteCommand(PROTOCOL_COMMAND_SET_BAUD_RATE, Baud_Rate_Index, &Request, 0) != 0) continue;
+		}
+		else
+		{
+			TransportWriteByte(&Protocol_Transport, PROTOCOL_BOOTLOADER_COMMAND_SET_BAUD_RATE);
+			TransportWriteByte(&Protocol_Transport, Baud_Rate_Index);
+			
+			if (ProtocolReadByteWithTimeout(PROTOCOL_BAUD_RATE_ANSWER_TIMEOUT, &Byte) != 0)
+			{
+				Debug("[%s] The robot did not answer.\n", __func__);
+				continue;
+			}
+			if (Byte != PROTOCOL_MAGIC_NUMBER)
+			{
+				Debug("[%s] The robot refused the baud rate.\n", __func__);
+				continue;
+			}
+		}
+		
+		// Both sides switch, then check that the link works
+		ProtocolReopenSerialPort(Protocol_Baud_Rates[Baud_Rate_Index]);
+		TransportWriteBuffer(&Protocol_Transport, Probe, sizeof(Probe));
+		if ((ProtocolReadByteWithTimeout(PROTOCOL_BAUD_RATE_PROBE_TIMEOUT, &Byte) == 0) && (Byte == PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE) && (ProtocolReadByteWithTimeout(PROTOCOL_BAUD_RATE_PROBE_TIMEOUT, &Byte) == 0) && (Byte == PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE))
+		{
+			printf("Using %u bit/s baud rate.\n", Protocol_Baud_Rates[Baud_Rate_Index]);
+			return Protocol_Baud_Rates[Baud_Rate_Index];
+		}
+		
+		// The probe failed, let the robot go back to the default baud rate
+		Debug("[%s] The probe failed.\n", __func__);
+		ProtocolReopenSerialPort(PROTOCOL_DEFAULT_BAUD_RATE);
+		usleep(PROTOCOL_BAUD_RATE_FALLBACK_TIME * 1000);
+	}
+	
+	Debug("[%s] Keeping the default baud rate.\n", __func__);
+	return PROTOCOL_DEFAULT_BAUD_RATE;
+}
+
+/** A MemoryImageIterate() callback telling the address of the first populated area.
+ * @param Address The area address.
+ * @param Pointer_Data The area content.
+ * @param Size The area size.
+ * @param Pointer_Parameter On output, contain the area address (it is an unsigned int).
+ * @return Always 1 to stop the iteration.
+ */
+static int ProtocolGetFirstAreaAddress(unsigned int Address, const unsigned char *Pointer_Data, unsigned int Size, void *Pointer_Parameter)
+{
+	(void) Pointer_Data;
+	(void) Size;
+	
+	*((unsigned int *) Pointer_Parameter) = Address;
+	return 1;
+}
+
+/** A MemoryImageIterate() callback computing the address following the last populated byte.
+ * @param Address The area address.
+ * @param Pointer_Data The area content.
+ * @param Size The area size.
+ * @param Pointer_Parameter On output, contain the area end address (it is an unsigned int).
+ * @return Always 0 to visit all areas.
+ */
+static int ProtocolGetLastAreaEndAddress(unsigned int Address, const unsigned char *Pointer_Data, unsigned int Size, void *Pointer_Parameter)
+{
+	(void) Pointer_Data;
+	
+	*((unsigned int *) Pointer_Parameter) = Address + Size;
+	return 0;
+}
+
+/** A MemoryImageIterate() callback counting the populated bytes.
+ * @param Address The area address.
+ * @param Pointer_Data The area content.
+ * @param Size The area size.
+ * @param Pointer_Parameter On output, the area size is added to this value (it is an unsigned int).
+ * @return Always 0 to visit all areas.
+ */
+static int ProtocolCountAreaBytes(unsigned int Address, const unsigned char *Pointer_Data, unsigned int Size, void *Pointer_Parameter)
+{
+	(void) Address;
+	(void) Pointer_Data;
+	
+	*((unsigned int *) Pointer_Parameter) += Size;
+	return 0;
+}
+
+/** A MemoryImageIterate() callback marking in the blocks map the blocks containing at least one non-erased byte.
+ * @param Address The area address.
+ * @param Pointer_Data The area content.
+ * @param Size The area size.
+ * @param Pointer_Parameter The blocks map, one bit per block starting from the firmware base address.
+ * @return Always 0 to visit all areas.
+ */
+static int ProtocolMarkNonBlankBlocks(unsigned int Address, const unsigned char *Pointer_Data, unsigned int Size, void *Pointer_Parameter)
+{
+	unsigned char *Pointer_Block_Map = Pointer_Parameter;
+	unsigned int i, Block_Index;
+	
+	for (i = 0; i < Size; i++)
+	{
+		if (Pointer_Data[i] != 0xFF)
+		{
+			Block_Index = (Address + i - CONFIGURATION_FIRMWARE_BASE_ADDRESS) / PROTOCOL_SEND_BUFFER_SIZE;
+			Pointer_Block_Map[Block_Index / 8] |= 1 << (Block_Index % 8);
+		}
+	}
+	return 0;
+}
+
+/** Convert the firmware Hex file into a memory image.
+ * @param String_Firmware_Hex_File The Intel Hex file containing the firmware.
+ * @return The firmware size in bytes (starting from the firmware base address) on success,
+ * @return -1 if the Hex file is bad.
+ */
+static int ProtocolLoadFirmware(char *String_Firmware_Hex_File)
+{
+	THexParserError Error;
+	unsigned int Address = 0, Configuration_Bytes_Count = 0, EEPROM_Bytes_Count = 0;
+	
+	Debug("[%s] Converting the Hex file to a memory image...\n", __func__);
+	MemoryImageFree(&Protocol_Firmware_Image); // Discard any previously loaded firmware
+	if (HexParserConvertHexToImage(String_Firmware_Hex_File, &Protocol_Firmware_Image, &Error) != 0)
+	{
+		printf("Error : failed to convert the hex file (%s", HexParserGetErrorMessage(Error.Code));
+		if (Error.Line_Number > 0) printf(" at line %d", Error.Line_Number);
+		printf(").\n");
+		return -1;
+	}
+	Debug("[%s] Conversion succeeded, %d segments found.\n", __func__, Protocol_Firmware_Image.Segments_Count);
+	
+	// The bootloader can't overwrite itself
+	if (MemoryImageIterate(&Protocol_Firmware_Image, 0, CONFIGURATION_FIRMWARE_BASE_ADDRESS, ProtocolGetFirstAreaAddress, &Address) != 0)
+	{
+		printf("Error : the firmware contains data at address 0x%04X, which belongs to the bootloader.\n", Address);
+		return -1;
+	}
+	
+	// Tell about the data the bootloader can't program
+	MemoryImageIterate(&Protocol_Firmware_Image, CONFIGURATION_TARGET_PROCESSOR_CONFIGURATION_WORDS_ADDRESS, CONFIGURATION_TARGET_PROCESSOR_CONFIGURATION_WORDS_ADDRESS + CONFIGURATION_TARGET_PROCESSOR_CONFIGURATION_WORDS_SIZE, ProtocolCountAreaBytes, &Configuration_Bytes_Count);
+	MemoryImageIterate(&Protocol_Firmware_Image, CONFIGURATION_TARGET_PROCESSOR_EEPROM_ADDRESS, CONFIGURATION_TARGET_PROCESSOR_EEPROM_ADDRESS + CONFIGURATION_TARGET_PROCESSOR_EEPROM_SIZE, ProtocolCountAreaBytes, &EEPROM_Bytes_Count);
+	if ((Configuration_Bytes_Count > 0) || (EEPROM_Bytes_Count > 0)) printf("Warning : the %u configuration bytes and %u EEPROM bytes found in the hex file are ignored, the bootloader can only program the flash.\n", Configuration_Bytes_Count, EEPROM_Bytes_Count);
+	
+	// The firmware ends with the last populated program memory byte
+	Address = CONFIGURATION_FIRMWARE_BASE_ADDRESS;
+	MemoryImageIterate(&Protocol_Firmware_Image, CONFIGURATION_FIRMWARE_BASE_ADDRESS, CONFIGURATION_TARGET_PROCESSOR_MEMORY_SIZE, ProtocolGetLastAreaEndAddress, &Address);
+	if (Address == CONFIGURATION_FIRMWARE_BASE_ADDRESS)
+	{
+		printf("Error : the hex file does not contain any firmware instruction.\n");
+		return -1;
+	}
+	
+	return Address - CONFIGURATION_FIRMWARE_BASE_ADDRESS;
+}
+
+/** Retrieve a firmware block content (the bytes that are not present in the hex file are erased flash bytes).
+ * @param Block_Index The block index, starting from the firmware base address.
+ * @param Pointer_Block On output, contain the block content (PROTOCOL_SEND_BUFFER_SIZE bytes).
+ */
+static void ProtocolReadFirmwareBlock(int Block_Index, unsigned char *Pointer_Block)
+{
+	MemoryImageRead(&Protocol_Firmware_Image, CONFIGURATION_FIRMWARE_BASE_ADDRESS + Block_Index * PROTOCOL_SEND_BUFFER_SIZE, Pointer_Block, PROTOCOL_SEND_BUFFER_SIZE, 0xFF);
+}
+
+/** Tell whether the bootloader can program the loaded firmware.
+ * @param Pointer_Identification The identification sent by the bootloader after its magic number.
+ * @return NULL if the bootloader is compatible,
+ * @return A string telling why the bootloader is not compatible.
+ */
+static const char *ProtocolCheckBootloaderIdentification(unsigned char *Pointer_Identification)
+{
+	unsigned int Firmware_Base_Address;
+	
+	Debug("[%s] Bootloader version : %d, firmware base address : 0x%02X%02X.\n", __func__, Pointer_Identification[0], Pointer_Identification[1], Pointer_Identification[2]);
+	if (Pointer_Identification[0] != PROTOCOL_BOOTLOADER_VERSION) return "the bootloader version is not supported";
+	
+	// The firmware is linked to run at a fixed address
+	Firmware_Base_Address = (Pointer_Identification[1] << 8) | Pointer_Identification[2];
+	if (Firmware_Base_Address != CONFIGURATION_FIRMWARE_BASE_ADDRESS) return "the bootloader expects another firmware base address";
+	
+	return NULL;
+}
+
+/** Reboot the robot into the bootloader if it is running the firmware (otherwise wait for the robot to be turned on), then make the bootloader enter programming mode.
+ * @return 0 if the bootloader entered programming mode,
+ * @return -1 if the bootloader did not start in time or the link is broken.
+ */
+static int ProtocolEnterBootloader(void)
+{
+	unsigned char Byte, Identification[PROTOCOL_BOOTLOADER_IDENTIFICATION_SIZE];
+	long long Deadline;
+	int Result, i;
+	const char *String_Incompatibility_Reason = NULL;
+	
+	// The daemon shares a running firmware, it can't let a client reprogram the robot
+	if (Protocol_Transport.Type == TRANSPORT_TYPE_UNIX_SOCKET)
+	{
+		printf("Error : the firmware can't be updated through the daemon, stop the daemon and use the serial port.\n");
+		return -1;
+	}
+	
+	// Ask a running firmware to reboot into the bootloader and to stay in programming mode
+	Debug("[%s] Requesting the firmware to start the bootloader...\n", __func__);
+	ProtocolSendEnterBootloaderRequest(&Protocol_Transport);
+	
+	// Hold the line in break state, so a robot turned on now stays in the bootloader instead of immediately starting the firmware (the request is sent first)
+	TransportSetBreak(&Protocol_Transport, 1);
+	
+	// Wait for the microcontroller's bootloader "ready" code
+	printf("Waiting for the bootloader code...\n");
+	Deadline = TransportGetCurrentTime() + PROTOCOL_BOOTLOADER_TIMEOUT;
+	while (1)
+	{
+		Result = TransportReadByte(&Protocol_Transport, &Byte, Deadline);
+		if (Result != 0)
+		{
+			TransportSetBreak(&Protocol_Transport, 0);
+			if (String_Incompatibility_Reason != NULL) printf("Error : %s, program the bootloader matching this program with a PIC programmer.\n", String_Incompatibility_Reason);
+			else printf("Error : the bootloader did not answer.\n");
+			return -1;
+		}
+		Debug("[%s] Received byte : 0x%02X.\n", __func__, Byte);
+		if (Byte != PROTOCOL_MAGIC_NUMBER) continue;
+		
+		// The bootloader identifies itself right after the magic number
+		for (i = 0; i < PROTOCOL_BOOTLOADER_IDENTIFICATION_SIZE; i++)
+		{
+			if (ProtocolReadByteWithTimeout(PROTOCOL_BOOTLOADER_IDENTIFICATION_TIMEOUT, &Identification[i]) != 0) break;
+		}
+		
+		// Do not answer an incompatible bootloader, it will start its firmware by itself (the magic number may also be a firmware byte, so keep waiting)
+		if (i < PROTOCOL_BOOTLOADER_IDENTIFICATION_SIZE) String_Incompatibility_Reason = "the bootloader is too old (it does not identify itself)";
+		else String_Incompatibility_Reason = ProtocolCheckBootloaderIdentification(Identification);
+		if (String_Incompatibility_Reason == NULL) break;
+		Debug("[%s] Ignoring the magic number : %s.\n", __func__, String_Incompatibility_Reason);
+	}
+	TransportSetBreak(&Protocol_Transport, 0);
+	
+	// Send the same code to the bootloader to enter programming mode
+	TransportWriteByte(&Protocol_Transport, PROTOCOL_MAGIC_NUMBER);
+	return 0;
+}
+
+/** Prepare a firmware transfer.
+ * @param Pointer_Transfer The transfer to initialize.
+ * @param Is_Compression_Enabled Set to 1 to transmit the blocks compressed, set to 0 to transmit them raw.
+ */
+static void ProtocolInitializeTransfer(TProtocolTransfer *Pointer_Transfer, int Is_Compression_Enabled)
+{
+	memset(Pointer_Transfer, 0, sizeof(TProtocolTransfer));
+	
+	// Each block is always protected by a CRC
+	Pointer_Transfer->Blocks_Flags = PROTOCOL_BLOCKS_FLAG_CRC;
+	if (Is_Compression_Enabled) Pointer_Transfer->Blocks_Flags |= PROTOCOL_BLOCKS_FLAG_COMPRESSED;
+}
+
+/** Display the transfer result, compression ratio and effective throughput.
+ * @param Pointer_Transfer The successful transfer.
+ * @param Data_Bytes_Count How many bytes of firmware data were transferred.
+ * @param Pointer_Start_Time When the transfer started.
+ */
+static void ProtocolDisplayTransferStatistics(TProtocolTransfer *Pointer_Transfer, int Data_Bytes_Count, struct timeval *Pointer_Start_Time)
+{
+	struct timeval End_Time;
+	double Elapsed_Time;
+	
+	gettimeofday(&End_Time, NULL);
+	Elapsed_Time = (End_Time.tv_sec - Pointer_Start_Time->tv_sec) + (End_Time.tv_usec - Pointer_Start_Time->tv_usec) / 1000000.;
+	
+	printf("Firmware successfully updated (%d blocks written, %d unchanged blocks skipped, %d corrupted blocks retransmitted).\n", Pointer_Transfer->Written_Blocks_Count, Pointer_Transfer->Skipped_Blocks_Count, Pointer_Transfer->Retransmitted_Blocks_Count);
+	if ((Pointer_Transfer->Transmitted_Bytes_Count > 0) && (Data_Bytes_Count > 0))
+	{
+		if (Pointer_Transfer->Blocks_Flags & PROTOCOL_BLOCKS_FLAG_COMPRESSED) printf("Compression ratio : %0.2f (%d data bytes transmitted as %d bytes).\n", (double) Data_Bytes_Count / Pointer_Transfer->Transmitted_Bytes_Count, Data_Bytes_Count, Pointer_Transfer->Transmitted_Bytes_Count);
+		// Raw blocks only carry their index and CRC in addition to the data
+		else printf("Framing overhead : %0.1f %% (%d data bytes transmitted as %d bytes).\n", (Pointer_Transfer->Transmitted_Bytes_Count - Data_Bytes_Count) * 100. / Data_Bytes_Count, Data_Bytes_Count, Pointer_Transfer->Transmitted_Bytes_Count);
+	}
+	if (Elapsed_Time > 0) printf("Effective throughput : %0.0f bytes/s (%0.2f s).\n", Data_Bytes_Count / Elapsed_Time, Elapsed_Time);
+}
+
+/** Receive the bootloader acknowledge of each block of a window.
+ * @param Pointer_Transfer The transfer to update the statistics of.
+ * @param Blocks_Count How many blocks were sent.
+ * @param Pointer_Are_Blocks_Corrupted On output, tell for each block of the window whether it must be retransmitted.
+ * @return 0 if all blocks were written or skipped,
+ * @return 1 if at least one block was corrupted (the bootloader aborted the command after this window),
+ * @return 2 if the acknowledges were not received in time or were bad (the whole window must be retransmitted).
+ */
+static int ProtocolReceiveBlocksAcknowledges(TProtocolTransfer *Pointer_Transfer, int Blocks_Count, unsigned char *Pointer_Are_Blocks_Corrupted)
+{
+	unsigned char Byte;
+	int i, Result = 0;
+	long long Window_Sending_Time;
+	
+	// The acknowledges latency is measured from the moment the whole window has been handed to the system
+	TransportFlush(&Protocol_Transport);
+	Window_Sending_Time = LatencyGetCurrentTime();
+	
+	for (i = 0; i < Blocks_Count; i++)
+	{
+		if (ProtocolReadByteWithTimeout(PROTOCOL_ACKNOWLEDGE_TIMEOUT, &Byte) != 0)
+		{
+			printf("Warning : the bootloader did not acknowledge the window in time, retransmitting it.\n");
+			return 2;
+		}
+		if (Protocol_Pointer_Acknowledges_Latency_Recorder != NULL) LatencyAddSample(Protocol_Pointer_Acknowledges_Latency_Recorder, LatencyGetCurrentTime() - Window_Sending_Time);
+		
+		// The link is still usable as long as some blocks get through
+		Pointer_Are_Blocks_Corrupted[i] = 0;
+		if (Byte == PROTOCOL_ACKNOWLEDGE_BLOCK_WRITTEN)
+		{
+			Pointer_Transfer->Written_Blocks_Count++;
+			Pointer_Transfer->Consecutive_Errors_Count = 0;
+		}
+		else if (Byte == PROTOCOL_ACKNOWLEDGE_BLOCK_SKIPPED)
+		{
+			Pointer_Transfer->Skipped_Blocks_Count++;
+			Pointer_Transfer->Consecutive_Errors_Count = 0;
+		}
+		else if (Byte == PROTOCOL_ACKNOWLEDGE_BLOCK_CORRUPTED)
+		{
+			Pointer_Are_Blocks_Corrupted[i] = 1;
+			Pointer_Transfer->Retransmitted_Blocks_Count++;
+			Result = 1;
+		}
+		else
+		{
+			printf("Warning : the bootloader acknowledged value was 0x%02X instead of 0x%02X, 0x%02X or 0x%02X, retransmitting the window.\n", Byte, PROTOCOL_ACKNOWLEDGE_BLOCK_WRITTEN, PROTOCOL_ACKNOWLEDGE_BLOCK_SKIPPED, PROTOCOL_ACKNOWLEDGE_BLOCK_CORRUPTED);
+			return 2;
+		}
+	}
+	return Result;
+}
+
+/** Wait for the bootloader to abort the failed command, then discard everything it sent meanwhile.
+ * @param Pointer_Transfer The failed transfer.
+ * @return 0 if the transfer can go on,
+ * @return 1 if too many transfer errors occurred in a row.
+ */
+static int ProtocolRecoverFromTransferError(TProtocolTransfer *Pointer_Transfer)
+{
+	Pointer_Transfer->Consecutive_Errors_Count++;
+	if (Pointer_Transfer->Consecutive_Errors_Count > PROTOCOL_TRANSFER_MAXIMUM_CONSECUTIVE_ERRORS_COUNT)
+	{
+		printf("Error : too many transfer errors in a row, giving up.\n");
+		return 1;
+	}
+	
+	// The bootloader goes back to the command loop when it has not received anything during its reception timeout
+	usleep(PROTOCOL_TRANSFER_RECOVERY_TIME * 1000);
+	TransportDiscardReceivedBytes(&Protocol_Transport);
+	return 0;
+}
+
+/** Append a firmware block to the window to transmit, compressing it if requested and adding its CRC if requested.
+ * @param Block_Index The block index, it is protected by the CRC too so a block can't be written at a wrong location.
+ * @param Blocks_Flags How to transmit the block (a combination of PROTOCOL_BLOCKS_FLAG_xxx values).
+ * @param Pointer_Window_Buffer Where to store the block data. Make sure there is at least COMPRESSION_MAXIMUM_COMPRESSED_BLOCK_SIZE + 2 bytes available.
+ * @return How many bytes were appended to the window.
+ */
+static int ProtocolAppendBlockToWindow(int Block_Index, unsigned char Blocks_Flags, unsigned char *Pointer_Window_Buffer)
+{
+	unsigned char Block[PROTOCOL_SEND_BUFFER_SIZE];
+	int Size, i;
+	unsigned short CRC;
+	
+	ProtocolReadFirmwareBlock(Block_Index, Block);
+	
+	if (Blocks_Flags & PROTOCOL_BLOCKS_FLAG_COMPRESSED) Size = CompressionCompressBlock(Block, Pointer_Window_Buffer);
+	else
+	{
+		memcpy(Pointer_Window_Buffer, Block, PROTOCOL_SEND_BUFFER_SIZE);
+		Size = PROTOCOL_SEND_BUFFER_SIZE;
+	}
+	
+	// Append the CRC of the uncompressed block, so the bootloader checks the decompressed data too
+	if (Blocks_Flags & PROTOCOL_BLOCKS_FLAG_CRC)
+	{
+		CRC = CRCUpdate(CRC_INITIAL_VALUE, (unsigned char) (Block_Index >> 8));
+		CRC = CRCUpdate(CRC, (unsigned char) Block_Index);
+		for (i = 0; i < PROTOCOL_SEND_BUFFER_SIZE; i++) CRC = CRCUpdate(CRC, Block[i]);
+		
+		Pointer_Window_Buffer[Size] = CRC >> 8;
+		Pointer_Window_Buffer[Size + 1] = (unsigned char) CRC;
+		Size += 2;
+	}
+	return Size;
+}
+
+/** Program a list of blocks using the WRITE_BLOCKS command. The corrupted blocks are retransmitted until they are written.
+ * @param Pointer_Transfer The transfer.
+ * @param Pointer_Blocks_Indexes The indexes of the blocks to write. This list is modified when blocks are retransmitted.
+ * @param Blocks_Count How many blocks to write.
+ * @return 0 if all blocks were written,
+ * @return 1 if too many transfer errors occurred.
+ */
+static int ProtocolWriteBlocks(TProtocolTransfer *Pointer_Transfer, unsigned short *Pointer_Blocks_Indexes, int Blocks_Count)
+{
+	unsigned char Window_Buffer[(2 + COMPRESSION_MAXIMUM_COMPRESSED_BLOCK_SIZE + 2) * PROTOCOL_WINDOW_BLOCKS_COUNT], Are_Blocks_Corrupted[PROTOCOL_WINDOW_BLOCKS_COUNT];
+	unsigned short Corrupted_Blocks_Indexes[PROTOCOL_WINDOW_BLOCKS_COUNT];
+	int i = 0, j, Block_Index, Window_Blocks_Count, Corrupted_Blocks_Count, Bytes_To_Send_Count, Result;
+	
+	while (i < Blocks_Count)
+	{
+		// Start a new command for the remaining blocks (the bootloader aborts the command after a failed window)
+		TransportWriteByte(&Protocol_Transport, PROTOCOL_BOOTLOADER_COMMAND_WRITE_BLOCKS);
+		TransportWriteByte(&Protocol_Transport, (Blocks_Count - i) >> 8);
+		TransportWriteByte(&Protocol_Transport, (unsigned char) (Blocks_Count - i));
+		TransportWriteByte(&Protocol_Transport, Pointer_Transfer->Blocks_Flags);
+		
+		while (i < Blocks_Count)
+		{
+			// Gather up to a whole window, each block being preceded by its index
+			Window_Blocks_Count = 0;
+			Bytes_To_Send_Count = 0;
+			while ((Window_Blocks_Count < PROTOCOL_WINDOW_BLOCKS_COUNT) && (i + Window_Blocks_Count < Blocks_Count))
+			{
+				Block_Index = Pointer_Blocks_Indexes[i + Window_Blocks_Count];
+				Window_Buffer[Bytes_To_Send_Count] = Block_Index >> 8;
+				Window_Buffer[Bytes_To_Send_Count + 1] = (unsigned char) Block_Index;
+				Bytes_To_Send_Count += 2 + ProtocolAppendBlockToWindow(Block_Index, Pointer_Transfer->Blocks_Flags, &Window_Buffer[Bytes_To_Send_Count + 2]);
+				Window_Blocks_Count++;
+			}
+			
+			// Send all the window blocks in a row
+			TransportWriteBuffer(&Protocol_Transport, Window_Buffer, Bytes_To_Send_Count);
+			Pointer_Transfer->Transmitted_Bytes_Count += Bytes_To_Send_Count;
+			
+			// Wait for the bootloader to acknowledge each block of the window
+			Result = ProtocolReceiveBlocksAcknowledges(Pointer_Transfer, Window_Blocks_Count, Are_Blocks_Corrupted);
+			if (Result == 0)
+			{
+				i += Window_Blocks_Count;
+				continue;
+			}
+			
+			// Keep only the corrupted blocks of the window, they will be sent first by the next command (the whole window is sent again if the acknowledges were lost)
+			if (Result == 1)
+			{
+				Corrupted_Blocks_Count = 0;
+				for (j = 0; j < Window_Blocks_Count; j++)
+				{
+					if (Are_Blocks_Corrupted[j])
+					{
+						Corrupted_Blocks_Indexes[Corrupted_Blocks_Count] = Pointer_Blocks_Indexes[i + j];
+						Corrupted_Blocks_Count++;
+					}
+				}
+				i += Window_Blocks_Count - Corrupted_Blocks_Count;
+				memcpy(&Pointer_Blocks_Indexes[i], Corrupted_Blocks_Indexes, Corrupted_Blocks_Count * sizeof(unsigned short));
+			}
+			Debug("[%s] Window failed, restarting from list entry %d.\n", __func__, i);
+			
+			if (ProtocolRecoverFromTransferError(Pointer_Transfer) != 0) return 1;
+			break;
+		}
+	}
+	return 0;
+}
+
+/** Program the non-blank firmware blocks using the UPLOAD_FIRMWARE command. The corrupted blocks of a window are retransmitted using the WRITE_BLOCKS command, then the upload is resumed after this window.
+ * @param Pointer_Transfer The transfer.
+ * @param Firmware_Size The firmware size in bytes.
+ * @param Pointer_Block_Map The map of the non-blank blocks, one bit per block.
+ * @return 0 if all blocks were written,
+ * @return 1 if too many transfer errors occurred.
+ */
+static int ProtocolUploadBlocks(TProtocolTransfer *Pointer_Transfer, int Firmware_Size, unsigned char *Pointer_Block_Map)
+{
+	unsigned char Window_Buffer[(COMPRESSION_MAXIMUM_COMPRESSED_BLOCK_SIZE + 2) * PROTOCOL_WINDOW_BLOCKS_COUNT], Are_Blocks_Corrupted[PROTOCOL_WINDOW_BLOCKS_COUNT];
+	unsigned short Window_Blocks_Indexes[PROTOCOL_WINDOW_BLOCKS_COUNT], Corrupted_Blocks_Indexes[PROTOCOL_WINDOW_BLOCKS_COUNT];
+	int Blocks_Count, Block_Index = 0, Window_First_Block_Index, Window_Blocks_Count, Corrupted_Blocks_Count, Bytes_To_Send_Count, i, Result;
+	
+	Blocks_Count = (Firmware_Size + PROTOCOL_SEND_BUFFER_SIZE - 1) / PROTOCOL_SEND_BUFFER_SIZE;
+	
+	while (Block_Index < Blocks_Count)
+	{
+		// Start the upload, or resume it from the first not acknowledged window
+		Debug("[%s] Starting the upload from block %d...\n", __func__, Block_Index);
+		TransportWriteByte(&Protocol_Transport, PROTOCOL_BOOTLOADER_COMMAND_UPLOAD_FIRMWARE);
+		TransportWriteByte(&Protocol_Transport, Firmware_Size >> 8);
+		TransportWriteByte(&Protocol_Transport, (unsigned char) Firmware_Size);
+		TransportWriteByte(&Protocol_Transport, Block_Index >> 8);
+		TransportWriteByte(&Protocol_Transport, (unsigned char) Block_Index);
+		TransportWriteByte(&Protocol_Transport, PROTOCOL_WINDOW_BLOCKS_COUNT);
+		TransportWriteByte(&Protocol_Transport, Pointer_Transfer->Blocks_Flags);
+		TransportWriteBuffer(&Protocol_Transport, Pointer_Block_Map, (Blocks_Count + 7) / 8);
+		
+		while (Block_Index < Blocks_Count)
+		{
+			Debug("[%s] Total remaining of blocks to send : %d.\n", __func__, Blocks_Count - Block_Index);
+			// Gather up to a whole window of non-blank blocks (the bootloader erases the blank blocks encountered meanwhile)
+			Window_First_Block_Index = Block_Index;
+			Window_Blocks_Count = 0;
+			Bytes_To_Send_Count = 0;
+			while ((Window_Blocks_Count < PROTOCOL_WINDOW_BLOCKS_COUNT) && (Block_Index < Blocks_Count))
+			{
+				if (Pointer_Block_Map[Block_Index / 8] & (1 << (Block_Index % 8)))
+				{
+					Bytes_To_Send_Count += ProtocolAppendBlockToWindow(Block_Index, Pointer_Transfer->Blocks_Flags, &Window_Buffer[Bytes_To_Send_Count]);
+					Window_Blocks_Indexes[Window_Blocks_Count] = Block_Index;
+					Window_Blocks_Count++;
+				}
+				Block_Index++;
+			}
+			
+			// Send all the window blocks in a row
+			TransportWriteBuffer(&Protocol_Transport, Window_Buffer, Bytes_To_Send_Count);
+			Pointer_Transfer->Transmitted_Bytes_Count += Bytes_To_Send_Count;
+			
+			// Wait for the bootloader to acknowledge each block of the window
+			Result = ProtocolReceiveBlocksAcknowledges(Pointer_Transfer, Window_Blocks_Count, Are_Blocks_Corrupted);
+			if (Result == 0) continue;
+			
+			if (ProtocolRecoverFromTransferError(Pointer_Transfer) != 0) return 1;
+			
+			// The bootloader state is unknown, resume the upload from the window beginning
+			if (Result == 2)
+			{
+				Block_Index = Window_First_Block_Index;
+				break;
+			}
+			
+			// Retransmit only the corrupted blocks, the other ones of the window are already written
+			Corrupted_Blocks_Count = 0;
+			for (i = 0; i < Window_Blocks_Count; i++)
+			{
+				if (Are_Blocks_Corrupted[i])
+				{
+					Corrupted_Blocks_Indexes[Corrupted_Blocks_Count] = Window_Blocks_Indexes[i];
+					Corrupted_Blocks_Count++;
+				}
+			}
+			Debug("[%s] Retransmitting %d corrupted blocks of the window starting at block %d.\n", __func__, Corrupted_Blocks_Count, Window_First_Block_Index);
+			if (ProtocolWriteBlocks(Pointer_Transfer, Corrupted_Blocks_Indexes, Corrupted_Blocks_Count) != 0) return 1;
+			break;
+		}
+	}
+	return 0;
+}
+
+/** Find the firmware blocks that are not blank, only them need to be transmitted (only the memory areas present in the hex file are checked).
+ * @param Firmware_Size The firmware size in bytes.
+ * @param Pointer_Block_Map On output, contain one bit per block, set when the block is not blank.
+ * @return How many blocks are not blank.
+ */
+static int ProtocolBuildBlockMap(int Firmware_Size, unsigned char *Pointer_Block_Map)
+{
+	int Blocks_Count, Block_Index, Non_Blank_Blocks_Count = 0;
+	
+	Blocks_Count = (Firmware_Size + PROTOCOL_SEND_BUFFER_SIZE - 1) / PROTOCOL_SEND_BUFFER_SIZE;
+	memset(Pointer_Block_Map, 0, (Blocks_Count + 7) / 8);
+	MemoryImageIterate(&Protocol_Firmware_Image, CONFIGURATION_FIRMWARE_BASE_ADDRESS, CONFIGURATION_FIRMWARE_BASE_ADDRESS + Firmware_Size, ProtocolMarkNonBlankBlocks, Pointer_Block_Map);
+	
+	for (Block_Index = 0; Block_Index < Blocks_Count; Block_Index++)
+	{
+		if (Pointer_Block_Map[Block_Index / 8] & (1 << (Block_Index % 8))) Non_Blank_Blocks_Count++;
+	}
+	Debug("[%s] %d non-blank blocks out of %d.\n", __func__, Non_Blank_Blocks_Count, Blocks_Count);
+	
+	return Non_Blank_Blocks_Count;
+}
+
+/** Stop updating a robot.
+ * @param Pointer_Robot The robot.
+ * @param String_Failure_Reason Why the update failed, it is displayed in the final table.
+ */
+static void ProtocolFleetFail(TProtocolFleetRobot *Pointer_Robot, const char *String_Failure_Reason)
+{
+	Pointer_Robot->State = PROTOCOL_FLEET_ROBOT_STATE_FAILED;
+	Pointer_Robot->String_Failure_Reason = String_Failure_Reason;
+	Pointer_Robot->End_Time = TransportGetCurrentTime();
+	printf("%s : failed, %s.\n", Pointer_Robot->String_Serial_Port_File, String_Failure_Reason);
+}
+
+/** Close the robot serial port and open it again with another baud rate. The robot update fails if the serial port can't be opened again.
+ * @param Pointer_Robot The robot.
+ * @param Baud_Rate The new baud rate.
+ * @return 0 if the serial port was reopened,
+ * @return 1 if the serial port is lost.
+ */
+static int ProtocolFleetReopenSerialPort(TProtocolFleetRobot *Pointer_Robot, unsigned int Baud_Rate)
+{
+	if (TransportSetBaudRate(&Pointer_Robot->Transport, Baud_Rate) != 0)
+	{
+		ProtocolFleetFail(Pointer_Robot, "could not reopen the serial port");
+		return 1;
+	}
+	return 0;
+}
+
+/** Transmit the blocks of the robot window and wait for their acknowledges.
+ * @param Pointer_Robot The robot.
+ */
+static void ProtocolFleetTransmitWindow(TProtocolFleetRobot *Pointer_Robot)
+{
+	unsigned char Window_Buffer[(2 + COMPRESSION_MAXIMUM_COMPRESSED_BLOCK_SIZE + 2) * PROTOCOL_WINDOW_BLOCKS_COUNT];
+	int i, Bytes_To_Send_Count = 0;
+	
+	for (i = 0; i < Pointer_Robot->Window_Blocks_Count; i++)
+	{
+		// The WRITE_BLOCKS command needs the block index before each block
+		if (Pointer_Robot->Is_Window_Retransmitted)
+		{
+			Window_Buffer[Bytes_To_Send_Count] = Pointer_Robot->Window_Block_Indexes[i] >> 8;
+			Window_Buffer[Bytes_To_Send_Count + 1] = (unsigned char) Pointer_Robot->Window_Block_Indexes[i];
+			Bytes_To_Send_Count += 2;
+		}
+		Bytes_To_Send_Count += ProtocolAppendBlockToWindow(Pointer_Robot->Window_Block_Indexes[i], Pointer_Robot->Transfer.Blocks_Flags, &Window_Buffer[Bytes_To_Send_Count]);
+	}
+	
+	// The window fits in the kernel serial port buffer, so writing it does not stall the other robots
+	TransportWriteBuffer(&Pointer_Robot->Transport, Window_Buffer, Bytes_To_Send_Count);
+	Pointer_Robot->Transfer.Transmitted_Bytes_Count += Bytes_To_Send_Count;
+	
+	Pointer_Robot->Received_Acknowledges_Count = 0;
+	Pointer_Robot->Corrupted_Blocks_Count = 0;
+	Pointer_Robot->State = PROTOCOL_FLEET_ROBOT_STATE_WAIT_ACKNOWLEDGES;
+	Pointer_Robot->Deadline = TransportGetCurrentTime() + PROTOCOL_ACKNOWLEDGE_TIMEOUT;
+}
+
+/** Send the next window of non-blank blocks, or reboot the robot if all blocks were sent.
+ * @param Pointer_Robot The robot.
+ */
+static void ProtocolFleetSendWindow(TProtocolFleetRobot *Pointer_Robot)
+{
+	// Gather up to a whole window of non-blank blocks, like ProtocolUploadBlocks() does
+	Pointer_Robot->Window_Blocks_Count = 0;
+	Pointer_Robot->Is_Window_Retransmitted = 0;
+	while ((Pointer_Robot->Window_Blocks_Count < PROTOCOL_WINDOW_BLOCKS_COUNT) && (Pointer_Robot->Block_Index < Protocol_Fleet_Blocks_Count))
+	{
+		if (Protocol_Fleet_Block_Map[Pointer_Robot->Block_Index / 8] & (1 << (Pointer_Robot->Block_Index % 8)))
+		{
+			Pointer_Robot->Window_Block_Indexes[Pointer_Robot->Window_Blocks_Count] = Pointer_Robot->Block_Index;
+			Pointer_Robot->Window_Blocks_Count++;
+		}
+		Pointer_Robot->Block_Index++;
+	}
+	
+	// Start the new firmware when everything has been sent
+	if (Pointer_Robot->Window_Blocks_Count == 0)
+	{
+		TransportWriteByte(&Pointer_Robot->Transport, PROTOCOL_BOOTLOADER_COMMAND_REBOOT);
+		Pointer_Robot->State = PROTOCOL_FLEET_ROBOT_STATE_SUCCEEDED;
+		Pointer_Robot->End_Time = TransportGetCurrentTime();
+		printf("%s : firmware successfully updated.\n", Pointer_Robot->String_Serial_Port_File);
+		return;
+	}
+	
+	ProtocolFleetTransmitWindow(Pointer_Robot);
+}
+
+/** Retransmit the blocks the bootloader refused with a WRITE_BLOCKS command.
+ * @param Pointer_Robot The robot, its window must contain the blocks to retransmit.
+ */
+static void ProtocolFleetRetransmitWindow(TProtocolFleetRobot *Pointer_Robot)
+{
+	TransportWriteByte(&Pointer_Robot->Transport, PROTOCOL_BOOTLOADER_COMMAND_WRITE_BLOCKS);
+	TransportWriteByte(&Pointer_Robot->Transport, Pointer_Robot->Window_Blocks_Count >> 8);
+	TransportWriteByte(&Pointer_Robot->Transport, (unsigned char) Pointer_Robot->Window_Blocks_Count);
+	TransportWriteByte(&Pointer_Robot->Transport, Pointer_Robot->Transfer.Blocks_Flags);
+	ProtocolFleetTransmitWindow(Pointer_Robot);
+}
+
+/** Send the UPLOAD_FIRMWARE command starting from the robot current block, then the first window.
+ * @param Pointer_Robot The robot.
+ */
+static void ProtocolFleetStartUpload(TProtocolFleetRobot *Pointer_Robot)
+{
+	if (Pointer_Robot->Start_Time == 0)
+	{
+		Pointer_Robot->Start_Time = TransportGetCurrentTime();
+		printf("%s : bootloader ready at %u bit/s, sending the firmware...\n", Pointer_Robot->String_Serial_Port_File, Protocol_Baud_Rates[Pointer_Robot->Baud_Rate_Index]);
+	}
+	
+	TransportWriteByte(&Pointer_Robot->Transport, PROTOCOL_BOOTLOADER_COMMAND_UPLOAD_FIRMWARE);
+	TransportWriteByte(&Pointer_Robot->Transport, Protocol_Fleet_Firmware_Size >> 8);
+	TransportWriteByte(&Pointer_Robot->Transport, (unsigned char) Protocol_Fleet_Firmware_Size);
+	TransportWriteByte(&Pointer_Robot->Transport, Pointer_Robot->Block_Index >> 8);
+	TransportWriteByte(&Pointer_Robot->Transport, (unsigned char) Pointer_Robot->Block_Index);
+	TransportWriteByte(&Pointer_Robot->Transport, PROTOCOL_WINDOW_BLOCKS_COUNT);
+	TransportWriteByte(&Pointer_Robot->Transport, Pointer_Robot->Transfer.Blocks_Flags);
+	TransportWriteBuffer(&Pointer_Robot->Transport, Protocol_Fleet_Block_Map, (Protocol_Fleet_Blocks_Count + 7) / 8);
+	
+	ProtocolFleetSendWindow(Pointer_Robot);
+}
+
+/** Propose the robot the fastest baud rate not tried yet, or start the upload at the current baud rate if there is no faster baud rate left.
+ * @param Pointer_Robot The robot.
+ */
+static void ProtocolFleetProposeBaudRate(TProtocolFleetRobot *Pointer_Robot)
+{
+	while ((Pointer_Robot->Baud_Rate_Index > 0) && (Protocol_Baud_Rates[Pointer_Robot->Baud_Rate_Index] > CONFIGURATION_MAXIMUM_BAUD_RATE)) Pointer_Robot->Baud_Rate_Index--;
+	
+	// A serial-to-network bridge owns the serial port settings
+	if (!TransportIsBaudRateChangeable(&Pointer_Robot->Transport)) Pointer_Robot->Baud_Rate_Index = 0;
+	
+	// Keep the default baud rate
+	if (Pointer_Robot->Baud_Rate_Index == 0)
+	{
+		ProtocolFleetStartUpload(Pointer_Robot);
+		return;
+	}
+	
+	TransportWriteByte(&Pointer_Robot->Transport, PROTOCOL_BOOTLOADER_COMMAND_SET_BAUD_RATE);
+	TransportWriteByte(&Pointer_Robot->Transport, Pointer_Robot->Baud_Rate_Index);
+	Pointer_Robot->State = PROTOCOL_FLEET_ROBOT_STATE_WAIT_BAUD_RATE_ANSWER;
+	Pointer_Robot->Deadline = TransportGetCurrentTime() + PROTOCOL_BAUD_RATE_ANSWER_TIMEOUT;
+}
+
+/** Let the robot go back to the default baud rate after a failed probe, a slower baud rate will be tried next.
+ * @param Pointer_Robot The robot.
+ */
+static void ProtocolFleetFallBackToDefaultBaudRate(TProtocolFleetRobot *Pointer_Robot)
+{
+	Pointer_Robot->Baud_Rate_Index--;
+	if (ProtocolFleetReopenSerialPort(Pointer_Robot, PROTOCOL_DEFAULT_BAUD_RATE) != 0) return;
+	Pointer_Robot->State = PROTOCOL_FLEET_ROBOT_STATE_WAIT_BAUD_RATE_FALLBACK;
+	Pointer_Robot->Deadline = TransportGetCurrentTime() + PROTOCOL_BAUD_RATE_FALLBACK_TIME;
+}
+
+/** Give the bootloader the time to abort the failed command, the transfer will be resumed when the recovery time is elapsed.
+ * @param Pointer_Robot The robot.
+ */
+static void ProtocolFleetHandleTransferError(TProtocolFleetRobot *Pointer_Robot)
+{
+	int i;
+	
+	Pointer_Robot->Transfer.Consecutive_Errors_Count++;
+	if (Pointer_Robot->Transfer.Consecutive_Errors_Count > PROTOCOL_TRANSFER_MAXIMUM_CONSECUTIVE_ERRORS_COUNT)
+	{
+		ProtocolFleetFail(Pointer_Robot, "too many transfer errors");
+		return;
+	}
+	
+	// Only the refused blocks need to be sent again
+	if (Pointer_Robot->Corrupted_Blocks_Count > 0)
+	{
+		for (i = 0; i < Pointer_Robot->Corrupted_Blocks_Count; i++) Pointer_Robot->Window_Block_Indexes[i] = Pointer_Robot->Corrupted_Block_Indexes[i];
+		Pointer_Robot->Window_Blocks_Count = Pointer_Robot->Corrupted_Blocks_Count;
+		Pointer_Robot->Is_Window_Retransmitted = 1;
+	}
+	// The acknowledges were lost, upload the window again (the already written blocks will be skipped)
+	else if (!Pointer_Robot->Is_Window_Retransmitted) Pointer_Robot->Block_Index = Pointer_Robot->Window_Block_Indexes[0];
+	
+	Pointer_Robot->State = PROTOCOL_FLEET_ROBOT_STATE_WAIT_RECOVERY;
+	Pointer_Robot->Deadline = TransportGetCurrentTime() + PROTOCOL_TRANSFER_RECOVERY_TIME;
+}
+
+/** Display the robot progress each time another tenth of the firmware has been acknowledged.
+ * @param Pointer_Robot The robot.
+ */
+static void ProtocolFleetDisplayProgress(TProtocolFleetRobot *Pointer_Robot)
+{
+	int Progress;
+	
+	Progress = Pointer_Robot->Block_Index * 100 / Protocol_Fleet_Blocks_Count;
+	if (Progress / 10 == Pointer_Robot->Displayed_Progress / 10) return;
+	
+	printf("%s : %3d %% (%d blocks written, %d skipped, %d retransmitted)\n", Pointer_Robot->String_Serial_Port_File, Progress, Pointer_Robot->Transfer.Written_Blocks_Count, Pointer_Robot->Transfer.Skipped_Blocks_Count, Pointer_Robot->Transfer.Retransmitted_Blocks_Count);
+	Pointer_Robot->Displayed_Progress = Progress;
+}
+
+/** Make a robot state machine progress when it receives a byte.
+ * @param Pointer_Robot The robot.
+ * @param Byte The received byte.
+ */
+static void ProtocolFleetProcessByte(TProtocolFleetRobot *Pointer_Robot, unsigned char Byte)
+{
+	unsigned char Probe[2] = {PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE, PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE};
+	
+	switch (Pointer_Robot->State)
+	{
+		// The bootloader sends the magic number when it starts, followed by its identification
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_BOOTLOADER:
+			if (Byte != PROTOCOL_MAGIC_NUMBER) break; // Ignore the answers of a running firmware
+			Pointer_Robot->Received_Identification_Bytes_Count = 0;
+			Pointer_Robot->State = PROTOCOL_FLEET_ROBOT_STATE_WAIT_BOOTLOADER_IDENTIFICATION;
+			Pointer_Robot->Deadline = TransportGetCurrentTime() + PROTOCOL_BOOTLOADER_IDENTIFICATION_TIMEOUT;
+			break;
+			
+		// The magic number must be echoed to enter programming mode, but only if the bootloader can program this firmware
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_BOOTLOADER_IDENTIFICATION:
+			Pointer_Robot->Bootloader_Identification[Pointer_Robot->Received_Identification_Bytes_Count] = Byte;
+			Pointer_Robot->Received_Identification_Bytes_Count++;
+			if (Pointer_Robot->Received_Identification_Bytes_Count < PROTOCOL_BOOTLOADER_IDENTIFICATION_SIZE) break;
+			
+			// An incompatible bootloader starts its firmware by itself, keep waiting in case the magic number was a firmware byte
+			Pointer_Robot->String_Failure_Reason = ProtocolCheckBootloaderIdentification(Pointer_Robot->Bootloader_Identification);
+			if (Pointer_Robot->String_Failure_Reason != NULL)
+			{
+				Pointer_Robot->State = PROTOCOL_FLEET_ROBOT_STATE_WAIT_BOOTLOADER;
+				Pointer_Robot->Deadline = Pointer_Robot->Bootloader_Deadline;
+				break;
+			}
+			TransportSetBreak(&Pointer_Robot->Transport, 0);
+			TransportWriteByte(&Pointer_Robot->Transport, PROTOCOL_MAGIC_NUMBER);
+			
+			Pointer_Robot->Baud_Rate_Index = sizeof(Protocol_Baud_Rates) / sizeof(Protocol_Baud_Rates[0]) - 1;
+			ProtocolFleetProposeBaudRate(Pointer_Robot);
+			break;
+			
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_BAUD_RATE_ANSWER:
+			// Try a slower baud rate if this one was refused
+			if (Byte != PROTOCOL_MAGIC_NUMBER)
+			{
+				Pointer_Robot->Baud_Rate_Index--;
+				ProtocolFleetProposeBaudRate(Pointer_Robot);
+				break;
+			}
+			
+			// Both sides switch, then check that the link works
+			if (ProtocolFleetReopenSerialPort(Pointer_Robot, Protocol_Baud_Rates[Pointer_Robot->Baud_Rate_Index]) != 0) break;
+			TransportWriteBuffer(&Pointer_Robot->Transport, Probe, sizeof(Probe));
+			Pointer_Robot->Received_Probe_Bytes_Count = 0;
+			Pointer_Robot->State = PROTOCOL_FLEET_ROBOT_STATE_WAIT_BAUD_RATE_PROBE_ECHO;
+			Pointer_Robot->Deadline = TransportGetCurrentTime() + PROTOCOL_BAUD_RATE_PROBE_TIMEOUT;
+			break;
+			
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_BAUD_RATE_PROBE_ECHO:
+			if (Byte != Probe[Pointer_Robot->Received_Probe_Bytes_Count])
+			{
+				ProtocolFleetFallBackToDefaultBaudRate(Pointer_Robot);
+				break;
+			}
+			Pointer_Robot->Received_Probe_Bytes_Count++;
+			if (Pointer_Robot->Received_Probe_Bytes_Count == sizeof(Probe)) ProtocolFleetStartUpload(Pointer_Robot);
+			break;
+			
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_ACKNOWLEDGES:
+			// Handle the block acknowledge the same way ProtocolReceiveBlocksAcknowledges() does
+			if (Byte == PROTOCOL_ACKNOWLEDGE_BLOCK_WRITTEN)
+			{
+				Pointer_Robot->Transfer.Written_Blocks_Count++;
+				Pointer_Robot->Transfer.Consecutive_Errors_Count = 0;
+			}
+			else if (Byte == PROTOCOL_ACKNOWLEDGE_BLOCK_SKIPPED)
+			{
+				Pointer_Robot->Transfer.Skipped_Blocks_Count++;
+				Pointer_Robot->Transfer.Consecutive_Errors_Count = 0;
+			}
+			else if (Byte == PROTOCOL_ACKNOWLEDGE_BLOCK_CORRUPTED)
+			{
+				Pointer_Robot->Transfer.Retransmitted_Blocks_Count++;
+				Pointer_Robot->Corrupted_Block_Indexes[Pointer_Robot->Corrupted_Blocks_Count] = Pointer_Robot->Window_Block_Indexes[Pointer_Robot->Received_Acknowledges_Count];
+				Pointer_Robot->Corrupted_Blocks_Count++;
+			}
+			else
+			{
+				Pointer_Robot->Corrupted_Blocks_Count = 0;
+				ProtocolFleetHandleTransferError(Pointer_Robot);
+				break;
+			}
+			
+			// Wait for the whole window to be acknowledged
+			Pointer_Robot->Received_Acknowledges_Count++;
+			if (Pointer_Robot->Received_Acknowledges_Count < Pointer_Robot->Window_Blocks_Count) break;
+			
+			// The bootloader aborted the command after a corrupted window
+			if (Pointer_Robot->Corrupted_Blocks_Count > 0)
+			{
+				ProtocolFleetHandleTransferError(Pointer_Robot);
+				break;
+			}
+			ProtocolFleetDisplayProgress(Pointer_Robot);
+			
+			// The upload command was aborted by the retransmitted blocks, start it again from the first block not sent yet
+			if (Pointer_Robot->Is_Window_Retransmitted) ProtocolFleetStartUpload(Pointer_Robot);
+			else ProtocolFleetSendWindow(Pointer_Robot);
+			break;
+			
+		// Discard anything received while waiting
+		default:
+			break;
+	}
+}
+
+/** Make a robot state machine progress when its current step deadline is reached.
+ * @param Pointer_Robot The robot.
+ */
+static void ProtocolFleetProcessTimeout(TProtocolFleetRobot *Pointer_Robot)
+{
+	switch (Pointer_Robot->State)
+	{
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_BOOTLOADER:
+			if (Pointer_Robot->String_Failure_Reason != NULL) ProtocolFleetFail(Pointer_Robot, Pointer_Robot->String_Failure_Reason);
+			else ProtocolFleetFail(Pointer_Robot, "the bootloader did not answer");
+			break;
+			
+		// Only the first bootloader sends nothing after the magic number
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_BOOTLOADER_IDENTIFICATION:
+			Pointer_Robot->String_Failure_Reason = "the bootloader is too old (it does not identify itself)";
+			Pointer_Robot->State = PROTOCOL_FLEET_ROBOT_STATE_WAIT_BOOTLOADER;
+			Pointer_Robot->Deadline = Pointer_Robot->Bootloader_Deadline;
+			break;
+			
+		// The robot did not understand the request, try a slower baud rate
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_BAUD_RATE_ANSWER:
+			Pointer_Robot->Baud_Rate_Index--;
+			ProtocolFleetProposeBaudRate(Pointer_Robot);
+			break;
+			
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_BAUD_RATE_PROBE_ECHO:
+			ProtocolFleetFallBackToDefaultBaudRate(Pointer_Robot);
+			break;
+			
+		// The robot is back to the default baud rate
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_BAUD_RATE_FALLBACK:
+			ProtocolFleetProposeBaudRate(Pointer_Robot);
+			break;
+			
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_ACKNOWLEDGES:
+			Pointer_Robot->Corrupted_Blocks_Count = 0;
+			ProtocolFleetHandleTransferError(Pointer_Robot);
+			break;
+			
+		// The bootloader is back to its command loop, resume the transfer
+		case PROTOCOL_FLEET_ROBOT_STATE_WAIT_RECOVERY:
+			TransportDiscardReceivedBytes(&Pointer_Robot->Transport);
+			if (Pointer_Robot->Is_Window_Retransmitted) ProtocolFleetRetransmitWindow(Pointer_Robot);
+			else ProtocolFleetStartUpload(Pointer_Robot);
+			break;
+			
+		default:
+			break;
+	}
+}
+
+/** Display the result of each robot update.
+ * @param Pointer_Robots The robots.
+ * @param Robots_Count How many robots were updated.
+ * @return How many robot updates failed.
+ */
+static int ProtocolFleetDisplayResults(TProtocolFleetRobot *Pointer_Robots, int Robots_Count)
+{
+	int i, Failed_Robots_Count = 0;
+	TProtocolFleetRobot *Pointer_Robot;
+	double Elapsed_Time;
+	
+	printf("\n%-24s %-8s %10s %8s %8s %8s %9s  %s\n", "Serial port", "Result", "Baud rate", "Written", "Skipped", "Resent", "Time (s)", "Failure reason");
+	for (i = 0; i < Robots_Count; i++)
+	{
+		Pointer_Robot = &Pointer_Robots[i];
+		if (Pointer_Robot->State != PROTOCOL_FLEET_ROBOT_STATE_SUCCEEDED) Failed_Robots_Count++;
+		
+		// The time is only meaningful if the upload started
+		if (Pointer_Robot->Start_Time == 0) Elapsed_Time = 0;
+		else Elapsed_Time = (Pointer_Robot->End_Time - Pointer_Robot->Start_Time) / 1000.;
+		
+		printf("%-24s %-8s %10u %8d %8d %8d %9.2f  %s\n", Pointer_Robot->String_Serial_Port_File, Pointer_Robot->State == PROTOCOL_FLEET_ROBOT_STATE_SUCCEEDED ? "success" : "FAILURE", Protocol_Baud_Rates[Pointer_Robot->Baud_Rate_Index], Pointer_Robot->Transfer.Written_Blocks_Count,
+			Pointer_Robot->Transfer.Skipped_Blocks_Count, Pointer_Robot->Transfer.Retransmitted_Blocks_Count, Elapsed_Time, Pointer_Robot->String_Failure_Reason == NULL ? "-" : Pointer_Robot->String_Failure_Reason);
+	}
+	printf("\n%d robots successfully updated, %d failed.\n", Robots_Count - Failed_Robots_Count, Failed_Robots_Count);
+	
+	return Failed_Robots_Count;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Public functions
+//-------------------------------------------------------------------------------------------------
+int ProtocolInitialize(char *String_Serial_Port_File)
+{
+	// Try to open the serial port
+	if (TransportOpen(&Protocol_Transport, String_Serial_Port_File, PROTOCOL_DEFAULT_BAUD_RATE) == 0)
+	{
+		atexit(ProtocolExitCloseTransport);
+		return 0;
+	}
+	
+	return 1;
+}
+
+int ProtocolBuildFrame(unsigned char Sequence_Number, unsigned char Command, const unsigned char *Pointer_Payload, int Payload_Size, unsigned char *Pointer_Frame)
+{
+	unsigned short CRC;
+	
+	Pointer_Frame[0] = PROTOCOL_FRAME_SYNCHRONIZATION_BYTE;
+	Pointer_Frame[1] = Payload_Size;
+	Pointer_Frame[2] = Sequence_Number;
+	Pointer_Frame[3] = Command;
+	memcpy(&Pointer_Frame[PROTOCOL_FRAME_HEADER_SIZE], Pointer_Payload, Payload_Size);
+	
+	// The CRC covers all bytes following the synchronization one
+	CRC = CRCComputeBuffer(&Pointer_Frame[1], PROTOCOL_FRAME_HEADER_SIZE - 1 + Payload_Size);
+	Pointer_Frame[PROTOCOL_FRAME_HEADER_SIZE + Payload_Size] = CRC >> 8;
+	Pointer_Frame[PROTOCOL_FRAME_HEADER_SIZE + Payload_Size + 1] = (unsigned char) CRC;
+	
+	return PROTOCOL_FRAME_OVERHEAD_SIZE + Payload_Size;
+}
+
+int ProtocolExecuteRequests(TProtocolRequest *Pointer_Requests, int Requests_Count)
+{
+	TProtocolPendingRequest Pending_Requests[PROTOCOL_MAXIMUM_PENDING_REQUESTS_COUNT];
+	TProtocolCapabilities Capabilities;
+	TProtocolFrame Frame;
+	TProtocolRequest *Pointer_Request;
+	int i, Pending_Requests_Count = 0, Next_Request_Index = 0, Return_Value = 0;
+	long long Deadline, Current_Time;
+	
+	// Ask the firmware how many requests can be pipelined
+	if ((Requests_Count > 1) && !Protocol_Are_Capabilities_Known) ProtocolGetCapabilities(&Capabilities);
+	
+	for (i = 0; i < Requests_Count; i++)
+	{
+		Pointer_Requests[i].Status = -1;
+		Pointer_Requests[i].Answer_Size = 0;
+	}
+	
+	while ((Next_Request_Index < Requests_Count) || (Pending_Requests_Count > 0))
+	{
+		// Send as many requests as the robot can buffer answers
+		while ((Pending_Requests_Count < Protocol_Maximum_Pending_Requests_Count) && (Next_Request_Index < Requests_Count))
+		{
+			Pending_Requests[Pending_Requests_Count].Pointer_Request = &Pointer_Requests[Next_Request_Index];
+			Pending_Requests[Pending_Requests_Count].Attempts_Count = 0;
+			ProtocolSendRequest(&Pending_Requests[Pending_Requests_Count]);
+			Pending_Requests_Count++;
+			Next_Request_Index++;
+		}
+		
+		// Wait for an answer until the nearest request deadline
+		Deadline = Pending_Requests[0].Deadline;
+		for (i = 1; i < Pending_Requests_Count; i++)
+		{
+			if (Pending_Requests[i].Deadline < Deadline) Deadline = Pending_Requests[i].Deadline;
+		}
+		
+		if (ProtocolReceiveFrame(&Frame, Deadline) == 0)
+		{
+			// Find the request being answered, ignoring the telemetry frames and the late answers to requests that were sent again
+			for (i = 0; i < Pending_Requests_Count; i++)
+			{
+				if ((Pending_Requests[i].Sequence_Number == Frame.Sequence_Number) && (Pending_Requests[i].Pointer_Request->Command == Frame.Command)) break;
+			}
+			if ((i == Pending_Requests_Count) || (Frame.Payload_Size == 0))
+			{
+				Debug("[%s] Ignoring frame with command %d and sequence number %d.\n", __func__, Frame.Command, Frame.Sequence_Number);
+				continue;
+			}
+			
+			// The first payload byte is the answer status
+			Pointer_Request = Pending_Requests[i].Pointer_Request;
+			Pointer_Request->Status = Frame.Payload[0];
+			Pointer_Request->Answer_Size = Frame.Payload_Size - 1;
+			memcpy(Pointer_Request->Answer, &Frame.Payload[1], Pointer_Request->Answer_Size);
+			
+			Pending_Requests_Count--;
+			Pending_Requests[i] = Pending_Requests[Pending_Requests_Count];
+			continue;
+		}
+		
+		// Send again the requests whose answer did not come in time
+		Current_Time = TransportGetCurrentTime();
+		i = 0;
+		while (i < Pending_Requests_Count)
+		{
+			if (Pending_Requests[i].Deadline > Current_Time)
+			{
+				i++;
+				continue;
+			}
+			
+			if (Pending_Requests[i].Attempts_Count >= PROTOCOL_REQUEST_MAXIMUM_ATTEMPTS_COUNT)
+			{
+				Debug("[%s] Giving up command %d, the robot did not answer.\n", __func__, Pending_Requests[i].Pointer_Request->Command);
+				Return_Value = -1;
+				Pending_Requests_Count--;
+				Pending_Requests[i] = Pending_Requests[Pending_Requests_Count];
+				continue;
+			}
+			
+			ProtocolSendRequest(&Pending_Requests[i]);
+			i++;
+		}
+	}
+	
+	return Return_Value;
+}
+
+int ProtocolGetCapabilities(TProtocolCapabilities *Pointer_Capabilities)
+{
+	TProtocolRequest Request;
+	
+	if (ProtocolExecuteCommand(PROTOCOL_COMMAND_GET_CAPABILITIES, -1, &Request, 5) != 0) return -1;
+	
+	Pointer_Capabilities->Protocol_Version = Request.Answer[0];
+	Pointer_Capabilities->Maximum_Request_Payload_Size = Request.Answer[1];
+	Pointer_Capabilities->Maximum_Pending_Requests_Count = Request.Answer[2];
+	Pointer_Capabilities->Supported_Commands_Mask = (Request.Answer[3] << 8) | Request.Answer[4];
+	
+	// Pipeline as many requests as the firmware allows
+	Protocol_Maximum_Pending_Requests_Count = Pointer_Capabilities->Maximum_Pending_Requests_Count;
+	if (Protocol_Maximum_Pending_Requests_Count < 1) Protocol_Maximum_Pending_Requests_Count = 1;
+	if (Protocol_Maximum_Pending_Requests_Count > PROTOCOL_MAXIMUM_PENDING_REQUESTS_COUNT) Protocol_Maximum_Pending_Requests_Count = PROTOCOL_MAXIMUM_PENDING_REQUESTS_COUNT;
+	Protocol_Are_Capabilities_Known = 1;
+	return 0;
+}
+
+int ProtocolGetLinkStatistics(TProtocolLinkStatistics *Pointer_Statistics)
+{
+	TProtocolRequest Request;
+	
+	if (ProtocolExecuteCommand(PROTOCOL_COMMAND_GET_LINK_STATISTICS, -1, &Request, 6) != 0) return -1;
+	
+	Pointer_Statistics->Reception_Overruns_Count = (Request.Answer[0] << 8) | Request.Answer[1];
+	Pointer_Statistics->Reception_Dropped_Bytes_Count = (Request.Answer[2] << 8) | Request.Answer[3];
+	Pointer_Statistics->Transmission_Dropped_Bytes_Count = (Request.Answer[4] << 8) | Request.Answer[5];
+	return 0;
+}
+
+int ProtocolGetInterruptProfiles(TProtocolInterruptProfile *Pointer_Profiles)
+{
+	TProtocolRequest Requests[PROTOCOL_INTERRUPT_SOURCES_COUNT];
+	int i;
+	
+	// Get all sources in a single pipelined exchange
+	for (i = 0; i < PROTOCOL_INTERRUPT_SOURCES_COUNT; i++)
+	{
+		Requests[i].Command = PROTOCOL_COMMAND_GET_INTERRUPT_PROFILE;
+		Requests[i].Payload[0] = i;
+		Requests[i].Payload_Size = 1;
+	}
+	if (ProtocolExecuteRequests(Requests, PROTOCOL_INTERRUPT_SOURCES_COUNT) != 0)
+	{
+		Debug("[%s] The robot did not answer.\n", __func__);
+		return -1;
+	}
+	
+	for (i = 0; i < PROTOCOL_INTERRUPT_SOURCES_COUNT; i++)
+	{
+		if ((Requests[i].Status != PROTOCOL_ANSWER_STATUS_SUCCESS) || (Requests[i].Answer_Size != 10))
+		{
+			Debug("[%s] The robot refused the command (status %d, %d answer bytes).\n", __func__, Requests[i].Status, Requests[i].Answer_Size);
+			return -1;
+		}
+		Pointer_Profiles[i].Calls_Count = ((unsigned int) Requests[i].Answer[0] << 24) | (Requests[i].Answer[1] << 16) | (Requests[i].Answer[2] << 8) | Requests[i].Answer[3];
+		Pointer_Profiles[i].Total_Cycles = ((unsigned int) Requests[i].Answer[4] << 24) | (Requests[i].Answer[5] << 16) | (Requests[i].Answer[6] << 8) | Requests[i].Answer[7];
+		Pointer_Profiles[i].Worst_Cycles = (Requests[i].Answer[8] << 8) | Requests[i].Answer[9];
+	}
+	return 0;
+}
+
+const char *ProtocolGetInterruptSourceName(int Source)
+{
+	if ((Source < 0) || (Source >= PROTOCOL_INTERRUPT_SOURCES_COUNT)) return "unknown";
+	return Protocol_String_Interrupt_Source_Names[Source];
+}
+
+float ProtocolGetBatteryVoltage(void)
+{
+	TProtocolRequest Request;
+	int Raw_Voltage;
+	
+	if (ProtocolExecuteCommand(PROTOCOL_COMMAND_GET_BATTERY_VOLTAGE, -1, &Request, 2) != 0) return -1;
+	Raw_Voltage = (Request.Answer[0] << 8) | Request.Answer[1];
+	Debug("[%s] Raw voltage : %d.\n", __func__, Raw_Voltage);
+	
+	// Convert the voltage to volts
+	return (15.f * Raw_Voltage) / 1023.f;
+}
+
+int ProtocolGetDistanceSensorSample(TProtocolDistanceSensorSample *Pointer_Sample)
+{
+	TProtocolRequest Request;
+	
+	if (ProtocolExecuteCommand(PROTOCOL_COMMAND_GET_DISTANCE_SENSOR_VALUE, -1, &Request, PROTOCOL_DISTANCE_SENSOR_SAMPLE_SIZE) != 0) return -1;
+	ProtocolDecodeDistanceSensorSample(Request.Answer, Pointer_Sample);
+	return 0;
+}
+
+float ProtocolGetBootTime(void)
+{
+	TProtocolRequest Request;
+	unsigned int Boot_Time;
+	
+	if (ProtocolExecuteCommand(PROTOCOL_COMMAND_GET_BOOT_TIME, -1, &Request, 4) != 0) return -1;
+	Boot_Time = ((unsigned int) Request.Answer[0] << 24) | (Request.Answer[1] << 16) | (Request.Answer[2] << 8) | Request.Answer[3];
+	Debug("[%s] Boot time : %u us.\n", __func__, Boot_Time);
+	
+	// Convert it to milliseconds
+	return Boot_Time / 1000.f;
+}
+
+int ProtocolStartTelemetry(int Period)
+{
+	TProtocolRequest Request;
+	
+	Protocol_Telemetry_Last_Sequence_Number = -1;
+	return ProtocolExecuteCommand(PROTOCOL_COMMAND_SET_TELEMETRY_PERIOD, Period, &Request, 0);
+}
+
+int ProtocolStopTelemetry(void)
+{
+	TProtocolRequest Request;
+	
+	// The telemetry frames received before the answer are ignored
+	return ProtocolExecuteCommand(PROTOCOL_COMMAND_SET_TELEMETRY_PERIOD, 0, &Request, 0);
+}
+
+int ProtocolReceiveTelemetryFrame(TProtocolTelemetryFrame *Pointer_Frame, int Timeout)
+{
+	TProtocolFrame Frame;
+	unsigned char *Pointer_Payload = Frame.Payload;
+	long long Deadline;
+	
+	// Skip the late answers
+	Deadline = TransportGetCurrentTime() + Timeout;
+	do
+	{
+		if (ProtocolReceiveFrame(&Frame, Deadline) != 0) return 1;
+	} while ((Frame.Command != PROTOCOL_COMMAND_TELEMETRY) || (Frame.Payload_Size != PROTOCOL_TELEMETRY_PAYLOAD_SIZE));
+	
+	// Decode the frame
+	Pointer_Frame->Sequence_Number = Frame.Sequence_Number;
+	Pointer_Frame->Timestamp = ((unsigned int) Pointer_Payload[0] << 24) | (Pointer_Payload[1] << 16) | (Pointer_Payload[2] << 8) | Pointer_Payload[3];
+	Pointer_Frame->Battery_Voltage = (15.f * ((Pointer_Payload[4] << 8) | Pointer_Payload[5])) / 1023.f;
+	Pointer_Frame->Left_Motor_State = Pointer_Payload[6] & 0x0F;
+	Pointer_Frame->Right_Motor_State = Pointer_Payload[6] >> 4;
+	Pointer_Frame->Artificial_Intelligence_State = Pointer_Payload[7];
+	ProtocolDecodeDistanceSensorSample(&Pointer_Payload[8], &Pointer_Frame->Distance_Sensor_Sample);
+	
+	// The robot increments the sequence number even for the frames it could not send
+	if (Protocol_Telemetry_Last_Sequence_Number < 0) Pointer_Frame->Lost_Frames_Count = 0;
+	else Pointer_Frame->Lost_Frames_Count = (Pointer_Frame->Sequence_Number - Protocol_Telemetry_Last_Sequence_Number - 1) & 0xFF;
+	Protocol_Telemetry_Last_Sequence_Number = Pointer_Frame->Sequence_Number;
+	
+	Protocol_Telemetry_Statistics.Received_Frames_Count++;
+	Protocol_Telemetry_Statistics.Lost_Frames_Count += Pointer_Frame->Lost_Frames_Count;
+	return 0;
+}
+
+void ProtocolGetTelemetryStatistics(TProtocolTelemetryStatistics *Pointer_Statistics)
+{
+	*Pointer_Statistics = Protocol_Telemetry_Statistics;
+	Pointer_Statistics->Corrupted_Frames_Count = Protocol_Corrupted_Frames_Count;
+}
+
+const char *ProtocolGetMotorStateName(int State)
+{
+	if ((State < 0) || (State >= (int) (sizeof(Protocol_String_Motor_State_Names) / sizeof(Protocol_String_Motor_State_Names[0])))) return "unknown";
+	return Protocol_String_Motor_State_Names[State];
+}
+
+const char *ProtocolGetArtificialIntelligenceStateName(int State)
+{
+	if ((State < 0) || (State >= (int) (sizeof(Protocol_String_Artificial_Intelligence_State_Names) / sizeof(Protocol_String_Artificial_Intelligence_State_Names[0])))) return "unknown";
+	return Protocol_String_Artificial_Intelligence_State_Names[State];
+}
+
+int ProtocolUpdateFirmware(char *String_Firmware_Hex_File, int Is_Compression_Enabled)
+{
+	static unsigned char Block_Map[CONFIGURATION_TARGET_PROCESSOR_MEMORY_SIZE / PROTOCOL_SEND_BUFFER_SIZE / 8];
+	int Firmware_Size, Blocks_Count, Non_Blank_Blocks_Count;
+	TProtocolTransfer Transfer;
+	struct timeval Start_Time;
+	
+	// Convert the Hex file into something usable
+	Firmware_Size = ProtocolLoadFirmware(String_Firmware_Hex_File);
+	if (Firmware_Size < 0) return 1;
+	
+	ProtocolInitializeTransfer(&Transfer, Is_Compression_Enabled);
+	
+	// Find the blocks that are not blank, only them will be transmitted
+	Blocks_Count = (Firmware_Size + PROTOCOL_SEND_BUFFER_SIZE - 1) / PROTOCOL_SEND_BUFFER_SIZE;
+	Non_Blank_Blocks_Count = ProtocolBuildBlockMap(Firmware_Size, Block_Map);
+	
+	if (ProtocolEnterBootloader() != 0) return 2;
+	if (Is_Compression_Enabled) ProtocolNegotiateBaudRate(1, PROTOCOL_COMPRESSED_TRANSFER_MAXIMUM_BAUD_RATE);
+	else ProtocolNegotiateBaudRate(1, CONFIGURATION_MAXIMUM_BAUD_RATE);
+	
+	// Send the instructions
+	printf("Sending %d non-blank blocks out of %d...\n", Non_Blank_Blocks_Count, Blocks_Count);
+	gettimeofday(&Start_Time, NULL);
+	if (ProtocolUploadBlocks(&Transfer, Firmware_Size, Block_Map) != 0) return 2;
+	
+	// Start the new firmware
+	TransportWriteByte(&Protocol_Transport, PROTOCOL_BOOTLOADER_COMMAND_REBOOT);
+	ProtocolDisplayTransferStatistics(&Transfer, Non_Blank_Blocks_Count * PROTOCOL_SEND_BUFFER_SIZE, &Start_Time);
+	
+	return 0;
+}
+
+int ProtocolUpdateFirmwareChangedBlocks(char *String_Firmware_Hex_File, int Is_Compression_Enabled)
+{
+	static unsigned short Blocks_Indexes[PROTOCOL_FIRMWARE_MAXIMUM_BLOCKS_COUNT];
+	unsigned char Block[PROTOCOL_SEND_BUFFER_SIZE], Byte, Robot_CRC_Low_Byte;
+	unsigned short Robot_CRC;
+	int Firmware_Size, Blocks_Count, Changed_Blocks_Count = 0, Erased_Blocks_Count = 0, Block_Index;
+	TProtocolTransfer Transfer;
+	struct timeval Start_Time;
+	
+	// Convert the Hex file into something usable
+	Firmware_Size = ProtocolLoadFirmware(String_Firmware_Hex_File);
+	if (Firmware_Size < 0) return 1;
+	ProtocolInitializeTransfer(&Transfer, Is_Compression_Enabled);
+	Blocks_Count = (Firmware_Size + PROTOCOL_SEND_BUFFER_SIZE - 1) / PROTOCOL_SEND_BUFFER_SIZE;
+	
+	if (ProtocolEnterBootloader() != 0) return 2;
+	if (Is_Compression_Enabled) ProtocolNegotiateBaudRate(1, PROTOCOL_COMPRESSED_TRANSFER_MAXIMUM_BAUD_RATE);
+	else ProtocolNegotiateBaudRate(1, CONFIGURATION_MAXIMUM_BAUD_RATE);
+	
+	// Retrieve the CRC of all firmware area blocks, so the blocks left by a bigger previous firmware are erased too (the new firmware reads as blank past its end)
+	Debug("[%s] Retrieving the CRC of %d blocks...\n", __func__, PROTOCOL_FIRMWARE_MAXIMUM_BLOCKS_COUNT);
+	TransportWriteByte(&Protocol_Transport, PROTOCOL_BOOTLOADER_COMMAND_GET_BLOCKS_CRC);
+	TransportWriteByte(&Protocol_Transport, 0); // Start from the first block
+	TransportWriteByte(&Protocol_Transport, 0);
+	TransportWriteByte(&Protocol_Transport, PROTOCOL_FIRMWARE_MAXIMUM_BLOCKS_COUNT >> 8);
+	TransportWriteByte(&Protocol_Transport, (unsigned char) PROTOCOL_FIRMWARE_MAXIMUM_BLOCKS_COUNT);
+	
+	// Keep only the blocks that differ from the robot ones
+	for (Block_Index = 0; Block_Index < PROTOCOL_FIRMWARE_MAXIMUM_BLOCKS_COUNT; Block_Index++)
+	{
+		if ((ProtocolReadByteWithTimeout(PROTOCOL_ACKNOWLEDGE_TIMEOUT, &Byte) != 0) || (ProtocolReadByteWithTimeout(PROTOCOL_ACKNOWLEDGE_TIMEOUT, &Robot_CRC_Low_Byte) != 0))
+		{
+			printf("Error : the bootloader did not send the CRC of block %d.\n", Block_Index);
+			return 2;
+		}
+		Robot_CRC = (Byte << 8) | Robot_CRC_Low_Byte;
+		
+		ProtocolReadFirmwareBlock(Block_Index, Block);
+		if (CRCComputeBuffer(Block, PROTOCOL_SEND_BUFFER_SIZE) != Robot_CRC)
+		{
+			Blocks_Indexes[Changed_Blocks_Count] = Block_Index;
+			Changed_Blocks_Count++;
+			if (Block_Index >= Blocks_Count) Erased_Blocks_Count++;
+		}
+	}
+	printf("Sending %d changed blocks out of %d (including %d blocks to erase after the end of the firmware)...\n", Changed_Blocks_Count, Blocks_Count, Erased_Blocks_Count);
+	
+	// Send the changed blocks, each one preceded by its index
+	gettimeofday(&Start_Time, NULL);
+	if (ProtocolWriteBlocks(&Transfer, Blocks_Indexes, Changed_Blocks_Count) != 0) return 2;
+	
+	// Start the new firmware
+	TransportWriteByte(&Protocol_Transport, PROTOCOL_BOOTLOADER_COMMAND_REBOOT);
+	ProtocolDisplayTransferStatistics(&Transfer, Changed_Blocks_Count * PROTOCOL_SEND_BUFFER_SIZE, &Start_Time);
+	
+	return 0;
+}
+
+void ProtocolSetAcknowledgesLatencyRecorder(TLatencyRecorder *Pointer_Recorder)
+{
+	Protocol_Pointer_Acknowledges_Latency_Recorder = Pointer_Recorder;
+}
+
+int ProtocolUpdateFleetFirmware(char *String_Firmware_Hex_File, char *String_Serial_Port_Files[], int Robots_Count)
+{
+	TProtocolFleetRobot *Pointer_Robots, *Pointer_Robot, *Pointer_Polled_Robots[PROTOCOL_FLEET_MAXIMUM_ROBOTS_COUNT];
+	TTransport *Pointer_Polled_Transports[PROTOCOL_FLEET_MAXIMUM_ROBOTS_COUNT];
+	int i, Polled_Robots_Count, Failed_Robots_Count, Non_Blank_Blocks_Count, Result, Transport_Statuses[PROTOCOL_FLEET_MAXIMUM_ROBOTS_COUNT];
+	long long Current_Time, Nearest_Deadline;
+	unsigned char Byte;
+	
+	if (Robots_Count > PROTOCOL_FLEET_MAXIMUM_ROBOTS_COUNT)
+	{
+		printf("Error : no more than %d robots can be updated at once.\n", PROTOCOL_FLEET_MAXIMUM_ROBOTS_COUNT);
+		return 1;
+	}
+	
+	// Parse the firmware only once for all robots
+	Protocol_Fleet_Firmware_Size = ProtocolLoadFirmware(String_Firmware_Hex_File);
+	if (Protocol_Fleet_Firmware_Size < 0) return 1;
+	Protocol_Fleet_Blocks_Count = (Protocol_Fleet_Firmware_Size + PROTOCOL_SEND_BUFFER_SIZE - 1) / PROTOCOL_SEND_BUFFER_SIZE;
+	Non_Blank_Blocks_Count = ProtocolBuildBlockMap(Protocol_Fleet_Firmware_Size, Protocol_Fleet_Block_Map);
+	printf("Sending %d non-blank blocks out of %d to %d robots...\n", Non_Blank_Blocks_Count, Protocol_Fleet_Blocks_Count, Robots_Count);
+	
+	Pointer_Robots = calloc(Robots_Count, sizeof(TProtocolFleetRobot));
+	if (Pointer_Robots == NULL)
+	{
+		printf("Error : not enough memory.\n");
+		return 2;
+	}
+	
+	// Ask all robots to enter the bootloader at the same time
+	for (i = 0; i < Robots_Count; i++)
+	{
+		Pointer_Robot = &Pointer_Robots[i];
+		Pointer_Robot->String_Serial_Port_File = String_Serial_Port_Files[i];
+		ProtocolInitializeTransfer(&Pointer_Robot->Transfer, 0);
+		
+		if (TransportOpen(&Pointer_Robot->Transport, Pointer_Robot->String_Serial_Port_File, PROTOCOL_DEFAULT_BAUD_RATE) != 0)
+		{
+			ProtocolFleetFail(Pointer_Robot, "could not open the serial port");
+			continue;
+		}
+		if (Pointer_Robot->Transport.Type == TRANSPORT_TYPE_UNIX_SOCKET)
+		{
+			ProtocolFleetFail(Pointer_Robot, "the firmware can't be updated through the daemon");
+			continue;
+		}
+		
+		// Reboot a running firmware into the bootloader, and hold the line in break state so a robot turned on now stays in the bootloader (see ProtocolEnterBootloader())
+		ProtocolSendEnterBootloaderRequest(&Pointer_Robot->Transport);
+		TransportSetBreak(&Pointer_Robot->Transport, 1);
+		
+		Pointer_Robot->State = PROTOCOL_FLEET_ROBOT_STATE_WAIT_BOOTLOADER;
+		Pointer_Robot->Bootloader_Deadline = TransportGetCurrentTime() + PROTOCOL_BOOTLOADER_TIMEOUT;
+		Pointer_Robot->Deadline = Pointer_Robot->Bootloader_Deadline;
+	}
+	printf("Waiting for the bootloaders (turn on the robots that are off)...\n");
+	
+	// Drive all robots until they all succeeded or failed
+	while (1)
+	{
+		// Wait for a byte from any robot that is still being updated, or for the nearest deadline
+		Polled_Robots_Count = 0;
+		Nearest_Deadline = 0;
+		for (i = 0; i < Robots_Count; i++)
+		{
+			Pointer_Robot = &Pointer_Robots[i];
+			if ((Pointer_Robot->State == PROTOCOL_FLEET_ROBOT_STATE_SUCCEEDED) || (Pointer_Robot->State == PROTOCOL_FLEET_ROBOT_STATE_FAILED)) continue;
+			
+			Pointer_Polled_Transports[Polled_Robots_Count] = &Pointer_Robot->Transport;
+			Pointer_Polled_Robots[Polled_Robots_Count] = Pointer_Robot;
+			Polled_Robots_Count++;
+			if ((Nearest_Deadline == 0) || (Pointer_Robot->Deadline < Nearest_Deadline)) Nearest_Deadline = Pointer_Robot->Deadline;
+		}
+		if (Polled_Robots_Count == 0) break;
+		
+		// The bytes the state machines gathered during the previous iteration are sent first
+		TransportWaitForBytes(Pointer_Polled_Transports, Polled_Robots_Count, Nearest_Deadline, Transport_Statuses);
+		
+		// Make each robot state machine progress
+		Current_Time = TransportGetCurrentTime();
+		for (i = 0; i < Polled_Robots_Count; i++)
+		{
+			Pointer_Robot = Pointer_Polled_Robots[i];
+			if (Transport_Statuses[i] > 0)
+			{
+				// Process all the received bytes, the robot may stop on the way
+				while ((Pointer_Robot->State != PROTOCOL_FLEET_ROBOT_STATE_SUCCEEDED) && (Pointer_Robot->State != PROTOCOL_FLEET_ROBOT_STATE_FAILED))
+				{
+					Result = TransportReadByte(&Pointer_Robot->Transport, &Byte, 0);
+					if (Result == 0) ProtocolFleetProcessByte(Pointer_Robot, Byte);
+					else
+					{
+						if (Result < 0) ProtocolFleetFail(Pointer_Robot, "the serial port was disconnected");
+						break;
+					}
+				}
+			}
+			else if (Transport_Statuses[i] < 0) ProtocolFleetFail(Pointer_Robot, "the serial port was disconnected");
+			else if (Current_Time >= Pointer_Robot->Deadline) ProtocolFleetProcessTimeout(Pointer_Robot);
+		}
+	}
+	
+	Failed_Robots_Count = ProtocolFleetDisplayResults(Pointer_Robots, Robots_Count);
+	
+	for (i = 0; i < Robots_Count; i++)
+	{
+		TransportClose(&Pointer_Robots[i].Transport);
+	}
+	free(Pointer_Robots);
+	
+	if (Failed_Robots_Count > 0) return 2;
+	return 0;
+}
@@ -1,36 +1,266 @@
-/** @file Protocol.h
- * Communicate with the robot.
- * @author Adrien RICCIARDI
- */
-#ifndef H_PROTOCOL_H
-#define H_PROTOCOL_H
-
-//-------------------------------------------------------------------------------------------------
-// Functions
-//-------------------------------------------------------------------------------------------------
-/** Initialize the protocol communication serial port. The serial port is automatically closed on program exit.
- * @param String_Serial_Port_File The serial port device used to communicate with the robot.
- * @return 0 if the serial port was successfully opened,
- * @return 1 if an error occurred.
- */
-int ProtocolInitialize(char *String_Serial_Port_File);
-
-/** Get the current battery voltage.
- * @return the battery voltage converted to volts.
- */
-float ProtocolGetBatteryVoltage(void);
-
-/** Get the distance between the robot and the nearest object in front of it.
- * @return the distance in centimeters.
- */
-int ProtocolGetSonarDistance(void);
-
-/** Update the robot firmware.
- * @param String_Firmware_Hex_File The Intel Hex file containing the firmware.
- * @return 0 if the firmware was successfully updated,
- * @return 1 if the provided firmware is bad,
- * @return 2 if a communication error occurred.
- */
-int ProtocolUpdateFirmware(char *String_Firmware_Hex_File);
-
+/** @file Protocol.h
+ * Communicate with the robot.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_PROTOCOL_H
+#define H_PROTOCOL_H
+
+#include "Latency.h"
+
+//-------------------------------------------------------------------------------------------------
+// Constants
+//-------------------------------------------------------------------------------------------------
+/** The biggest payload a firmware frame can carry. */
+#define PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE 32
+/** The first byte of every firmware frame. */
+#define PROTOCOL_FRAME_SYNCHRONIZATION_BYTE 0x5A
+/** How many bytes precede a frame payload : synchronization byte, payload size, sequence number and command. */
+#define PROTOCOL_FRAME_HEADER_SIZE 4
+/** How many bytes a frame contains besides its payload (the header and the 16-bit CRC). */
+#define PROTOCOL_FRAME_OVERHEAD_SIZE 6
+
+/** How many interrupt sources the firmware profiles. */
+#define PROTOCOL_INTERRUPT_SOURCES_COUNT 5
+/** The firmware profiler counts the instruction cycles, which last 1/16 microsecond. */
+#define PROTOCOL_INTERRUPT_CYCLES_PER_MICROSECOND 16
+
+//-------------------------------------------------------------------------------------------------
+// Types
+//-------------------------------------------------------------------------------------------------
+/** All commands understood by the firmware (their values are sent to the robot, so do not reorder them). */
+typedef enum
+{
+	PROTOCOL_COMMAND_GET_BATTERY_VOLTAGE,
+	PROTOCOL_COMMAND_GET_DISTANCE_SENSOR_VALUE,
+	PROTOCOL_COMMAND_SET_BAUD_RATE,
+	PROTOCOL_COMMAND_ENTER_BOOTLOADER,
+	PROTOCOL_COMMAND_GET_BOOT_TIME,
+	PROTOCOL_COMMAND_SET_TELEMETRY_PERIOD,
+	PROTOCOL_COMMAND_GET_CAPABILITIES,
+	PROTOCOL_COMMAND_TELEMETRY, //!< Sent by the robot only, without request.
+	PROTOCOL_COMMAND_GET_LINK_STATISTICS,
+	PROTOCOL_COMMAND_GET_INTERRUPT_PROFILE
+} TProtocolCommand;
+
+/** Tell how the firmware executed a request. */
+typedef enum
+{
+	PROTOCOL_ANSWER_STATUS_SUCCESS,
+	PROTOCOL_ANSWER_STATUS_UNKNOWN_COMMAND,
+	PROTOCOL_ANSWER_STATUS_BAD_PAYLOAD_SIZE,
+	PROTOCOL_ANSWER_STATUS_BAD_PARAMETER
+} TProtocolAnswerStatus;
+
+/** A request to send to the firmware and its answer. */
+typedef struct
+{
+	TProtocolCommand Command; //!< The command to execute.
+	unsigned char Payload[PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE]; //!< The command parameters.
+	int Payload_Size; //!< How many parameter bytes to send.
+	int Status; //!< On output, contain the answer status (a TProtocolAnswerStatus value), or -1 if the robot did not answer.
+	unsigned char Answer[PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE]; //!< On output, contain the answer data (the status is not included).
+	int Answer_Size; //!< On output, contain how many answer data bytes were received.
+} TProtocolRequest;
+
+/** What the firmware protocol supports. */
+typedef struct
+{
+	int Protocol_Version; //!< The firmware protocol version.
+	int Maximum_Request_Payload_Size; //!< The biggest request payload the firmware can receive.
+	int Maximum_Pending_Requests_Count; //!< How many requests can be sent without waiting for their answers.
+	unsigned int Supported_Commands_Mask; //!< One bit per supported TProtocolCommand value.
+} TProtocolCapabilities;
+
+/** How many bytes the firmware UART driver lost since the robot started. */
+typedef struct
+{
+	int Reception_Overruns_Count; //!< How many times the UART hardware reception FIFO overflowed.
+	int Reception_Dropped_Bytes_Count; //!< How many received bytes were dropped because the firmware reception buffer was full.
+	int Transmission_Dropped_Bytes_Count; //!< How many bytes were not sent because the firmware transmission buffer was full.
+} TProtocolLinkStatistics;
+
+/** How much processing time an interrupt handler consumed since the robot started. */
+typedef struct
+{
+	unsigned int Calls_Count; //!< How many times the handler was executed.
+	unsigned int Total_Cycles; //!< How many instruction cycles all executions lasted (it wraps around after 268s of interrupt handling).
+	unsigned int Worst_Cycles; //!< The longest execution, in instruction cycles.
+} TProtocolInterruptProfile;
+
+/** A distance measure, as the firmware filtered and timestamped it. */
+typedef struct
+{
+	int Filtered_Distance; //!< The median of the last 3 measured distances to the nearest object, in centimeters.
+	int Raw_Distance; //!< The last measured distance to the nearest object, in centimeters.
+	unsigned int Timestamp; //!< When the measure ended, in milliseconds since the firmware started.
+	int Sequence_Number; //!< The measure number, it wraps around after 255.
+	int Is_Valid; //!< 0 if the firmware does not trust the measure (less than 3 measures done, or the next measure got no echo), 1 otherwise.
+} TProtocolDistanceSensorSample;
+
+/** A snapshot of the robot state, periodically sent by the firmware once telemetry is started. */
+typedef struct
+{
+	int Sequence_Number; //!< The frame number, it wraps around after 255.
+	unsigned int Timestamp; //!< When the frame was built, in milliseconds since the firmware started.
+	TProtocolDistanceSensorSample Distance_Sensor_Sample; //!< The last distance measure.
+	float Battery_Voltage; //!< The last sampled battery voltage, in volts.
+	int Left_Motor_State; //!< The left motor state (0 = stopped, 1 = forward, 2 = backward).
+	int Right_Motor_State; //!< The right motor state (0 = stopped, 1 = forward, 2 = backward).
+	int Artificial_Intelligence_State; //!< What the artificial intelligence is doing (see ProtocolGetArtificialIntelligenceStateName()).
+	int Lost_Frames_Count; //!< How many frames were lost between the previous received frame and this one.
+} TProtocolTelemetryFrame;
+
+/** Telemetry reception statistics. */
+typedef struct
+{
+	int Received_Frames_Count; //!< How many valid frames were received.
+	int Lost_Frames_Count; //!< How many frames were skipped by the robot or lost on the line.
+	int Corrupted_Frames_Count; //!< How many frames were discarded because of a bad CRC.
+} TProtocolTelemetryStatistics;
+
+//-------------------------------------------------------------------------------------------------
+// Functions
+//-------------------------------------------------------------------------------------------------
+/** Initialize the protocol communication serial port. The serial port is automatically closed on program exit.
+ * @param String_Serial_Port_File The serial port device used to communicate with the robot.
+ * @return 0 if the serial port was successfully opened,
+ * @return 1 if an error occurred.
+ */
+int ProtocolInitialize(char *String_Serial_Port_File);
+
+/** Build a firmware frame.
+ * @param Sequence_Number The frame sequence number.
+ * @param Command The frame command.
+ * @param Pointer_Payload The frame payload.
+ * @param Payload_Size How many payload bytes to send.
+ * @param Pointer_Frame On output, contain the frame. It must be at least PROTOCOL_FRAME_OVERHEAD_SIZE bytes bigger than the payload.
+ * @return The frame size in bytes.
+ */
+int ProtocolBuildFrame(unsigned char Sequence_Number, unsigned char Command, const unsigned char *Pointer_Payload, int Payload_Size, unsigned char *Pointer_Frame);
+
+/** Send requests to the firmware and wait for their answers. The requests are pipelined, and a request is sent again if its answer is lost or corrupted.
+ * @param Pointer_Requests The requests to execute. On output, they contain the answers.
+ * @param Requests_Count How many requests to execute.
+ * @return 0 if all requests were answered (whatever their answer status is),
+ * @return -1 if at least one request was not answered.
+ */
+int ProtocolExecuteRequests(TProtocolRequest *Pointer_Requests, int Requests_Count);
+
+/** Ask the firmware what its protocol supports. This also tells ProtocolExecuteRequests() how many requests it can pipeline.
+ * @param Pointer_Capabilities On output, contain the firmware capabilities.
+ * @return 0 on success,
+ * @return -1 if the robot did not answer.
+ */
+int ProtocolGetCapabilities(TProtocolCapabilities *Pointer_Capabilities);
+
+/** Get the firmware UART driver error counters (the firmware supports it if the PROTOCOL_COMMAND_GET_LINK_STATISTICS bit is set in the supported commands mask).
+ * @param Pointer_Statistics On output, contain the counters.
+ * @return 0 on success,
+ * @return -1 if the robot did not answer or does not support the command.
+ */
+int ProtocolGetLinkStatistics(TProtocolLinkStatistics *Pointer_Statistics);
+
+/** Get the firmware interrupt handlers execution statistics (the firmware supports it if the PROTOCOL_COMMAND_GET_INTERRUPT_PROFILE bit is set in the supported commands mask).
+ * @param Pointer_Profiles On output, contain the statistics of each of the PROTOCOL_INTERRUPT_SOURCES_COUNT interrupt sources.
+ * @return 0 on success,
+ * @return -1 if the robot did not answer or does not support the command.
+ */
+int ProtocolGetInterruptProfiles(TProtocolInterruptProfile *Pointer_Profiles);
+
+/** Convert an interrupt source index to a human-readable name.
+ * @param Source The interrupt source, from 0 to PROTOCOL_INTERRUPT_SOURCES_COUNT - 1.
+ * @return A static string.
+ */
+const char *ProtocolGetInterruptSourceName(int Source);
+
+/** Get the current battery voltage.
+ * @return the battery voltage converted to volts,
+ * @return -1 if the robot did not answer.
+ */
+float ProtocolGetBatteryVoltage(void);
+
+/** Get the last measure of the distance between the robot and the nearest object in front of it.
+ * @param Pointer_Sample On output, contain the measure.
+ * @return 0 on success,
+ * @return -1 if the robot did not answer.
+ */
+int ProtocolGetDistanceSensorSample(TProtocolDistanceSensorSample *Pointer_Sample);
+
+/** Get the time the robot needed to start the artificial intelligence after being reset.
+ * @return The boot time in milliseconds (0 if the robot is not ready yet),
+ * @return -1 if the robot did not answer.
+ */
+float ProtocolGetBootTime(void);
+
+/** Make the robot periodically send telemetry frames, until ProtocolStopTelemetry() is called.
+ * @param Period How often to send a frame, in units of 100ms (from 1 to 255, the distance sensor is sampled every 100ms).
+ * @return 0 on success,
+ * @return -1 if the robot did not answer.
+ */
+int ProtocolStartTelemetry(int Period);
+
+/** Stop the telemetry frames, the ones received before the robot acknowledged the request are discarded.
+ * @return 0 on success,
+ * @return -1 if the robot did not answer.
+ */
+int ProtocolStopTelemetry(void);
+
+/** Wait for the next valid telemetry frame. The corrupted frames are discarded.
+ * @param Pointer_Frame On output, contain the decoded frame.
+ * @param Timeout How many milliseconds to wait for the frame.
+ * @return 0 if a frame was received,
+ * @return 1 if no frame was received in time.
+ */
+int ProtocolReceiveTelemetryFrame(TProtocolTelemetryFrame *Pointer_Frame, int Timeout);
+
+/** Get the telemetry reception statistics since the program started.
+ * @param Pointer_Statistics On output, contain the statistics.
+ */
+void ProtocolGetTelemetryStatistics(TProtocolTelemetryStatistics *Pointer_Statistics);
+
+/** Convert a motor state reported by the telemetry to a human-readable name.
+ * @param State The motor state.
+ * @return A static string.
+ */
+const char *ProtocolGetMotorStateName(int State);
+
+/** Convert an artificial intelligence state reported by the telemetry to a human-readable name.
+ * @param State The artificial intelligence state.
+ * @return A static string.
+ */
+const char *ProtocolGetArtificialIntelligenceStateName(int State);
+
+/** Update the robot firmware.
+ * @param String_Firmware_Hex_File The Intel Hex file containing the firmware.
+ * @param Is_Compression_Enabled Set to 1 to transmit the blocks compressed (the bootloader decompresses them on the fly), set to 0 to transmit them raw.
+ * @return 0 if the firmware was successfully updated,
+ * @return 1 if the provided firmware is bad,
+ * @return 2 if a communication error occurred.
+ */
+int ProtocolUpdateFirmware(char *String_Firmware_Hex_File, int Is_Compression_Enabled);
+
+/** Update only the robot firmware blocks that differ from the provided firmware. The robot flash content is checked using a CRC per block, so only the changed blocks are transmitted.
+ * @param String_Firmware_Hex_File The Intel Hex file containing the firmware.
+ * @param Is_Compression_Enabled Set to 1 to transmit the blocks compressed, set to 0 to transmit them raw.
+ * @return 0 if the firmware was successfully updated,
+ * @return 1 if the provided firmware is bad,
+ * @return 2 if a communication error occurred.
+ */
+int ProtocolUpdateFirmwareChangedBlocks(char *String_Firmware_Hex_File, int Is_Compression_Enabled);
+
+/** Record how long each block acknowledge takes during the next firmware updates (see ProtocolUpdateFirmware() and ProtocolUpdateFirmwareChangedBlocks()). The delay is measured from the moment the whole window containing the block has been handed to the serial port, so it includes the window transmission time and the bootloader flash writing time.
+ * @param Pointer_Recorder Where to record the delays, NULL to stop recording them.
+ */
+void ProtocolSetAcknowledgesLatencyRecorder(TLatencyRecorder *Pointer_Recorder);
+
+/** Update several robots at the same time with the same firmware. Each robot has its own serial port and is driven by its own state machine, so a slow or failing robot does not delay the other ones. The progress of each robot is displayed, followed by a table summarizing all updates.
+ * @param String_Firmware_Hex_File The Intel Hex file containing the firmware.
+ * @param String_Serial_Port_Files The serial port devices the robots are connected to.
+ * @param Robots_Count How many robots to update.
+ * @return 0 if all robots were successfully updated,
+ * @return 1 if the provided firmware is bad,
+ * @return 2 if at least one robot could not be updated.
+ */
+int ProtocolUpdateFleetFirmware(char *String_Firmware_Hex_File, char *String_Serial_Port_Files[], int Robots_Count);
+
 #endif
\ No newline at end of file
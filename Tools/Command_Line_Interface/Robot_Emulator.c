@@ -0,0 +1,1395 @@
+/** @file Robot_Emulator.c
+ * Emulate a robot behind a pseudo-terminal, so the command line interface can be tested and benchmarked on any Linux computer without hardware.
+ * Both the firmware and the bootloader serial protocols are implemented. The flash programming times and the serial line speed are modeled, and faults (dropped bytes, line noise, delayed answers) can be injected.
+ * Give the pseudo-terminal path displayed on the first line to the command line interface as its serial port.
+ * @author Adrien RICCIARDI
+ */
+#define _GNU_SOURCE // Needed by posix_openpt() and cfmakeraw()
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "CRC.h"
+
+//-------------------------------------------------------------------------------------------------
+// Private constants
+//-------------------------------------------------------------------------------------------------
+/** The bootloader protocol magic number. */
+#define EMULATOR_PROTOCOL_MAGIC_NUMBER 0xA5
+/** The bootloader protocol version, sent after the magic number with the firmware base address. */
+#define EMULATOR_BOOTLOADER_PROTOCOL_VERSION 2
+/** The first byte of every firmware frame. */
+#define EMULATOR_PROTOCOL_FRAME_SYNCHRONIZATION_BYTE 0x5A
+/** How many bytes precede a frame payload : synchronization byte, payload size, sequence number and command. */
+#define EMULATOR_PROTOCOL_FRAME_HEADER_SIZE 4
+/** How many bytes a frame contains besides its payload (the header and the 16-bit CRC). */
+#define EMULATOR_PROTOCOL_FRAME_OVERHEAD_SIZE 6
+/** The biggest payload a firmware request can carry. */
+#define EMULATOR_PROTOCOL_REQUEST_MAXIMUM_PAYLOAD_SIZE 4
+/** The biggest payload a firmware frame sent to the PC can carry (it is a telemetry frame). */
+#define EMULATOR_PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE 18
+/** The firmware protocol version. */
+#define EMULATOR_PROTOCOL_VERSION 3
+/** How many requests the PC can send without waiting for their answers. */
+#define EMULATOR_PROTOCOL_MAXIMUM_PENDING_REQUESTS_COUNT 6
+/** The commands the firmware supports (one bit per TEmulatorFirmwareCommand value). */
+#define EMULATOR_PROTOCOL_SUPPORTED_COMMANDS_MASK 0x037F
+/** The bootloader acknowledges that it has received and flashed a block. */
+#define EMULATOR_PROTOCOL_ACKNOWLEDGE_BLOCK_WRITTEN 0x42
+/** The bootloader acknowledges that it has received a block which was already present in the flash memory. */
+#define EMULATOR_PROTOCOL_ACKNOWLEDGE_BLOCK_SKIPPED 0x43
+/** The bootloader received a corrupted block, or did not receive the whole block in time. */
+#define EMULATOR_PROTOCOL_ACKNOWLEDGE_BLOCK_CORRUPTED 0x44
+/** The blocks are transmitted compressed. */
+#define EMULATOR_PROTOCOL_BLOCKS_FLAG_COMPRESSED 0x01
+/** Each block is followed by the CRC of its 16-bit index and of its data. */
+#define EMULATOR_PROTOCOL_BLOCKS_FLAG_CRC 0x02
+/** The first byte of the frame sent by the PC to check that the new baud rate works. */
+#define EMULATOR_PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE 0x55
+/** The second byte of the frame sent by the PC to check that the new baud rate works. */
+#define EMULATOR_PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE 0xAA
+/** How many blocks the PC can send before waiting for an acknowledge. */
+#define EMULATOR_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT 8
+
+/** The microcontroller flash size in bytes. */
+#define EMULATOR_FLASH_SIZE 65536
+/** A flash block size in bytes. */
+#define EMULATOR_FLASH_BLOCK_SIZE 64
+/** The firmware base address. */
+#define EMULATOR_FIRMWARE_BASE_ADDRESS 0x800
+/** How many flash blocks are available to the firmware. */
+#define EMULATOR_FIRMWARE_BLOCKS_COUNT ((EMULATOR_FLASH_SIZE - EMULATOR_FIRMWARE_BASE_ADDRESS) / EMULATOR_FLASH_BLOCK_SIZE)
+
+/** How many milliseconds the bootloader waits for a byte before considering that the PC stopped transmitting (4 timer 5 overflows). */
+#define EMULATOR_BOOTLOADER_RECEPTION_TIMEOUT 131
+/** How many milliseconds the bootloader waits for the PC to answer the handshake code before starting the firmware (16 timer 5 overflows). */
+#define EMULATOR_BOOTLOADER_HANDSHAKE_TIMEOUT 524
+/** How many milliseconds the bootloader waits for each baud rate probe byte. */
+#define EMULATOR_BOOTLOADER_BAUD_RATE_PROBE_TIMEOUT 200
+/** How many milliseconds the firmware waits for the baud rate probe. */
+#define EMULATOR_FIRMWARE_BAUD_RATE_PROBE_TIMEOUT 300
+/** How many milliseconds the microcontroller needs to reboot. */
+#define EMULATOR_REBOOT_TIME 10
+
+/** The default flash block erase time in microseconds (PIC18F26K22 datasheet typical self-timed write cycle). */
+#define EMULATOR_DEFAULT_FLASH_ERASE_TIME 2000
+/** The default flash block write time in microseconds. */
+#define EMULATOR_DEFAULT_FLASH_WRITE_TIME 2000
+/** The default boot time reported by the firmware, in microseconds. */
+#define EMULATOR_DEFAULT_BOOT_TIME 1500
+/** The default maximum duration of an injected delay, in milliseconds. */
+#define EMULATOR_DEFAULT_MAXIMUM_DELAY 200
+/** An encoded distance sensor sample size in bytes. */
+#define EMULATOR_DISTANCE_SENSOR_SAMPLE_SIZE 10
+/** The telemetry frame payload size in bytes. */
+#define EMULATOR_TELEMETRY_PAYLOAD_SIZE (8 + EMULATOR_DISTANCE_SENSOR_SAMPLE_SIZE)
+/** How many milliseconds elapse between two firmware distance measures (the firmware waits 60ms after an echo before triggering the next measure). */
+#define EMULATOR_DISTANCE_SENSOR_SAMPLING_PERIOD 60
+
+/** How many interrupt sources the firmware profiles. */
+#define EMULATOR_INTERRUPT_SOURCES_COUNT 5
+/** How many instruction cycles the firmware low priority interrupt handler spends selecting the handlers to call. */
+#define EMULATOR_INTERRUPT_DISPATCH_CYCLES 40
+
+/** How many values can be scripted for each sensor. */
+#define EMULATOR_MAXIMUM_SCRIPTED_VALUES_COUNT 256
+/** How many bytes can be read from the pseudo-terminal at once. */
+#define EMULATOR_RECEPTION_BUFFER_SIZE 4096
+
+//-------------------------------------------------------------------------------------------------
+// Private types
+//-------------------------------------------------------------------------------------------------
+/** All commands understood by the firmware. */
+typedef enum
+{
+	EMULATOR_FIRMWARE_COMMAND_GET_BATTERY_VOLTAGE,
+	EMULATOR_FIRMWARE_COMMAND_GET_DISTANCE_SENSOR_VALUE,
+	EMULATOR_FIRMWARE_COMMAND_SET_BAUD_RATE,
+	EMULATOR_FIRMWARE_COMMAND_ENTER_BOOTLOADER,
+	EMULATOR_FIRMWARE_COMMAND_GET_BOOT_TIME,
+	EMULATOR_FIRMWARE_COMMAND_SET_TELEMETRY_PERIOD,
+	EMULATOR_FIRMWARE_COMMAND_GET_CAPABILITIES,
+	EMULATOR_FIRMWARE_COMMAND_TELEMETRY,
+	EMULATOR_FIRMWARE_COMMAND_GET_LINK_STATISTICS,
+	EMULATOR_FIRMWARE_COMMAND_GET_INTERRUPT_PROFILE
+} TEmulatorFirmwareCommand;
+
+/** The first payload byte of every firmware answer. */
+typedef enum
+{
+	EMULATOR_FIRMWARE_ANSWER_STATUS_SUCCESS,
+	EMULATOR_FIRMWARE_ANSWER_STATUS_UNKNOWN_COMMAND,
+	EMULATOR_FIRMWARE_ANSWER_STATUS_BAD_PAYLOAD_SIZE,
+	EMULATOR_FIRMWARE_ANSWER_STATUS_BAD_PARAMETER
+} TEmulatorFirmwareAnswerStatus;
+
+/** All commands understood by the bootloader once it is in programming mode. */
+typedef enum
+{
+	EMULATOR_BOOTLOADER_COMMAND_UPLOAD_FIRMWARE,
+	EMULATOR_BOOTLOADER_COMMAND_GET_BLOCKS_CRC,
+	EMULATOR_BOOTLOADER_COMMAND_WRITE_BLOCKS,
+	EMULATOR_BOOTLOADER_COMMAND_REBOOT,
+	EMULATOR_BOOTLOADER_COMMAND_SET_BAUD_RATE
+} TEmulatorBootloaderCommand;
+
+/** Values returned by a sensor, either scripted or random. */
+typedef struct
+{
+	float Values[EMULATOR_MAXIMUM_SCRIPTED_VALUES_COUNT]; //!< The scripted values, returned in a loop.
+	int Values_Count; //!< How many values are scripted, 0 to return random values.
+	int Next_Value_Index; //!< The next scripted value to return.
+	float Minimum_Random_Value; //!< The lowest random value.
+	float Maximum_Random_Value; //!< The highest random value.
+} TEmulatorSensor;
+
+/** Everything that happened since the emulator started. */
+typedef struct
+{
+	unsigned long Received_Bytes_Count;
+	unsigned long Transmitted_Bytes_Count;
+	unsigned long Dropped_Bytes_Count;
+	unsigned long Corrupted_Bytes_Count;
+	unsigned long Delayed_Transmissions_Count;
+	unsigned long Firmware_Commands_Count;
+	unsigned long Written_Blocks_Count;
+	unsigned long Skipped_Blocks_Count;
+	unsigned long Erased_Blocks_Count;
+	unsigned long Refused_Blocks_Count;
+} TEmulatorStatistics;
+
+//-------------------------------------------------------------------------------------------------
+// Private variables
+//-------------------------------------------------------------------------------------------------
+/** The baud rates the robot supports, in the same order as the robot UART. */
+static unsigned int Emulator_Baud_Rates[] = {115200, 230400, 460800, 500000, 1000000};
+/** The termios speeds matching the supported baud rates. */
+static speed_t Emulator_Termios_Speeds[] = {B115200, B230400, B460800, B500000, B1000000};
+/** The current robot baud rate. */
+static int Emulator_Baud_Rate_Index = 0;
+
+/** The pseudo-terminal master side, the emulator talks through it. */
+static int Emulator_Master_ID;
+/** The pseudo-terminal slave side, it is kept opened so the master side stays usable when the command line interface closes it, and so the baud rate the command line interface uses can be checked. */
+static int Emulator_Slave_ID;
+
+/** The microcontroller flash content. */
+static unsigned char Emulator_Flash[EMULATOR_FLASH_SIZE];
+/** The file the flash content is loaded from and saved to when the bootloader reboots (can be NULL). */
+static char *Emulator_String_Flash_File = NULL;
+
+/** Set when the bytes must not be delivered faster than the current baud rate allows. */
+static int Emulator_Is_Line_Speed_Emulated = 0;
+/** How many microseconds a flash block erase lasts. */
+static int Emulator_Flash_Erase_Time = EMULATOR_DEFAULT_FLASH_ERASE_TIME;
+/** How many microseconds a flash block write lasts. */
+static int Emulator_Flash_Write_Time = EMULATOR_DEFAULT_FLASH_WRITE_TIME;
+
+/** The probability for each byte, in both directions, to be lost. */
+static double Emulator_Drop_Probability = 0;
+/** The probability for each byte, in both directions, to get a bit flipped. */
+static double Emulator_Noise_Probability = 0;
+/** The probability for each transmission to be delayed. */
+static double Emulator_Delay_Probability = 0;
+/** The longest injected delay in milliseconds. */
+static int Emulator_Maximum_Delay = EMULATOR_DEFAULT_MAXIMUM_DELAY;
+
+/** The battery voltage in volts. */
+static TEmulatorSensor Emulator_Battery_Voltage_Sensor = {{0}, 0, 0, 6.f, 8.4f};
+/** The distance to the nearest object in centimeters. */
+static TEmulatorSensor Emulator_Distance_Sensor = {{0}, 0, 0, 2.f, 400.f};
+/** The boot time the firmware reports, in microseconds. */
+static unsigned int Emulator_Boot_Time = EMULATOR_DEFAULT_BOOT_TIME;
+
+/** How often each profiled firmware interrupt handler runs (in calls per second, the UART one is driven by the exchanged bytes instead) and how many instruction cycles it lasts, in the same order as the firmware sources. The first source is the whole interrupt handler, it is computed from the other ones. */
+static const struct
+{
+	int Frequency;
+	int Cycles;
+	int Worst_Cycles;
+} Emulator_Interrupt_Sources[EMULATOR_INTERRUPT_SOURCES_COUNT] = {{0, 0, 0}, {0, 45, 70}, {150, 60, 110}, {10, 20, 20}, {30, 90, 310}};
+
+/** The received bytes that have not been processed yet. */
+static unsigned char Emulator_Reception_Buffer[EMULATOR_RECEPTION_BUFFER_SIZE];
+/** When each received byte has been fully transmitted on the emulated line (in microseconds). */
+static long long Emulator_Reception_Buffer_Arrival_Times[EMULATOR_RECEPTION_BUFFER_SIZE];
+/** How many bytes the reception buffer contains. */
+static int Emulator_Reception_Buffer_Bytes_Count = 0;
+/** The next byte to process. */
+static int Emulator_Reception_Buffer_Index = 0;
+/** When the last received byte has been fully transmitted on the emulated line (in microseconds). */
+static long long Emulator_Reception_Line_Time = 0;
+/** When the last transmitted byte will be fully transmitted on the emulated line (in microseconds). */
+static long long Emulator_Transmission_Line_Time = 0;
+/** Set when a byte was received at another baud rate than the robot one, the robot UART would have reported a framing error. */
+static int Emulator_Is_Framing_Error_Detected = 0;
+
+/** Set when the PC stopped transmitting in the middle of a bootloader command or sent a malformed compressed block, all following receptions immediately fail until the next command. */
+static int Emulator_Is_Reception_Timed_Out;
+/** How the blocks of the bootloader command being executed are transmitted. */
+static unsigned char Emulator_Blocks_Flags;
+/** Tell which firmware blocks are sent by the PC. */
+static unsigned char Emulator_Block_Map[(EMULATOR_FIRMWARE_BLOCKS_COUNT + 7) / 8];
+/** Hold all blocks of a window until they are flashed. */
+static unsigned char Emulator_Window_Buffer[EMULATOR_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT * EMULATOR_FLASH_BLOCK_SIZE];
+/** The index of each block stored in the window buffer. */
+static unsigned short Emulator_Window_Blocks_Indexes[EMULATOR_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT];
+/** The CRC transmitted with each block stored in the window buffer. */
+static unsigned short Emulator_Window_Blocks_CRC[EMULATOR_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT];
+
+/** Everything that happened since the emulator started. */
+static TEmulatorStatistics Emulator_Statistics;
+/** Set by the signal handler when the user wants to stop the emulator. */
+static volatile sig_atomic_t Emulator_Is_Exit_Requested = 0;
+
+//-------------------------------------------------------------------------------------------------
+// Private functions
+//-------------------------------------------------------------------------------------------------
+/** Get a monotonic time reference.
+ * @return The current time in microseconds.
+ */
+static long long EmulatorGetCurrentTime(void)
+{
+	struct timespec Time;
+	
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return (long long) Time.tv_sec * 1000000 + Time.tv_nsec / 1000;
+}
+
+/** Sleep until a specific time.
+ * @param Time The time to wake up at, in microseconds.
+ */
+static void EmulatorWaitUntil(long long Time)
+{
+	long long Remaining_Time;
+	
+	Remaining_Time = Time - EmulatorGetCurrentTime();
+	if (Remaining_Time > 0) usleep(Remaining_Time);
+}
+
+/** Tell whether a random event happens.
+ * @param Probability The event probability, from 0 to 1.
+ * @return 1 if the event happens, 0 otherwise.
+ */
+static int EmulatorIsEventHappening(double Probability)
+{
+	if (Probability <= 0) return 0;
+	return (rand() / (RAND_MAX + 1.)) < Probability;
+}
+
+/** Get how long a byte lasts on the line at the current baud rate (one start bit, 8 data bits, one stop bit).
+ * @return The byte duration in microseconds.
+ */
+static long long EmulatorGetByteTime(void)
+{
+	if (!Emulator_Is_Line_Speed_Emulated) return 0;
+	return 10000000LL / Emulator_Baud_Rates[Emulator_Baud_Rate_Index];
+}
+
+/** Tell whether the command line interface uses the same baud rate as the robot.
+ * @return 1 if the baud rates are different, 0 if they match.
+ */
+static int EmulatorIsBaudRateMismatched(void)
+{
+	struct termios Parameters;
+	
+	if (tcgetattr(Emulator_Slave_ID, &Parameters) != 0) return 0;
+	return cfgetospeed(&Parameters) != Emulator_Termios_Speeds[Emulator_Baud_Rate_Index];
+}
+
+/** Display what happened since the emulator started. */
+static void EmulatorDisplayStatistics(void)
+{
+	printf("Statistics : %lu bytes received, %lu bytes transmitted, %lu bytes dropped, %lu bytes corrupted, %lu transmissions delayed, %lu firmware commands, %lu blocks written, %lu skipped, %lu erased, %lu refused.\n", Emulator_Statistics.Received_Bytes_Count,
+		Emulator_Statistics.Transmitted_Bytes_Count, Emulator_Statistics.Dropped_Bytes_Count, Emulator_Statistics.Corrupted_Bytes_Count, Emulator_Statistics.Delayed_Transmissions_Count, Emulator_Statistics.Firmware_Commands_Count, Emulator_Statistics.Written_Blocks_Count,
+		Emulator_Statistics.Skipped_Blocks_Count, Emulator_Statistics.Erased_Blocks_Count, Emulator_Statistics.Refused_Blocks_Count);
+}
+
+/** Stop the emulator when the user asks for it.
+ * @param Signal_Number The received signal.
+ */
+static void EmulatorSignalHandler(int __attribute__((unused)) Signal_Number)
+{
+	Emulator_Is_Exit_Requested = 1;
+}
+
+/** Exit if the user asked for it, displaying the statistics first. */
+static void EmulatorExitIfRequested(void)
+{
+	if (!Emulator_Is_Exit_Requested) return;
+	
+	EmulatorDisplayStatistics();
+	exit(EXIT_SUCCESS);
+}
+
+/** Wait for a byte during a limited amount of time. The line faults are injected here, and the byte is not delivered before it would have been fully received on a real line.
+ * @param Timeout How many milliseconds to wait for the byte, -1 to wait forever.
+ * @param Pointer_Byte On output, contain the received byte.
+ * @return 0 if a byte was received,
+ * @return 1 if no byte was received in time.
+ */
+static int EmulatorReceiveByte(int Timeout, unsigned char *Pointer_Byte)
+{
+	struct pollfd Poll_File_Descriptor;
+	unsigned char Buffer[EMULATOR_RECEPTION_BUFFER_SIZE], Byte;
+	long long Deadline = 0, Current_Time;
+	int i, Read_Bytes_Count, Remaining_Time = -1, Is_Baud_Rate_Mismatched;
+	
+	if (Timeout >= 0) Deadline = EmulatorGetCurrentTime() + Timeout * 1000LL;
+	
+	while (Emulator_Reception_Buffer_Index >= Emulator_Reception_Buffer_Bytes_Count)
+	{
+		// Wait for some data
+		if (Timeout >= 0)
+		{
+			Remaining_Time = (Deadline - EmulatorGetCurrentTime() + 999) / 1000;
+			if (Remaining_Time <= 0) return 1;
+		}
+		Poll_File_Descriptor.fd = Emulator_Master_ID;
+		Poll_File_Descriptor.events = POLLIN;
+		if (poll(&Poll_File_Descriptor, 1, Remaining_Time) <= 0)
+		{
+			EmulatorExitIfRequested();
+			continue;
+		}
+		
+		Read_Bytes_Count = read(Emulator_Master_ID, Buffer, sizeof(Buffer));
+		if (Read_Bytes_Count <= 0)
+		{
+			// The slave side is kept opened, so this should not happen, avoid spinning anyway
+			if ((Read_Bytes_Count < 0) && (errno != EINTR) && (errno != EAGAIN)) usleep(1000);
+			continue;
+		}
+		
+		// Inject the line faults and compute when each byte would have been received (the bytes follow each other on the line)
+		Current_Time = EmulatorGetCurrentTime();
+		if (Emulator_Reception_Line_Time < Current_Time) Emulator_Reception_Line_Time = Current_Time;
+		Is_Baud_Rate_Mismatched = EmulatorIsBaudRateMismatched();
+		Emulator_Reception_Buffer_Bytes_Count = 0;
+		Emulator_Reception_Buffer_Index = 0;
+		for (i = 0; i < Read_Bytes_Count; i++)
+		{
+			Emulator_Statistics.Received_Bytes_Count++;
+			Emulator_Reception_Line_Time += EmulatorGetByteTime();
+			Byte = Buffer[i];
+			
+			if (EmulatorIsEventHappening(Emulator_Drop_Probability))
+			{
+				Emulator_Statistics.Dropped_Bytes_Count++;
+				continue;
+			}
+			
+			// A byte sent at another baud rate is garbage, the UART reports a framing error
+			if (Is_Baud_Rate_Mismatched)
+			{
+				Byte = rand();
+				Emulator_Is_Framing_Error_Detected = 1;
+				Emulator_Statistics.Corrupted_Bytes_Count++;
+			}
+			else if (EmulatorIsEventHappening(Emulator_Noise_Probability))
+			{
+				Byte ^= 1 << (rand() % 8);
+				Emulator_Statistics.Corrupted_Bytes_Count++;
+			}
+			
+			Emulator_Reception_Buffer[Emulator_Reception_Buffer_Bytes_Count] = Byte;
+			Emulator_Reception_Buffer_Arrival_Times[Emulator_Reception_Buffer_Bytes_Count] = Emulator_Reception_Line_Time;
+			Emulator_Reception_Buffer_Bytes_Count++;
+		}
+	}
+	
+	EmulatorWaitUntil(Emulator_Reception_Buffer_Arrival_Times[Emulator_Reception_Buffer_Index]);
+	*Pointer_Byte = Emulator_Reception_Buffer[Emulator_Reception_Buffer_Index];
+	Emulator_Reception_Buffer_Index++;
+	return 0;
+}
+
+/** Discard all received bytes that have not been processed yet, like the robot UART does when it changes its baud rate. */
+static void EmulatorFlushReceivedBytes(void)
+{
+	Emulator_Reception_Buffer_Index = Emulator_Reception_Buffer_Bytes_Count;
+	tcflush(Emulator_Master_ID, TCIFLUSH);
+	Emulator_Is_Framing_Error_Detected = 0;
+}
+
+/** Send data to the PC. The line faults are injected here, and the function returns when the data would have been fully transmitted on a real line.
+ * @param Pointer_Buffer The data to send.
+ * @param Size How many bytes to send.
+ */
+static void EmulatorWriteBuffer(unsigned char *Pointer_Buffer, int Size)
+{
+	unsigned char Buffer[EMULATOR_RECEPTION_BUFFER_SIZE];
+	int i, Bytes_To_Send_Count = 0, Is_Baud_Rate_Mismatched;
+	long long Current_Time;
+	
+	// Make the robot answer late
+	if (EmulatorIsEventHappening(Emulator_Delay_Probability))
+	{
+		Emulator_Statistics.Delayed_Transmissions_Count++;
+		usleep((rand() % (Emulator_Maximum_Delay + 1)) * 1000);
+	}
+	
+	Is_Baud_Rate_Mismatched = EmulatorIsBaudRateMismatched();
+	for (i = 0; i < Size; i++)
+	{
+		Emulator_Statistics.Transmitted_Bytes_Count++;
+		if (EmulatorIsEventHappening(Emulator_Drop_Probability))
+		{
+			Emulator_Statistics.Dropped_Bytes_Count++;
+			continue;
+		}
+		
+		Buffer[Bytes_To_Send_Count] = Pointer_Buffer[i];
+		if (Is_Baud_Rate_Mismatched)
+		{
+			Buffer[Bytes_To_Send_Count] = rand();
+			Emulator_Statistics.Corrupted_Bytes_Count++;
+		}
+		else if (EmulatorIsEventHappening(Emulator_Noise_Probability))
+		{
+			Buffer[Bytes_To_Send_Count] ^= 1 << (rand() % 8);
+			Emulator_Statistics.Corrupted_Bytes_Count++;
+		}
+		Bytes_To_Send_Count++;
+	}
+	
+	// The bytes follow the ones that are still being transmitted
+	Current_Time = EmulatorGetCurrentTime();
+	if (Emulator_Transmission_Line_Time < Current_Time) Emulator_Transmission_Line_Time = Current_Time;
+	Emulator_Transmission_Line_Time += Size * EmulatorGetByteTime();
+	EmulatorWaitUntil(Emulator_Transmission_Line_Time);
+	
+	if ((Bytes_To_Send_Count > 0) && (write(Emulator_Master_ID, Buffer, Bytes_To_Send_Count) != Bytes_To_Send_Count)) printf("Warning : could not transmit %d bytes.\n", Bytes_To_Send_Count);
+}
+
+/** Send a single byte to the PC.
+ * @param Byte The byte to send.
+ */
+static void EmulatorWriteByte(unsigned char Byte)
+{
+	EmulatorWriteBuffer(&Byte, 1);
+}
+
+/** Send a 16-bit value most significant byte first.
+ * @param Word The value to send.
+ */
+static void EmulatorWriteWord(unsigned short Word)
+{
+	unsigned char Buffer[2];
+	
+	Buffer[0] = Word >> 8;
+	Buffer[1] = (unsigned char) Word;
+	EmulatorWriteBuffer(Buffer, sizeof(Buffer));
+}
+
+/** Change the robot baud rate once the bytes being transmitted have been fully sent. The bytes received meanwhile are discarded.
+ * @param Baud_Rate_Index The new baud rate index.
+ */
+static void EmulatorSetBaudRate(int Baud_Rate_Index)
+{
+	EmulatorWaitUntil(Emulator_Transmission_Line_Time);
+	EmulatorFlushReceivedBytes();
+	
+	if (Baud_Rate_Index == Emulator_Baud_Rate_Index) return;
+	Emulator_Baud_Rate_Index = Baud_Rate_Index;
+	printf("Baud rate set to %u bit/s.\n", Emulator_Baud_Rates[Baud_Rate_Index]);
+}
+
+/** Get the next value of a sensor.
+ * @param Pointer_Sensor The sensor.
+ * @return The scripted value, or a random one if no value is scripted.
+ */
+static float EmulatorGetSensorValue(TEmulatorSensor *Pointer_Sensor)
+{
+	float Value;
+	
+	if (Pointer_Sensor->Values_Count == 0) return Pointer_Sensor->Minimum_Random_Value + (Pointer_Sensor->Maximum_Random_Value - Pointer_Sensor->Minimum_Random_Value) * (rand() / (float) RAND_MAX);
+	
+	Value = Pointer_Sensor->Values[Pointer_Sensor->Next_Value_Index];
+	Pointer_Sensor->Next_Value_Index = (Pointer_Sensor->Next_Value_Index + 1) % Pointer_Sensor->Values_Count;
+	return Value;
+}
+
+/** Parse the values a sensor must return.
+ * @param Pointer_Sensor The sensor.
+ * @param String_Values Comma-separated values, or "random" to generate random values.
+ * @return 0 if the values are valid,
+ * @return 1 if a value is not a number.
+ */
+static int EmulatorParseSensorValues(TEmulatorSensor *Pointer_Sensor, char *String_Values)
+{
+	char *String_Value, *Pointer_End;
+	
+	Pointer_Sensor->Values_Count = 0;
+	Pointer_Sensor->Next_Value_Index = 0;
+	if (strcmp(String_Values, "random") == 0) return 0;
+	
+	String_Value = strtok(String_Values, ",");
+	while ((String_Value != NULL) && (Pointer_Sensor->Values_Count < EMULATOR_MAXIMUM_SCRIPTED_VALUES_COUNT))
+	{
+		Pointer_Sensor->Values[Pointer_Sensor->Values_Count] = strtof(String_Value, &Pointer_End);
+		if ((Pointer_End == String_Value) || (*Pointer_End != 0)) return 1;
+		Pointer_Sensor->Values_Count++;
+		String_Value = strtok(NULL, ",");
+	}
+	return 0;
+}
+
+/** Load the flash content from the flash file, if any. The flash is left erased if the file does not exist yet. */
+static void EmulatorLoadFlash(void)
+{
+	FILE *File;
+	size_t Read_Bytes_Count;
+	
+	memset(Emulator_Flash, 0xFF, sizeof(Emulator_Flash));
+	if (Emulator_String_Flash_File == NULL) return;
+	
+	File = fopen(Emulator_String_Flash_File, "rb");
+	if (File == NULL) return;
+	Read_Bytes_Count = fread(Emulator_Flash, 1, sizeof(Emulator_Flash), File);
+	fclose(File);
+	printf("Loaded %lu flash bytes from '%s'.\n", (unsigned long) Read_Bytes_Count, Emulator_String_Flash_File);
+}
+
+/** Save the flash content to the flash file, if any. */
+static void EmulatorSaveFlash(void)
+{
+	FILE *File;
+	
+	if (Emulator_String_Flash_File == NULL) return;
+	
+	File = fopen(Emulator_String_Flash_File, "wb");
+	if ((File == NULL) || (fwrite(Emulator_Flash, 1, sizeof(Emulator_Flash), File) != sizeof(Emulator_Flash))) printf("Error : could not save the flash content to '%s'.\n", Emulator_String_Flash_File);
+	if (File != NULL) fclose(File);
+}
+
+/** Wait for a bootloader command byte, giving up if the PC stops transmitting.
+ * @return The received byte, or 0xFF if the PC stopped transmitting (in this case Emulator_Is_Reception_Timed_Out is set).
+ */
+static unsigned char EmulatorBootloaderReceiveByte(void)
+{
+	unsigned char Byte;
+	
+	if (Emulator_Is_Reception_Timed_Out) return 0xFF;
+	
+	if (EmulatorReceiveByte(EMULATOR_BOOTLOADER_RECEPTION_TIMEOUT, &Byte) != 0)
+	{
+		Emulator_Is_Reception_Timed_Out = 1;
+		return 0xFF;
+	}
+	return Byte;
+}
+
+/** Receive a 16-bit value transmitted most significant byte first.
+ * @return The received value.
+ */
+static unsigned short EmulatorBootloaderReceiveWord(void)
+{
+	unsigned short Word;
+	
+	Word = EmulatorBootloaderReceiveByte() << 8;
+	Word |= EmulatorBootloaderReceiveByte();
+	return Word;
+}
+
+/** Discard all received bytes until the PC stops transmitting. */
+static void EmulatorBootloaderDiscardReceivedBytes(void)
+{
+	Emulator_Is_Reception_Timed_Out = 0;
+	while (!Emulator_Is_Reception_Timed_Out) EmulatorBootloaderReceiveByte();
+}
+
+/** Receive a block, decompressing it if needed, and its CRC if any (see the bootloader MainReceiveBlock()). A malformed compressed block aborts the reception like a timeout does.
+ * @param Pointer_Block On output, contain the block data.
+ * @param Pointer_CRC On output, contain the transmitted CRC.
+ */
+static void EmulatorBootloaderReceiveBlock(unsigned char *Pointer_Block, unsigned short *Pointer_CRC)
+{
+	unsigned char Token, Byte, Distance;
+	int i = 0, Count;
+	
+	if (Emulator_Blocks_Flags & EMULATOR_PROTOCOL_BLOCKS_FLAG_COMPRESSED)
+	{
+		while (i < EMULATOR_FLASH_BLOCK_SIZE)
+		{
+			Token = EmulatorBootloaderReceiveByte();
+			
+			// Back-reference
+			if (Token & 0x80)
+			{
+				Count = (Token & 0x7F) + 1;
+				Distance = EmulatorBootloaderReceiveByte();
+				if ((Distance == 0) || (Distance > i) || (Count > EMULATOR_FLASH_BLOCK_SIZE - i))
+				{
+					Emulator_Is_Reception_Timed_Out = 1;
+					return;
+				}
+				for (; Count > 0; Count--, i++) Pointer_Block[i] = Pointer_Block[i - Distance];
+			}
+			// Repeated byte
+			else if (Token & 0x40)
+			{
+				Count = (Token & 0x3F) + 1;
+				Byte = EmulatorBootloaderReceiveByte();
+				if (Count > EMULATOR_FLASH_BLOCK_SIZE - i)
+				{
+					Emulator_Is_Reception_Timed_Out = 1;
+					return;
+				}
+				for (; Count > 0; Count--, i++) Pointer_Block[i] = Byte;
+			}
+			// Literal bytes
+			else
+			{
+				Count = Token + 1;
+				if (Count > EMULATOR_FLASH_BLOCK_SIZE - i)
+				{
+					Emulator_Is_Reception_Timed_Out = 1;
+					return;
+				}
+				for (; Count > 0; Count--, i++) Pointer_Block[i] = EmulatorBootloaderReceiveByte();
+			}
+		}
+	}
+	else
+	{
+		for (i = 0; i < EMULATOR_FLASH_BLOCK_SIZE; i++) Pointer_Block[i] = EmulatorBootloaderReceiveByte();
+	}
+	
+	if (Emulator_Blocks_Flags & EMULATOR_PROTOCOL_BLOCKS_FLAG_CRC) *Pointer_CRC = EmulatorBootloaderReceiveWord();
+}
+
+/** Check a received block against its transmitted CRC.
+ * @param Block_Index The block index relative to the firmware base address.
+ * @param Pointer_Block The block data.
+ * @param CRC The transmitted CRC.
+ * @return 0 if the block is corrupted,
+ * @return 1 if the block is valid or if no CRC is transmitted.
+ */
+static int EmulatorBootloaderIsBlockValid(unsigned short Block_Index, unsigned char *Pointer_Block, unsigned short CRC)
+{
+	unsigned short Computed_CRC;
+	int i;
+	
+	if (!(Emulator_Blocks_Flags & EMULATOR_PROTOCOL_BLOCKS_FLAG_CRC)) return 1;
+	
+	Computed_CRC = CRCUpdate(CRC_INITIAL_VALUE, Block_Index >> 8);
+	Computed_CRC = CRCUpdate(Computed_CRC, (unsigned char) Block_Index);
+	for (i = 0; i < EMULATOR_FLASH_BLOCK_SIZE; i++) Computed_CRC = CRCUpdate(Computed_CRC, Pointer_Block[i]);
+	
+	return Computed_CRC == CRC;
+}
+
+/** Refuse a corrupted block.
+ * @return Always 1, so the caller can remember that the window is corrupted.
+ */
+static int EmulatorBootloaderRefuseBlock(void)
+{
+	EmulatorWriteByte(EMULATOR_PROTOCOL_ACKNOWLEDGE_BLOCK_CORRUPTED);
+	Emulator_Statistics.Refused_Blocks_Count++;
+	return 1;
+}
+
+/** Write a received block only if the flash does not contain the same data yet, spending the time the real flash would need, then acknowledge it.
+ * @param Block_Index The block index relative to the firmware base address.
+ * @param Pointer_Block The block data.
+ */
+static void EmulatorBootloaderProgramBlock(unsigned short Block_Index, unsigned char *Pointer_Block)
+{
+	unsigned char *Pointer_Flash_Block;
+	
+	Pointer_Flash_Block = &Emulator_Flash[EMULATOR_FIRMWARE_BASE_ADDRESS + Block_Index * EMULATOR_FLASH_BLOCK_SIZE];
+	if (memcmp(Pointer_Flash_Block, Pointer_Block, EMULATOR_FLASH_BLOCK_SIZE) == 0)
+	{
+		EmulatorWriteByte(EMULATOR_PROTOCOL_ACKNOWLEDGE_BLOCK_SKIPPED);
+		Emulator_Statistics.Skipped_Blocks_Count++;
+		return;
+	}
+	
+	usleep(Emulator_Flash_Erase_Time + Emulator_Flash_Write_Time);
+	memcpy(Pointer_Flash_Block, Pointer_Block, EMULATOR_FLASH_BLOCK_SIZE);
+	EmulatorWriteByte(EMULATOR_PROTOCOL_ACKNOWLEDGE_BLOCK_WRITTEN);
+	Emulator_Statistics.Written_Blocks_Count++;
+}
+
+/** Erase a blank block located between two transmitted blocks, if it is not erased yet.
+ * @param Block_Index The block index relative to the firmware base address.
+ */
+static void EmulatorBootloaderEraseBlock(unsigned short Block_Index)
+{
+	unsigned char *Pointer_Flash_Block;
+	int i;
+	
+	Pointer_Flash_Block = &Emulator_Flash[EMULATOR_FIRMWARE_BASE_ADDRESS + Block_Index * EMULATOR_FLASH_BLOCK_SIZE];
+	for (i = 0; i < EMULATOR_FLASH_BLOCK_SIZE; i++)
+	{
+		if (Pointer_Flash_Block[i] != 0xFF)
+		{
+			usleep(Emulator_Flash_Erase_Time);
+			memset(Pointer_Flash_Block, 0xFF, EMULATOR_FLASH_BLOCK_SIZE);
+			Emulator_Statistics.Erased_Blocks_Count++;
+			return;
+		}
+	}
+}
+
+/** Handle the UPLOAD_FIRMWARE command, like the bootloader MainUploadFirmware() does. */
+static void EmulatorBootloaderUploadFirmware(void)
+{
+	unsigned short Blocks_Count, Block_Index, Window_First_Block_Index;
+	int i, Window_Blocks_Count, Received_Blocks_Count, Is_Window_Corrupted;
+	
+	Blocks_Count = (EmulatorBootloaderReceiveWord() + EMULATOR_FLASH_BLOCK_SIZE - 1) / EMULATOR_FLASH_BLOCK_SIZE;
+	Block_Index = EmulatorBootloaderReceiveWord();
+	if ((Blocks_Count > EMULATOR_FIRMWARE_BLOCKS_COUNT) || (Block_Index > Blocks_Count))
+	{
+		EmulatorBootloaderDiscardReceivedBytes();
+		return;
+	}
+	Window_Blocks_Count = EmulatorBootloaderReceiveByte();
+	if ((Window_Blocks_Count == 0) || (Window_Blocks_Count > EMULATOR_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT)) Window_Blocks_Count = EMULATOR_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT;
+	Emulator_Blocks_Flags = EmulatorBootloaderReceiveByte();
+	for (i = 0; i < (Blocks_Count + 7) / 8; i++) Emulator_Block_Map[i] = EmulatorBootloaderReceiveByte();
+	if (Emulator_Is_Reception_Timed_Out) return;
+	
+	while (Block_Index < Blocks_Count)
+	{
+		// Receive a whole window
+		Window_First_Block_Index = Block_Index;
+		Received_Blocks_Count = 0;
+		while ((Received_Blocks_Count < Window_Blocks_Count) && (Block_Index < Blocks_Count))
+		{
+			if (Emulator_Block_Map[Block_Index / 8] & (1 << (Block_Index % 8)))
+			{
+				EmulatorBootloaderReceiveBlock(&Emulator_Window_Buffer[Received_Blocks_Count * EMULATOR_FLASH_BLOCK_SIZE], &Emulator_Window_Blocks_CRC[Received_Blocks_Count]);
+				Received_Blocks_Count++;
+			}
+			Block_Index++;
+		}
+		
+		// Flash the valid blocks and erase the blank ones located between them
+		Received_Blocks_Count = 0;
+		Is_Window_Corrupted = 0;
+		for (; Window_First_Block_Index < Block_Index; Window_First_Block_Index++)
+		{
+			if (Emulator_Block_Map[Window_First_Block_Index / 8] & (1 << (Window_First_Block_Index % 8)))
+			{
+				if (Emulator_Is_Reception_Timed_Out || !EmulatorBootloaderIsBlockValid(Window_First_Block_Index, &Emulator_Window_Buffer[Received_Blocks_Count * EMULATOR_FLASH_BLOCK_SIZE], Emulator_Window_Blocks_CRC[Received_Blocks_Count])) Is_Window_Corrupted = EmulatorBootloaderRefuseBlock();
+				else EmulatorBootloaderProgramBlock(Window_First_Block_Index, &Emulator_Window_Buffer[Received_Blocks_Count * EMULATOR_FLASH_BLOCK_SIZE]);
+				Received_Blocks_Count++;
+			}
+			else EmulatorBootloaderEraseBlock(Window_First_Block_Index);
+		}
+		
+		// Let the PC retransmit the corrupted blocks
+		if (Is_Window_Corrupted)
+		{
+			EmulatorBootloaderDiscardReceivedBytes();
+			return;
+		}
+	}
+}
+
+/** Handle the GET_BLOCKS_CRC command. */
+static void EmulatorBootloaderSendBlocksCRC(void)
+{
+	unsigned short Block_Index, Blocks_Count, CRC;
+	int i;
+	
+	Block_Index = EmulatorBootloaderReceiveWord();
+	Blocks_Count = EmulatorBootloaderReceiveWord();
+	if (Emulator_Is_Reception_Timed_Out) return;
+	
+	for (; Blocks_Count > 0; Blocks_Count--, Block_Index++)
+	{
+		// The blocks located outside of the firmware area are reported as blank
+		CRC = CRC_INITIAL_VALUE;
+		for (i = 0; i < EMULATOR_FLASH_BLOCK_SIZE; i++) CRC = CRCUpdate(CRC, Block_Index < EMULATOR_FIRMWARE_BLOCKS_COUNT ? Emulator_Flash[EMULATOR_FIRMWARE_BASE_ADDRESS + Block_Index * EMULATOR_FLASH_BLOCK_SIZE + i] : 0xFF);
+		EmulatorWriteWord(CRC);
+	}
+}
+
+/** Handle the WRITE_BLOCKS command, like the bootloader MainWriteBlocks() does. */
+static void EmulatorBootloaderWriteBlocks(void)
+{
+	unsigned short Blocks_Count, Block_Index;
+	int i, Window_Blocks_Count, Is_Window_Corrupted;
+	
+	Blocks_Count = EmulatorBootloaderReceiveWord();
+	Emulator_Blocks_Flags = EmulatorBootloaderReceiveByte();
+	if (Emulator_Is_Reception_Timed_Out) return;
+	
+	while (Blocks_Count > 0)
+	{
+		// Receive a whole window, each block is preceded by its index
+		if (Blocks_Count >= EMULATOR_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT) Window_Blocks_Count = EMULATOR_PROTOCOL_WINDOW_MAXIMUM_BLOCKS_COUNT;
+		else Window_Blocks_Count = Blocks_Count;
+		for (i = 0; i < Window_Blocks_Count; i++)
+		{
+			Emulator_Window_Blocks_Indexes[i] = EmulatorBootloaderReceiveWord();
+			EmulatorBootloaderReceiveBlock(&Emulator_Window_Buffer[i * EMULATOR_FLASH_BLOCK_SIZE], &Emulator_Window_Blocks_CRC[i]);
+		}
+		
+		// Flash the valid blocks, never writing outside of the firmware area
+		Is_Window_Corrupted = 0;
+		for (i = 0; i < Window_Blocks_Count; i++)
+		{
+			Block_Index = Emulator_Window_Blocks_Indexes[i];
+			if (Emulator_Is_Reception_Timed_Out || !EmulatorBootloaderIsBlockValid(Block_Index, &Emulator_Window_Buffer[i * EMULATOR_FLASH_BLOCK_SIZE], Emulator_Window_Blocks_CRC[i])) Is_Window_Corrupted = EmulatorBootloaderRefuseBlock();
+			else if (Block_Index < EMULATOR_FIRMWARE_BLOCKS_COUNT) EmulatorBootloaderProgramBlock(Block_Index, &Emulator_Window_Buffer[i * EMULATOR_FLASH_BLOCK_SIZE]);
+			else EmulatorWriteByte(EMULATOR_PROTOCOL_ACKNOWLEDGE_BLOCK_SKIPPED);
+		}
+		
+		if (Is_Window_Corrupted)
+		{
+			EmulatorBootloaderDiscardReceivedBytes();
+			return;
+		}
+		Blocks_Count -= Window_Blocks_Count;
+	}
+}
+
+/** Switch to the baud rate accepted by a SET_BAUD_RATE command of either the bootloader or the firmware, and check that the link works.
+ * @param Baud_Rate_Index The requested baud rate index, it must be valid.
+ * @param Probe_Timeout How many milliseconds to wait for each probe byte.
+ */
+static void EmulatorNegotiateBaudRate(unsigned char Baud_Rate_Index, int Probe_Timeout)
+{
+	unsigned char Byte;
+	
+	EmulatorSetBaudRate(Baud_Rate_Index);
+	
+	// Echo the PC probe if it is correctly received at the new baud rate
+	if ((EmulatorReceiveByte(Probe_Timeout, &Byte) == 0) && (Byte == EMULATOR_PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE) && (EmulatorReceiveByte(Probe_Timeout, &Byte) == 0) && (Byte == EMULATOR_PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE))
+	{
+		EmulatorWriteByte(EMULATOR_PROTOCOL_BAUD_RATE_PROBE_FIRST_BYTE);
+		EmulatorWriteByte(EMULATOR_PROTOCOL_BAUD_RATE_PROBE_SECOND_BYTE);
+		return;
+	}
+	
+	// The link does not work at this baud rate
+	EmulatorSetBaudRate(0);
+}
+
+/** Run the bootloader programming mode until the PC asks to reboot. */
+static void EmulatorRunBootloader(void)
+{
+	unsigned char Byte;
+	long long Deadline, Remaining_Time;
+	
+	usleep(EMULATOR_REBOOT_TIME * 1000);
+	EmulatorSetBaudRate(0);
+	printf("Bootloader started, waiting for the PC...\n");
+	
+	// Send the handshake code and the bootloader identification, then wait for the PC to answer
+	EmulatorWriteByte(EMULATOR_PROTOCOL_MAGIC_NUMBER);
+	EmulatorWriteByte(EMULATOR_BOOTLOADER_PROTOCOL_VERSION);
+	EmulatorWriteByte(EMULATOR_FIRMWARE_BASE_ADDRESS >> 8);
+	EmulatorWriteByte((unsigned char) EMULATOR_FIRMWARE_BASE_ADDRESS);
+	Deadline = EmulatorGetCurrentTime() + EMULATOR_BOOTLOADER_HANDSHAKE_TIMEOUT * 1000LL;
+	do
+	{
+		// Start the firmware if no PC answers
+		Remaining_Time = (Deadline - EmulatorGetCurrentTime()) / 1000;
+		if ((Remaining_Time <= 0) || (EmulatorReceiveByte(Remaining_Time, &Byte) != 0))
+		{
+			printf("The PC did not answer, starting the firmware.\n");
+			return;
+		}
+	} while (Byte != EMULATOR_PROTOCOL_MAGIC_NUMBER);
+	printf("Programming mode entered.\n");
+	
+	while (1)
+	{
+		Emulator_Is_Reception_Timed_Out = 0;
+		EmulatorReceiveByte(-1, &Byte);
+		switch (Byte)
+		{
+			case EMULATOR_BOOTLOADER_COMMAND_UPLOAD_FIRMWARE:
+				EmulatorBootloaderUploadFirmware();
+				break;
+			
+			case EMULATOR_BOOTLOADER_COMMAND_GET_BLOCKS_CRC:
+				EmulatorBootloaderSendBlocksCRC();
+				break;
+			
+			case EMULATOR_BOOTLOADER_COMMAND_WRITE_BLOCKS:
+				EmulatorBootloaderWriteBlocks();
+				break;
+			
+			case EMULATOR_BOOTLOADER_COMMAND_SET_BAUD_RATE:
+				EmulatorReceiveByte(-1, &Byte);
+				if (Byte >= sizeof(Emulator_Baud_Rates) / sizeof(Emulator_Baud_Rates[0]))
+				{
+					EmulatorWriteByte(0);
+					break;
+				}
+				EmulatorWriteByte(EMULATOR_PROTOCOL_MAGIC_NUMBER);
+				EmulatorNegotiateBaudRate(Byte, EMULATOR_BOOTLOADER_BAUD_RATE_PROBE_TIMEOUT);
+				break;
+			
+			case EMULATOR_BOOTLOADER_COMMAND_REBOOT:
+				EmulatorSaveFlash();
+				printf("Rebooting.\n");
+				EmulatorDisplayStatistics();
+				return;
+			
+			// Unknown command, do nothing
+			default:
+				break;
+		}
+	}
+}
+
+/** Send a firmware frame.
+ * @param Sequence_Number The frame sequence number.
+ * @param Command The frame command.
+ * @param Pointer_Payload The frame payload.
+ * @param Payload_Size How many payload bytes to send.
+ */
+static void EmulatorFirmwareSendFrame(unsigned char Sequence_Number, unsigned char Command, unsigned char *Pointer_Payload, int Payload_Size)
+{
+	unsigned char Frame[EMULATOR_PROTOCOL_FRAME_OVERHEAD_SIZE + EMULATOR_PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE];
+	unsigned short CRC;
+	
+	Frame[0] = EMULATOR_PROTOCOL_FRAME_SYNCHRONIZATION_BYTE;
+	Frame[1] = Payload_Size;
+	Frame[2] = Sequence_Number;
+	Frame[3] = Command;
+	memcpy(&Frame[EMULATOR_PROTOCOL_FRAME_HEADER_SIZE], Pointer_Payload, Payload_Size);
+	CRC = CRCComputeBuffer(&Frame[1], EMULATOR_PROTOCOL_FRAME_HEADER_SIZE - 1 + Payload_Size);
+	Frame[EMULATOR_PROTOCOL_FRAME_HEADER_SIZE + Payload_Size] = CRC >> 8;
+	Frame[EMULATOR_PROTOCOL_FRAME_HEADER_SIZE + Payload_Size + 1] = (unsigned char) CRC;
+	
+	EmulatorWriteBuffer(Frame, EMULATOR_PROTOCOL_FRAME_OVERHEAD_SIZE + Payload_Size);
+}
+
+/** Receive the end of a firmware request frame, its synchronization byte being already received (see the firmware UARTInterruptHandler()).
+ * @param Pointer_Sequence_Number On output, contain the request sequence number.
+ * @param Pointer_Command On output, contain the request command.
+ * @param Pointer_Payload On output, contain the request payload.
+ * @param Pointer_Payload_Size On output, contain the request payload size.
+ * @return 0 if a valid request was received,
+ * @return 1 if the request was corrupted, it must be silently discarded.
+ */
+static int EmulatorFirmwareReceiveRequest(unsigned char *Pointer_Sequence_Number, unsigned char *Pointer_Command, unsigned char *Pointer_Payload, int *Pointer_Payload_Size)
+{
+	unsigned char Header[EMULATOR_PROTOCOL_FRAME_HEADER_SIZE - 1], CRC_Bytes[2];
+	unsigned short CRC;
+	int i;
+	
+	// A too big payload can only come from a corrupted frame
+	EmulatorReceiveByte(-1, &Header[0]);
+	if (Header[0] > EMULATOR_PROTOCOL_REQUEST_MAXIMUM_PAYLOAD_SIZE) return 1;
+	EmulatorReceiveByte(-1, &Header[1]);
+	EmulatorReceiveByte(-1, &Header[2]);
+	for (i = 0; i < Header[0]; i++) EmulatorReceiveByte(-1, &Pointer_Payload[i]);
+	EmulatorReceiveByte(-1, &CRC_Bytes[0]);
+	EmulatorReceiveByte(-1, &CRC_Bytes[1]);
+	
+	CRC = CRCComputeBuffer(Header, sizeof(Header));
+	for (i = 0; i < Header[0]; i++) CRC = CRCUpdate(CRC, Pointer_Payload[i]);
+	if ((CRC_Bytes[0] != (CRC >> 8)) || (CRC_Bytes[1] != (unsigned char) CRC)) return 1;
+	
+	*Pointer_Payload_Size = Header[0];
+	*Pointer_Sequence_Number = Header[1];
+	*Pointer_Command = Header[2];
+	return 0;
+}
+
+/** Encode the last distance sensor sample like the firmware does. The emulated sensor returns no spurious echo, so the filtered distance is the raw one.
+ * @param Start_Time When the firmware started, in microseconds.
+ * @param Pointer_Buffer On output, contain the filtered distance, the raw distance, the timestamp, the sequence number and the validity flag (EMULATOR_DISTANCE_SENSOR_SAMPLE_SIZE bytes).
+ */
+static void EmulatorEncodeDistanceSensorSample(long long Start_Time, unsigned char *Pointer_Buffer)
+{
+	unsigned int Measures_Count, Distance, Timestamp;
+	
+	// The sample is zeroed until the first measure terminates
+	Measures_Count = (EmulatorGetCurrentTime() - Start_Time) / (EMULATOR_DISTANCE_SENSOR_SAMPLING_PERIOD * 1000LL);
+	if (Measures_Count == 0)
+	{
+		memset(Pointer_Buffer, 0, EMULATOR_DISTANCE_SENSOR_SAMPLE_SIZE);
+		return;
+	}
+	
+	// The sensor returns the echo duration in microseconds, sound needs 58us to travel 1 cm back and forth
+	Distance = EmulatorGetSensorValue(&Emulator_Distance_Sensor) * 58.f + 0.5f;
+	if (Distance > 0xFFFF) Distance = 0xFFFF;
+	Timestamp = Measures_Count * EMULATOR_DISTANCE_SENSOR_SAMPLING_PERIOD;
+	
+	Pointer_Buffer[0] = Distance >> 8;
+	Pointer_Buffer[1] = (unsigned char) Distance;
+	Pointer_Buffer[2] = Distance >> 8;
+	Pointer_Buffer[3] = (unsigned char) Distance;
+	Pointer_Buffer[4] = Timestamp >> 24;
+	Pointer_Buffer[5] = Timestamp >> 16;
+	Pointer_Buffer[6] = Timestamp >> 8;
+	Pointer_Buffer[7] = (unsigned char) Timestamp;
+	Pointer_Buffer[8] = (unsigned char) (Measures_Count - 1);
+	Pointer_Buffer[9] = Measures_Count >= 3; // The firmware filter needs 3 measures
+}
+
+/** Send a telemetry frame like the firmware does. The motors are reported stopped and the artificial intelligence still starting, as none of them is emulated.
+ * @param Sequence_Number The frame sequence number.
+ * @param Start_Time When the firmware started, in microseconds.
+ */
+static void EmulatorSendTelemetryFrame(unsigned char Sequence_Number, long long Start_Time)
+{
+	unsigned char Payload[EMULATOR_TELEMETRY_PAYLOAD_SIZE];
+	unsigned int Uptime, Battery_Voltage;
+	
+	Uptime = (EmulatorGetCurrentTime() - Start_Time) / 1000;
+	Battery_Voltage = EmulatorGetSensorValue(&Emulator_Battery_Voltage_Sensor) * 1023.f / 15.f + 0.5f;
+	if (Battery_Voltage > 1023) Battery_Voltage = 1023;
+	
+	Payload[0] = Uptime >> 24;
+	Payload[1] = Uptime >> 16;
+	Payload[2] = Uptime >> 8;
+	Payload[3] = (unsigned char) Uptime;
+	Payload[4] = Battery_Voltage >> 8;
+	Payload[5] = (unsigned char) Battery_Voltage;
+	Payload[6] = 0; // Both motors are stopped
+	Payload[7] = 0; // The artificial intelligence is starting
+	EmulatorEncodeDistanceSensorSample(Start_Time, &Payload[8]);
+	
+	EmulatorFirmwareSendFrame(Sequence_Number, EMULATOR_FIRMWARE_COMMAND_TELEMETRY, Payload, sizeof(Payload));
+}
+
+/** Synthesize the firmware interrupt profile from the emulated activity.
+ * @param Source The interrupt source (it must be valid).
+ * @param Start_Time When the firmware started, in microseconds.
+ * @param Pointer_Answer On output, contain the calls count, the total cycles and the worst cycles as the firmware encodes them (10 bytes).
+ */
+static void EmulatorGetInterruptProfile(int Source, long long Start_Time, unsigned char *Pointer_Answer)
+{
+	unsigned int Calls_Count = 0, Total_Cycles = 0, Worst_Cycles = 0, Source_Calls_Count;
+	long long Elapsed_Time;
+	int i, First_Source, Last_Source;
+	
+	// The whole handler runs once per handled source and adds its own dispatching cost
+	if (Source == 0)
+	{
+		First_Source = 1;
+		Last_Source = EMULATOR_INTERRUPT_SOURCES_COUNT - 1;
+	}
+	else First_Source = Last_Source = Source;
+	
+	Elapsed_Time = EmulatorGetCurrentTime() - Start_Time;
+	for (i = First_Source; i <= Last_Source; i++)
+	{
+		if (i == 1) Source_Calls_Count = Emulator_Statistics.Received_Bytes_Count + Emulator_Statistics.Transmitted_Bytes_Count;
+		else Source_Calls_Count = Emulator_Interrupt_Sources[i].Frequency * Elapsed_Time / 1000000;
+		Calls_Count += Source_Calls_Count;
+		Total_Cycles += Source_Calls_Count * Emulator_Interrupt_Sources[i].Cycles;
+		if (Emulator_Interrupt_Sources[i].Worst_Cycles > (int) Worst_Cycles) Worst_Cycles = Emulator_Interrupt_Sources[i].Worst_Cycles;
+	}
+	if (Source == 0)
+	{
+		Total_Cycles += Calls_Count * EMULATOR_INTERRUPT_DISPATCH_CYCLES;
+		Worst_Cycles += EMULATOR_INTERRUPT_DISPATCH_CYCLES;
+	}
+	
+	Pointer_Answer[0] = Calls_Count >> 24;
+	Pointer_Answer[1] = Calls_Count >> 16;
+	Pointer_Answer[2] = Calls_Count >> 8;
+	Pointer_Answer[3] = (unsigned char) Calls_Count;
+	Pointer_Answer[4] = Total_Cycles >> 24;
+	Pointer_Answer[5] = Total_Cycles >> 16;
+	Pointer_Answer[6] = Total_Cycles >> 8;
+	Pointer_Answer[7] = (unsigned char) Total_Cycles;
+	Pointer_Answer[8] = Worst_Cycles >> 8;
+	Pointer_Answer[9] = (unsigned char) Worst_Cycles;
+}
+
+/** Run the firmware until the PC asks to enter the bootloader. */
+static void EmulatorRunFirmware(void)
+{
+	unsigned char Byte, Sequence_Number, Command, Payload[EMULATOR_PROTOCOL_REQUEST_MAXIMUM_PAYLOAD_SIZE], Answer[EMULATOR_PROTOCOL_FRAME_MAXIMUM_PAYLOAD_SIZE], Telemetry_Sequence_Number = 0;
+	unsigned int Value, Telemetry_Period = 0;
+	long long Start_Time, Telemetry_Deadline = 0;
+	int Timeout, Payload_Size, Expected_Payload_Size, Answer_Size;
+	
+	usleep(EMULATOR_REBOOT_TIME * 1000);
+	EmulatorSetBaudRate(0);
+	Start_Time = EmulatorGetCurrentTime();
+	printf("Firmware started.\n");
+	
+	while (1)
+	{
+		// Wait for the beginning of a frame, sending the telemetry frames in the meantime
+		if (Telemetry_Period == 0) Timeout = -1;
+		else
+		{
+			Timeout = (Telemetry_Deadline - EmulatorGetCurrentTime() + 999) / 1000;
+			if (Timeout < 0) Timeout = 0;
+		}
+		if (EmulatorReceiveByte(Timeout, &Byte) != 0)
+		{
+			Telemetry_Sequence_Number++;
+			EmulatorSendTelemetryFrame(Telemetry_Sequence_Number, Start_Time);
+			Telemetry_Deadline += Telemetry_Period * 100000LL;
+			continue;
+		}
+		
+		// A PC talking at the default baud rate while a faster one is in use produces framing errors, so fall back to the default baud rate
+		if (Emulator_Is_Framing_Error_Detected && (Emulator_Baud_Rate_Index != 0))
+		{
+			EmulatorSetBaudRate(0);
+			continue;
+		}
+		if (Byte != EMULATOR_PROTOCOL_FRAME_SYNCHRONIZATION_BYTE) continue;
+		if (EmulatorFirmwareReceiveRequest(&Sequence_Number, &Command, Payload, &Payload_Size) != 0) continue;
+		Emulator_Statistics.Firmware_Commands_Count++;
+		
+		// Only the configuration commands take a parameter
+		if ((Command == EMULATOR_FIRMWARE_COMMAND_SET_BAUD_RATE) || (Command == EMULATOR_FIRMWARE_COMMAND_SET_TELEMETRY_PERIOD) || (Command == EMULATOR_FIRMWARE_COMMAND_GET_INTERRUPT_PROFILE)) Expected_Payload_Size = 1;
+		else Expected_Payload_Size = 0;
+		if ((Command != EMULATOR_FIRMWARE_COMMAND_TELEMETRY) && (Command <= EMULATOR_FIRMWARE_COMMAND_GET_INTERRUPT_PROFILE) && (Payload_Size != Expected_Payload_Size))
+		{
+			Answer[0] = EMULATOR_FIRMWARE_ANSWER_STATUS_BAD_PAYLOAD_SIZE;
+			EmulatorFirmwareSendFrame(Sequence_Number, Command, Answer, 1);
+			continue;
+		}
+		
+		// Execute the command, the first answer byte is the status
+		Answer[0] = EMULATOR_FIRMWARE_ANSWER_STATUS_SUCCESS;
+		Answer_Size = 1;
+		switch (Command)
+		{
+			// The voltage is sampled by a 10-bit ADC with a 15V full scale
+			case EMULATOR_FIRMWARE_COMMAND_GET_BATTERY_VOLTAGE:
+				Value = EmulatorGetSensorValue(&Emulator_Battery_Voltage_Sensor) * 1023.f / 15.f + 0.5f;
+				if (Value > 1023) Value = 1023;
+				Answer[1] = Value >> 8;
+				Answer[2] = (unsigned char) Value;
+				Answer_Size = 3;
+				break;
+			
+			case EMULATOR_FIRMWARE_COMMAND_GET_DISTANCE_SENSOR_VALUE:
+				EmulatorEncodeDistanceSensorSample(Start_Time, &Answer[1]);
+				Answer_Size = 1 + EMULATOR_DISTANCE_SENSOR_SAMPLE_SIZE;
+				break;
+			
+			// The switch happens once the answer is sent
+			case EMULATOR_FIRMWARE_COMMAND_SET_BAUD_RATE:
+				if (Payload[0] >= sizeof(Emulator_Baud_Rates) / sizeof(Emulator_Baud_Rates[0]))
+				{
+					Answer[0] = EMULATOR_FIRMWARE_ANSWER_STATUS_BAD_PARAMETER;
+					break;
+				}
+				EmulatorFirmwareSendFrame(Sequence_Number, Command, Answer, Answer_Size);
+				EmulatorNegotiateBaudRate(Payload[0], EMULATOR_FIRMWARE_BAUD_RATE_PROBE_TIMEOUT);
+				continue;
+			
+			// There is no answer, the PC waits for the bootloader
+			case EMULATOR_FIRMWARE_COMMAND_ENTER_BOOTLOADER:
+				printf("Rebooting into the bootloader.\n");
+				return;
+			
+			case EMULATOR_FIRMWARE_COMMAND_GET_BOOT_TIME:
+				Answer[1] = Emulator_Boot_Time >> 24;
+				Answer[2] = Emulator_Boot_Time >> 16;
+				Answer[3] = Emulator_Boot_Time >> 8;
+				Answer[4] = (unsigned char) Emulator_Boot_Time;
+				Answer_Size = 5;
+				break;
+			
+			// The period is expressed in units of 100ms, 0 stops the telemetry
+			case EMULATOR_FIRMWARE_COMMAND_SET_TELEMETRY_PERIOD:
+				Telemetry_Period = Payload[0];
+				Telemetry_Deadline = EmulatorGetCurrentTime() + Telemetry_Period * 100000LL;
+				break;
+			
+			case EMULATOR_FIRMWARE_COMMAND_GET_CAPABILITIES:
+				Answer[1] = EMULATOR_PROTOCOL_VERSION;
+				Answer[2] = EMULATOR_PROTOCOL_REQUEST_MAXIMUM_PAYLOAD_SIZE;
+				Answer[3] = EMULATOR_PROTOCOL_MAXIMUM_PENDING_REQUESTS_COUNT;
+				Answer[4] = EMULATOR_PROTOCOL_SUPPORTED_COMMANDS_MASK >> 8;
+				Answer[5] = (unsigned char) EMULATOR_PROTOCOL_SUPPORTED_COMMANDS_MASK;
+				Answer_Size = 6;
+				break;
+			
+			// The pseudo-terminal never loses bytes, the line faults are injected on purpose and counted by the emulator statistics
+			case EMULATOR_FIRMWARE_COMMAND_GET_LINK_STATISTICS:
+				memset(&Answer[1], 0, 6);
+				Answer_Size = 7;
+				break;
+			
+			case EMULATOR_FIRMWARE_COMMAND_GET_INTERRUPT_PROFILE:
+				if (Payload[0] >= EMULATOR_INTERRUPT_SOURCES_COUNT)
+				{
+					Answer[0] = EMULATOR_FIRMWARE_ANSWER_STATUS_BAD_PARAMETER;
+					break;
+				}
+				EmulatorGetInterruptProfile(Payload[0], Start_Time, &Answer[1]);
+				Answer_Size = 11;
+				break;
+			
+			default:
+				Answer[0] = EMULATOR_FIRMWARE_ANSWER_STATUS_UNKNOWN_COMMAND;
+				break;
+		}
+		EmulatorFirmwareSendFrame(Sequence_Number, Command, Answer, Answer_Size);
+	}
+}
+
+/** Create the pseudo-terminal the command line interface will connect to.
+ * @return 0 on success,
+ * @return 1 if an error occurred.
+ */
+static int EmulatorOpenPseudoTerminal(void)
+{
+	struct termios Parameters;
+	char *String_Slave_File;
+	
+	Emulator_Master_ID = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((Emulator_Master_ID < 0) || (grantpt(Emulator_Master_ID) != 0) || (unlockpt(Emulator_Master_ID) != 0)) return 1;
+	String_Slave_File = ptsname(Emulator_Master_ID);
+	if (String_Slave_File == NULL) return 1;
+	
+	// Configure the line like the robot one, so the command line interface starts talking at the right baud rate even if it does not configure the line
+	Emulator_Slave_ID = open(String_Slave_File, O_RDWR | O_NOCTTY);
+	if ((Emulator_Slave_ID < 0) || (tcgetattr(Emulator_Slave_ID, &Parameters) != 0)) return 1;
+	cfmakeraw(&Parameters);
+	cfsetspeed(&Parameters, Emulator_Termios_Speeds[0]);
+	if (tcsetattr(Emulator_Slave_ID, TCSANOW, &Parameters) != 0) return 1;
+	
+	printf("%s\n", String_Slave_File);
+	return 0;
+}
+
+/** Display the program usage.
+ * @param String_Program_Name The program name.
+ */
+static void EmulatorDisplayUsage(char *String_Program_Name)
+{
+	printf("Usage : %s [Options]\n"
+		"Emulate a robot on a pseudo-terminal, its path is displayed on the first line.\n"
+		"Options :\n"
+		"   -b : start in the bootloader, like a robot turned on while the PC holds the line in break state\n"
+		"   -f Flash_File : load the flash content from this binary file and save it each time the bootloader reboots\n"
+		"   -l : deliver the bytes at the speed of the negotiated baud rate instead of the pseudo-terminal speed\n"
+		"   -e Microseconds : flash block erase time (default %d)\n"
+		"   -w Microseconds : flash block write time (default %d)\n"
+		"   -v Volts[,Volts...] : battery voltages to return in a loop, or \"random\" (default)\n"
+		"   -d Centimeters[,Centimeters...] : sonar distances to return in a loop, or \"random\" (default)\n"
+		"   -t Microseconds : boot time to return (default %d)\n"
+		"   -D Probability : probability for each byte to be lost\n"
+		"   -N Probability : probability for each byte to get a bit flipped\n"
+		"   -L Probability : probability for each transmission to be delayed\n"
+		"   -M Milliseconds : longest injected delay (default %d)\n"
+		"   -s Seed : random generator seed, so a faulty session can be reproduced (default 1)\n"
+		"Send SIGINT (Ctrl+C) to display the statistics and exit.\n", String_Program_Name, EMULATOR_DEFAULT_FLASH_ERASE_TIME, EMULATOR_DEFAULT_FLASH_WRITE_TIME, EMULATOR_DEFAULT_BOOT_TIME, EMULATOR_DEFAULT_MAXIMUM_DELAY);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Entry point
+//-------------------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+	int Option, Is_Bootloader_Started = 0;
+	unsigned int Seed = 1;
+	struct sigaction Signal_Action;
+	
+	// Allow the pseudo-terminal path to be read by a script while the emulator is running
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	
+	while ((Option = getopt(argc, argv, "bf:le:w:v:d:t:D:N:L:M:s:h")) != -1)
+	{
+		switch (Option)
+		{
+			case 'b':
+				Is_Bootloader_Started = 1;
+				break;
+			
+			case 'f':
+				Emulator_String_Flash_File = optarg;
+				break;
+			
+			case 'l':
+				Emulator_Is_Line_Speed_Emulated = 1;
+				break;
+			
+			case 'e':
+				Emulator_Flash_Erase_Time = atoi(optarg);
+				break;
+			
+			case 'w':
+				Emulator_Flash_Write_Time = atoi(optarg);
+				break;
+			
+			case 'v':
+				if (EmulatorParseSensorValues(&Emulator_Battery_Voltage_Sensor, optarg) != 0)
+				{
+					printf("Error : bad battery voltage values.\n");
+					return EXIT_FAILURE;
+				}
+				break;
+			
+			case 'd':
+				if (EmulatorParseSensorValues(&Emulator_Distance_Sensor, optarg) != 0)
+				{
+					printf("Error : bad sonar distance values.\n");
+					return EXIT_FAILURE;
+				}
+				break;
+			
+			case 't':
+				Emulator_Boot_Time = strtoul(optarg, NULL, 10);
+				break;
+			
+			case 'D':
+				Emulator_Drop_Probability = atof(optarg);
+				break;
+			
+			case 'N':
+				Emulator_Noise_Probability = atof(optarg);
+				break;
+			
+			case 'L':
+				Emulator_Delay_Probability = atof(optarg);
+				break;
+			
+			case 'M':
+				Emulator_Maximum_Delay = atoi(optarg);
+				break;
+			
+			case 's':
+				Seed = strtoul(optarg, NULL, 10);
+				break;
+			
+			default:
+				EmulatorDisplayUsage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	srand(Seed);
+	
+	// Display the statistics on exit (the system calls must be interrupted, so the exit request is seen)
+	memset(&Signal_Action, 0, sizeof(Signal_Action));
+	Signal_Action.sa_handler = EmulatorSignalHandler;
+	sigaction(SIGINT, &Signal_Action, NULL);
+	sigaction(SIGTERM, &Signal_Action, NULL);
+	
+	if (EmulatorOpenPseudoTerminal() != 0)
+	{
+		printf("Error : could not create the pseudo-terminal (%s).\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+	EmulatorLoadFlash();
+	
+	// Reboot between the firmware and the bootloader forever
+	while (1)
+	{
+		if (Is_Bootloader_Started) EmulatorRunBootloader();
+		else EmulatorRunFirmware();
+		Is_Bootloader_Started = !Is_Bootloader_Started;
+	}
+}
@@ -0,0 +1,348 @@
+/** @file Transport.c
+ * @see Transport.h for description.
+ * @author Adrien RICCIARDI
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h> // Needed by TCP_NODELAY
+#include <poll.h>
+#include <Serial_Port.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h> // Needed by ioctl()
+#include <sys/socket.h>
+#include <sys/un.h> // Needed by struct sockaddr_un
+#include <termios.h> // Needed by tcdrain() and tcflush()
+#include <time.h> // Needed by clock_gettime()
+#include <unistd.h>
+#include "Configuration.h"
+#include "Transport.h"
+
+//-------------------------------------------------------------------------------------------------
+// Private constants
+//-------------------------------------------------------------------------------------------------
+/** The prefix telling that the address is a TCP one. */
+#define TRANSPORT_TCP_ADDRESS_PREFIX "tcp:"
+/** The prefix telling that the address is a UNIX socket one. */
+#define TRANSPORT_UNIX_ADDRESS_PREFIX "unix:"
+/** How many milliseconds to wait at most for the system to accept the pending bytes (the slowest baud rate sends the whole transmission buffer in less than 400ms). */
+#define TRANSPORT_WRITE_TIMEOUT 5000
+
+//-------------------------------------------------------------------------------------------------
+// Private functions
+//-------------------------------------------------------------------------------------------------
+/** Connect to a serial-to-network bridge.
+ * @param String_Address The address without its "tcp:" prefix, written "Host:Port".
+ * @return The connected socket,
+ * @return -1 if the connection failed.
+ */
+static int TransportConnectSocket(char *String_Address)
+{
+	char String_Host[256], *Pointer_Port;
+	struct addrinfo Hints, *Pointer_Addresses, *Pointer_Address;
+	int Socket = -1, Is_Enabled = 1;
+	size_t Length;
+	
+	// The port follows the last colon, so the host can contain colons
+	Pointer_Port = strrchr(String_Address, ':');
+	if (Pointer_Port == NULL) return -1;
+	Length = Pointer_Port - String_Address;
+	if (Length >= sizeof(String_Host)) return -1;
+	memcpy(String_Host, String_Address, Length);
+	String_Host[Length] = 0;
+	
+	memset(&Hints, 0, sizeof(Hints));
+	Hints.ai_family = AF_UNSPEC;
+	Hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(String_Host, Pointer_Port + 1, &Hints, &Pointer_Addresses) != 0)
+	{
+		Debug("[%s] Could not resolve the host '%s'.\n", __func__, String_Host);
+		return -1;
+	}
+	
+	for (Pointer_Address = Pointer_Addresses; Pointer_Address != NULL; Pointer_Address = Pointer_Address->ai_next)
+	{
+		Socket = socket(Pointer_Address->ai_family, Pointer_Address->ai_socktype, Pointer_Address->ai_protocol);
+		if (Socket < 0) continue;
+		if (connect(Socket, Pointer_Address->ai_addr, Pointer_Address->ai_addrlen) == 0) break;
+		close(Socket);
+		Socket = -1;
+	}
+	freeaddrinfo(Pointer_Addresses);
+	if (Socket < 0) return -1;
+	
+	// The frames are small and already gathered, do not let the system delay them
+	setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, &Is_Enabled, sizeof(Is_Enabled));
+	return Socket;
+}
+
+/** Connect to the daemon sharing the robot.
+ * @param String_Socket_File The daemon socket file.
+ * @return The connected socket,
+ * @return -1 if the connection failed.
+ */
+static int TransportConnectUnixSocket(char *String_Socket_File)
+{
+	struct sockaddr_un Address;
+	int Socket;
+	
+	if (strlen(String_Socket_File) >= sizeof(Address.sun_path)) return -1;
+	memset(&Address, 0, sizeof(Address));
+	Address.sun_family = AF_UNIX;
+	strcpy(Address.sun_path, String_Socket_File);
+	
+	Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (Socket < 0) return -1;
+	if (connect(Socket, (struct sockaddr *) &Address, sizeof(Address)) != 0)
+	{
+		Debug("[%s] Could not connect to the daemon socket '%s'.\n", __func__, String_Socket_File);
+		close(Socket);
+		return -1;
+	}
+	return Socket;
+}
+
+/** Open the transport connection.
+ * @param Pointer_Transport The transport, its type and address must be set.
+ * @param Baud_Rate The serial port baud rate.
+ * @return 0 on success,
+ * @return -1 if the connection failed.
+ */
+static int TransportConnect(TTransport *Pointer_Transport, unsigned int Baud_Rate)
+{
+	TSerialPortID Serial_Port_ID;
+	
+	if (Pointer_Transport->Type == TRANSPORT_TYPE_TCP_SOCKET) Pointer_Transport->File_Descriptor = TransportConnectSocket(Pointer_Transport->String_Address + sizeof(TRANSPORT_TCP_ADDRESS_PREFIX) - 1);
+	else if (Pointer_Transport->Type == TRANSPORT_TYPE_UNIX_SOCKET) Pointer_Transport->File_Descriptor = TransportConnectUnixSocket(Pointer_Transport->String_Address + sizeof(TRANSPORT_UNIX_ADDRESS_PREFIX) - 1);
+	else
+	{
+		// Let the library configure the serial port, its file descriptor is then directly used
+		if (SerialPortOpen(Pointer_Transport->String_Address, Baud_Rate, &Serial_Port_ID) != 0) Pointer_Transport->File_Descriptor = -1;
+		else Pointer_Transport->File_Descriptor = Serial_Port_ID;
+	}
+	if (Pointer_Transport->File_Descriptor < 0) return -1;
+	
+	// The deadlines are handled by poll(), so a system call must never block
+	fcntl(Pointer_Transport->File_Descriptor, F_SETFL, fcntl(Pointer_Transport->File_Descriptor, F_GETFL) | O_NONBLOCK);
+	
+	Pointer_Transport->Reception_Buffer_Read_Index = 0;
+	Pointer_Transport->Reception_Buffer_Bytes_Count = 0;
+	Pointer_Transport->Transmission_Buffer_Bytes_Count = 0;
+	return 0;
+}
+
+/** Close the transport connection without sending the pending bytes.
+ * @param Pointer_Transport The transport.
+ */
+static void TransportDisconnect(TTransport *Pointer_Transport)
+{
+	if (Pointer_Transport->File_Descriptor < 0) return;
+	
+	if (Pointer_Transport->Type != TRANSPORT_TYPE_SERIAL_PORT) close(Pointer_Transport->File_Descriptor);
+	else SerialPortClose(Pointer_Transport->File_Descriptor);
+	Pointer_Transport->File_Descriptor = -1;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Public functions
+//-------------------------------------------------------------------------------------------------
+long long TransportGetCurrentTime(void)
+{
+	struct timespec Time;
+	
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return (long long) Time.tv_sec * 1000 + Time.tv_nsec / 1000000;
+}
+
+int TransportOpen(TTransport *Pointer_Transport, char *String_Address, unsigned int Baud_Rate)
+{
+	memset(Pointer_Transport, 0, sizeof(TTransport));
+	Pointer_Transport->String_Address = String_Address;
+	if (strncmp(String_Address, TRANSPORT_TCP_ADDRESS_PREFIX, sizeof(TRANSPORT_TCP_ADDRESS_PREFIX) - 1) == 0) Pointer_Transport->Type = TRANSPORT_TYPE_TCP_SOCKET;
+	else if (strncmp(String_Address, TRANSPORT_UNIX_ADDRESS_PREFIX, sizeof(TRANSPORT_UNIX_ADDRESS_PREFIX) - 1) == 0) Pointer_Transport->Type = TRANSPORT_TYPE_UNIX_SOCKET;
+	else Pointer_Transport->Type = TRANSPORT_TYPE_SERIAL_PORT;
+	
+	return TransportConnect(Pointer_Transport, Baud_Rate);
+}
+
+void TransportClose(TTransport *Pointer_Transport)
+{
+	if (Pointer_Transport->File_Descriptor < 0) return;
+	
+	TransportFlush(Pointer_Transport);
+	TransportDisconnect(Pointer_Transport);
+}
+
+int TransportSetBaudRate(TTransport *Pointer_Transport, unsigned int Baud_Rate)
+{
+	if (Pointer_Transport->Type != TRANSPORT_TYPE_SERIAL_PORT) return 0;
+	
+	// The last bytes must leave the serial port before it is reconfigured
+	TransportFlush(Pointer_Transport);
+	tcdrain(Pointer_Transport->File_Descriptor);
+	TransportDisconnect(Pointer_Transport);
+	return TransportConnect(Pointer_Transport, Baud_Rate);
+}
+
+int TransportIsBaudRateChangeable(TTransport *Pointer_Transport)
+{
+	if (Pointer_Transport->Type == TRANSPORT_TYPE_SERIAL_PORT) return 1;
+	return 0;
+}
+
+void TransportWriteByte(TTransport *Pointer_Transport, unsigned char Byte)
+{
+	if (Pointer_Transport->Transmission_Buffer_Bytes_Count >= TRANSPORT_TRANSMISSION_BUFFER_SIZE) TransportFlush(Pointer_Transport);
+	
+	Pointer_Transport->Transmission_Buffer[Pointer_Transport->Transmission_Buffer_Bytes_Count] = Byte;
+	Pointer_Transport->Transmission_Buffer_Bytes_Count++;
+}
+
+void TransportWriteBuffer(TTransport *Pointer_Transport, const void *Pointer_Buffer, int Bytes_Count)
+{
+	const unsigned char *Pointer_Bytes = Pointer_Buffer;
+	int Size;
+	
+	while (Bytes_Count > 0)
+	{
+		if (Pointer_Transport->Transmission_Buffer_Bytes_Count >= TRANSPORT_TRANSMISSION_BUFFER_SIZE) TransportFlush(Pointer_Transport);
+		
+		Size = TRANSPORT_TRANSMISSION_BUFFER_SIZE - Pointer_Transport->Transmission_Buffer_Bytes_Count;
+		if (Size > Bytes_Count) Size = Bytes_Count;
+		memcpy(&Pointer_Transport->Transmission_Buffer[Pointer_Transport->Transmission_Buffer_Bytes_Count], Pointer_Bytes, Size);
+		Pointer_Transport->Transmission_Buffer_Bytes_Count += Size;
+		Pointer_Bytes += Size;
+		Bytes_Count -= Size;
+	}
+}
+
+int TransportFlush(TTransport *Pointer_Transport)
+{
+	struct pollfd Poll_File_Descriptor;
+	int Offset = 0, Written_Bytes_Count, Timeout;
+	long long Deadline;
+	
+	if (Pointer_Transport->Transmission_Buffer_Bytes_Count == 0) return 0;
+	
+	Deadline = TransportGetCurrentTime() + TRANSPORT_WRITE_TIMEOUT;
+	while (Offset < Pointer_Transport->Transmission_Buffer_Bytes_Count)
+	{
+		if (Pointer_Transport->File_Descriptor < 0) break;
+		
+		Written_Bytes_Count = write(Pointer_Transport->File_Descriptor, &Pointer_Transport->Transmission_Buffer[Offset], Pointer_Transport->Transmission_Buffer_Bytes_Count - Offset);
+		Pointer_Transport->Write_Calls_Count++;
+		if (Written_Bytes_Count > 0)
+		{
+			Offset += Written_Bytes_Count;
+			continue;
+		}
+		if ((Written_Bytes_Count < 0) && (errno != EAGAIN) && (errno != EINTR)) break;
+		
+		// The system buffer is full, wait for room
+		Timeout = Deadline - TransportGetCurrentTime();
+		if (Timeout <= 0) break;
+		Poll_File_Descriptor.fd = Pointer_Transport->File_Descriptor;
+		Poll_File_Descriptor.events = POLLOUT;
+		poll(&Poll_File_Descriptor, 1, Timeout);
+	}
+	
+	Written_Bytes_Count = Pointer_Transport->Transmission_Buffer_Bytes_Count;
+	Pointer_Transport->Transmission_Buffer_Bytes_Count = 0;
+	if (Offset < Written_Bytes_Count)
+	{
+		Debug("[%s] Only %d bytes out of %d could be sent.\n", __func__, Offset, Written_Bytes_Count);
+		return -1;
+	}
+	return 0;
+}
+
+int TransportReadByte(TTransport *Pointer_Transport, unsigned char *Pointer_Byte, long long Deadline)
+{
+	struct pollfd Poll_File_Descriptor;
+	int Read_Bytes_Count, Timeout;
+	
+	// Send the request before waiting for its answer
+	TransportFlush(Pointer_Transport);
+	
+	while (Pointer_Transport->Reception_Buffer_Read_Index >= Pointer_Transport->Reception_Buffer_Bytes_Count)
+	{
+		if (Pointer_Transport->File_Descriptor < 0) return -1;
+		
+		// Get all the bytes that are already available at once
+		Read_Bytes_Count = read(Pointer_Transport->File_Descriptor, Pointer_Transport->Reception_Buffer, TRANSPORT_RECEPTION_BUFFER_SIZE);
+		Pointer_Transport->Read_Calls_Count++;
+		if (Read_Bytes_Count > 0)
+		{
+			Pointer_Transport->Reception_Buffer_Read_Index = 0;
+			Pointer_Transport->Reception_Buffer_Bytes_Count = Read_Bytes_Count;
+			break;
+		}
+		if (Read_Bytes_Count == 0) return -1; // The other end closed the connection
+		if ((errno != EAGAIN) && (errno != EINTR)) return -1;
+		
+		// Wait for more bytes
+		Timeout = Deadline - TransportGetCurrentTime();
+		if (Timeout <= 0) return 1;
+		Poll_File_Descriptor.fd = Pointer_Transport->File_Descriptor;
+		Poll_File_Descriptor.events = POLLIN;
+		if (poll(&Poll_File_Descriptor, 1, Timeout) == 0) return 1;
+		if ((Poll_File_Descriptor.revents & (POLLERR | POLLHUP | POLLNVAL)) && !(Poll_File_Descriptor.revents & POLLIN)) return -1;
+	}
+	
+	*Pointer_Byte = Pointer_Transport->Reception_Buffer[Pointer_Transport->Reception_Buffer_Read_Index];
+	Pointer_Transport->Reception_Buffer_Read_Index++;
+	return 0;
+}
+
+void TransportWaitForBytes(TTransport *Pointer_Transports[], int Transports_Count, long long Deadline, int *Pointer_Statuses)
+{
+	struct pollfd Poll_File_Descriptors[TRANSPORT_WAIT_MAXIMUM_TRANSPORTS_COUNT];
+	int i, Timeout;
+	
+	Timeout = Deadline - TransportGetCurrentTime();
+	if (Timeout < 0) Timeout = 0;
+	
+	for (i = 0; i < Transports_Count; i++)
+	{
+		// Send all the bytes gathered so far at once
+		TransportFlush(Pointer_Transports[i]);
+		
+		// Do not wait if some bytes were received but not read yet
+		if (Pointer_Transports[i]->Reception_Buffer_Read_Index < Pointer_Transports[i]->Reception_Buffer_Bytes_Count) Timeout = 0;
+		
+		Poll_File_Descriptors[i].fd = Pointer_Transports[i]->File_Descriptor;
+		Poll_File_Descriptors[i].events = POLLIN;
+		Poll_File_Descriptors[i].revents = 0;
+	}
+	poll(Poll_File_Descriptors, Transports_Count, Timeout);
+	
+	for (i = 0; i < Transports_Count; i++)
+	{
+		if ((Poll_File_Descriptors[i].revents & POLLIN) || (Pointer_Transports[i]->Reception_Buffer_Read_Index < Pointer_Transports[i]->Reception_Buffer_Bytes_Count)) Pointer_Statuses[i] = 1;
+		else if (Poll_File_Descriptors[i].revents & (POLLERR | POLLHUP | POLLNVAL)) Pointer_Statuses[i] = -1;
+		else Pointer_Statuses[i] = 0;
+	}
+}
+
+void TransportDiscardReceivedBytes(TTransport *Pointer_Transport)
+{
+	if (Pointer_Transport->Type == TRANSPORT_TYPE_SERIAL_PORT) tcflush(Pointer_Transport->File_Descriptor, TCIFLUSH);
+	Pointer_Transport->Reception_Buffer_Read_Index = 0;
+	Pointer_Transport->Reception_Buffer_Bytes_Count = 0;
+}
+
+void TransportSetBreak(TTransport *Pointer_Transport, int Is_Break_Enabled)
+{
+	if (Pointer_Transport->Type != TRANSPORT_TYPE_SERIAL_PORT) return;
+	
+	if (Is_Break_Enabled)
+	{
+		// Do not truncate the bytes being sent
+		TransportFlush(Pointer_Transport);
+		tcdrain(Pointer_Transport->File_Descriptor);
+		ioctl(Pointer_Transport->File_Descriptor, TIOCSBRK);
+	}
+	else ioctl(Pointer_Transport->File_Descriptor, TIOCCBRK);
+}
@@ -0,0 +1,130 @@
+/** @file Transport.h
+ * Buffered byte stream to the robot. The robot is reached through a serial port (a real tty or a pseudo-terminal like the emulator one), through a TCP socket (a serial-to-network bridge, the address is written "tcp:Host:Port") or through a UNIX socket (a daemon sharing the robot, the address is written "unix:Socket_File").
+ * The written bytes are gathered and sent with as few system calls as possible when the program waits for an answer, and every read is bounded by a deadline, so a robot that does not answer can never block the program.
+ * @author Adrien RICCIARDI
+ */
+#ifndef H_TRANSPORT_H
+#define H_TRANSPORT_H
+
+//-------------------------------------------------------------------------------------------------
+// Constants
+//-------------------------------------------------------------------------------------------------
+/** How many received bytes can be buffered. */
+#define TRANSPORT_RECEPTION_BUFFER_SIZE 4096
+/** How many bytes can be gathered before being sent. */
+#define TRANSPORT_TRANSMISSION_BUFFER_SIZE 4096
+/** How many transports can be waited for at the same time. */
+#define TRANSPORT_WAIT_MAXIMUM_TRANSPORTS_COUNT 64
+
+//-------------------------------------------------------------------------------------------------
+// Types
+//-------------------------------------------------------------------------------------------------
+/** All ways to reach a robot. */
+typedef enum
+{
+	TRANSPORT_TYPE_SERIAL_PORT, //!< A tty or a pseudo-terminal, its baud rate can be changed and it can send a break.
+	TRANSPORT_TYPE_TCP_SOCKET, //!< A TCP connection to a serial-to-network bridge, the bridge owns the serial port settings.
+	TRANSPORT_TYPE_UNIX_SOCKET //!< A connection to the daemon sharing the robot (see Daemon.h), only the firmware frames can be exchanged.
+} TTransportType;
+
+/** A connection to a robot. */
+typedef struct
+{
+	TTransportType Type; //!< How the robot is reached.
+	int File_Descriptor; //!< The opened serial port or socket, -1 if the transport is closed.
+	char *String_Address; //!< The serial port device or the TCP address, needed to reopen a serial port at another baud rate.
+	unsigned char Reception_Buffer[TRANSPORT_RECEPTION_BUFFER_SIZE]; //!< The received bytes that were not read yet.
+	int Reception_Buffer_Read_Index; //!< The next byte to read from the reception buffer.
+	int Reception_Buffer_Bytes_Count; //!< How many bytes the reception buffer contains, including the already read ones.
+	unsigned char Transmission_Buffer[TRANSPORT_TRANSMISSION_BUFFER_SIZE]; //!< The bytes waiting to be sent.
+	int Transmission_Buffer_Bytes_Count; //!< How many bytes are waiting to be sent.
+	unsigned long Read_Calls_Count; //!< How many read() system calls were made.
+	unsigned long Write_Calls_Count; //!< How many write() system calls were made.
+} TTransport;
+
+//-------------------------------------------------------------------------------------------------
+// Functions
+//-------------------------------------------------------------------------------------------------
+/** Get a monotonic time reference, all deadlines are expressed with it.
+ * @return The current time in milliseconds.
+ */
+long long TransportGetCurrentTime(void);
+
+/** Connect to a robot.
+ * @param Pointer_Transport The transport to initialize.
+ * @param String_Address The serial port device, "tcp:Host:Port" to connect to a serial-to-network bridge, or "unix:Socket_File" to connect to a daemon. The string must stay valid until the transport is closed.
+ * @param Baud_Rate The serial port baud rate (it is ignored by socket transports).
+ * @return 0 on success,
+ * @return -1 if the connection failed.
+ */
+int TransportOpen(TTransport *Pointer_Transport, char *String_Address, unsigned int Baud_Rate);
+
+/** Send the pending bytes, then close the connection. Closing an already closed transport does nothing.
+ * @param Pointer_Transport The transport.
+ */
+void TransportClose(TTransport *Pointer_Transport);
+
+/** Change the serial port baud rate, the pending bytes are sent at the previous baud rate and the received bytes are discarded.
+ * @param Pointer_Transport The transport.
+ * @param Baud_Rate The new baud rate.
+ * @return 0 on success,
+ * @return -1 if the serial port could not be reopened (the transport is closed).
+ */
+int TransportSetBaudRate(TTransport *Pointer_Transport, unsigned int Baud_Rate);
+
+/** Tell whether the transport can change the robot link baud rate.
+ * @param Pointer_Transport The transport.
+ * @return 1 if the baud rate can be changed, 0 if the link baud rate is fixed by a bridge or a daemon.
+ */
+int TransportIsBaudRateChangeable(TTransport *Pointer_Transport);
+
+/** Queue a byte for transmission.
+ * @param Pointer_Transport The transport.
+ * @param Byte The byte to send.
+ */
+void TransportWriteByte(TTransport *Pointer_Transport, unsigned char Byte);
+
+/** Queue bytes for transmission.
+ * @param Pointer_Transport The transport.
+ * @param Pointer_Buffer The bytes to send.
+ * @param Bytes_Count How many bytes to send.
+ */
+void TransportWriteBuffer(TTransport *Pointer_Transport, const void *Pointer_Buffer, int Bytes_Count);
+
+/** Send all pending bytes.
+ * @param Pointer_Transport The transport.
+ * @return 0 on success,
+ * @return -1 if the bytes could not be sent (they are discarded).
+ */
+int TransportFlush(TTransport *Pointer_Transport);
+
+/** Send the pending bytes, then wait for a byte until the deadline.
+ * @param Pointer_Transport The transport.
+ * @param Pointer_Byte On output, contain the received byte.
+ * @param Deadline When to stop waiting (in milliseconds, see TransportGetCurrentTime()). Use a past deadline to get a byte only if one is already available.
+ * @return 0 if a byte was received,
+ * @return 1 if no byte was received in time,
+ * @return -1 if the connection is broken.
+ */
+int TransportReadByte(TTransport *Pointer_Transport, unsigned char *Pointer_Byte, long long Deadline);
+
+/** Send the pending bytes of several transports, then wait until any of them received bytes or the deadline is reached.
+ * @param Pointer_Transports The transports to wait for (no more than TRANSPORT_WAIT_MAXIMUM_TRANSPORTS_COUNT).
+ * @param Transports_Count How many transports to wait for.
+ * @param Deadline When to stop waiting (in milliseconds, see TransportGetCurrentTime()).
+ * @param Pointer_Statuses On output, contain for each transport 1 if bytes can be read, 0 if nothing was received, -1 if the connection is broken.
+ */
+void TransportWaitForBytes(TTransport *Pointer_Transports[], int Transports_Count, long long Deadline, int *Pointer_Statuses);
+
+/** Discard the bytes received so far.
+ * @param Pointer_Transport The transport.
+ */
+void TransportDiscardReceivedBytes(TTransport *Pointer_Transport);
+
+/** Send the pending bytes, then hold the serial line in break state or release it. Socket transports ignore this request.
+ * @param Pointer_Transport The transport.
+ * @param Is_Break_Enabled Set to 1 to start the break, set to 0 to stop it.
+ */
+void TransportSetBreak(TTransport *Pointer_Transport, int Is_Break_Enabled);
+
+#endif